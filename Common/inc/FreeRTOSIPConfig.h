@@ -18,7 +18,7 @@
 #define ipconfigUSE_CALLBACKS							1
 #define ipconfigCHECK_IP_QUEUE_SPACE					1
 #define ipconfigETHERNET_DRIVER_FILTERS_FRAME_TYPES     1
-#define ipconfigETHERNET_DRIVER_FILTERS_PACKETS			0
+#define ipconfigETHERNET_DRIVER_FILTERS_PACKETS			1
 #define ipconfigALLOW_SOCKET_SEND_WITHOUT_BIND          0
 #define ipconfigSOCKET_HAS_USER_WAKE_CALLBACK    		1
 #define ipconfigSUPPORT_SELECT_FUNCTION 				1
@@ -251,6 +251,15 @@
 #define  USE_HAL_WWDG_REGISTER_CALLBACKS      0U    /* WWDG register callback disabled      */
 #define  USE_HAL_XSPI_REGISTER_CALLBACKS      0U    /* XSPI register callback disabled      */
 
+/* ############################################ Ethernet Configuration ############################################## */
+/* Ethernet DMA descriptor ring depths, may be overridden from the build */
+#ifndef ETH_TX_DESC_CNT
+#define ETH_TX_DESC_CNT         4U  /* number of Ethernet Tx DMA descriptors */
+#endif
+#ifndef ETH_RX_DESC_CNT
+#define ETH_RX_DESC_CNT         8U  /* number of Ethernet Rx DMA descriptors */
+#endif
+
 /* ############################################ SPI peripheral configuration ######################################## */
 
 /* CRC FEATURE: Use to activate CRC feature inside HAL SPI Driver
@@ -221,8 +221,15 @@
 #define  USE_HAL_WWDG_REGISTER_CALLBACKS    0U /* WWDG register callback disabled    */
 
 /* ########################### Ethernet Configuration ######################### */
+/* Depth of the Ethernet DMA descriptor rings, shared by the HAL and the network interface.
+   Each Rx descriptor holds a network buffer, a deployment picks its own depth from the build,
+   e.g. -DETH_RX_DESC_CNT=16U */
+#ifndef ETH_TX_DESC_CNT
 #define ETH_TX_DESC_CNT         4U  /* number of Ethernet Tx DMA descriptors */
-#define ETH_RX_DESC_CNT         4U  /* number of Ethernet Rx DMA descriptors */
+#endif
+#ifndef ETH_RX_DESC_CNT
+#define ETH_RX_DESC_CNT         8U  /* number of Ethernet Rx DMA descriptors */
+#endif
 
 #define ETH_MAC_ADDR0    (0x02UL)
 #define ETH_MAC_ADDR1    (0x00UL)
@@ -298,6 +298,7 @@ static void prvProcessIPEventsAndTimers( void )
             /* The network hardware driver has received a new packet.  A
              * pointer to the received buffer is located in the pvData member
              * of the received event structure. */
+            ipSET_NETWORK_BUFFER_OWNER( ( NetworkBufferDescriptor_t * ) xReceivedEvent.pvData, eNetworkBufferStack );
             prvHandleEthernetPacket( ( NetworkBufferDescriptor_t * ) xReceivedEvent.pvData );
             break;
 
@@ -381,6 +382,7 @@ static void prvProcessIPEventsAndTimers( void )
             /* The network stack has generated a packet to send.  A
              * pointer to the generated buffer is located in the pvData
              * member of the received event structure. */
+            ipSET_NETWORK_BUFFER_OWNER( ( NetworkBufferDescriptor_t * ) xReceivedEvent.pvData, eNetworkBufferStack );
             vProcessGeneratedUDPPacket( ( NetworkBufferDescriptor_t * ) xReceivedEvent.pvData );
             break;
 
@@ -1665,6 +1667,7 @@ static void prvProcessEthernetPacket( NetworkBufferDescriptor_t * const pxNetwor
             if( pxARPWaitingNetworkBuffer == NULL )
             {
                 pxARPWaitingNetworkBuffer = pxNetworkBuffer;
+                ipSET_NETWORK_BUFFER_OWNER( pxNetworkBuffer, eNetworkBufferARPWaiting );
                 vIPTimerStartARPResolution( ipARP_RESOLUTION_MAX_DELAY );
 
                 iptraceDELAYED_ARP_REQUEST_STARTED();
@@ -2078,13 +2081,24 @@ void vReturnEthernetFrame( NetworkBufferDescriptor_t * pxNetworkBuffer,
     #if ( ipconfigZERO_COPY_TX_DRIVER != 0 )
         if( xReleaseAfterSend == pdFALSE )
         {
-            pxNewBuffer = pxDuplicateNetworkBufferWithDescriptor( pxNetworkBuffer, pxNetworkBuffer->xDataLength );
+            /* The caller only releases the frame after this call, so the driver
+             * can share it. A copy is only made when it is not a pool buffer. */
+            pxNewBuffer = pxNetworkBufferAddReference( pxNetworkBuffer );
+
+            if( pxNewBuffer == NULL )
+            {
+                pxNewBuffer = pxDuplicateNetworkBufferWithDescriptor( pxNetworkBuffer, pxNetworkBuffer->xDataLength );
+
+                if( pxNewBuffer != NULL )
+                {
+                    /* Want no rounding up. */
+                    pxNewBuffer->xDataLength = pxNetworkBuffer->xDataLength;
+                }
+            }
 
             if( pxNewBuffer != NULL )
             {
                 xReleaseAfterSend = pdTRUE;
-                /* Want no rounding up. */
-                pxNewBuffer->xDataLength = pxNetworkBuffer->xDataLength;
             }
 
             pxNetworkBuffer = pxNewBuffer;
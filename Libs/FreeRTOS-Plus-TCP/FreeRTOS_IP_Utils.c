@@ -110,6 +110,15 @@ typedef union xUnionPtr
     const uint8_t * u8ptr;   /**< The pointer member to an 8-bit variable. */
 } xUnionPtr_t;
 
+/* The add-with-carry kernel needs Thumb-2 (ARMv7-M or ARMv8-M Mainline) and
+ * GCC style inline assembly. */
+#if ( ipconfigIS_ENABLED( ipconfigCHECKSUM_USE_CARRY_CHAIN ) && defined( __GNUC__ ) && \
+    ( defined( __ARM_ARCH_7M__ ) || defined( __ARM_ARCH_7EM__ ) || defined( __ARM_ARCH_8M_MAIN__ ) || defined( __ARM_ARCH_8_1M_MAIN__ ) ) )
+    #define ipCHECKSUM_CARRY_CHAIN    1
+#else
+    #define ipCHECKSUM_CARRY_CHAIN    0
+#endif
+
 /*
  * Returns the network buffer descriptor that owns a given packet buffer.
  */
@@ -118,6 +127,12 @@ static NetworkBufferDescriptor_t * prvPacketBuffer_to_NetworkBuffer( const void
 
 static uintptr_t void_ptr_to_uintptr( const void * pvPointer );
 
+#if ( ipCHECKSUM_CARRY_CHAIN != 0 )
+    static uint32_t prvChecksumCarryChain( uint32_t ulSum,
+                                           const uint32_t * pulSource,
+                                           size_t uxBlockCount );
+#endif
+
 static BaseType_t prvChecksumProtocolChecks( size_t uxBufferLength,
                                              struct xPacketSummary * pxSet );
 
@@ -1253,7 +1268,6 @@ uint16_t usGenerateChecksum( uint16_t usSum,
 {
 /* MISRA/PC-lint doesn't like the use of unions. Here, they are a great
  * aid though to optimise the calculations. */
-    xUnion32_t xSum2;
     xUnion32_t xSum;
     xUnion32_t xTerm;
     xUnionPtr_t xSource;
@@ -1310,58 +1324,75 @@ uint16_t usGenerateChecksum( uint16_t usSum,
 
     /* Word (32-bit) aligned, do the most part. */
 
-    uxSize = ( size_t ) ( ( uxDataLengthBytes / 4U ) * 4U );
-
-    if( uxSize >= ( 3U * sizeof( uint32_t ) ) )
+    #if ( ipCHECKSUM_CARRY_CHAIN != 0 )
     {
-        uxSize -= ( 3U * sizeof( uint32_t ) );
+        uxSize = uxDataLengthBytes / ( 4U * sizeof( uint32_t ) );
+
+        if( uxSize != 0U )
+        {
+            /* The kernel returns the end-around carry already folded in. */
+            xSum.u32 = prvChecksumCarryChain( xSum.u32, xSource.u32ptr, uxSize );
+            xSource.u32ptr = &( xSource.u32ptr[ uxSize * 4U ] );
+        }
     }
-    else
+    #else /* if ( ipCHECKSUM_CARRY_CHAIN != 0 ) */
     {
-        uxSize = 0U;
-    }
+        xUnion32_t xSum2;
 
-    /* In this loop, four 32-bit additions will be done, in total 16 bytes.
-     * Indexing with constants (0,1,2,3) gives faster code than using
-     * post-increments. */
-    for( ulX = 0U; ulX < uxSize; ulX += 4U * sizeof( uint32_t ) )
-    {
-        /* Use a secondary Sum2, just to see if the addition produced an
-         * overflow. */
-        xSum2.u32 = xSum.u32 + xSource.u32ptr[ 0 ];
+        uxSize = ( size_t ) ( ( uxDataLengthBytes / 4U ) * 4U );
 
-        if( xSum2.u32 < xSum.u32 )
+        if( uxSize >= ( 3U * sizeof( uint32_t ) ) )
         {
-            ulCarry++;
+            uxSize -= ( 3U * sizeof( uint32_t ) );
         }
-
-        /* Now add the secondary sum to the major sum, and remember if there was
-         * a carry. */
-        xSum.u32 = xSum2.u32 + xSource.u32ptr[ 1 ];
-
-        if( xSum2.u32 > xSum.u32 )
+        else
         {
-            ulCarry++;
+            uxSize = 0U;
         }
 
-        /* And do the same trick once again for indexes 2 and 3 */
-        xSum2.u32 = xSum.u32 + xSource.u32ptr[ 2 ];
-
-        if( xSum2.u32 < xSum.u32 )
+        /* In this loop, four 32-bit additions will be done, in total 16 bytes.
+         * Indexing with constants (0,1,2,3) gives faster code than using
+         * post-increments. */
+        for( ulX = 0U; ulX < uxSize; ulX += 4U * sizeof( uint32_t ) )
         {
-            ulCarry++;
-        }
+            /* Use a secondary Sum2, just to see if the addition produced an
+             * overflow. */
+            xSum2.u32 = xSum.u32 + xSource.u32ptr[ 0 ];
 
-        xSum.u32 = xSum2.u32 + xSource.u32ptr[ 3 ];
+            if( xSum2.u32 < xSum.u32 )
+            {
+                ulCarry++;
+            }
 
-        if( xSum2.u32 > xSum.u32 )
-        {
-            ulCarry++;
-        }
+            /* Now add the secondary sum to the major sum, and remember if there was
+             * a carry. */
+            xSum.u32 = xSum2.u32 + xSource.u32ptr[ 1 ];
+
+            if( xSum2.u32 > xSum.u32 )
+            {
+                ulCarry++;
+            }
+
+            /* And do the same trick once again for indexes 2 and 3 */
+            xSum2.u32 = xSum.u32 + xSource.u32ptr[ 2 ];
+
+            if( xSum2.u32 < xSum.u32 )
+            {
+                ulCarry++;
+            }
 
-        /* And finally advance the pointer 4 * 4 = 16 bytes. */
-        xSource.u32ptr = &( xSource.u32ptr[ 4 ] );
+            xSum.u32 = xSum2.u32 + xSource.u32ptr[ 3 ];
+
+            if( xSum2.u32 > xSum.u32 )
+            {
+                ulCarry++;
+            }
+
+            /* And finally advance the pointer 4 * 4 = 16 bytes. */
+            xSource.u32ptr = &( xSource.u32ptr[ 4 ] );
+        }
     }
+    #endif /* if ( ipCHECKSUM_CARRY_CHAIN != 0 ) */
 
     /* Now add all carries. */
     xSum.u32 = ( uint32_t ) xSum.u16[ 0 ] + xSum.u16[ 1 ] + ulCarry;
@@ -1416,6 +1447,60 @@ uint16_t usGenerateChecksum( uint16_t usSum,
 }
 /*-----------------------------------------------------------*/
 
+#if ( ipCHECKSUM_CARRY_CHAIN != 0 )
+
+/**
+ * @brief Add blocks of 16 bytes to a checksum with a chain of ADCS
+ *        instructions, so the carry of every addition is fed into the next one
+ *        instead of being counted separately.
+ *
+ * @param[in] ulSum The sum so far.
+ * @param[in] pulSource The 32-bit aligned data.
+ * @param[in] uxBlockCount The number of 16-byte blocks, must be non-zero.
+ *
+ * @return The one's complement sum of ulSum and the data, as 32 bits. Its
+ *         two 16-bit halves fold to the same checksum as the C loop.
+ */
+    static uint32_t prvChecksumCarryChain( uint32_t ulSum,
+                                           const uint32_t * pulSource,
+                                           size_t uxBlockCount )
+    {
+        uint32_t ulResult = ulSum;
+        const uint32_t * pulNext = pulSource;
+        size_t uxCount = uxBlockCount;
+        uint32_t ulWord0;
+        uint32_t ulWord1;
+        uint32_t ulWord2;
+        uint32_t ulWord3;
+
+        /* SUB and TEQ with #0 leave the carry flag alone, so the chain runs
+         * across the loop iterations. An add that carries leaves at most
+         * 0xFFFFFFFE, so the final carry goes in once without carrying again. */
+        __asm volatile (
+            "   adds  %[sum], %[sum], #0                \n"
+            "1: ldrd  %[w0], %[w1], [%[src]], #8        \n"
+            "   ldrd  %[w2], %[w3], [%[src]], #8        \n"
+            "   adcs  %[sum], %[sum], %[w0]             \n"
+            "   adcs  %[sum], %[sum], %[w1]             \n"
+            "   adcs  %[sum], %[sum], %[w2]             \n"
+            "   adcs  %[sum], %[sum], %[w3]             \n"
+            "   sub   %[cnt], %[cnt], #1                \n"
+            "   teq   %[cnt], #0                        \n"
+            "   bne   1b                                \n"
+            "   adc   %[sum], %[sum], #0                \n"
+            : [ sum ] "+r" ( ulResult ), [ src ] "+r" ( pulNext ), [ cnt ] "+r" ( uxCount ),
+            [ w0 ] "=&r" ( ulWord0 ), [ w1 ] "=&r" ( ulWord1 ),
+            [ w2 ] "=&r" ( ulWord2 ), [ w3 ] "=&r" ( ulWord3 )
+            :
+            : "cc", "memory"
+            );
+
+        return ulResult;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( ipCHECKSUM_CARRY_CHAIN != 0 ) */
+
 #if ( ipconfigHAS_PRINTF != 0 )
 
     #ifndef ipMONITOR_MAX_HEAP
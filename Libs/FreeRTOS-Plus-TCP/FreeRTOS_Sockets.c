@@ -1181,6 +1181,7 @@ static NetworkBufferDescriptor_t * prvRecvFromWaitForPacket( FreeRTOS_Socket_t c
                 /* Remove the network buffer from the list of buffers waiting to
                  * be processed by the socket. */
                 ( void ) uxListRemove( &( pxNetworkBuffer->xBufferListItem ) );
+                ipSET_NETWORK_BUFFER_OWNER( pxNetworkBuffer, eNetworkBufferStack );
             }
         }
         ( void ) xTaskResumeAll();
@@ -1438,6 +1439,8 @@ static int32_t prvSendUDPPacket( const FreeRTOS_Socket_t * pxSocket,
     xStackTxEvent.pvData = pxNetworkBuffer;
 
     /* Ask the IP-task to send this packet */
+    ipSET_NETWORK_BUFFER_OWNER( pxNetworkBuffer, eNetworkBufferIPQueue );
+
     if( xSendEventStructToIPTask( &xStackTxEvent, xTicksToWait ) == pdPASS )
     {
         /* The packet was successfully sent to the IP task. */
@@ -3572,7 +3575,7 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t * pxSocket )
 
 /*-----------------------------------------------------------*/
 
-#if ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 )
+#if ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 ) || ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
 
 /**
  * @brief This define makes it possible for network interfaces to inspect
@@ -3600,7 +3603,36 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t * pxSocket )
         return xFound;
     }
 
-#endif /* ipconfigETHERNET_DRIVER_FILTERS_PACKETS */
+    #if ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 ) && ( ipconfigUSE_TCP == 1 )
+
+/**
+ * @brief Lets network interfaces see if any TCP socket, listening or connected,
+ *        is bound to a given port number, so that segments for closed ports
+ *        can be dropped before they reach the IP-task.
+ *
+ * @param[in] usPortNr the port number to look for.
+ *
+ * @return xFound if a socket with the port number is found.
+ */
+        BaseType_t xPortHasTCPSocket( uint16_t usPortNr )
+        {
+            BaseType_t xFound = pdFALSE;
+
+            vTaskSuspendAll();
+            {
+                if( ( pxListFindListItemWithValue( &xBoundTCPSocketsList, ( TickType_t ) usPortNr ) != NULL ) )
+                {
+                    xFound = pdTRUE;
+                }
+            }
+            ( void ) xTaskResumeAll();
+
+            return xFound;
+        }
+
+    #endif /* ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 ) && ( ipconfigUSE_TCP == 1 ) */
+
+#endif /* ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 ) || ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 ) */
 
 /*-----------------------------------------------------------*/
 
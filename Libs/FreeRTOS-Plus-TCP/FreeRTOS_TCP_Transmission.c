@@ -70,6 +70,17 @@
  */
     static BaseType_t prvTCPPrepareConnect( FreeRTOS_Socket_t * pxSocket );
 
+/*
+ * Append the following unsent segments to a full-size segment, so that the
+ * network interface can send them as a single super-segment.
+ */
+    #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+        static uint32_t prvTCPAddSegments( FreeRTOS_Socket_t * pxSocket,
+                                           NetworkBufferDescriptor_t * pxNetworkBuffer,
+                                           uint32_t ulDataLength,
+                                           UBaseType_t uxOptionsLength );
+    #endif
+
 /*------------------------------------------------------------------------*/
 
 /**
@@ -794,6 +805,85 @@
     }
 /*-----------------------------------------------------------*/
 
+    #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+
+/**
+ * @brief Append the following unsent segments to a network buffer that carries
+ *        a full-size segment.  Each extra segment is copied into a network buffer
+ *        of its own, which is linked through 'pxNextBuffer'.  The sliding window
+ *        keeps track of every segment separately, the network interface cuts the
+ *        super-segment at the same boundaries.
+ *
+ * @param[in] pxSocket The socket owning the connection.
+ * @param[in] pxNetworkBuffer The network buffer holding the headers and the first segment.
+ * @param[in] ulDataLength The length of the first segment.
+ * @param[in] uxOptionsLength The length of the TCP options.
+ *
+ * @return The total number of bytes of TCP payload.
+ */
+        static uint32_t prvTCPAddSegments( FreeRTOS_Socket_t * pxSocket,
+                                           NetworkBufferDescriptor_t * pxNetworkBuffer,
+                                           uint32_t ulDataLength,
+                                           UBaseType_t uxOptionsLength )
+        {
+            TCPWindow_t * pxTCPWindow = &( pxSocket->u.xTCP.xTCPWindow );
+            NetworkBufferDescriptor_t * pxLastBuffer = pxNetworkBuffer;
+            NetworkBufferDescriptor_t * pxSegmentBuffer;
+            uint32_t ulTotal = ulDataLength;
+            uint32_t ulSegmentLength = ulDataLength;
+            int32_t lStreamPos = 0;
+            size_t uxCount;
+            size_t uxOffset;
+            size_t uxHeaderLength = uxIPHeaderSizeSocket( pxSocket ) + ipSIZE_OF_TCP_HEADER + ( size_t ) uxOptionsLength;
+
+            pxNetworkBuffer->usTCPSegmentSize = 0U;
+
+            /* Only full-size segments are combined, a shorter segment ends the super-segment. */
+            if( ulDataLength == ( uint32_t ) pxTCPWindow->usMSS )
+            {
+                for( uxCount = 1U; uxCount < ( size_t ) ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS; uxCount++ )
+                {
+                    if( ( ulSegmentLength != ulDataLength ) ||
+                        ( ( uxHeaderLength + ulTotal + ulDataLength ) > ( size_t ) UINT16_MAX ) )
+                    {
+                        break;
+                    }
+
+                    pxSegmentBuffer = pxGetNetworkBufferWithDescriptor( ( size_t ) ulDataLength, 0U );
+
+                    if( pxSegmentBuffer == NULL )
+                    {
+                        break;
+                    }
+
+                    ulSegmentLength = ulTCPWindowTxGetNext( pxTCPWindow, pxSocket->u.xTCP.ulWindowSize, pxTCPWindow->ulOurSequenceNumber + ulTotal, &lStreamPos );
+
+                    if( ulSegmentLength == 0U )
+                    {
+                        vReleaseNetworkBufferAndDescriptor( pxSegmentBuffer );
+                        break;
+                    }
+
+                    uxOffset = uxStreamBufferDistance( pxSocket->u.xTCP.txStream, pxSocket->u.xTCP.txStream->uxTail, ( size_t ) lStreamPos );
+                    ( void ) uxStreamBufferGet( pxSocket->u.xTCP.txStream, uxOffset, pxSegmentBuffer->pucEthernetBuffer, ( size_t ) ulSegmentLength, pdTRUE );
+                    pxSegmentBuffer->xDataLength = ( size_t ) ulSegmentLength;
+
+                    pxLastBuffer->pxNextBuffer = pxSegmentBuffer;
+                    pxLastBuffer = pxSegmentBuffer;
+                    ulTotal += ulSegmentLength;
+                }
+            }
+
+            if( pxLastBuffer != pxNetworkBuffer )
+            {
+                pxNetworkBuffer->usTCPSegmentSize = ( uint16_t ) ulDataLength;
+            }
+
+            return ulTotal;
+        }
+    #endif /* ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 */
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Prepare an outgoing message, in case anything has to be sent.
  *
@@ -890,6 +980,22 @@
                     }
                     #endif
 
+                    #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+                    {
+                        /* Let the network interface send the following segments
+                         * in one go. */
+                        if( ulDataGot == ( uint32_t ) lDataLen )
+                        {
+                            ulDataGot = prvTCPAddSegments( pxSocket, pxNewBuffer, ulDataGot, uxOptionsLength );
+                            lDataLen = ( int32_t ) ulDataGot;
+                        }
+                        else
+                        {
+                            pxNewBuffer->usTCPSegmentSize = 0U;
+                        }
+                    }
+                    #endif
+
                     /* If the owner of the socket requests a closure, add the FIN
                      * flag to the last packet. */
                     if( pxSocket->u.xTCP.bits.bCloseRequested != pdFALSE_UNSIGNED )
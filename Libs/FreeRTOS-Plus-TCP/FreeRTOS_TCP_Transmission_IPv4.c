@@ -226,7 +226,20 @@ void prvTCPReturnPacket_IPV4( FreeRTOS_Socket_t * pxSocket,
 
             #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
             {
-                pxNetworkBuffer->pxNextBuffer = NULL;
+                #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+                    if( pxNetworkBuffer->usTCPSegmentSize != 0U )
+                    {
+                        /* A super-segment: this buffer holds the headers and the first
+                         * segment, the other segments are stored in the linked buffers. */
+                        pxNetworkBuffer->xDataLength = ipSIZE_OF_ETH_HEADER + uxIPHeaderSize;
+                        pxNetworkBuffer->xDataLength += ( size_t ) ( ( pxProtocolHeaders->xTCPHeader.ucTCPOffset >> 4 ) << 2 );
+                        pxNetworkBuffer->xDataLength += pxNetworkBuffer->usTCPSegmentSize;
+                    }
+                    else
+                #endif
+                {
+                    pxNetworkBuffer->pxNextBuffer = NULL;
+                }
             }
             #endif
 
@@ -309,6 +322,23 @@ void prvTCPReturnPacket_IPV4( FreeRTOS_Socket_t * pxSocket,
 
     if( xDoRelease == pdTRUE )
     {
+        #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+        {
+            /* The other segments of a super-segment that was not sent. */
+            if( pxNetworkBuffer->usTCPSegmentSize != 0U )
+            {
+                NetworkBufferDescriptor_t * pxSegmentBuffer = pxNetworkBuffer->pxNextBuffer;
+
+                while( pxSegmentBuffer != NULL )
+                {
+                    NetworkBufferDescriptor_t * pxNextBuffer = pxSegmentBuffer->pxNextBuffer;
+                    vReleaseNetworkBufferAndDescriptor( pxSegmentBuffer );
+                    pxSegmentBuffer = pxNextBuffer;
+                }
+            }
+        }
+        #endif
+
         vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
     }
 }
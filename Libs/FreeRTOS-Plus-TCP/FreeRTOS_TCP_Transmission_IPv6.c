@@ -178,12 +178,6 @@ void prvTCPReturnPacket_IPV6( FreeRTOS_Socket_t * pxSocket,
 
                 if( pxNetworkBuffer->pxEndPoint == NULL )
                 {
-                    if( xDoRelease != pdFALSE )
-                    {
-                        vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
-                    }
-
-                    pxNetworkBuffer = NULL;
                     break;
                 }
             }
@@ -227,7 +221,20 @@ void prvTCPReturnPacket_IPV6( FreeRTOS_Socket_t * pxSocket,
 
             #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
             {
-                pxNetworkBuffer->pxNextBuffer = NULL;
+                #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+                    if( pxNetworkBuffer->usTCPSegmentSize != 0U )
+                    {
+                        /* A super-segment: this buffer holds the headers and the first
+                         * segment, the other segments are stored in the linked buffers. */
+                        pxNetworkBuffer->xDataLength = ipSIZE_OF_ETH_HEADER + uxIPHeaderSize;
+                        pxNetworkBuffer->xDataLength += ( size_t ) ( ( pxProtocolHeaders->xTCPHeader.ucTCPOffset >> 4 ) << 2 );
+                        pxNetworkBuffer->xDataLength += pxNetworkBuffer->usTCPSegmentSize;
+                    }
+                    else
+                #endif
+                {
+                    pxNetworkBuffer->pxNextBuffer = NULL;
+                }
             }
             #endif
 
@@ -293,10 +300,33 @@ void prvTCPReturnPacket_IPV6( FreeRTOS_Socket_t * pxSocket,
             }
             else
             {
-                /* Nothing to do: the buffer has been passed to DMA and will be released after use */
+                xDoRelease = pdFALSE;
+                /* The buffer has been passed to DMA and will be released after use */
             }
         } /* if( pxNetworkBuffer != NULL ) */
     } while( ipFALSE_BOOL );
+
+    if( ( xDoRelease == pdTRUE ) && ( pxNetworkBuffer != NULL ) )
+    {
+        #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+        {
+            /* The other segments of a super-segment that was not sent. */
+            if( pxNetworkBuffer->usTCPSegmentSize != 0U )
+            {
+                NetworkBufferDescriptor_t * pxSegmentBuffer = pxNetworkBuffer->pxNextBuffer;
+
+                while( pxSegmentBuffer != NULL )
+                {
+                    NetworkBufferDescriptor_t * pxNextBuffer = pxSegmentBuffer->pxNextBuffer;
+                    vReleaseNetworkBufferAndDescriptor( pxSegmentBuffer );
+                    pxSegmentBuffer = pxNextBuffer;
+                }
+            }
+        }
+        #endif
+
+        vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+    }
 }
 /*-----------------------------------------------------------*/
 
@@ -187,6 +187,15 @@
                                                   uint32_t ulWindowSize );
     #endif /* ipconfigUSE_TCP_WIN == 1 */
 
+/*
+ * A segment is about to be transmitted, move it to the waiting queue and
+ * restart its transmit timer.
+ */
+    #if ( ipconfigUSE_TCP_WIN == 1 )
+        static void prvTCPWindowTxSetOutstanding( TCPWindow_t * pxWindow,
+                                                  TCPSegment_t * pxSegment );
+    #endif /* ipconfigUSE_TCP_WIN == 1 */
+
 /*
  * An acknowledge was received.  See if some outstanding data may be removed
  * from the transmission queue(s).
@@ -1783,6 +1792,51 @@
 
     #if ( ipconfigUSE_TCP_WIN == 1 )
 
+/**
+ * @brief A segment is about to be transmitted.  Add it to the waiting queue,
+ *        mark it as outstanding and restart its transmit timer.
+ *
+ * @param[in] pxWindow The descriptor of the TCP sliding windows.
+ * @param[in] pxSegment The segment that will be transmitted.
+ */
+        static void prvTCPWindowTxSetOutstanding( TCPWindow_t * pxWindow,
+                                                  TCPSegment_t * pxSegment )
+        {
+            configASSERT( listLIST_ITEM_CONTAINER( &( pxSegment->xQueueItem ) ) == NULL );
+
+            /* Now that the segment will be transmitted, add it to the tail of
+             * the waiting queue. */
+            vListInsertFifo( &pxWindow->xWaitQueue, &pxSegment->xQueueItem );
+
+            /* And mark it as outstanding. */
+            pxSegment->u.bits.bOutstanding = pdTRUE_UNSIGNED;
+
+            /* Administer the transmit count, needed for fast
+             * retransmissions. */
+            ( pxSegment->u.bits.ucTransmitCount )++;
+
+            /* If there have been several retransmissions (4), decrease the
+             * size of the transmission window to at most 2 times MSS. */
+            if( ( pxSegment->u.bits.ucTransmitCount == MAX_TRANSMIT_COUNT_USING_LARGE_WINDOW ) &&
+                ( pxWindow->xSize.ulTxWindowLength > ( 2U * ( ( uint32_t ) pxWindow->usMSS ) ) ) )
+            {
+                uint16_t usMSS2 = ( uint16_t ) ( pxWindow->usMSS * 2U );
+                FreeRTOS_debug_printf( ( "ulTCPWindowTxGet[%u - %u]: Change Tx window: %u -> %u\n",
+                                         pxWindow->usPeerPortNumber,
+                                         pxWindow->usOurPortNumber,
+                                         ( unsigned ) pxWindow->xSize.ulTxWindowLength,
+                                         usMSS2 ) );
+                pxWindow->xSize.ulTxWindowLength = usMSS2;
+            }
+
+            /* Clear the transmit timer. */
+            vTCPTimerSet( &( pxSegment->xTransmitTimer ) );
+        }
+    #endif /* ipconfigUSE_TCP_WIN == 1 */
+/*-----------------------------------------------------------*/
+
+    #if ( ipconfigUSE_TCP_WIN == 1 )
+
 /**
  * @brief Get data that can be transmitted right now. There are three types of
  *        outstanding segments: Priority queue, Waiting queue, Normal TX queue.
@@ -1839,35 +1893,7 @@
             /* See if it has already been determined to return 0. */
             if( pxSegment != NULL )
             {
-                configASSERT( listLIST_ITEM_CONTAINER( &( pxSegment->xQueueItem ) ) == NULL );
-
-                /* Now that the segment will be transmitted, add it to the tail of
-                 * the waiting queue. */
-                vListInsertFifo( &pxWindow->xWaitQueue, &pxSegment->xQueueItem );
-
-                /* And mark it as outstanding. */
-                pxSegment->u.bits.bOutstanding = pdTRUE_UNSIGNED;
-
-                /* Administer the transmit count, needed for fast
-                 * retransmissions. */
-                ( pxSegment->u.bits.ucTransmitCount )++;
-
-                /* If there have been several retransmissions (4), decrease the
-                 * size of the transmission window to at most 2 times MSS. */
-                if( ( pxSegment->u.bits.ucTransmitCount == MAX_TRANSMIT_COUNT_USING_LARGE_WINDOW ) &&
-                    ( pxWindow->xSize.ulTxWindowLength > ( 2U * ( ( uint32_t ) pxWindow->usMSS ) ) ) )
-                {
-                    uint16_t usMSS2 = ( uint16_t ) ( pxWindow->usMSS * 2U );
-                    FreeRTOS_debug_printf( ( "ulTCPWindowTxGet[%u - %u]: Change Tx window: %u -> %u\n",
-                                             pxWindow->usPeerPortNumber,
-                                             pxWindow->usOurPortNumber,
-                                             ( unsigned ) pxWindow->xSize.ulTxWindowLength,
-                                             usMSS2 ) );
-                    pxWindow->xSize.ulTxWindowLength = usMSS2;
-                }
-
-                /* Clear the transmit timer. */
-                vTCPTimerSet( &( pxSegment->xTransmitTimer ) );
+                prvTCPWindowTxSetOutstanding( pxWindow, pxSegment );
 
                 pxWindow->ulOurSequenceNumber = pxSegment->ulSequenceNumber;
 
@@ -1883,6 +1909,50 @@
     #endif /* ipconfigUSE_TCP_WIN == 1 */
 /*-----------------------------------------------------------*/
 
+    #if ( ( ipconfigUSE_TCP_WIN == 1 ) && ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 ) )
+
+/**
+ * @brief Get the next segment of unsent data, but only when it directly follows
+ *        the data that is being sent.  Used to combine several segments into one
+ *        super-segment.  Different from ulTCPWindowTxGet(), the current sequence
+ *        number 'ulOurSequenceNumber' is not changed.
+ *
+ * @param[in] pxWindow The descriptor of the TCP sliding windows.
+ * @param[in] ulWindowSize The current size of the sliding RX window of the peer.
+ * @param[in] ulSequenceNumber The sequence number that the segment must start with.
+ * @param[out] plPosition The index within the TX stream buffer of the first byte to be sent.
+ *
+ * @return The amount of data in bytes that can be transmitted right now, or zero.
+ */
+        uint32_t ulTCPWindowTxGetNext( TCPWindow_t * pxWindow,
+                                       uint32_t ulWindowSize,
+                                       uint32_t ulSequenceNumber,
+                                       int32_t * plPosition )
+        {
+            TCPSegment_t * pxSegment = xTCPWindowPeekHead( &( pxWindow->xTxQueue ) );
+            uint32_t ulReturn = 0U;
+
+            /* Retransmissions have priority, and they are sent one by one. */
+            if( ( pxSegment != NULL ) &&
+                ( pxSegment->ulSequenceNumber == ulSequenceNumber ) &&
+                ( listCURRENT_LIST_LENGTH( &( pxWindow->xPriorityQueue ) ) == 0U ) )
+            {
+                pxSegment = pxTCPWindowTx_GetTXQueue( pxWindow, ulWindowSize );
+
+                if( pxSegment != NULL )
+                {
+                    prvTCPWindowTxSetOutstanding( pxWindow, pxSegment );
+
+                    *plPosition = pxSegment->lStreamPos;
+                    ulReturn = ( uint32_t ) pxSegment->lDataLength;
+                }
+            }
+
+            return ulReturn;
+        }
+    #endif /* ( ipconfigUSE_TCP_WIN == 1 ) && ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 ) */
+/*-----------------------------------------------------------*/
+
     #if ( ipconfigUSE_TCP_WIN == 1 )
 
 /**
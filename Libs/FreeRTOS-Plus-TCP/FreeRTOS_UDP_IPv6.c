@@ -498,6 +498,7 @@ BaseType_t xProcessReceivedUDPPacket_IPv6( NetworkBufferDescriptor_t * pxNetwork
                 {
                     /* Add the network packet to the list of packets to be
                      * processed by the socket. */
+                    ipSET_NETWORK_BUFFER_OWNER( pxNetworkBuffer, eNetworkBufferSocket );
                     vListInsertEnd( &( pxSocket->u.xUDP.xWaitingPacketsList ), &( pxNetworkBuffer->xBufferListItem ) );
                 }
                 ( void ) xTaskResumeAll();
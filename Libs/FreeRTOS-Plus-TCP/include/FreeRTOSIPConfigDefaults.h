@@ -610,6 +610,33 @@
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * ipconfigCHECKSUM_USE_CARRY_CHAIN
+ *
+ * Type: BaseType_t ( ipconfigENABLE | ipconfigDISABLE )
+ *
+ * When enabled, and the compiler targets an ARMv7-M or ARMv8-M Mainline core
+ * (Cortex-M3/M4/M7/M33/M55) with GCC compatible inline assembly,
+ * usGenerateChecksum() sums the bulk of the data with a chain of add-with-carry
+ * instructions instead of counting carries in C. On other targets, or when
+ * disabled, the portable C loop is used. Both produce the same checksum.
+ * Disabled by default until the assembly has been verified on the target.
+ *
+ * Only matters for checksums that are calculated in software, see
+ * ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM and
+ * ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM.
+ */
+
+#ifndef ipconfigCHECKSUM_USE_CARRY_CHAIN
+    #define ipconfigCHECKSUM_USE_CARRY_CHAIN    ipconfigDISABLE
+#endif
+
+#if ( ( ipconfigCHECKSUM_USE_CARRY_CHAIN != ipconfigDISABLE ) && ( ipconfigCHECKSUM_USE_CARRY_CHAIN != ipconfigENABLE ) )
+    #error Invalid ipconfigCHECKSUM_USE_CARRY_CHAIN configuration
+#endif
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM
  *
@@ -854,6 +881,150 @@
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS
+ *
+ * Type: size_t
+ * Unit: Count of network buffers
+ * Minimum: 0
+ *
+ * Advanced users only.
+ *
+ * The number of extra network buffers of ipconfigSMALL_NETWORK_BUFFER_SIZE
+ * bytes, on top of ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS. A network
+ * interface can get one from pxGetSmallNetworkBufferWithDescriptor() to copy
+ * a short received frame out of its full-size buffer and return that buffer
+ * to the DMA straight away. pxGetNetworkBufferWithDescriptor() also hands
+ * them out for requests that fit, before trying the medium and full-size
+ * buffers.
+ *
+ * With a fixed-size buffer allocator the IP-task may reuse a received buffer
+ * for a reply of any size. A network interface must therefore only copy
+ * frames which are never answered in place, such as UDP datagrams that are
+ * queued on a socket.
+ *
+ * The network interface provides the storage through
+ * vNetworkInterfaceAllocateRAMToSmallBuffers().
+ */
+
+#ifndef ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS
+    #define ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS    ( 0 )
+#endif
+
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS < 0 )
+    #error ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS must be at least 0
+#endif
+
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > SIZE_MAX )
+    #error ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS overflows a size_t
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * ipconfigSMALL_NETWORK_BUFFER_SIZE
+ *
+ * Type: size_t
+ * Unit: bytes
+ * Minimum: ipconfigETHERNET_MINIMUM_PACKET_BYTES
+ *
+ * The size of the Ethernet frame that fits in a small network buffer, see
+ * ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS. The buffer is preceded by
+ * ipBUFFER_PADDING bytes, like any other network buffer.
+ */
+
+#ifndef ipconfigSMALL_NETWORK_BUFFER_SIZE
+    #define ipconfigSMALL_NETWORK_BUFFER_SIZE    ( 256 )
+#endif
+
+#if ( ipconfigSMALL_NETWORK_BUFFER_SIZE < ipconfigETHERNET_MINIMUM_PACKET_BYTES )
+    #error ipconfigSMALL_NETWORK_BUFFER_SIZE must be at least ipconfigETHERNET_MINIMUM_PACKET_BYTES
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS
+ *
+ * Type: size_t
+ * Unit: Count of network buffers
+ * Minimum: 0
+ *
+ * Advanced users only.
+ *
+ * The number of extra network buffers of ipconfigMEDIUM_NETWORK_BUFFER_SIZE
+ * bytes. pxGetNetworkBufferWithDescriptor() hands them out for requests
+ * that are too big for a small buffer, or when no small buffer is free, so
+ * that short replies such as TCP acknowledgements do not hold a full-size
+ * buffer. pxResizeNetworkBufferWithDescriptor() moves the data to a bigger
+ * buffer when needed.
+ *
+ * The network interface provides the storage through
+ * vNetworkInterfaceAllocateRAMToMediumBuffers().
+ */
+
+#ifndef ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS
+    #define ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS    ( 0 )
+#endif
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS < 0 )
+    #error ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS must be at least 0
+#endif
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > SIZE_MAX )
+    #error ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS overflows a size_t
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * ipconfigMEDIUM_NETWORK_BUFFER_SIZE
+ *
+ * Type: size_t
+ * Unit: bytes
+ * Minimum: ipconfigSMALL_NETWORK_BUFFER_SIZE
+ *
+ * The size of the Ethernet frame that fits in a medium network buffer, see
+ * ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS.
+ */
+
+#ifndef ipconfigMEDIUM_NETWORK_BUFFER_SIZE
+    #define ipconfigMEDIUM_NETWORK_BUFFER_SIZE    ( 512 )
+#endif
+
+#if ( ipconfigMEDIUM_NETWORK_BUFFER_SIZE < ipconfigSMALL_NETWORK_BUFFER_SIZE )
+    #error ipconfigMEDIUM_NETWORK_BUFFER_SIZE must be at least ipconfigSMALL_NETWORK_BUFFER_SIZE
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * ipconfigTRACK_NETWORK_BUFFER_OWNERS
+ *
+ * Type: BaseType_t ( ipconfigENABLE | ipconfigDISABLE )
+ *
+ * When enabled, the buffer allocator remembers for every network buffer who
+ * holds it (network interface Rx, IP-task queue, IP-task or application,
+ * socket queue, ARP resolution, network interface Tx), when it was allocated
+ * and since when the current owner holds it. Every completed hold is counted
+ * in a per-owner histogram of hold times. vGetNetworkBufferOwnerStats()
+ * returns a snapshot, which shows where buffers go when the pool runs dry,
+ * and which owner is slow to give them back.
+ *
+ * Costs a few bytes per network buffer and a tick count read on every owner
+ * change.
+ */
+
+#ifndef ipconfigTRACK_NETWORK_BUFFER_OWNERS
+    #define ipconfigTRACK_NETWORK_BUFFER_OWNERS    ipconfigDISABLE
+#endif
+
+#if ( ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != ipconfigDISABLE ) && ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != ipconfigENABLE ) )
+    #error Invalid ipconfigTRACK_NETWORK_BUFFER_OWNERS configuration
+#endif
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * ipconfigUSE_LINKED_RX_MESSAGES
  *
@@ -1623,6 +1794,86 @@
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * ipconfigUSE_TCP_SEGMENTATION_OFFLOAD
+ *
+ * Type: BaseType_t ( ipconfigENABLE | ipconfigDISABLE )
+ *
+ * Advanced users only.
+ *
+ * When enabled, a TCP socket which has several full-size segments ready
+ * for their first transmission will hand them to the network interface as
+ * one super-segment. The TCP/IP headers and the first segment are stored in
+ * the first network buffer, every following segment is stored in a network
+ * buffer linked through 'pxNextBuffer'. The field
+ * NetworkBufferDescriptor_t::usTCPSegmentSize tells the driver the size of
+ * the segments, and the EMAC is expected to cut the super-segment into
+ * frames and to complete the headers and checksums of each frame.
+ *
+ * The sliding window still keeps track of each segment, retransmissions are
+ * always sent one segment at a time.
+ *
+ * Only enable this option when the network interface supports TCP
+ * segmentation offload.
+ */
+
+#ifndef ipconfigUSE_TCP_SEGMENTATION_OFFLOAD
+    #define ipconfigUSE_TCP_SEGMENTATION_OFFLOAD    ipconfigDISABLE
+#endif
+
+#if ( ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != ipconfigDISABLE ) && ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != ipconfigENABLE ) )
+    #error Invalid ipconfigUSE_TCP_SEGMENTATION_OFFLOAD configuration
+#endif
+
+#if ( ipconfigIS_ENABLED( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD ) && ipconfigIS_DISABLED( ipconfigUSE_TCP_WIN ) )
+    #error ipconfigUSE_TCP_SEGMENTATION_OFFLOAD requires ipconfigUSE_TCP_WIN
+#endif
+
+#if ( ipconfigIS_ENABLED( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD ) && ipconfigIS_DISABLED( ipconfigUSE_LINKED_RX_MESSAGES ) )
+    #error ipconfigUSE_TCP_SEGMENTATION_OFFLOAD requires ipconfigUSE_LINKED_RX_MESSAGES
+#endif
+
+#if ( ipconfigIS_ENABLED( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD ) && ipconfigIS_DISABLED( ipconfigZERO_COPY_TX_DRIVER ) )
+    #error ipconfigUSE_TCP_SEGMENTATION_OFFLOAD requires ipconfigZERO_COPY_TX_DRIVER
+#endif
+
+#if ( ipconfigIS_ENABLED( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD ) && ipconfigIS_DISABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM ) )
+    #error ipconfigUSE_TCP_SEGMENTATION_OFFLOAD requires ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS
+ *
+ * Type: size_t
+ * Unit: count of TCP segments
+ * Minimum: 2
+ *
+ * The maximum number of segments which are combined into a single
+ * super-segment when ipconfigUSE_TCP_SEGMENTATION_OFFLOAD is enabled.
+ * Every segment occupies one network buffer. The total size of a
+ * super-segment is also limited by the 16-bit length field of the
+ * IPv4 header.
+ *
+ * The default fits the STM32 driver's default ring of 4 Tx descriptors.
+ * Larger values need a larger ETH_TX_DESC_CNT.
+ */
+
+#ifndef ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS
+    #define ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS    ( 5 )
+#endif
+
+#if ( ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS < 2 )
+    #error ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS must be at least 2
+#endif
+
+#if ( ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS > SIZE_MAX )
+    #error ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS overflows a size_t
+#endif
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * pvPortMallocLarge / vPortFreeLarge
  *
@@ -169,6 +169,9 @@ typedef struct xNETWORK_BUFFER
     #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
         struct xNETWORK_BUFFER * pxNextBuffer; /**< Possible optimisation for expert users - requires network driver support. */
     #endif
+    #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+        uint16_t usTCPSegmentSize; /**< When non-zero, a TCP super-segment which the driver must cut into segments of this size. */
+    #endif
 
 #define ul_IPAddress     xIPAddress.xIP_IPv4
 #define x_IPv6Address    xIPAddress.xIP_IPv6
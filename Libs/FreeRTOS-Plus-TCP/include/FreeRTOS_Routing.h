@@ -54,14 +54,20 @@
 /* Return true as long as the LinkStatus on the PHY is present. */
     typedef BaseType_t ( * GetPhyLinkStatusFunction_t ) ( struct xNetworkInterface * pxDescriptor );
 
+/* Add or remove a MAC address, e.g. of a multicast group, from the receive filter. */
+    typedef void ( * NetworkInterfaceMACFilterFunction_t ) ( struct xNetworkInterface * pxDescriptor,
+                                                             const uint8_t * pucMacAddressBytes );
+
 /** @brief These NetworkInterface access functions are collected in a struct: */
     typedef struct xNetworkInterface
     {
-        const char * pcName;                               /**< Just for logging, debugging. */
-        void * pvArgument;                                 /**< Will be passed to the access functions. */
-        NetworkInterfaceInitialiseFunction_t pfInitialise; /**< This function will be called upon initialisation and repeated until it returns pdPASS. */
-        NetworkInterfaceOutputFunction_t pfOutput;         /**< This function is supposed to send out a packet. */
-        GetPhyLinkStatusFunction_t pfGetPhyLinkStatus;     /**< This function will return pdTRUE as long as the PHY Link Status is high. */
+        const char * pcName;                                    /**< Just for logging, debugging. */
+        void * pvArgument;                                      /**< Will be passed to the access functions. */
+        NetworkInterfaceInitialiseFunction_t pfInitialise;      /**< This function will be called upon initialisation and repeated until it returns pdPASS. */
+        NetworkInterfaceOutputFunction_t pfOutput;              /**< This function is supposed to send out a packet. */
+        GetPhyLinkStatusFunction_t pfGetPhyLinkStatus;          /**< This function will return pdTRUE as long as the PHY Link Status is high. */
+        NetworkInterfaceMACFilterFunction_t pfAddAllowedMAC;    /**< Optional, lets frames sent to a MAC address pass the receive filter. */
+        NetworkInterfaceMACFilterFunction_t pfRemoveAllowedMAC; /**< Optional, undoes one call to pfAddAllowedMAC. */
         struct
         {
             uint32_t
@@ -271,9 +271,14 @@
     size_t FreeRTOS_GetLocalAddress( ConstSocket_t xSocket,
                                      struct freertos_sockaddr * pxAddress );
 
-    #if ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 )
+    #if ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 ) || ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
 /* Returns true if an UDP socket exists bound to mentioned port number. */
         BaseType_t xPortHasUDPSocket( uint16_t usPortNr );
+
+        #if ( ipconfigETHERNET_DRIVER_FILTERS_PACKETS == 1 ) && ( ipconfigUSE_TCP == 1 )
+/* Returns true if a TCP socket exists bound to mentioned port number. */
+            BaseType_t xPortHasTCPSocket( uint16_t usPortNr );
+        #endif
     #endif
 
 /* End UDP Socket Attributes */
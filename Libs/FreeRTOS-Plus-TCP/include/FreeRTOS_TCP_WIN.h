@@ -214,6 +214,16 @@ uint32_t ulTCPWindowTxGet( TCPWindow_t * pxWindow,
                            uint32_t ulWindowSize,
                            int32_t * plPosition );
 
+#if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+
+/* Fetches the next unsent segment, if it starts at 'ulSequenceNumber'.
+ * Used to combine consecutive segments into a single super-segment. */
+    uint32_t ulTCPWindowTxGetNext( TCPWindow_t * pxWindow,
+                                   uint32_t ulWindowSize,
+                                   uint32_t ulSequenceNumber,
+                                   int32_t * plPosition );
+#endif
+
 /* Receive a normal ACK */
 uint32_t ulTCPWindowTxAck( TCPWindow_t * pxWindow,
                            uint32_t ulSequenceNumber );
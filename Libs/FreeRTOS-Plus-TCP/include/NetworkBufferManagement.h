@@ -55,12 +55,65 @@ BaseType_t vNetworkBufferReleaseFromISR( NetworkBufferDescriptor_t * const pxNet
 uint8_t * pucGetNetworkBuffer( size_t * pxRequestedSizeBytes );
 void vReleaseNetworkBuffer( uint8_t * pucEthernetBuffer );
 
+/* Take another reference to a buffer that is shared read-only, or NULL when it
+ * is not a pool buffer. Every reference is dropped with vReleaseNetworkBufferAndDescriptor(). */
+NetworkBufferDescriptor_t * pxNetworkBufferAddReference( NetworkBufferDescriptor_t * const pxNetworkBuffer );
+
 /* Get the current number of free network buffers. */
 UBaseType_t uxGetNumberOfFreeNetworkBuffers( void );
 
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+    /* Never blocks, returns NULL when no small buffer is free or the size does not fit. */
+    NetworkBufferDescriptor_t * pxGetSmallNetworkBufferWithDescriptor( size_t xRequestedSizeBytes );
+    UBaseType_t uxGetNumberOfFreeSmallNetworkBuffers( void );
+#endif
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+    UBaseType_t uxGetNumberOfFreeMediumNetworkBuffers( void );
+#endif
+
 /* Get the lowest number of free network buffers. */
 UBaseType_t uxGetMinimumFreeNetworkBuffers( void );
 
+/* Who holds a network buffer, see ipconfigTRACK_NETWORK_BUFFER_OWNERS. */
+typedef enum eNETWORK_BUFFER_OWNER
+{
+    eNetworkBufferFree = 0,   /* On a free list. */
+    eNetworkBufferStack,      /* The IP-task or an application task. */
+    eNetworkBufferDriverRx,   /* The network interface, waiting for a received frame. */
+    eNetworkBufferIPQueue,    /* Queued for the IP-task. */
+    eNetworkBufferSocket,     /* Queued on a socket. */
+    eNetworkBufferARPWaiting, /* Parked until an address is resolved. */
+    eNetworkBufferDriverTx,   /* The network interface, queued or being sent. */
+    eNetworkBufferOwnerCount
+} eNetworkBufferOwner_t;
+
+#if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+
+/* Number of hold time buckets, bucket n counts holds shorter than 4^n ticks,
+ * the last bucket counts all longer holds. */
+    #define ipNETWORK_BUFFER_HOLD_BUCKETS    8U
+
+    typedef struct xNETWORK_BUFFER_OWNER_STATS
+    {
+        UBaseType_t uxHeld;                                    /* Buffers held right now. */
+        TickType_t xLongestHeld;                               /* Longest current hold among them. */
+        TickType_t xOldestAllocation;                          /* Age of the oldest of them, since it was allocated. */
+        uint32_t ulHoldTimes[ ipNETWORK_BUFFER_HOLD_BUCKETS ]; /* Completed holds. */
+    } NetworkBufferOwnerStats_t;
+
+    void vNetworkBufferSetOwner( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                 eNetworkBufferOwner_t eOwner );
+
+/* The snapshot is taken without stopping other tasks, it can be off by the
+ * buffers that change hands while it is taken. */
+    void vGetNetworkBufferOwnerStats( NetworkBufferOwnerStats_t pxStats[ eNetworkBufferOwnerCount ] );
+
+    #define ipSET_NETWORK_BUFFER_OWNER( pxNetworkBuffer, eOwner )    vNetworkBufferSetOwner( ( pxNetworkBuffer ), ( eOwner ) )
+#else
+    #define ipSET_NETWORK_BUFFER_OWNER( pxNetworkBuffer, eOwner )    do {} while( ipFALSE_BOOL )
+#endif /* if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 ) */
+
 /* Copy a network buffer into a bigger buffer. */
 NetworkBufferDescriptor_t * pxDuplicateNetworkBufferWithDescriptor( const NetworkBufferDescriptor_t * const pxNetworkBuffer,
                                                                     size_t uxNewLength );
@@ -50,6 +50,16 @@
 /* The following function is defined only when BufferAllocation_1.c is linked in the project. */
 void vNetworkInterfaceAllocateRAMToBuffers( NetworkBufferDescriptor_t pxNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ] );
 
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+    /* Storage for the small network buffers, each of ipconfigSMALL_NETWORK_BUFFER_SIZE bytes. */
+    void vNetworkInterfaceAllocateRAMToSmallBuffers( NetworkBufferDescriptor_t pxSmallNetworkBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ] );
+#endif
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+    /* Storage for the medium network buffers, each of ipconfigMEDIUM_NETWORK_BUFFER_SIZE bytes. */
+    void vNetworkInterfaceAllocateRAMToMediumBuffers( NetworkBufferDescriptor_t pxMediumNetworkBuffers[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ] );
+#endif
+
 BaseType_t xGetPhyLinkStatus( struct xNetworkInterface * pxInterface );
 
 /* *INDENT-OFF* */
@@ -1,5 +1,6 @@
 /* Standard includes. */
 #include <stdint.h>
+#include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
@@ -13,26 +14,289 @@
 #include "NetworkInterface.h"
 #include "NetworkBufferManagement.h"
 
+/* The free lists are lock-free LIFOs. On ARMv7-M/ARMv8-M mainline they are
+ * updated with LDREX/STREX, anywhere else (host builds) with C11 atomics. */
+#if defined( __ARM_ARCH_7M__ ) || defined( __ARM_ARCH_7EM__ ) || defined( __ARM_ARCH_8M_MAIN__ )
+    #define baUSE_EXCLUSIVE_ACCESS    1
+    typedef volatile uint32_t         baAtomicU32_t;
+#else
+    #include <stdatomic.h>
+    #define baUSE_EXCLUSIVE_ACCESS    0
+    typedef _Atomic uint32_t          baAtomicU32_t;
+#endif
+
 #define baINTERRUPT_BUFFER_GET_THRESHOLD    ( 3 )
 
-#if !defined( ipconfigBUFFER_ALLOC_LOCK )
-    #define ipconfigBUFFER_ALLOC_INIT()             do {} while( ipFALSE_BOOL )
-    #define ipconfigBUFFER_ALLOC_LOCK_FROM_ISR()    UBaseType_t uxSavedInterruptStatus = ( UBaseType_t ) portSET_INTERRUPT_MASK_FROM_ISR(); {
-    #define ipconfigBUFFER_ALLOC_UNLOCK_FROM_ISR()  portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus ); }
-    #define ipconfigBUFFER_ALLOC_LOCK()             taskENTER_CRITICAL()
-    #define ipconfigBUFFER_ALLOC_UNLOCK()           taskEXIT_CRITICAL()
+/* A LIFO head holds a 1-based descriptor index in the low half (0 when empty)
+ * and a modification tag in the high half, which defeats ABA on the swap. */
+#define baLIFO_INDEX_MASK                   ( 0x0000FFFFUL )
+#define baLIFO_NEXT_TAG( ulHead )           ( ( ( ulHead ) + 0x00010000UL ) & ~baLIFO_INDEX_MASK )
+
+#if ( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS >= 0xFFFF ) || ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS >= 0xFFFF ) || ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS >= 0xFFFF )
+    #error Too many network buffer descriptors for the free list index
 #endif
 
+#if !defined( ipconfigBUFFER_ALLOC_INIT )
+    #define ipconfigBUFFER_ALLOC_INIT()    do {} while( ipFALSE_BOOL )
+#endif
+
+typedef struct xBUFFER_LINK
+{
+    baAtomicU32_t ulNext;   /* 1-based index of the next free descriptor. */
+    baAtomicU32_t ulRefCount; /* Number of owners, zero while the descriptor is on the free list. */
+    #if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+        eNetworkBufferOwner_t eOwner;
+        TickType_t xAllocatedAt;
+        TickType_t xOwnedSince;
+    #endif
+} BufferLink_t;
+
+typedef struct xBUFFER_LIFO
+{
+    baAtomicU32_t ulHead;
+    baAtomicU32_t ulCount;
+    BufferLink_t * pxLinks;
+    NetworkBufferDescriptor_t * pxDescriptors;
+} BufferLifo_t;
+
 const BaseType_t xBufferAllocFixedSize = pdTRUE;
 
 static NetworkBufferDescriptor_t xNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
 
-static List_t xFreeBuffersList;
+static BufferLink_t xNetworkBufferLinks[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+
+static BufferLifo_t xFreeBuffers;
 
 static UBaseType_t uxMinimumFreeNetworkBuffers = 0U;
 
+/* Only used to wake tasks that are blocked waiting for a free buffer. */
 static SemaphoreHandle_t xNetworkBufferSemaphore = NULL;
 
+static baAtomicU32_t ulNetworkBufferWaiters;
+
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+    static NetworkBufferDescriptor_t xSmallNetworkBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ];
+
+    static BufferLink_t xSmallNetworkBufferLinks[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ];
+
+    static BufferLifo_t xFreeSmallBuffers;
+#endif
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+    static NetworkBufferDescriptor_t xMediumNetworkBuffers[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ];
+
+    static BufferLink_t xMediumNetworkBufferLinks[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ];
+
+    static BufferLifo_t xFreeMediumBuffers;
+#endif
+
+#if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+    static baAtomicU32_t ulHoldTimes[ eNetworkBufferOwnerCount ][ ipNETWORK_BUFFER_HOLD_BUCKETS ];
+#endif
+
+#if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+    static void prvTrackOwner( const NetworkBufferDescriptor_t * pxNetworkBuffer,
+                               eNetworkBufferOwner_t eOwner,
+                               BaseType_t xFromISR );
+#endif
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCompareAndSwap( baAtomicU32_t * pulTarget, uint32_t ulExpected, uint32_t ulDesired )
+{
+    BaseType_t xSwapped = pdFALSE;
+
+    #if ( baUSE_EXCLUSIVE_ACCESS != 0 )
+    {
+        /* Order earlier stores (e.g. a link update) before the exclusive store. */
+        __DMB();
+
+        for( ;; )
+        {
+            if( __LDREXW( pulTarget ) != ulExpected )
+            {
+                __CLREX();
+                break;
+            }
+
+            if( __STREXW( ulDesired, pulTarget ) == 0U )
+            {
+                xSwapped = pdTRUE;
+                __DMB();
+                break;
+            }
+        }
+    }
+    #else
+    {
+        if( atomic_compare_exchange_strong( pulTarget, &ulExpected, ulDesired ) )
+        {
+            xSwapped = pdTRUE;
+        }
+    }
+    #endif /* if ( baUSE_EXCLUSIVE_ACCESS != 0 ) */
+
+    return xSwapped;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAtomicAdd( baAtomicU32_t * pulTarget, int32_t lDelta )
+{
+    #if ( baUSE_EXCLUSIVE_ACCESS != 0 )
+    {
+        uint32_t ulValue;
+
+        __DMB();
+
+        do
+        {
+            ulValue = __LDREXW( pulTarget ) + ( uint32_t ) lDelta;
+        } while( __STREXW( ulValue, pulTarget ) != 0U );
+
+        __DMB();
+    }
+    #else
+    {
+        ( void ) atomic_fetch_add( pulTarget, ( uint32_t ) lDelta );
+    }
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static NetworkBufferDescriptor_t * prvLifoPop( BufferLifo_t * pxLifo )
+{
+    NetworkBufferDescriptor_t * pxReturn = NULL;
+    uint32_t ulHead;
+    uint32_t ulIndex;
+
+    for( ;; )
+    {
+        ulHead = pxLifo->ulHead;
+        ulIndex = ulHead & baLIFO_INDEX_MASK;
+
+        if( ulIndex == 0U )
+        {
+            break;
+        }
+
+        /* The link may be stale if another context got here first, the tag
+         * then makes the swap fail and the loop retries. */
+        if( prvCompareAndSwap( &( pxLifo->ulHead ), ulHead, baLIFO_NEXT_TAG( ulHead ) | pxLifo->pxLinks[ ulIndex - 1U ].ulNext ) != pdFALSE )
+        {
+            pxLifo->pxLinks[ ulIndex - 1U ].ulRefCount = 1U;
+            prvAtomicAdd( &( pxLifo->ulCount ), -1 );
+            pxReturn = &( pxLifo->pxDescriptors[ ulIndex - 1U ] );
+            break;
+        }
+    }
+
+    return pxReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvLifoPush( BufferLifo_t * pxLifo, uint32_t ulIndex )
+{
+    uint32_t ulHead;
+
+    do
+    {
+        ulHead = pxLifo->ulHead;
+        pxLifo->pxLinks[ ulIndex ].ulNext = ulHead & baLIFO_INDEX_MASK;
+    } while( prvCompareAndSwap( &( pxLifo->ulHead ), ulHead, baLIFO_NEXT_TAG( ulHead ) | ( ulIndex + 1U ) ) == pdFALSE );
+
+    prvAtomicAdd( &( pxLifo->ulCount ), 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Returns pdTRUE when the last reference was dropped and the descriptor must
+ * go back to the free list. A descriptor that is already free is left alone,
+ * which also rejects a buffer that is released twice. */
+static BaseType_t prvDropReference( BufferLink_t * pxLink )
+{
+    BaseType_t xLast = pdFALSE;
+    uint32_t ulCount;
+
+    for( ;; )
+    {
+        ulCount = pxLink->ulRefCount;
+
+        if( ulCount == 0U )
+        {
+            break;
+        }
+
+        if( prvCompareAndSwap( &( pxLink->ulRefCount ), ulCount, ulCount - 1U ) != pdFALSE )
+        {
+            xLast = ( ulCount == 1U ) ? pdTRUE : pdFALSE;
+            break;
+        }
+    }
+
+    return xLast;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvLifoInitialise( BufferLifo_t * pxLifo, NetworkBufferDescriptor_t * pxDescriptors, BufferLink_t * pxLinks, uint32_t ulCount )
+{
+    uint32_t ulIndex;
+
+    pxLifo->ulHead = 0U;
+    pxLifo->ulCount = 0U;
+    pxLifo->pxLinks = pxLinks;
+    pxLifo->pxDescriptors = pxDescriptors;
+
+    /* Push in reverse so that the first descriptor is handed out first. */
+    for( ulIndex = ulCount; ulIndex > 0U; --ulIndex )
+    {
+        pxLinks[ ulIndex - 1U ].ulRefCount = 0U;
+        vListInitialiseItem( &( pxDescriptors[ ulIndex - 1U ].xBufferListItem ) );
+        listSET_LIST_ITEM_OWNER( &( pxDescriptors[ ulIndex - 1U ].xBufferListItem ), &( pxDescriptors[ ulIndex - 1U ] ) );
+        prvLifoPush( pxLifo, ulIndex - 1U );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrepareDescriptor( NetworkBufferDescriptor_t * pxDescriptor,
+                                  size_t xRequestedSizeBytes,
+                                  BaseType_t xFromISR )
+{
+    pxDescriptor->xDataLength = xRequestedSizeBytes;
+    pxDescriptor->pxInterface = NULL;
+    pxDescriptor->pxEndPoint = NULL;
+
+    #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
+        pxDescriptor->pxNextBuffer = NULL;
+    #endif
+
+    #if ( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD != 0 )
+        pxDescriptor->usTCPSegmentSize = 0U;
+    #endif
+
+    #if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+        prvTrackOwner( pxDescriptor, eNetworkBufferStack, xFromISR );
+    #else
+        ( void ) xFromISR;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvUpdateMinimumFree( void )
+{
+    const UBaseType_t uxCount = uxGetNumberOfFreeNetworkBuffers();
+
+    if( uxMinimumFreeNetworkBuffers > uxCount )
+    {
+        uxMinimumFreeNetworkBuffers = uxCount;
+    }
+}
+
 /*-----------------------------------------------------------*/
 
 static BaseType_t xIsValidNetworkDescriptor( const NetworkBufferDescriptor_t * pxDesc )
@@ -60,9 +324,266 @@ static BaseType_t xIsValidNetworkDescriptor( const NetworkBufferDescriptor_t * p
 
 /*-----------------------------------------------------------*/
 
-static BaseType_t xIsFreeBuffer( const NetworkBufferDescriptor_t * pxDesc )
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+static BaseType_t xIsSmallNetworkDescriptor( const NetworkBufferDescriptor_t * pxDesc )
+{
+    const uint32_t offset = ( uint32_t ) ( ( ( const char * ) pxDesc ) - ( ( const char * ) xSmallNetworkBuffers ) );
+
+    return ( ( offset < sizeof( xSmallNetworkBuffers ) ) && ( ( offset % sizeof( xSmallNetworkBuffers[ 0 ] ) ) == 0 ) ) ? pdTRUE : pdFALSE;
+}
+
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+static BaseType_t xIsMediumNetworkDescriptor( const NetworkBufferDescriptor_t * pxDesc )
+{
+    const uint32_t offset = ( uint32_t ) ( ( ( const char * ) pxDesc ) - ( ( const char * ) xMediumNetworkBuffers ) );
+
+    return ( ( offset < sizeof( xMediumNetworkBuffers ) ) && ( ( offset % sizeof( xMediumNetworkBuffers[ 0 ] ) ) == 0 ) ) ? pdTRUE : pdFALSE;
+}
+
+#endif
+
+/*-----------------------------------------------------------*/
+
+/* Pops from the smallest size class that fits and has a free buffer,
+ * returns NULL when the request needs a full-size buffer. */
+static NetworkBufferDescriptor_t * prvPopSizedBuffer( size_t xRequestedSizeBytes )
+{
+    NetworkBufferDescriptor_t * pxReturn = NULL;
+
+    #if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        if( xRequestedSizeBytes <= ( size_t ) ipconfigSMALL_NETWORK_BUFFER_SIZE )
+        {
+            pxReturn = prvLifoPop( &xFreeSmallBuffers );
+        }
+    #endif
+
+    #if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        if( ( pxReturn == NULL ) && ( xRequestedSizeBytes <= ( size_t ) ipconfigMEDIUM_NETWORK_BUFFER_SIZE ) )
+        {
+            pxReturn = prvLifoPop( &xFreeMediumBuffers );
+        }
+    #endif
+
+    ( void ) xRequestedSizeBytes;
+
+    return pxReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Finds the pool a descriptor belongs to, NULL when it is not a pool descriptor. */
+static BufferLifo_t * prvFindPool( const NetworkBufferDescriptor_t * pxNetworkBuffer, uint32_t * pulIndex )
 {
-    return ( xIsValidNetworkDescriptor( pxDesc ) != pdFALSE ) && ( listIS_CONTAINED_WITHIN( &xFreeBuffersList, &( pxDesc->xBufferListItem ) ) != pdFALSE );
+    BufferLifo_t * pxReturn = NULL;
+
+    if( xIsValidNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+    {
+        pxReturn = &xFreeBuffers;
+    }
+
+    #if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        if( xIsSmallNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+        {
+            pxReturn = &xFreeSmallBuffers;
+        }
+    #endif
+
+    #if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        if( xIsMediumNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+        {
+            pxReturn = &xFreeMediumBuffers;
+        }
+    #endif
+
+    if( pxReturn != NULL )
+    {
+        *pulIndex = ( uint32_t ) ( pxNetworkBuffer - pxReturn->pxDescriptors );
+    }
+
+    return pxReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+
+static TickType_t prvTickCount( BaseType_t xFromISR )
+{
+    return ( xFromISR != pdFALSE ) ? xTaskGetTickCountFromISR() : xTaskGetTickCount();
+}
+
+/*-----------------------------------------------------------*/
+
+/* Hands a descriptor to a new owner and books the hold time of the previous
+ * one. Only the current owner changes the owner, so no locking is needed. */
+static void prvTrackOwner( const NetworkBufferDescriptor_t * pxNetworkBuffer,
+                           eNetworkBufferOwner_t eOwner,
+                           BaseType_t xFromISR )
+{
+    uint32_t ulIndex = 0U;
+    const BufferLifo_t * const pxLifo = prvFindPool( pxNetworkBuffer, &ulIndex );
+    BufferLink_t * pxLink;
+    TickType_t xNow;
+    TickType_t xHeld;
+    UBaseType_t uxBucket = 0U;
+
+    if( ( pxLifo != NULL ) && ( eOwner < eNetworkBufferOwnerCount ) )
+    {
+        pxLink = &( pxLifo->pxLinks[ ulIndex ] );
+        xNow = prvTickCount( xFromISR );
+
+        if( pxLink->eOwner == eNetworkBufferFree )
+        {
+            pxLink->xAllocatedAt = xNow;
+        }
+        else
+        {
+            xHeld = xNow - pxLink->xOwnedSince;
+
+            while( ( uxBucket < ( ipNETWORK_BUFFER_HOLD_BUCKETS - 1U ) ) && ( ( xHeld >> ( 2U * uxBucket ) ) != 0U ) )
+            {
+                ++uxBucket;
+            }
+
+            prvAtomicAdd( &( ulHoldTimes[ pxLink->eOwner ][ uxBucket ] ), 1 );
+        }
+
+        pxLink->eOwner = eOwner;
+        pxLink->xOwnedSince = xNow;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCollectOwnerStats( const BufferLifo_t * pxLifo,
+                                  uint32_t ulLength,
+                                  TickType_t xNow,
+                                  NetworkBufferOwnerStats_t pxStats[ eNetworkBufferOwnerCount ] )
+{
+    const BufferLink_t * pxLink;
+    NetworkBufferOwnerStats_t * pxOwnerStats;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0U; ulIndex < ulLength; ++ulIndex )
+    {
+        pxLink = &( pxLifo->pxLinks[ ulIndex ] );
+        pxOwnerStats = &( pxStats[ pxLink->eOwner ] );
+
+        ++pxOwnerStats->uxHeld;
+
+        if( pxLink->eOwner != eNetworkBufferFree )
+        {
+            if( ( xNow - pxLink->xOwnedSince ) > pxOwnerStats->xLongestHeld )
+            {
+                pxOwnerStats->xLongestHeld = xNow - pxLink->xOwnedSince;
+            }
+
+            if( ( xNow - pxLink->xAllocatedAt ) > pxOwnerStats->xOldestAllocation )
+            {
+                pxOwnerStats->xOldestAllocation = xNow - pxLink->xAllocatedAt;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#endif /* if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 ) */
+
+/* Drops one reference and, for the last one, puts the descriptor back on the
+ * free list of its pool. Returns pdTRUE when a task waiting for a full-size
+ * buffer must be woken. */
+static BaseType_t prvReleaseReference( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                       BaseType_t xFromISR )
+{
+    BaseType_t xWakeWaiter = pdFALSE;
+    uint32_t ulIndex = 0U;
+    BufferLifo_t * const pxLifo = prvFindPool( pxNetworkBuffer, &ulIndex );
+
+    if( ( pxLifo != NULL ) && ( prvDropReference( &( pxLifo->pxLinks[ ulIndex ] ) ) != pdFALSE ) )
+    {
+        pxNetworkBuffer->xDataLength = 0U;
+
+        #if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+            prvTrackOwner( pxNetworkBuffer, eNetworkBufferFree, xFromISR );
+        #else
+            ( void ) xFromISR;
+        #endif
+
+        prvLifoPush( pxLifo, ulIndex );
+
+        iptraceNETWORK_BUFFER_RELEASED( pxNetworkBuffer );
+
+        if( ( pxLifo == &xFreeBuffers ) && ( ulNetworkBufferWaiters != 0U ) )
+        {
+            xWakeWaiter = pdTRUE;
+        }
+    }
+
+    return xWakeWaiter;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The number of bytes a descriptor can hold, judged by the pool it belongs to. */
+static size_t prvBufferCapacity( const NetworkBufferDescriptor_t * pxNetworkBuffer )
+{
+    size_t uxCapacity = ( size_t ) ipTOTAL_ETHERNET_FRAME_SIZE;
+
+    #if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        if( xIsSmallNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+        {
+            uxCapacity = ( size_t ) ipconfigSMALL_NETWORK_BUFFER_SIZE;
+        }
+    #endif
+
+    #if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        if( xIsMediumNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+        {
+            uxCapacity = ( size_t ) ipconfigMEDIUM_NETWORK_BUFFER_SIZE;
+        }
+    #endif
+
+    ( void ) pxNetworkBuffer;
+
+    return uxCapacity;
+}
+
+/*-----------------------------------------------------------*/
+
+static NetworkBufferDescriptor_t * prvWaitForFreeBuffer( TickType_t xBlockTimeTicks )
+{
+    NetworkBufferDescriptor_t * pxReturn;
+    TimeOut_t xTimeOut;
+    TickType_t xRemainingTicks = xBlockTimeTicks;
+
+    vTaskSetTimeOutState( &xTimeOut );
+
+    /* Register before looking again, so a release that happens in between
+     * either leaves a descriptor to pop or gives the semaphore. */
+    prvAtomicAdd( &ulNetworkBufferWaiters, 1 );
+
+    for( ;; )
+    {
+        pxReturn = prvLifoPop( &xFreeBuffers );
+
+        if( ( pxReturn != NULL ) || ( xTaskCheckForTimeOut( &xTimeOut, &xRemainingTicks ) != pdFALSE ) )
+        {
+            break;
+        }
+
+        ( void ) xSemaphoreTake( xNetworkBufferSemaphore, xRemainingTicks );
+    }
+
+    prvAtomicAdd( &ulNetworkBufferWaiters, -1 );
+
+    return pxReturn;
 }
 
 /*-----------------------------------------------------------*/
@@ -76,15 +597,32 @@ UBaseType_t uxGetMinimumFreeNetworkBuffers( void )
 
 UBaseType_t uxGetNumberOfFreeNetworkBuffers( void )
 {
-    return listCURRENT_LIST_LENGTH( &xFreeBuffersList );
+    return ( UBaseType_t ) xFreeBuffers.ulCount;
 }
 
 /*-----------------------------------------------------------*/
 
 NetworkBufferDescriptor_t * pxResizeNetworkBufferWithDescriptor( NetworkBufferDescriptor_t * pxNetworkBuffer, size_t xNewSizeBytes )
 {
-    pxNetworkBuffer->xDataLength = xNewSizeBytes;
-    return pxNetworkBuffer;
+    NetworkBufferDescriptor_t * pxReturn = pxNetworkBuffer;
+
+    if( xNewSizeBytes <= prvBufferCapacity( pxNetworkBuffer ) )
+    {
+        pxNetworkBuffer->xDataLength = xNewSizeBytes;
+    }
+    else
+    {
+        /* Move to a bigger size class. On failure the original buffer is
+         * left untouched and still owned by the caller. */
+        pxReturn = pxDuplicateNetworkBufferWithDescriptor( pxNetworkBuffer, xNewSizeBytes );
+
+        if( pxReturn != NULL )
+        {
+            vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+        }
+    }
+
+    return pxReturn;
 }
 
 /*-----------------------------------------------------------*/
@@ -92,7 +630,6 @@ NetworkBufferDescriptor_t * pxResizeNetworkBufferWithDescriptor( NetworkBufferDe
 BaseType_t xNetworkBuffersInitialise( void )
 {
     BaseType_t xReturn;
-    size_t i;
 
     if( xNetworkBufferSemaphore == NULL )
     {
@@ -100,9 +637,9 @@ BaseType_t xNetworkBuffersInitialise( void )
 
         #if ( configSUPPORT_STATIC_ALLOCATION != 0 )
             static StaticSemaphore_t xNetworkBufferSemaphoreBuffer;
-            xNetworkBufferSemaphore = xSemaphoreCreateCountingStatic( ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, &xNetworkBufferSemaphoreBuffer );
+            xNetworkBufferSemaphore = xSemaphoreCreateCountingStatic( ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, 0U, &xNetworkBufferSemaphoreBuffer );
         #else
-            xNetworkBufferSemaphore = xSemaphoreCreateCounting( ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS );
+            xNetworkBufferSemaphore = xSemaphoreCreateCounting( ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, 0U );
         #endif
 
         configASSERT( xNetworkBufferSemaphore != NULL );
@@ -113,18 +650,25 @@ BaseType_t xNetworkBuffersInitialise( void )
                 vQueueAddToRegistry( xNetworkBufferSemaphore, "NetBufSem" );
             #endif
 
-            vListInitialise( &xFreeBuffersList );
+            ulNetworkBufferWaiters = 0U;
 
             vNetworkInterfaceAllocateRAMToBuffers( xNetworkBuffers );
 
-            for( i = 0U; i < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; ++i )
-            {
-                vListInitialiseItem( &( xNetworkBuffers[ i ].xBufferListItem ) );
-                listSET_LIST_ITEM_OWNER( &( xNetworkBuffers[ i ].xBufferListItem ), &xNetworkBuffers[ i ] );
-                vListInsert( &xFreeBuffersList, &( xNetworkBuffers[ i ].xBufferListItem ) );
-            }
+            prvLifoInitialise( &xFreeBuffers, xNetworkBuffers, xNetworkBufferLinks, ( uint32_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS );
 
             uxMinimumFreeNetworkBuffers = ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS;
+
+            #if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+                vNetworkInterfaceAllocateRAMToSmallBuffers( xSmallNetworkBuffers );
+
+                prvLifoInitialise( &xFreeSmallBuffers, xSmallNetworkBuffers, xSmallNetworkBufferLinks, ( uint32_t ) ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS );
+            #endif
+
+            #if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+                vNetworkInterfaceAllocateRAMToMediumBuffers( xMediumNetworkBuffers );
+
+                prvLifoInitialise( &xFreeMediumBuffers, xMediumNetworkBuffers, xMediumNetworkBufferLinks, ( uint32_t ) ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS );
+            #endif
         }
     }
 
@@ -144,45 +688,31 @@ BaseType_t xNetworkBuffersInitialise( void )
 NetworkBufferDescriptor_t * pxGetNetworkBufferWithDescriptor( size_t xRequestedSizeBytes, TickType_t xBlockTimeTicks )
 {
     NetworkBufferDescriptor_t * pxReturn = NULL;
-    UBaseType_t uxCount;
 
     if( xNetworkBufferSemaphore != NULL )
     {
-        if( xSemaphoreTake( xNetworkBufferSemaphore, xBlockTimeTicks ) == pdPASS )
+        pxReturn = prvPopSizedBuffer( xRequestedSizeBytes );
+
+        if( pxReturn == NULL )
         {
-            ipconfigBUFFER_ALLOC_LOCK();
+            pxReturn = prvLifoPop( &xFreeBuffers );
+
+            /* Only a caller that is prepared to wait touches the kernel. */
+            if( ( pxReturn == NULL ) && ( xBlockTimeTicks > ( TickType_t ) 0U ) )
             {
-                pxReturn = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &xFreeBuffersList );
-
-                if( xIsFreeBuffer( pxReturn ) != pdFALSE )
-                {
-                    ( void ) uxListRemove( &( pxReturn->xBufferListItem ) );
-                }
-                else
-                {
-                    pxReturn = NULL;
-                }
+                pxReturn = prvWaitForFreeBuffer( xBlockTimeTicks );
             }
-            ipconfigBUFFER_ALLOC_UNLOCK();
 
             if( pxReturn != NULL )
             {
-                uxCount = uxGetNumberOfFreeNetworkBuffers();
-
-                if( uxMinimumFreeNetworkBuffers > uxCount )
-                {
-                    uxMinimumFreeNetworkBuffers = uxCount;
-                }
-
-                pxReturn->xDataLength = xRequestedSizeBytes;
-                pxReturn->pxInterface = NULL;
-                pxReturn->pxEndPoint = NULL;
-
-                #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
-                    pxReturn->pxNextBuffer = NULL;
-                #endif
+                prvUpdateMinimumFree();
             }
         }
+
+        if( pxReturn != NULL )
+        {
+            prvPrepareDescriptor( pxReturn, xRequestedSizeBytes, pdFALSE );
+        }
     }
 
     if( pxReturn == NULL )
@@ -198,32 +728,51 @@ NetworkBufferDescriptor_t * pxGetNetworkBufferWithDescriptor( size_t xRequestedS
 }
 /*-----------------------------------------------------------*/
 
-void vReleaseNetworkBufferAndDescriptor( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+NetworkBufferDescriptor_t * pxGetSmallNetworkBufferWithDescriptor( size_t xRequestedSizeBytes )
 {
-    BaseType_t xListItemAlreadyInFreeList;
+    NetworkBufferDescriptor_t * pxReturn = NULL;
 
-    if( xIsValidNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+    if( ( xNetworkBufferSemaphore != NULL ) && ( xRequestedSizeBytes <= ( size_t ) ipconfigSMALL_NETWORK_BUFFER_SIZE ) )
     {
-        ipconfigBUFFER_ALLOC_LOCK();
+        pxReturn = prvLifoPop( &xFreeSmallBuffers );
+
+        if( pxReturn != NULL )
         {
-            xListItemAlreadyInFreeList = listIS_CONTAINED_WITHIN( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
+            prvPrepareDescriptor( pxReturn, xRequestedSizeBytes, pdFALSE );
 
-            if( xListItemAlreadyInFreeList == pdFALSE )
-            {
-                vListInsertEnd( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
-            }
+            iptraceNETWORK_BUFFER_OBTAINED( pxReturn );
         }
-        ipconfigBUFFER_ALLOC_UNLOCK();
+    }
 
-        if( xListItemAlreadyInFreeList == pdFALSE )
-        {
-            if( xSemaphoreGive( xNetworkBufferSemaphore ) == pdPASS )
-            {
-                iptraceNETWORK_BUFFER_RELEASED( pxNetworkBuffer );
-            }
+    return pxReturn;
+}
+/*-----------------------------------------------------------*/
 
-            pxNetworkBuffer->xDataLength = 0U;
-        }
+UBaseType_t uxGetNumberOfFreeSmallNetworkBuffers( void )
+{
+    return ( UBaseType_t ) xFreeSmallBuffers.ulCount;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 ) */
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+UBaseType_t uxGetNumberOfFreeMediumNetworkBuffers( void )
+{
+    return ( UBaseType_t ) xFreeMediumBuffers.ulCount;
+}
+/*-----------------------------------------------------------*/
+
+#endif
+
+void vReleaseNetworkBufferAndDescriptor( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+    if( prvReleaseReference( pxNetworkBuffer, pdFALSE ) != pdFALSE )
+    {
+        ( void ) xSemaphoreGive( xNetworkBufferSemaphore );
     }
 }
 /*-----------------------------------------------------------*/
@@ -231,48 +780,25 @@ void vReleaseNetworkBufferAndDescriptor( NetworkBufferDescriptor_t * const pxNet
 NetworkBufferDescriptor_t * pxNetworkBufferGetFromISR( size_t xRequestedSizeBytes )
 {
     NetworkBufferDescriptor_t * pxReturn = NULL;
-    UBaseType_t uxCount;
 
     if( xNetworkBufferSemaphore != NULL )
     {
-        if( uxQueueMessagesWaitingFromISR( ( QueueHandle_t ) xNetworkBufferSemaphore ) > ( UBaseType_t ) baINTERRUPT_BUFFER_GET_THRESHOLD )
+        pxReturn = prvPopSizedBuffer( xRequestedSizeBytes );
+
+        if( ( pxReturn == NULL ) && ( uxGetNumberOfFreeNetworkBuffers() > ( UBaseType_t ) baINTERRUPT_BUFFER_GET_THRESHOLD ) )
         {
-            if( xSemaphoreTakeFromISR( xNetworkBufferSemaphore, NULL ) == pdPASS )
+            pxReturn = prvLifoPop( &xFreeBuffers );
+
+            if( pxReturn != NULL )
             {
-                ipconfigBUFFER_ALLOC_LOCK_FROM_ISR();
-                {
-                    pxReturn = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &xFreeBuffersList );
-
-                    if( xIsFreeBuffer( pxReturn ) != pdFALSE )
-                    {
-                        ( void ) uxListRemove( &( pxReturn->xBufferListItem ) );
-                    }
-                    else
-                    {
-                        pxReturn = NULL;
-                    }
-                }
-                ipconfigBUFFER_ALLOC_UNLOCK_FROM_ISR();
-
-                if( pxReturn != NULL )
-                {
-                    uxCount = uxGetNumberOfFreeNetworkBuffers();
-
-                    if( uxMinimumFreeNetworkBuffers > uxCount )
-                    {
-                        uxMinimumFreeNetworkBuffers = uxCount;
-                    }
-
-                    pxReturn->xDataLength = xRequestedSizeBytes;
-                    pxReturn->pxInterface = NULL;
-                    pxReturn->pxEndPoint = NULL;
-
-                    #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
-                        pxReturn->pxNextBuffer = NULL;
-                    #endif
-                }
+                prvUpdateMinimumFree();
             }
         }
+
+        if( pxReturn != NULL )
+        {
+            prvPrepareDescriptor( pxReturn, xRequestedSizeBytes, pdTRUE );
+        }
     }
 
     if( pxReturn == NULL )
@@ -291,33 +817,84 @@ NetworkBufferDescriptor_t * pxNetworkBufferGetFromISR( size_t xRequestedSizeByte
 BaseType_t xReleaseNetworkBufferFromISR( NetworkBufferDescriptor_t * const pxNetworkBuffer )
 {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    BaseType_t xListItemAlreadyInFreeList;
 
-    if( xIsValidNetworkDescriptor( pxNetworkBuffer ) != pdFALSE )
+    if( prvReleaseReference( pxNetworkBuffer, pdTRUE ) != pdFALSE )
+    {
+        ( void ) xSemaphoreGiveFromISR( xNetworkBufferSemaphore, &xHigherPriorityTaskWoken );
+    }
+
+    return xHigherPriorityTaskWoken;
+}
+
+/*-----------------------------------------------------------*/
+
+NetworkBufferDescriptor_t * pxNetworkBufferAddReference( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+    NetworkBufferDescriptor_t * pxReturn = NULL;
+    uint32_t ulIndex = 0U;
+    uint32_t ulCount;
+    BufferLifo_t * const pxLifo = prvFindPool( pxNetworkBuffer, &ulIndex );
+
+    if( pxLifo != NULL )
     {
-        ipconfigBUFFER_ALLOC_LOCK_FROM_ISR();
+        /* A descriptor that is on the free list cannot be revived. */
+        do
         {
-            xListItemAlreadyInFreeList = listIS_CONTAINED_WITHIN( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
+            ulCount = pxLifo->pxLinks[ ulIndex ].ulRefCount;
+        } while( ( ulCount != 0U ) && ( prvCompareAndSwap( &( pxLifo->pxLinks[ ulIndex ].ulRefCount ), ulCount, ulCount + 1U ) == pdFALSE ) );
 
-            if( xListItemAlreadyInFreeList == pdFALSE )
-            {
-                vListInsertEnd( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
-            }
+        if( ulCount != 0U )
+        {
+            pxReturn = pxNetworkBuffer;
         }
-        ipconfigBUFFER_ALLOC_UNLOCK_FROM_ISR();
+    }
+
+    return pxReturn;
+}
 
-        if( xListItemAlreadyInFreeList == pdFALSE )
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 )
+
+void vNetworkBufferSetOwner( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                             eNetworkBufferOwner_t eOwner )
+{
+    /* Only the allocator puts a buffer back on a free list. */
+    if( eOwner != eNetworkBufferFree )
+    {
+        prvTrackOwner( pxNetworkBuffer, eOwner, pdFALSE );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vGetNetworkBufferOwnerStats( NetworkBufferOwnerStats_t pxStats[ eNetworkBufferOwnerCount ] )
+{
+    const TickType_t xNow = xTaskGetTickCount();
+    UBaseType_t uxOwner;
+    UBaseType_t uxBucket;
+
+    ( void ) memset( pxStats, 0, sizeof( NetworkBufferOwnerStats_t ) * ( size_t ) eNetworkBufferOwnerCount );
+
+    for( uxOwner = 0U; uxOwner < ( UBaseType_t ) eNetworkBufferOwnerCount; ++uxOwner )
+    {
+        for( uxBucket = 0U; uxBucket < ipNETWORK_BUFFER_HOLD_BUCKETS; ++uxBucket )
         {
-            if( xSemaphoreGiveFromISR( xNetworkBufferSemaphore, &xHigherPriorityTaskWoken ) == pdPASS )
-            {
-                iptraceNETWORK_BUFFER_RELEASED( pxNetworkBuffer );
-            }
+            pxStats[ uxOwner ].ulHoldTimes[ uxBucket ] = ulHoldTimes[ uxOwner ][ uxBucket ];
         }
-
-        pxNetworkBuffer->xDataLength = 0U;
     }
 
-    return xHigherPriorityTaskWoken;
+    prvCollectOwnerStats( &xFreeBuffers, ( uint32_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, xNow, pxStats );
+
+    #if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        prvCollectOwnerStats( &xFreeSmallBuffers, ( uint32_t ) ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, xNow, pxStats );
+    #endif
+
+    #if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+        prvCollectOwnerStats( &xFreeMediumBuffers, ( uint32_t ) ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS, xNow, pxStats );
+    #endif
 }
 
 /*-----------------------------------------------------------*/
+
+#endif /* if ( ipconfigTRACK_NETWORK_BUFFER_OWNERS != 0 ) */
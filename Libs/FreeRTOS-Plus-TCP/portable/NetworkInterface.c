@@ -51,10 +51,15 @@
 #include "FreeRTOS_Routing.h"
 #if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
     #include "FreeRTOS_Sockets.h"
+    #include "FreeRTOS_ICMP.h"
+    #if ipconfigIS_ENABLED( ipconfigUSE_DNS )
+        #include "FreeRTOS_DNS.h"
+    #endif
 #endif
 #include "NetworkBufferManagement.h"
 #include "NetworkInterface.h"
 #include "phyHandling.h"
+#include "NetworkInterface_STM32.h"
 
 /* ST includes. */
 #if defined( STM32F4 )
@@ -71,6 +76,8 @@
     #error "Unknown STM32 Family for NetworkInterface"
 #endif /* if defined( STM32F4 ) */
 
+#if ipconfigIS_DISABLED( niEMAC_REGISTER_DRIVER )
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
 /*                                Config                                     */
@@ -91,13 +98,21 @@
 #define niEMAC_RX_DESC_SECTION            ".RxDescripSection"
 #define niEMAC_BUFFERS_SECTION            ".EthBuffersSection"
 
+/* Bytes the linker script and the MPU set aside for both descriptor sections. The ring depths,
+ * ETH_TX_DESC_CNT and ETH_RX_DESC_CNT, come from the HAL configuration or the build. */
+#define niEMAC_DESC_REGION_SIZE           1024U
+
 #define niEMAC_TASK_MAX_BLOCK_TIME_MS     100U
 #define niEMAC_TX_MAX_BLOCK_TIME_MS       20U
 #define niEMAC_RX_MAX_BLOCK_TIME_MS       20U
-#define niEMAC_DESCRIPTOR_WAIT_TIME_MS    20U
 
-#define niEMAC_TX_MUTEX_NAME              "EMAC_TxMutex"
-#define niEMAC_TX_DESC_SEM_NAME           "EMAC_TxDescSem"
+#define niEMAC_TX_QUEUE_NAME              "EMAC_TxQueue"
+#define niEMAC_TX_QUEUE_LENGTH            ( 2U * ETH_TX_DESC_CNT )
+
+#define niEMAC_RX_RESERVE_NAME            "EMAC_RxReserve"
+#define niEMAC_RX_RESERVE_LENGTH          ETH_RX_DESC_CNT
+#define niEMAC_RX_REFILL_DELAY_TICKS      1U
+#define niEMAC_MDIO_POLL_DELAY_TICKS      1U
 
 #define niEMAC_AUTO_NEGOTIATION           ipconfigENABLE
 #define niEMAC_USE_100MB                  ( ipconfigENABLE && ipconfigIS_DISABLED( niEMAC_AUTO_NEGOTIATION ) )
@@ -105,10 +120,68 @@
 #define niEMAC_AUTO_CROSS                 ( ipconfigENABLE && ipconfigIS_ENABLED( niEMAC_AUTO_NEGOTIATION ) )
 #define niEMAC_CROSSED_LINK               ( ipconfigENABLE && ipconfigIS_DISABLED( niEMAC_AUTO_CROSS ) )
 
+/* The PHY interrupt output is wired to an EXTI line whose handler calls vSTM32_PhyIRQHandler */
+#define niEMAC_PHY_INTERRUPT              ipconfigDISABLE
+
+/* Reset and negotiate the PHY in the EMAC task, the interface comes up once the link does */
+#define niEMAC_PHY_ASYNC_START            ipconfigENABLE
+
+/* Reuse the negotiated link after a warm reset, kept in RAM the startup code neither loads nor zeroes */
+#define niEMAC_PHY_CACHE                  ipconfigDISABLE
+#define niEMAC_PHY_CACHE_SECTION          ".noinit"
+
 #define niEMAC_USE_RMII                   ipconfigENABLE
 
+#define niEMAC_TCP_SEGMENTATION           ( ipconfigENABLE && ipconfigIS_ENABLED( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD ) )
+
 #define niEMAC_USE_MPU                    ipconfigENABLE
 
+#define niEMAC_RX_MODERATION              ipconfigENABLE
+#define niEMAC_RX_MODERATION_FRAMES       ( ( ETH_RX_DESC_CNT + 1U ) / 2U )
+#define niEMAC_RX_MODERATION_STEP_US      10U
+#define niEMAC_RX_MODERATION_MAX_US       100U
+
+#define niEMAC_RX_POLLING                 ipconfigENABLE
+#define niEMAC_RX_POLL_BUDGET             ETH_RX_DESC_CNT
+#define niEMAC_RX_POLL_DELAY_TICKS        1U
+
+/* Take a Tx completion interrupt every few frames, or when frames wait for room in the Tx ring */
+#define niEMAC_TX_COALESCING              ipconfigENABLE
+#define niEMAC_TX_COALESCE_FRAMES         ( ( ETH_TX_DESC_CNT + 1U ) / 2U )
+#define niEMAC_TX_COALESCE_DELAY_TICKS    1U
+
+/* Receive frames into several smaller Rx buffers, linked through pxNextBuffer, may be set from the build */
+#ifndef niEMAC_RX_CHAINING
+    #define niEMAC_RX_CHAINING            ipconfigDISABLE
+#endif
+#define niEMAC_RX_CHAIN_BUFFER_SIZE       512U
+
+/* Copy small UDP frames into a small network buffer, and give the large one straight back to the DMA */
+#define niEMAC_RX_COPY_BREAK              ( ipconfigENABLE && ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 ) )
+#define niEMAC_RX_COPY_BREAK_BYTES        128U
+
+/* Frames of up to ETH_JUMBO_FRAME_PAYLOAD bytes, sized by ipconfigNETWORK_MTU */
+#define niEMAC_JUMBO_FRAMES               ipconfigDISABLE
+
+/* Hardware timestamps of Rx and Tx frames, and a clock that PTP style exchanges can discipline, may be set from the build */
+#ifndef niEMAC_TIMESTAMPING
+    #define niEMAC_TIMESTAMPING           ipconfigDISABLE
+#endif
+#define niEMAC_PTP_CLOCK_HZ               50000000U /* Rate of the sub-second counter, at most half of HCLK */
+#define niEMAC_PTP_STEP_NS                1000000   /* Offsets from the master beyond this are stepped rather than slewed */
+#define niEMAC_PTP_MAX_PPB                500000    /* Largest frequency trim, in parts per billion */
+#define niEMAC_PTP_KP_DIVISOR             2         /* Proportional gain of the clock servo, as a divisor of the offset */
+#define niEMAC_PTP_KI_DIVISOR             8         /* Integral gain of the clock servo, as a divisor of the offset */
+
+/* Interface contexts handed out by pxSTM32_FillInterfaceDescriptor, and the ETH peripheral each
+ * one drives. Parts with a single ETH keep one context, both may be set from the build. */
+#ifndef niEMAC_INSTANCE_COUNT
+    #define niEMAC_INSTANCE_COUNT            1U
+#endif
+#ifndef niEMAC_ETH_INSTANCE
+    #define niEMAC_ETH_INSTANCE( xIndex )    ETH
+#endif
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
 /*                             Config Checks                                 */
@@ -139,14 +212,83 @@
     #error "ipconfigZERO_COPY_RX_DRIVER must be enabled for NetworkInterface"
 #endif
 
-#if ( ipconfigNETWORK_MTU < ETH_MIN_PAYLOAD ) || ( ipconfigNETWORK_MTU > ETH_MAX_PAYLOAD )
+#if ipconfigIS_ENABLED( niEMAC_JUMBO_FRAMES )
+    #if ( ipconfigNETWORK_MTU < ETH_MIN_PAYLOAD ) || ( ipconfigNETWORK_MTU > ETH_JUMBO_FRAME_PAYLOAD )
+        #error "Unsupported ipconfigNETWORK_MTU size for NetworkInterface"
+    #endif
+#elif ( ipconfigNETWORK_MTU < ETH_MIN_PAYLOAD ) || ( ipconfigNETWORK_MTU > ETH_MAX_PAYLOAD )
     #error "Unsupported ipconfigNETWORK_MTU size for NetworkInterface"
 #endif
 
+#if ipconfigIS_ENABLED( niEMAC_JUMBO_FRAMES ) && defined( niEMAC_STM32FX )
+    #error "Jumbo frames are only supported by the STM32H7/H5 EMAC"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_JUMBO_FRAMES ) && ( ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM ) || ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION ) )
+    #error "Jumbo frames are cut through the Tx FIFO, which bypasses the Tx checksum offload that ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM and niEMAC_TCP_SEGMENTATION rely on"
+#endif
+
+#if ipconfigIS_ENABLED( ipconfigUSE_TCP_SEGMENTATION_OFFLOAD ) && ipconfigIS_DISABLED( niEMAC_TCP_SEGMENTATION )
+    #error "ipconfigUSE_TCP_SEGMENTATION_OFFLOAD requires niEMAC_TCP_SEGMENTATION for NetworkInterface"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION ) && defined( niEMAC_STM32FX )
+    #error "TCP Segmentation Offload is only supported by the STM32H7/H5 EMAC"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_RX_MODERATION ) && ( ( niEMAC_RX_MODERATION_STEP_US == 0 ) || ( niEMAC_RX_MODERATION_STEP_US > niEMAC_RX_MODERATION_MAX_US ) )
+    #error "niEMAC_RX_MODERATION_STEP_US must be non-zero and no larger than niEMAC_RX_MODERATION_MAX_US"
+#endif
+
+#if ( niEMAC_RX_RESERVE_LENGTH == 0 ) || ( niEMAC_RX_REFILL_DELAY_TICKS == 0 )
+    #error "niEMAC_RX_RESERVE_LENGTH and niEMAC_RX_REFILL_DELAY_TICKS must be non-zero"
+#endif
+
+#if ( ETH_RX_DESC_CNT + niEMAC_RX_RESERVE_LENGTH ) >= ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS
+    #error "The Rx descriptors and the Rx reserve would take every network buffer"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_TX_COALESCING ) && ( ( niEMAC_TX_COALESCE_FRAMES == 0 ) || ( niEMAC_TX_COALESCE_DELAY_TICKS == 0 ) )
+    #error "niEMAC_TX_COALESCE_FRAMES and niEMAC_TX_COALESCE_DELAY_TICKS must be non-zero"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_RX_POLLING ) && ( ( niEMAC_RX_POLL_BUDGET == 0 ) || ( niEMAC_RX_POLL_DELAY_TICKS == 0 ) )
+    #error "niEMAC_RX_POLL_BUDGET and niEMAC_RX_POLL_DELAY_TICKS must be non-zero"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING ) && ( ( niEMAC_PTP_CLOCK_HZ == 0 ) || ( ( 1000000000U % niEMAC_PTP_CLOCK_HZ ) != 0 ) || ( ( 1000000000U / niEMAC_PTP_CLOCK_HZ ) > 0xFFU ) )
+    #error "niEMAC_PTP_CLOCK_HZ must give a whole sub-second increment of at most 255 ns"
+#endif
+
+#if ( niEMAC_INSTANCE_COUNT == 0 )
+    #error "niEMAC_INSTANCE_COUNT must be non-zero"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK ) && ( niEMAC_RX_COPY_BREAK_BYTES > ipconfigSMALL_NETWORK_BUFFER_SIZE )
+    #error "niEMAC_RX_COPY_BREAK_BYTES must not exceed ipconfigSMALL_NETWORK_BUFFER_SIZE"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_RX_CHAINING ) && ipconfigIS_DISABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+    #error "niEMAC_RX_CHAINING requires ipconfigUSE_LINKED_RX_MESSAGES to link the buffers of a frame"
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_RX_CHAINING ) && ( ( ( ipconfigNETWORK_MTU + ( ETH_MAX_PACKET_SIZE - ETH_MAX_PAYLOAD ) + niEMAC_RX_CHAIN_BUFFER_SIZE - 1U ) / niEMAC_RX_CHAIN_BUFFER_SIZE ) > ETH_RX_DESC_CNT )
+    #error "A full sized frame does not fit in the Rx descriptor ring, increase ETH_RX_DESC_CNT or niEMAC_RX_CHAIN_BUFFER_SIZE"
+#endif
+
+/* The rings of every context must fit the region set aside by the linker script and the MPU */
+STATIC_ASSERT( ( sizeof( ETH_DMADescTypeDef ) * ( ETH_TX_DESC_CNT + ETH_RX_DESC_CNT ) * niEMAC_INSTANCE_COUNT ) <= niEMAC_DESC_REGION_SIZE );
+
+/* The F4/F7 HAL_ETH_ReleaseTxPacket wraps its index with ( ETH_TX_DESC_CNT - 1U ) as a mask, the other
+ * indexes of the HALs and of this driver wrap by comparison with the depth */
+#if defined( niEMAC_STM32FX )
+    STATIC_ASSERT( ( ETH_TX_DESC_CNT & ( ETH_TX_DESC_CNT - 1U ) ) == 0U );
+#endif
+
 #if ipconfigIS_DISABLED( ipconfigPORT_SUPPRESS_WARNING )
 
     #if defined( niEMAC_STM32FX ) && defined( ETH_RX_BUF_SIZE )
-        #warning "As of F7 V1.17.1 && F4 V1.28.0, a bug exists in the ETH HAL Driver where ETH_RX_BUF_SIZE is used instead of RxBuffLen, so ETH_RX_BUF_SIZE must == niEMAC_DATA_BUFFER_SIZE"
+        #warning "As of F7 V1.17.1 && F4 V1.28.0, a bug exists in the ETH HAL Driver where ETH_RX_BUF_SIZE is used instead of RxBuffLen, so ETH_RX_BUF_SIZE must == niEMAC_RX_BUFFER_SIZE"
     #endif
 
     #if ipconfigIS_DISABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM )
@@ -161,19 +303,24 @@
         #warning "Consider enabling ipconfigETHERNET_DRIVER_FILTERS_FRAME_TYPES for NetworkInterface"
     #endif
 
-/* TODO: There should be a universal check for use in network interfaces, similar to eConsiderFrameForProcessing.
- * So, don't use this macro, and filter anyways in the mean time. */
-
-/* #if ipconfigIS_DISABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
- #warning "Consider enabling ipconfigETHERNET_DRIVER_FILTERS_PACKETS for NetworkInterface"
- #endif */
+    #if ipconfigIS_DISABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
+        #warning "Consider enabling ipconfigETHERNET_DRIVER_FILTERS_PACKETS for NetworkInterface"
+    #endif
 
     #if ipconfigIS_DISABLED( ipconfigUSE_LINKED_RX_MESSAGES )
         #warning "Consider enabling ipconfigUSE_LINKED_RX_MESSAGES for NetworkInterface"
     #endif
 
+    #if ipconfigIS_ENABLED( niEMAC_JUMBO_FRAMES ) && ipconfigIS_ENABLED( ipconfigUSE_TCP ) && ( ipconfigTCP_MSS <= ( ETH_MAX_PAYLOAD - 40U ) )
+        #warning "ipconfigTCP_MSS does not make use of jumbo frames, leave it to its default derived from ipconfigNETWORK_MTU"
+    #endif
+
 #endif /* if ipconfigIS_DISABLED( ipconfigPORT_SUPPRESS_WARNING ) */
 
+#if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS ) && ipconfigIS_DISABLED( ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM )
+    #error "ipconfigETHERNET_DRIVER_FILTERS_PACKETS requires ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM for the Rx descriptor classification"
+#endif
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
 /*                            Macros & Definitions                           */
@@ -204,6 +351,42 @@
 
 #define niEMAC_DATA_BUFFER_SIZE          ( ( ipTOTAL_ETHERNET_FRAME_SIZE + niEMAC_DATA_ALIGNMENT_MASK ) & ~niEMAC_DATA_ALIGNMENT_MASK )
 #define niEMAC_TOTAL_BUFFER_SIZE         ( ( ( niEMAC_DATA_BUFFER_SIZE + ipBUFFER_PADDING ) + niEMAC_BUF_ALIGNMENT_MASK ) & ~niEMAC_BUF_ALIGNMENT_MASK )
+#define niEMAC_SMALL_TOTAL_BUFFER_SIZE   ( ( ( ipconfigSMALL_NETWORK_BUFFER_SIZE + ipBUFFER_PADDING ) + niEMAC_BUF_ALIGNMENT_MASK ) & ~niEMAC_BUF_ALIGNMENT_MASK )
+#define niEMAC_MEDIUM_TOTAL_BUFFER_SIZE  ( ( ( ipconfigMEDIUM_NETWORK_BUFFER_SIZE + ipBUFFER_PADDING ) + niEMAC_BUF_ALIGNMENT_MASK ) & ~niEMAC_BUF_ALIGNMENT_MASK )
+
+/* Size of the buffers given to the Rx descriptors */
+#if ipconfigIS_ENABLED( niEMAC_RX_CHAINING )
+    #define niEMAC_RX_BUFFER_SIZE        ( ( niEMAC_RX_CHAIN_BUFFER_SIZE + niEMAC_DATA_ALIGNMENT_MASK ) & ~niEMAC_DATA_ALIGNMENT_MASK )
+#else
+    #define niEMAC_RX_BUFFER_SIZE        niEMAC_DATA_BUFFER_SIZE
+#endif
+
+/* Number of data buffers each Tx DMA descriptor can point at */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_BUFS_PER_DESC    1U
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_BUFS_PER_DESC    2U
+#endif
+
+/* Largest number of network buffers a single transmitted frame may be split across */
+#if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+    #define niEMAC_TX_MAX_BUFFERS    ( niEMAC_BUFS_PER_DESC * ETH_TX_DESC_CNT )
+#else
+    #define niEMAC_TX_MAX_BUFFERS    1U
+#endif
+
+#if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+
+/* A super-segment takes a context descriptor for its MSS, and its headers take a buffer of their own */
+    #define niEMAC_TSO_MAX_BUFFERS    ( niEMAC_BUFS_PER_DESC * ( ETH_TX_DESC_CNT - 1U ) )
+
+/* Limited by the 16 bit length field of the IP header */
+    #define niEMAC_TSO_MAX_LENGTH     ( ipSIZE_OF_ETH_HEADER + UINT16_MAX )
+
+    #if ( ( ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS + 1 ) > niEMAC_TSO_MAX_BUFFERS )
+        #error "ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS does not fit in the Tx descriptor ring, increase ETH_TX_DESC_CNT"
+    #endif
+#endif
 
 #if defined( niEMAC_STM32FX )
 
@@ -236,6 +419,12 @@
     #undef ETH_IP_PAYLOAD_ICMPN
     #define ETH_IP_PAYLOAD_ICMPN         ETH_DMAPTPRXDESC_IPPT_ICMP
 
+    #undef ETH_CHECKSUM_IP_HEADER_ERROR
+    #define ETH_CHECKSUM_IP_HEADER_ERROR     ETH_DMAPTPRXDESC_IPHE
+
+    #undef ETH_CHECKSUM_IP_PAYLOAD_ERROR
+    #define ETH_CHECKSUM_IP_PAYLOAD_ERROR    ETH_DMAPTPRXDESC_IPPE
+
 #elif defined( niEMAC_STM32HX )
 
     #undef ETH_DMA_TX_BUFFER_UNAVAILABLE_FLAG
@@ -255,6 +444,119 @@
 #define niEMAC_ADDRESS_HASH_BITS      64U
 #define niEMAC_MAC_SRC_MATCH_COUNT    3U
 
+/* Frames read per wake-up of the EMAC task when not polling */
+#define niEMAC_RX_UNLIMITED_BUDGET    ( ( UBaseType_t ) ~0U )
+
+/* The Rx interrupt watchdog counts in units of 256 HCLK cycles, with an 8 bit counter */
+#define niEMAC_RX_WATCHDOG_UNIT       256U
+#define niEMAC_RX_WATCHDOG_MAX        0xFFU
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_RX_WATCHDOG_REG( ETHx )    ( ( ETHx )->DMARSWTR )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_RX_WATCHDOG_REG( ETHx )    ( ( ETHx )->DMACRIWTR )
+#endif
+
+/* Frames dropped by the DMA for want of an Rx descriptor, the counter clears when read */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_RX_MISSED_FRAMES( ETHx )    ( ( ETHx )->DMAMFBOCR & ETH_DMAMFBOCR_MFC )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_RX_MISSED_FRAMES( ETHx )    ( ( ETHx )->DMACMFCR & ETH_DMACMFCR_MFC )
+#endif
+
+/* Rx checksum offload engine classification, written back to the last descriptor of a frame */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_RX_DESC_CLASSIFIED( pxDesc )    ( ( ( pxDesc )->DESC0 & ETH_DMARXDESC_MAMPCE ) != 0U )
+    #define niEMAC_RX_DESC_CLASS( pxDesc )         ( ( pxDesc )->DESC4 )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_RX_DESC_CLASSIFIED( pxDesc )    ( ( ( pxDesc )->DESC3 & ETH_DMARXNDESCWBF_RS1V ) != 0U )
+    #define niEMAC_RX_DESC_CLASS( pxDesc )         ( ( pxDesc )->DESC1 )
+#endif
+#define niEMAC_RX_DESC_IP_ERRORS    ( ETH_CHECKSUM_IP_HEADER_ERROR | ETH_CHECKSUM_IP_PAYLOAD_ERROR )
+
+/* Rx descriptor write-back status, the frame length is only valid in the last descriptor of a frame */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_RX_DESC_IS_FIRST( pxDesc )        ( ( ( pxDesc )->DESC0 & ETH_DMARXDESC_FS ) != 0U )
+    #define niEMAC_RX_DESC_IS_LAST( pxDesc )         ( ( ( pxDesc )->DESC0 & ETH_DMARXDESC_LS ) != 0U )
+    #define niEMAC_RX_DESC_FRAME_LENGTH( pxDesc )    ( ( ( ( pxDesc )->DESC0 & ETH_DMARXDESC_FL ) >> 16U ) - ipSIZE_OF_ETH_CRC_BYTES )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_RX_DESC_IS_FIRST( pxDesc )        ( ( ( pxDesc )->DESC3 & ETH_DMARXNDESCWBF_FD ) != 0U )
+    #define niEMAC_RX_DESC_IS_LAST( pxDesc )         ( ( ( pxDesc )->DESC3 & ETH_DMARXNDESCWBF_LD ) != 0U )
+    #define niEMAC_RX_DESC_FRAME_LENGTH( pxDesc )    ( ( pxDesc )->DESC3 & ETH_DMARXNDESCWBF_PL )
+#endif
+
+/* Timestamp status of the descriptors. The F7 Rx status flags the stamp in enhanced descriptors,
+ * the H7/H5 one announces a context descriptor holding it, which follows the last descriptor. */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_RX_DESC_TSV                      ( 1UL << 7U )
+    #define niEMAC_TX_DESC_TIMESTAMPED( pxDesc )    ( ( ( pxDesc )->DESC0 & ETH_DMATXDESC_TTSS ) != 0U )
+    #define niEMAC_TX_DESC_OWNED( pxDesc )          ( ( ( pxDesc )->DESC0 & ETH_DMATXDESC_OWN ) != 0U )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_TX_DESC_TIMESTAMPED( pxDesc )    ( ( ( pxDesc )->DESC3 & ETH_DMATXNDESCWBF_TTSS ) != 0U )
+    #define niEMAC_TX_DESC_OWNED( pxDesc )          ( ( ( pxDesc )->DESC3 & ETH_DMATXNDESCWBF_OWN ) != 0U )
+#endif
+#define niEMAC_TIMESTAMP_NS_MASK    0x7FFFFFFFUL
+#define niEMAC_NS_PER_SECOND        1000000000UL
+
+/* Timestamp state kept per network buffer */
+#define niEMAC_BUF_RX_TIMESTAMP     ( 1U << 0U )
+#define niEMAC_BUF_TX_TIMESTAMP     ( 1U << 1U )
+
+/* The Rx descriptor of a buffer is looked up to chain frames, to filter on its classification, or to read its timestamp */
+#define niEMAC_RX_DESC_LOOKUP    ( ipconfigIS_ENABLED( niEMAC_RX_CHAINING ) || ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS ) || ipconfigIS_ENABLED( niEMAC_TIMESTAMPING ) )
+
+/* DMA process state and fatal bus error source. On the H7/H5 a Tx fault either reads a buffer
+ * or writes back a descriptor, so its error bits are never all clear. */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_DMA_TX_STOPPED( pxInstance )    ( ( ( pxInstance )->DMASR & ETH_DMASR_TPS ) == ETH_DMASR_TPS_Stopped )
+    #define niEMAC_DMA_RX_STOPPED( pxInstance )    ( ( ( pxInstance )->DMASR & ETH_DMASR_RPS ) == ETH_DMASR_RPS_Stopped )
+    #define niEMAC_DMA_TX_FAULT( pxInstance )      ( ( ( pxInstance )->DMASR & ( ETH_DMASR_FBES | ETH_DMASR_EBS_DataTransfTx ) ) == ( ETH_DMASR_FBES | ETH_DMASR_EBS_DataTransfTx ) )
+    #define niEMAC_DMA_RX_FAULT( pxInstance )      ( ( ( pxInstance )->DMASR & ( ETH_DMASR_FBES | ETH_DMASR_EBS_DataTransfTx ) ) == ETH_DMASR_FBES )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_DMA_TX_STOPPED( pxInstance )    ( ( ( pxInstance )->DMADSR & ETH_DMADSR_TPS ) == 0U )
+    #define niEMAC_DMA_RX_STOPPED( pxInstance )    ( ( ( pxInstance )->DMADSR & ETH_DMADSR_RPS ) == 0U )
+    #define niEMAC_DMA_TX_FAULT( pxInstance )      ( ( ( ( pxInstance )->DMACSR & ETH_DMACSR_FBE ) != 0U ) && ( ( ( pxInstance )->DMACSR & ETH_DMACSR_TEB ) != 0U ) )
+    #define niEMAC_DMA_RX_FAULT( pxInstance )      ( ( ( ( pxInstance )->DMACSR & ETH_DMACSR_FBE ) != 0U ) && ( ( ( pxInstance )->DMACSR & ETH_DMACSR_TEB ) == 0U ) )
+#endif
+#define niEMAC_DMA_STOP_POLLS    1000U
+
+/* Polls of a self-clearing register bit before the hardware is taken as stuck. Counted rather
+ * than timed, as some of the waits are made with interrupts masked. */
+#define niEMAC_REG_WAIT_POLLS    100000U
+
+/* MDIO transfer status, the PHY registers are 16 bits wide */
+#if defined( niEMAC_STM32FX )
+    #define niEMAC_MDIO_BUSY( pxInstance )    ( ( ( pxInstance )->MACMIIAR & ETH_MACMIIAR_MB ) != 0U )
+    #define niEMAC_MDIO_DATA( pxInstance )    ( ( pxInstance )->MACMIIDR & 0xFFFFU )
+    #define niEMAC_MDIO_WAIT( pxInstance )    prvWaitBitsClear( &( pxInstance )->MACMIIAR, ETH_MACMIIAR_MB )
+#elif defined( niEMAC_STM32HX )
+    #define niEMAC_MDIO_BUSY( pxInstance )    ( ( ( pxInstance )->MACMDIOAR & ETH_MACMDIOAR_MB ) != 0U )
+    #define niEMAC_MDIO_DATA( pxInstance )    ( ( pxInstance )->MACMDIODR & 0xFFFFU )
+    #define niEMAC_MDIO_WAIT( pxInstance )    prvWaitBitsClear( &( pxInstance )->MACMDIOAR, ETH_MACMDIOAR_MB )
+#endif
+
+/* A transfer takes some 30 us, one still busy after this is taken as lost */
+#define niEMAC_MDIO_TIMEOUT_MS    10U
+
+/* PHY registers read by the link monitor. The LAN8742 and DP83848 latch their interrupt
+ * sources in a status register, which releases the interrupt output when read. */
+#define niEMAC_PHY_REG_BMSR             0x01U
+#define niEMAC_PHY_BMSR_LINK            0x0004U
+#define niEMAC_PHY_BMSR_AN_COMPLETE     0x0020U
+#define niEMAC_PHY_REG_ANLPAR           0x05U
+#define niEMAC_PHY_CACHE_MAGIC          0x50485943UL /* "PHYC" */
+#define niEMAC_LAN8742_REG_ISFR         0x1DU
+#define niEMAC_LAN8742_REG_IMR          0x1EU
+#define niEMAC_LAN8742_LINK_IT          ( ( 1U << 4U ) | ( 1U << 6U ) ) /* Link down, auto-negotiation complete */
+#define niEMAC_DP83848_REG_MICR         0x11U
+#define niEMAC_DP83848_REG_MISR         0x12U
+#define niEMAC_DP83848_MICR_INT_OE      ( 1U << 0U )
+#define niEMAC_DP83848_MICR_INTEN       ( 1U << 1U )
+#define niEMAC_DP83848_LINK_IT          ( ( 1U << 2U ) | ( 1U << 5U ) ) /* Auto-negotiation complete, link status change */
+
+/* Interface context of a network interface, or of an ETH handle, which is its first member */
+#define niEMAC_GET_DATA( pxInterface )           ( ( EMACData_t * ) ( pxInterface )->pvArgument )
+#define niEMAC_HANDLE_TO_DATA( pxEthHandle )     ( ( EMACData_t * ) ( pxEthHandle ) )
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
 /*                               typedefs                                    */
@@ -272,7 +574,9 @@ typedef enum
     eMacEventErrDma = 1 << 4,
     eMacEventErrEth = 1 << 5,
     eMacEventErrMac = 1 << 6,
-    eMacEventAll = ( 1 << 7 ) - 1,
+    eMacEventTxPending = 1 << 7,
+    eMacEventPhy = 1 << 8,
+    eMacEventAll = ( 1 << 9 ) - 1,
 } eMAC_IF_EVENT;
 
 typedef enum
@@ -285,38 +589,118 @@ typedef enum
     eMacInitComplete /* Initialisation was successful. */
 } eMAC_INIT_STATUS_TYPE;
 
-/* typedef struct xMacSrcMatchData
- * {
- *  uint8_t ucSrcMatchCounters[ niEMAC_MAC_SRC_MATCH_COUNT ];
- *  uint8_t uxMACEntryIndex = 0;
- * } MacSrcMatchData_t;
- *
- * typedef struct xMacHashData
- * {
- *  uint32_t ulHashTable[ niEMAC_ADDRESS_HASH_BITS / 32 ];
- *  uint8_t ucAddrHashCounters[ niEMAC_ADDRESS_HASH_BITS ];
- * } MacHashData_t;
- *
- * typedef struct xMacFilteringData
- * {
- *  MacSrcMatchData_t xSrcMatch;
- *  MacHashData_t xHash;
- * } MacFilteringData_t;
- *
- * typedef struct xEMACData
- * {
- *  ETH_HandleTypeDef xEthHandle;
- *  EthernetPhy_t xPhyObject;
- *  TaskHandle_t xEMACTaskHandle;
- *  SemaphoreHandle_t xTxMutex, xTxDescSem;
- *  ETH_BufferTypeDef xTxBuffers[ niEMAC_BUFS_PER_DESC * ETH_TX_DESC_CNT ];
- *  BaseType_t xSwitchRequired;
- *  eMAC_INIT_STATUS_TYPE xMacInitStatus;
- *  BaseType_t xEMACIndex;
- *  MacFilteringData_t xMacFilteringData;
- * } EMACData_t; */
-
-/* TODO: need a data structure to assist in adding/removing allowed addresses */
+/* Dest Mac Perfect Matching, MACA1 to MACA3, reference counted per address */
+typedef struct xMacSrcMatchData
+{
+    uint8_t ucSrcMatchCounters[ niEMAC_MAC_SRC_MATCH_COUNT ];
+    MACAddress_t xSrcMatchAddresses[ niEMAC_MAC_SRC_MATCH_COUNT ];
+} MacSrcMatchData_t;
+
+/* Dest Mac Hashing, reference counted per hash bucket */
+typedef struct xMacHashData
+{
+    uint32_t ulHashTable[ niEMAC_ADDRESS_HASH_BITS / 32 ];
+    uint8_t ucAddrHashCounters[ niEMAC_ADDRESS_HASH_BITS ];
+} MacHashData_t;
+
+typedef struct xMacFilteringData
+{
+    MacSrcMatchData_t xSrcMatch;
+    MacHashData_t xHash;
+} MacFilteringData_t;
+
+/* Timestamp state of one network buffer */
+typedef struct xEMACBufferTimestamp
+{
+    EMACTimestamp_t xRxTimestamp; /* Valid while niEMAC_BUF_RX_TIMESTAMP is set. */
+    uint8_t ucFlags;
+} EMACBufferTimestamp_t;
+
+/* Link monitor, reads the PHYs one register at a time without waiting on the MDIO bus */
+typedef enum
+{
+    eMdioIdle,      /* No transfer in flight. */
+    eMdioReadIrq,   /* Reading the interrupt status of the current port, which acknowledges it. */
+    eMdioReadStatus /* Reading the basic status of the current port. */
+} eMDIO_STATE;
+
+typedef struct xEMACLinkMonitor
+{
+    eMDIO_STATE eState;
+    BaseType_t xPortIndex;  /* Port of the transfer in flight. */
+    BaseType_t xChanged;    /* A port changed its link status during this pass over the ports. */
+    BaseType_t xIrqPending; /* The PHY signalled a change which has not been read yet. */
+    BaseType_t xIrqEnabled; /* Every port signals its link changes through the PHY interrupt. */
+    BaseType_t xDataReady;  /* The transfer in flight was completed by a blocking PHY access. */
+    BaseType_t xReadFailed; /* The transfer in flight timed out, ulData is not valid. */
+    TickType_t xStartTime;  /* Tick count when the transfer in flight was started. */
+    uint32_t ulData;
+} EMACLinkMonitor_t;
+
+/* Link the PHY settled on, and the link partner abilities it was negotiated against */
+typedef struct xEMACPhyCache
+{
+    uint32_t ulMagic;
+    uint32_t ulPhyID;
+    uint32_t ulPartnerAbility;
+    uint32_t ulBCRValue;
+    uint32_t ulACRValue;
+    PhyProperties_t xPhyProperties;
+    uint32_t ulCheck; /* Sum of the fields above, which the power-on contents of RAM won't match. */
+} EMACPhyCache_t;
+
+/* State of one network interface, reached through pxInterface->pvArgument */
+typedef struct xEMACData
+{
+    ETH_HandleTypeDef xEthHandle; /* Must stay first, the HAL callbacks are only given the handle. */
+    EthernetPhy_t xPhyObject;
+    EMACLinkMonitor_t xLinkMonitor;
+    TaskHandle_t xEMACTaskHandle;
+    QueueHandle_t xTxQueue;
+    QueueHandle_t xRxReserve;                /* Network buffers set aside for the Rx descriptors, refilled by the EMAC task. */
+    NetworkBufferDescriptor_t * pxTxPending; /* Frame dequeued by the EMAC task which did not fit in the Tx descriptor ring. */
+    BaseType_t xSwitchRequired;
+    eMAC_INIT_STATUS_TYPE xMacInitStatus;
+    BaseType_t xEMACIndex;
+    char pcName[ 17 ];
+    MacFilteringData_t xMacFilteringData;
+    EMACRxReserveStatus_t xRxReserveStatus;
+    EMACStats_t xEMACStats;                  /* Written by the EMAC task and the ETH interrupt, the Tx drop counters also by prvNetworkInterfaceOutput through prvCountTxDrop. */
+    TickType_t xErrorTime;                   /* Tick at which the last fatal error was reported. */
+    BaseType_t xLinkWasUp;                   /* The link came up at least once since boot. */
+    #if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+        EMACRxModeration_t xRxModeration;
+        EMACRxModerationStatus_t xRxModerationStatus;
+    #endif
+    #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+        UBaseType_t uxRxPollBudget;
+        BaseType_t xRxPolling;
+        BaseType_t xRxBacklog;               /* The last poll used its whole budget, frames may be left in the ring. */
+        EMACRxPollStatus_t xRxPollStatus;
+    #endif
+    #if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+        UBaseType_t uxTxUnsignalled;         /* Frames given to the DMA since the Tx interrupt was last unmasked. */
+        BaseType_t xTxIrqEnabled;
+    #endif
+    #if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK )
+        UBaseType_t uxRxCopyBreak;           /* Largest frame copied into a small network buffer, zero when disabled. */
+    #endif
+    #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+        uint32_t ulTimestampAddend;          /* Addend which runs the clock at its nominal rate. */
+        int32_t lFrequencyPpb;               /* Trim applied on top of the nominal rate. */
+        int32_t lPtpIntegralPpb;             /* Integral term of the clock servo. */
+        EMACTimestamp_t xTxTimestamp;        /* Last Tx timestamp, not yet taken while xTxTimestampReady is set. */
+        BaseType_t xTxTimestampReady;
+    #endif
+    #if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION )
+        StaticQueue_t xTxQueueBuf;
+        uint8_t ucTxQueueStorage[ niEMAC_TX_QUEUE_LENGTH * sizeof( NetworkBufferDescriptor_t * ) ];
+        StaticQueue_t xRxReserveBuf;
+        uint8_t ucRxReserveStorage[ niEMAC_RX_RESERVE_LENGTH * sizeof( NetworkBufferDescriptor_t * ) ];
+        StackType_t uxEMACTaskStack[ niEMAC_TASK_STACK_SIZE ];
+        StaticTask_t xEMACTaskTCB;
+    #endif
+} EMACData_t;
 
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
@@ -331,6 +715,20 @@ static BaseType_t prvPhyReadReg( BaseType_t xAddress,
 static BaseType_t prvPhyWriteReg( BaseType_t xAddress,
                                   BaseType_t xRegister,
                                   uint32_t ulValue );
+static void prvMdioStartRead( ETH_TypeDef * const pxEthInstance,
+                              uint32_t ulAddress,
+                              uint32_t ulRegister );
+static BaseType_t prvMdioGetResult( EMACData_t * pxEMACData,
+                                    uint32_t * pulValue );
+static void prvMdioFinish( EMACData_t * pxEMACData );
+static void prvStartLinkRead( EMACData_t * pxEMACData,
+                              eMDIO_STATE eState );
+static BaseType_t prvCheckLinkStatus( EMACData_t * pxEMACData,
+                                      BaseType_t xHadReception );
+#if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT )
+    static uint32_t prvPhyInterruptRegister( uint32_t ulPhyID );
+    static void prvPhyEnableInterrupts( EMACData_t * pxEMACData );
+#endif
 
 /* Network Interface Access Hooks */
 static BaseType_t prvGetPhyLinkStatus( NetworkInterface_t * pxInterface );
@@ -344,17 +742,38 @@ static void prvRemoveAllowedMACAddress( NetworkInterface_t * pxInterface,
                                         const uint8_t * pucMacAddress );
 
 /* EMAC Task */
-static BaseType_t prvNetworkInterfaceInput( ETH_HandleTypeDef * pxEthHandle,
-                                            NetworkInterface_t * pxInterface );
+static UBaseType_t prvNetworkInterfaceInput( EMACData_t * pxEMACData,
+                                             NetworkInterface_t * pxInterface,
+                                             UBaseType_t uxBudget );
+#if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+    static void prvSetRxPolling( EMACData_t * pxEMACData,
+                                 BaseType_t xPolling );
+    static UBaseType_t prvPollRx( EMACData_t * pxEMACData,
+                                  NetworkInterface_t * pxInterface,
+                                  UBaseType_t uxRxCount );
+#endif
+#if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+    static void prvSetTxInterrupt( EMACData_t * pxEMACData,
+                                   BaseType_t xEnable );
+    static void prvCoalesceTx( EMACData_t * pxEMACData,
+                               uint32_t ulISREvents );
+#endif
 static __NO_RETURN portTASK_FUNCTION_PROTO( prvEMACHandlerTask,
                                             pvParameters );
 static BaseType_t prvEMACTaskStart( NetworkInterface_t * pxInterface );
+static BaseType_t prvEthStart( EMACData_t * pxEMACData );
+static BaseType_t prvEthRestartDMA( EMACData_t * pxEMACData );
+static BaseType_t prvEthReset( EMACData_t * pxEMACData,
+                               NetworkInterface_t * pxInterface );
+static void prvNotifyLinkUp( const EMACData_t * pxEMACData,
+                             NetworkInterface_t * pxInterface );
 
 /* EMAC Init */
-static BaseType_t prvEthConfigInit( ETH_HandleTypeDef * pxEthHandle,
+static BaseType_t prvEthConfigInit( EMACData_t * pxEMACData,
                                     NetworkInterface_t * pxInterface );
-static void prvInitMacAddresses( ETH_HandleTypeDef * pxEthHandle,
-                                 NetworkInterface_t * pxInterface );
+static void prvEthApplyConfig( EMACData_t * pxEMACData,
+                               NetworkInterface_t * pxInterface );
+static void prvInitMacAddresses( NetworkInterface_t * pxInterface );
 #ifdef niEMAC_STM32HX
     static void prvInitPacketFilter( ETH_HandleTypeDef * pxEthHandle,
                                      const NetworkInterface_t * const pxInterface );
@@ -363,6 +782,11 @@ static BaseType_t prvPhyInit( EthernetPhy_t * pxPhyObject );
 static BaseType_t prvPhyStart( ETH_HandleTypeDef * pxEthHandle,
                                NetworkInterface_t * pxInterface,
                                EthernetPhy_t * pxPhyObject );
+#if ipconfigIS_ENABLED( niEMAC_PHY_CACHE )
+    static uint32_t prvPhyCacheSum( const EMACPhyCache_t * pxCache );
+    static BaseType_t prvPhyCacheRestore( EMACData_t * pxEMACData );
+    static void prvPhyCacheSave( EMACData_t * pxEMACData );
+#endif
 
 /* MAC Filtering Helpers */
 static uint32_t prvCalcCrc32( const uint8_t * const pucMACAddr );
@@ -372,26 +796,104 @@ static void prvHAL_ETH_SetDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
                                             const uint8_t * const pucMACAddr );
 static void prvHAL_ETH_ClearDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
                                               uint8_t ucIndex );
-static BaseType_t prvAddDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
+static BaseType_t prvAddDestMACAddrMatch( EMACData_t * pxEMACData,
                                           const uint8_t * const pucMACAddr );
-static BaseType_t prvRemoveDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
+static BaseType_t prvRemoveDestMACAddrMatch( EMACData_t * pxEMACData,
                                              const uint8_t * const pucMACAddr );
-static BaseType_t prvSetNewDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
+static BaseType_t prvSetNewDestMACAddrMatch( EMACData_t * pxEMACData,
                                              uint8_t ucHashIndex,
                                              const uint8_t * const pucMACAddr );
-static void prvAddDestMACAddrHash( ETH_HandleTypeDef * pxEthHandle,
+static void prvAddDestMACAddrHash( EMACData_t * pxEMACData,
                                    uint8_t ucHashIndex );
-static void prvRemoveDestMACAddrHash( ETH_HandleTypeDef * pxEthHandle,
+static void prvRemoveDestMACAddrHash( EMACData_t * pxEMACData,
                                       const uint8_t * const pucMACAddr );
+static void prvRestoreMacAddresses( EMACData_t * pxEMACData );
 
 /* EMAC Helpers */
+static void prvTakeEthContext( EMACData_t * pxEMACData );
+static void prvGiveEthContext( EMACData_t * pxEMACData );
+static EMACData_t * prvGetEthContext( void );
+static EMACData_t * prvInstanceToData( const ETH_TypeDef * pxEthInstance );
 static void prvReleaseTxPacket( ETH_HandleTypeDef * pxEthHandle );
+static void prvReclaimTxDescriptors( EMACData_t * pxEMACData );
+static void prvReclaimRxDescriptors( ETH_HandleTypeDef * pxEthHandle );
+static void prvReleaseRxBuffers( ETH_HandleTypeDef * pxEthHandle );
+static void prvSendTxQueue( EMACData_t * pxEMACData );
+static void prvFlushTxQueue( EMACData_t * pxEMACData );
+static void prvCountTxDrop( uint32_t * pulCounter );
+static BaseType_t prvWaitBitsClear( const volatile uint32_t * pulRegister,
+                                    uint32_t ulMask );
+static void prvRefillRxReserve( EMACData_t * pxEMACData );
+static size_t prvGetTxFrameLength( const NetworkBufferDescriptor_t * const pxDescriptor,
+                                   UBaseType_t * const puxBufferCount );
+#if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+    static size_t prvGetTxHeaderLength( const NetworkBufferDescriptor_t * const pxDescriptor,
+                                        size_t * const puxTCPHeaderLength );
+#endif
 static BaseType_t prvMacUpdateConfig( ETH_HandleTypeDef * pxEthHandle,
                                       EthernetPhy_t * pxPhyObject );
+static BaseType_t prvMacSetLinkConfig( ETH_HandleTypeDef * pxEthHandle,
+                                       const EthernetPhy_t * pxPhyObject );
+static void prvLinkSettled( EMACData_t * pxEMACData );
 static void prvReleaseNetworkBufferDescriptor( NetworkBufferDescriptor_t * const pxDescriptor );
 static void prvSendRxEvent( NetworkBufferDescriptor_t * const pxDescriptor );
-static BaseType_t prvAcceptPacket( const NetworkBufferDescriptor_t * const pxDescriptor,
+static BaseType_t prvAcceptPacket( EMACData_t * pxEMACData,
+                                   const NetworkBufferDescriptor_t * const pxDescriptor,
+                                   const ETH_DMADescTypeDef * const pxRxDesc,
                                    uint16_t usLength );
+#if ipconfigIS_ENABLED( niEMAC_RX_DESC_LOOKUP )
+    static const ETH_DMADescTypeDef * prvGetRxDescriptor( const ETH_HandleTypeDef * pxEthHandle,
+                                                          const uint8_t * pucBuff );
+#endif
+#if ipconfigIS_ENABLED( niEMAC_RX_CHAINING )
+    static NetworkBufferDescriptor_t * prvGatherRxChain( EMACData_t * pxEMACData,
+                                                         NetworkBufferDescriptor_t * const pxFirstDescriptor,
+                                                         size_t uxFrameLength );
+#endif
+#if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK )
+    static BaseType_t prvIsCopyBreakFrame( const NetworkBufferDescriptor_t * const pxDescriptor );
+    static NetworkBufferDescriptor_t * prvRxCopyBreak( EMACData_t * pxEMACData,
+                                                       NetworkBufferDescriptor_t * const pxDescriptor );
+#endif
+#if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
+    static BaseType_t prvAcceptUDPPort( uint16_t usDestinationPort,
+                                        uint16_t usSourcePort );
+    #if ipconfigIS_ENABLED( ipconfigUSE_TCP )
+        static BaseType_t prvAcceptTCPSegment( uint16_t usDestinationPort,
+                                               uint8_t ucTCPFlags );
+    #endif
+    #if ipconfigIS_ENABLED( ipconfigUSE_IPv4 )
+        static BaseType_t prvAcceptIPPacketIPv4( const uint8_t * pucEthernetBuffer,
+                                                 uint16_t usLength,
+                                                 uint32_t ulRxClass );
+    #endif
+    #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
+        static BaseType_t prvAcceptIPPacketIPv6( const uint8_t * pucEthernetBuffer,
+                                                 uint16_t usLength,
+                                                 uint32_t ulRxClass );
+    #endif
+#endif
+#if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+    static uint32_t prvRxWatchdogCount( uint32_t ulDelayUs );
+    static void prvSetRxModeration( EMACData_t * pxEMACData );
+    static void prvUpdateRxModeration( EMACData_t * pxEMACData,
+                                       UBaseType_t uxFrameCount );
+#endif
+#if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+    static BaseType_t prvInitTimestamping( EMACData_t * pxEMACData );
+    static BaseType_t prvSetClockFrequency( EMACData_t * pxEMACData,
+                                            int32_t lFrequencyPpb );
+    static BaseType_t prvUpdateTime( ETH_TypeDef * const pxEthInstance,
+                                     int64_t llOffsetNs );
+    static EMACBufferTimestamp_t * prvGetBufferTimestamp( const NetworkBufferDescriptor_t * const pxDescriptor );
+    static void prvSetTxTimestamping( ETH_HandleTypeDef * pxEthHandle,
+                                      const NetworkBufferDescriptor_t * const pxDescriptor );
+    static void prvGetTxTimestamps( EMACData_t * pxEMACData );
+    static void prvGetRxTimestamp( const ETH_HandleTypeDef * pxEthHandle,
+                                   const NetworkBufferDescriptor_t * const pxDescriptor,
+                                   const ETH_DMADescTypeDef * const pxRxDesc );
+    static int64_t prvTimestampToNs( const EMACTimestamp_t * const pxTimestamp );
+#endif
 
 /* Network Interface Definition */
 NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex,
@@ -403,26 +905,33 @@ NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex,
 /*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-/* static EMACData_t xEMACData; */
-
-static ETH_HandleTypeDef xEthHandle;
+static EMACData_t xEMACData[ niEMAC_INSTANCE_COUNT ];
 
-static EthernetPhy_t xPhyObject;
+/* Descriptor rings, one pair per context */
+static ETH_DMADescTypeDef xDMADescTx[ niEMAC_INSTANCE_COUNT ][ ETH_TX_DESC_CNT ] __ALIGNED( portBYTE_ALIGNMENT ) __attribute__( ( section( niEMAC_TX_DESC_SECTION ) ) );
+static ETH_DMADescTypeDef xDMADescRx[ niEMAC_INSTANCE_COUNT ][ ETH_RX_DESC_CNT ] __ALIGNED( portBYTE_ALIGNMENT ) __attribute__( ( section( niEMAC_RX_DESC_SECTION ) ) );
 
-static TaskHandle_t xEMACTaskHandle = NULL;
-static SemaphoreHandle_t xTxMutex = NULL, xTxDescSem = NULL;
+/* Context of the HAL call or PHY access in progress, for the HAL callbacks and PHY hooks which
+ * are not given a handle. Set by prvTakeEthContext, which serialises the contexts when there
+ * are several. */
+static EMACData_t * pxActiveEMACData = NULL;
 
-static BaseType_t xSwitchRequired = pdFALSE;
-
-static eMAC_INIT_STATUS_TYPE xMacInitStatus = eMacEthInit;
+#if ( niEMAC_INSTANCE_COUNT > 1U )
+    static SemaphoreHandle_t xEthContextMutex = NULL;
+    #if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION )
+        static StaticSemaphore_t xEthContextMutexBuf;
+    #endif
+#endif
 
-/* Src Mac Matching */
-static uint8_t ucSrcMatchCounters[ niEMAC_MAC_SRC_MATCH_COUNT ] = { 0U };
-static uint8_t uxMACEntryIndex = 0;
+#if ipconfigIS_ENABLED( niEMAC_PHY_CACHE )
+    static EMACPhyCache_t xPhyCache[ niEMAC_INSTANCE_COUNT ] __attribute__( ( section( niEMAC_PHY_CACHE_SECTION ) ) );
+#endif
 
-/* Src Mac Hashing */
-static uint32_t ulHashTable[ niEMAC_ADDRESS_HASH_BITS / 32 ];
-static uint8_t ucAddrHashCounters[ niEMAC_ADDRESS_HASH_BITS ] = { 0U };
+#if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+    /* Network buffers handed to vNetworkInterfaceAllocateRAMToBuffers, and their timestamps */
+    static const NetworkBufferDescriptor_t * pxNetworkBufferPool = NULL;
+    static EMACBufferTimestamp_t xBufferTimestamps[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+#endif
 
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
@@ -436,7 +945,12 @@ static BaseType_t prvPhyReadReg( BaseType_t xAddress,
 {
     BaseType_t xResult = 0;
 
-    if( HAL_ETH_ReadPHYRegister( &xEthHandle, ( uint32_t ) xAddress, ( uint32_t ) xRegister, pulValue ) != HAL_OK )
+    EMACData_t * const pxEMACData = prvGetEthContext();
+
+    /* The MDIO bus belongs to the ETH peripheral, and may be busy with a link monitor read */
+    prvMdioFinish( pxEMACData );
+
+    if( HAL_ETH_ReadPHYRegister( &pxEMACData->xEthHandle, ( uint32_t ) xAddress, ( uint32_t ) xRegister, pulValue ) != HAL_OK )
     {
         xResult = -1;
     }
@@ -452,7 +966,11 @@ static BaseType_t prvPhyWriteReg( BaseType_t xAddress,
 {
     BaseType_t xResult = 0;
 
-    if( HAL_ETH_WritePHYRegister( &xEthHandle, ( uint32_t ) xAddress, ( uint32_t ) xRegister, ulValue ) != HAL_OK )
+    EMACData_t * const pxEMACData = prvGetEthContext();
+
+    prvMdioFinish( pxEMACData );
+
+    if( HAL_ETH_WritePHYRegister( &pxEMACData->xEthHandle, ( uint32_t ) xAddress, ( uint32_t ) xRegister, ulValue ) != HAL_OK )
     {
         xResult = -1;
     }
@@ -460,103 +978,360 @@ static BaseType_t prvPhyWriteReg( BaseType_t xAddress,
     return xResult;
 }
 
-/*---------------------------------------------------------------------------*/
-/*===========================================================================*/
-/*                      Network Interface Access Hooks                       */
-/*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvGetPhyLinkStatus( NetworkInterface_t * pxInterface )
+static void prvMdioStartRead( ETH_TypeDef * const pxEthInstance,
+                              uint32_t ulAddress,
+                              uint32_t ulRegister )
 {
-    ( void ) pxInterface;
+    /* Same request as HAL_ETH_ReadPHYRegister, without waiting for the answer */
+    #if defined( niEMAC_STM32FX )
+        uint32_t ulValue = pxEthInstance->MACMIIAR & ETH_MACMIIAR_CR;
+        ulValue |= ( ulAddress << 11U ) & ETH_MACMIIAR_PA;
+        ulValue |= ( ulRegister << 6U ) & ETH_MACMIIAR_MR;
+        pxEthInstance->MACMIIAR = ulValue | ETH_MACMIIAR_MB;
+    #elif defined( niEMAC_STM32HX )
+        uint32_t ulValue = pxEthInstance->MACMDIOAR & ~( ETH_MACMDIOAR_PA | ETH_MACMDIOAR_RDA | ETH_MACMDIOAR_MOC );
+        ulValue |= ( ulAddress << 21U ) & ETH_MACMDIOAR_PA;
+        ulValue |= ( ulRegister << 16U ) & ETH_MACMDIOAR_RDA;
+        pxEthInstance->MACMDIOAR = ulValue | ETH_MACMDIOAR_MOC_RD | ETH_MACMDIOAR_MB;
+    #endif
+}
 
-    BaseType_t xReturn = pdFALSE;
+/*---------------------------------------------------------------------------*/
 
-    /* const EMACData_t xEMACData = *( ( EMACData_t * ) pxInterface->pvArgument ); */
+static BaseType_t prvMdioGetResult( EMACData_t * pxEMACData,
+                                    uint32_t * pulValue )
+{
+    BaseType_t xResult = pdFALSE;
+    EMACLinkMonitor_t * const pxMonitor = &pxEMACData->xLinkMonitor;
+    const ETH_TypeDef * const pxEthInstance = pxEMACData->xEthHandle.Instance;
 
-    if( xPhyObject.ulLinkStatusMask != 0U )
+    if( pxMonitor->xDataReady != pdFALSE )
     {
-        xReturn = pdTRUE;
+        pxMonitor->xDataReady = pdFALSE;
+        *pulValue = pxMonitor->ulData;
+        xResult = pdTRUE;
+    }
+    else if( !niEMAC_MDIO_BUSY( pxEthInstance ) )
+    {
+        *pulValue = niEMAC_MDIO_DATA( pxEthInstance );
+        xResult = pdTRUE;
+    }
+    else if( ( xTaskGetTickCount() - pxMonitor->xStartTime ) > pdMS_TO_TICKS( niEMAC_MDIO_TIMEOUT_MS ) )
+    {
+        pxMonitor->xReadFailed = pdTRUE;
+        ++pxEMACData->xEMACStats.ulMdioTimeouts;
+        xResult = pdTRUE;
     }
 
-    return xReturn;
+    return xResult;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvNetworkInterfaceInitialise( NetworkInterface_t * pxInterface )
+static void prvMdioFinish( EMACData_t * pxEMACData )
 {
-    BaseType_t xInitResult = pdFAIL;
-    ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
-    EthernetPhy_t * pxPhyObject = &xPhyObject;
+    EMACLinkMonitor_t * const pxMonitor = &pxEMACData->xLinkMonitor;
+    const ETH_TypeDef * const pxEthInstance = pxEMACData->xEthHandle.Instance;
 
-    switch( xMacInitStatus )
+    if( ( pxMonitor->eState != eMdioIdle ) && ( pxMonitor->xDataReady == pdFALSE ) )
     {
-        default:
-            configASSERT( pdFALSE );
-            break;
+        /* Keep the answer for the link monitor, before a blocking access overwrites it */
+        if( niEMAC_MDIO_WAIT( pxEthInstance ) != pdFALSE )
+        {
+            pxMonitor->ulData = niEMAC_MDIO_DATA( pxEthInstance );
+        }
+        else
+        {
+            pxMonitor->xReadFailed = pdTRUE;
+            ++pxEMACData->xEMACStats.ulMdioTimeouts;
+        }
 
-        case eMacEthInit:
+        pxMonitor->xDataReady = pdTRUE;
+    }
+}
 
-            if( prvEthConfigInit( pxEthHandle, pxInterface ) == pdFALSE )
-            {
-                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacEthInit failed\n" ) );
-                break;
-            }
+/*---------------------------------------------------------------------------*/
 
-            xMacInitStatus = eMacPhyInit;
-        /* fallthrough */
+static void prvStartLinkRead( EMACData_t * pxEMACData,
+                              eMDIO_STATE eState )
+{
+    EMACLinkMonitor_t * const pxMonitor = &pxEMACData->xLinkMonitor;
+    const EthernetPhy_t * const pxPhyObject = &pxEMACData->xPhyObject;
+    uint32_t ulRegister = niEMAC_PHY_REG_BMSR;
 
-        case eMacPhyInit:
+    #if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT )
+        if( eState == eMdioReadIrq )
+        {
+            ulRegister = prvPhyInterruptRegister( pxPhyObject->ulPhyIDs[ pxMonitor->xPortIndex ] );
+        }
+    #endif
 
-            if( prvPhyInit( pxPhyObject ) == pdFALSE )
-            {
-                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacPhyInit failed\n" ) );
-                break;
-            }
+    pxMonitor->eState = eState;
+    pxMonitor->xReadFailed = pdFALSE;
+    pxMonitor->xStartTime = xTaskGetTickCount();
+    ++pxEMACData->xEMACStats.ulLinkStatusReads;
+    prvMdioStartRead( pxEMACData->xEthHandle.Instance, pxPhyObject->ucPhyIndexes[ pxMonitor->xPortIndex ], ulRegister );
+}
 
-            xMacInitStatus = eMacPhyStart;
-        /* fallthrough */
+/*---------------------------------------------------------------------------*/
 
-        case eMacPhyStart:
+static BaseType_t prvCheckLinkStatus( EMACData_t * pxEMACData,
+                                      BaseType_t xHadReception )
+{
+    /* Takes the place of xPhyCheckLinkStatus, returning as soon as a read is in flight */
+    BaseType_t xNeedCheck = pdFALSE;
+    EMACLinkMonitor_t * const pxMonitor = &pxEMACData->xLinkMonitor;
+    EthernetPhy_t * const pxPhyObject = &pxEMACData->xPhyObject;
+    const uint32_t ulAllPorts = xPhyGetMask( pxPhyObject );
+    const eMDIO_STATE eFirstRead = ( pxMonitor->xIrqEnabled != pdFALSE ) ? eMdioReadIrq : eMdioReadStatus;
+    uint32_t ulValue = 0U;
+
+    if( pxMonitor->eState == eMdioIdle )
+    {
+        BaseType_t xStart = pxMonitor->xIrqPending;
+
+        if( xHadReception != pdFALSE )
+        {
+            /* A frame arrived so the link is up, look again once the traffic stops */
+            vTaskSetTimeOutState( &( pxPhyObject->xLinkStatusTimer ) );
+            pxPhyObject->xLinkStatusRemaining = pdMS_TO_TICKS( ipconfigPHY_LS_HIGH_CHECK_TIME_MS );
 
-            if( prvPhyStart( pxEthHandle, pxInterface, pxPhyObject ) == pdFALSE )
+            if( pxPhyObject->ulLinkStatusMask != ulAllPorts )
             {
-                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacPhyStart failed\n" ) );
-                break;
+                pxPhyObject->ulLinkStatusMask = ulAllPorts;
+                FreeRTOS_printf( ( "prvCheckLinkStatus: PHY LS now %02X\n", ( unsigned int ) pxPhyObject->ulLinkStatusMask ) );
+                xNeedCheck = pdTRUE;
             }
-
-            xMacInitStatus = eMacTaskStart;
-        /* fallthrough */
-
-        case eMacTaskStart:
-
-            if( prvEMACTaskStart( pxInterface ) == pdFALSE )
+        }
+        else if( ( pxMonitor->xIrqEnabled == pdFALSE ) || ( pxPhyObject->ulLinkStatusMask != ulAllPorts ) )
+        {
+            /* Polled, or waiting for a link whose return the PHY may not signal, e.g. with a fixed speed */
+            if( xTaskCheckForTimeOut( &( pxPhyObject->xLinkStatusTimer ), &( pxPhyObject->xLinkStatusRemaining ) ) != pdFALSE )
             {
-                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacTaskStart failed\n" ) );
-                break;
+                xStart = pdTRUE;
             }
+        }
 
-            xMacInitStatus = eMacEthStart;
-        /* fallthrough */
+        if( ( xStart != pdFALSE ) && ( pxPhyObject->xPortCount > 0 ) )
+        {
+            pxMonitor->xIrqPending = pdFALSE;
+            pxMonitor->xChanged = pdFALSE;
+            pxMonitor->xPortIndex = 0;
+            prvStartLinkRead( pxEMACData, eFirstRead );
+        }
+    }
+    else if( prvMdioGetResult( pxEMACData, &ulValue ) != pdFALSE )
+    {
+        if( pxMonitor->eState == eMdioReadIrq )
+        {
+            prvStartLinkRead( pxEMACData, eMdioReadStatus );
+        }
+        else
+        {
+            const uint32_t ulBitMask = 1U << pxMonitor->xPortIndex;
+            const uint32_t ulLinkBit = ( ( ulValue & niEMAC_PHY_BMSR_LINK ) != 0U ) ? ulBitMask : 0U;
 
-        case eMacEthStart:
+            if( pxMonitor->xReadFailed != pdFALSE )
+            {
+                /* Nothing was read, the port keeps its last known link status */
+            }
+            else if( ( pxPhyObject->ulLinkStatusMask & ulBitMask ) != ulLinkBit )
+            {
+                pxPhyObject->ulLinkStatusMask ^= ulBitMask;
+                FreeRTOS_printf( ( "prvCheckLinkStatus: PHY LS now %02X\n", ( unsigned int ) pxPhyObject->ulLinkStatusMask ) );
+                pxMonitor->xChanged = pdTRUE;
+            }
 
-            if( pxEthHandle->gState != HAL_ETH_STATE_STARTED )
+            if( ++( pxMonitor->xPortIndex ) < pxPhyObject->xPortCount )
+            {
+                prvStartLinkRead( pxEMACData, eFirstRead );
+            }
+            else
             {
-                if( HAL_ETH_Start_IT( pxEthHandle ) != HAL_OK )
+                pxMonitor->eState = eMdioIdle;
+                xNeedCheck = pxMonitor->xChanged;
+                vTaskSetTimeOutState( &( pxPhyObject->xLinkStatusTimer ) );
+
+                if( pxPhyObject->ulLinkStatusMask != 0U )
                 {
-                    FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacEthStart failed\n" ) );
-                    break;
+                    pxPhyObject->xLinkStatusRemaining = pdMS_TO_TICKS( ipconfigPHY_LS_HIGH_CHECK_TIME_MS );
+                }
+                else
+                {
+                    pxPhyObject->xLinkStatusRemaining = pdMS_TO_TICKS( ipconfigPHY_LS_LOW_CHECK_TIME_MS );
                 }
             }
+        }
+    }
 
-            xMacInitStatus = eMacInitComplete;
-        /* fallthrough */
+    return xNeedCheck;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT )
+
+    static uint32_t prvPhyInterruptRegister( uint32_t ulPhyID )
+    {
+        uint32_t ulRegister = 0U;
+
+        if( ( ulPhyID == PHY_ID_LAN8742A ) || ( ulPhyID == PHY_ID_LAN8720 ) )
+        {
+            ulRegister = niEMAC_LAN8742_REG_ISFR;
+        }
+        else if( ulPhyID == PHY_ID_DP83848I )
+        {
+            ulRegister = niEMAC_DP83848_REG_MISR;
+        }
+
+        return ulRegister;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvPhyEnableInterrupts( EMACData_t * pxEMACData )
+    {
+        EthernetPhy_t * const pxPhyObject = &pxEMACData->xPhyObject;
+        BaseType_t xEnabled = ( pxPhyObject->xPortCount > 0 ) ? pdTRUE : pdFALSE;
+        BaseType_t xPhyIndex;
+        uint32_t ulValue;
+
+        for( xPhyIndex = 0; xPhyIndex < pxPhyObject->xPortCount; ++xPhyIndex )
+        {
+            const BaseType_t xAddress = pxPhyObject->ucPhyIndexes[ xPhyIndex ];
+            const uint32_t ulPhyID = pxPhyObject->ulPhyIDs[ xPhyIndex ];
+            const uint32_t ulRegister = prvPhyInterruptRegister( ulPhyID );
+
+            if( ulRegister == niEMAC_LAN8742_REG_ISFR )
+            {
+                ( void ) pxPhyObject->fnPhyWrite( xAddress, niEMAC_LAN8742_REG_IMR, niEMAC_LAN8742_LINK_IT );
+            }
+            else if( ulRegister == niEMAC_DP83848_REG_MISR )
+            {
+                ( void ) pxPhyObject->fnPhyWrite( xAddress, niEMAC_DP83848_REG_MISR, niEMAC_DP83848_LINK_IT );
+                ( void ) pxPhyObject->fnPhyWrite( xAddress, niEMAC_DP83848_REG_MICR, niEMAC_DP83848_MICR_INTEN | niEMAC_DP83848_MICR_INT_OE );
+            }
+            else
+            {
+                /* No known interrupt source, so the link stays polled */
+                FreeRTOS_debug_printf( ( "prvPhyEnableInterrupts: PHY %08X has no link interrupt\n", ( unsigned int ) ulPhyID ) );
+                xEnabled = pdFALSE;
+            }
+
+            if( ulRegister != 0U )
+            {
+                /* Acknowledge whatever was latched while configuring */
+                ( void ) pxPhyObject->fnPhyRead( xAddress, ( BaseType_t ) ulRegister, &ulValue );
+            }
+        }
+
+        pxEMACData->xLinkMonitor.xIrqEnabled = xEnabled;
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT ) */
+
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                      Network Interface Access Hooks                       */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvGetPhyLinkStatus( NetworkInterface_t * pxInterface )
+{
+    const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+    BaseType_t xReturn = pdFALSE;
+
+    if( pxEMACData->xPhyObject.ulLinkStatusMask != 0U )
+    {
+        xReturn = pdTRUE;
+    }
+
+    return xReturn;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvNetworkInterfaceInitialise( NetworkInterface_t * pxInterface )
+{
+    BaseType_t xInitResult = pdFAIL;
+    EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+    EthernetPhy_t * pxPhyObject = &pxEMACData->xPhyObject;
+
+    prvTakeEthContext( pxEMACData );
+
+    switch( pxEMACData->xMacInitStatus )
+    {
+        default:
+            configASSERT( pdFALSE );
+            break;
+
+        case eMacEthInit:
+
+            if( prvEthConfigInit( pxEMACData, pxInterface ) == pdFALSE )
+            {
+                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacEthInit failed\n" ) );
+                break;
+            }
+
+            pxEMACData->xMacInitStatus = eMacPhyInit;
+        /* fallthrough */
+
+        case eMacPhyInit:
+
+            if( prvPhyInit( pxPhyObject ) == pdFALSE )
+            {
+                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacPhyInit failed\n" ) );
+                break;
+            }
+
+            pxEMACData->xMacInitStatus = eMacPhyStart;
+        /* fallthrough */
+
+        case eMacPhyStart:
+
+            #if ipconfigIS_DISABLED( niEMAC_PHY_ASYNC_START )
+                if( prvPhyStart( pxEthHandle, pxInterface, pxPhyObject ) == pdFALSE )
+                {
+                    FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacPhyStart failed\n" ) );
+                    break;
+                }
+            #endif
+
+            pxEMACData->xMacInitStatus = eMacTaskStart;
+        /* fallthrough */
+
+        case eMacTaskStart:
+
+            if( prvEMACTaskStart( pxInterface ) == pdFALSE )
+            {
+                FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacTaskStart failed\n" ) );
+                break;
+            }
+
+            pxEMACData->xMacInitStatus = eMacEthStart;
+        /* fallthrough */
+
+        case eMacEthStart:
+
+            /* With niEMAC_PHY_ASYNC_START, the EMAC task starts the ETH once the link is up */
+            if( ipconfigIS_DISABLED( niEMAC_PHY_ASYNC_START ) && ( pxEthHandle->gState != HAL_ETH_STATE_STARTED ) )
+            {
+                if( prvEthStart( pxEMACData ) == pdFALSE )
+                {
+                    FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacEthStart failed\n" ) );
+                    break;
+                }
+            }
+
+            pxEMACData->xMacInitStatus = eMacInitComplete;
+        /* fallthrough */
 
         case eMacInitComplete:
 
-            if( prvGetPhyLinkStatus( pxInterface ) != pdTRUE )
+            if( ( prvGetPhyLinkStatus( pxInterface ) != pdTRUE ) || ( pxEthHandle->gState != HAL_ETH_STATE_STARTED ) )
             {
                 FreeRTOS_debug_printf( ( "prvNetworkInterfaceInitialise: eMacInitComplete failed\n" ) );
                 break;
@@ -565,6 +1340,8 @@ static BaseType_t prvNetworkInterfaceInitialise( NetworkInterface_t * pxInterfac
             xInitResult = pdPASS;
     }
 
+    prvGiveEthContext( pxEMACData );
+
     return xInitResult;
 }
 
@@ -581,41 +1358,30 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface,
 
     do
     {
-        ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+        const ETH_HandleTypeDef * const pxEthHandle = &pxEMACData->xEthHandle;
 
-        if( ( pxDescriptor == NULL ) || ( pxDescriptor->pucEthernetBuffer == NULL ) || ( pxDescriptor->xDataLength > niEMAC_DATA_BUFFER_SIZE ) )
+        if( ( pxDescriptor == NULL ) || ( prvGetTxFrameLength( pxDescriptor, NULL ) == 0U ) )
         {
-            /* TODO: if xDataLength is greater than niEMAC_DATA_BUFFER_SIZE, you can link buffers */
+            prvCountTxDrop( &pxEMACData->xEMACStats.ulTxDropInvalid );
             FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Invalid Descriptor\n" ) );
             break;
         }
 
         if( prvGetPhyLinkStatus( pxInterface ) == pdFALSE )
         {
+            prvCountTxDrop( &pxEMACData->xEMACStats.ulTxDropLinkDown );
             FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Link Down\n" ) );
             break;
         }
 
-        if( ( xMacInitStatus != eMacInitComplete ) || ( pxEthHandle->gState != HAL_ETH_STATE_STARTED ) )
+        if( ( pxEMACData->xMacInitStatus != eMacInitComplete ) || ( pxEthHandle->gState != HAL_ETH_STATE_STARTED ) )
         {
+            prvCountTxDrop( &pxEMACData->xEMACStats.ulTxDropLinkDown );
             FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Interface Not Started\n" ) );
             break;
         }
 
-        // ETH_TxPacketConfigTypedef
-        ETH_TxPacketConfig xTxConfig =
-        {
-            .CRCPadCtrl = ETH_CRC_PAD_INSERT,
-            .Attributes = ETH_TX_PACKETS_FEATURES_CRCPAD,
-        };
-
-        #if ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM )
-            xTxConfig.ChecksumCtrl = ETH_CHECKSUM_IPHDR_PAYLOAD_INSERT_PHDR_CALC;
-            xTxConfig.Attributes |= ETH_TX_PACKETS_FEATURES_CSUM;
-        #else
-            xTxConfig.ChecksumCtrl = ETH_CHECKSUM_DISABLE;
-        #endif
-
         const EthernetHeader_t * const pxEthHeader = ( const EthernetHeader_t * const ) pxDescriptor->pucEthernetBuffer;
 
         if( pxEthHeader->usFrameType == ipIPv4_FRAME_TYPE )
@@ -639,13 +1405,7 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface,
                 {
                     #if ipconfigIS_ENABLED( ipconfigUSE_TCP )
                         TCPPacket_t * const pxTCPPacket = ( TCPPacket_t * const ) pxDescriptor->pucEthernetBuffer;
-
-                        /* #if defined( niEMAC_STM32HX ) && ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
-                         *  xTxConfig.MaxSegmentSize = ipconfigTCP_MSS;
-                         *  xTxConfig.PayloadLen = pxDescriptor->xDataLength;
-                         *  xTxConfig.TCPHeaderLen = ( pxTCPPacket->xIPHeader.ucVersionHeaderLength & ( uint8_t ) 0x0FU );
-                         *  xTxConfig.Attributes |= ETH_TX_PACKETS_FEATURES_TSO;
-                         #endif */
+                        /* Super-segments are given their TSO attributes in prvSendTxQueue */
                         ( void ) pxTCPPacket;
                     #else
                         FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Unsupported TCP\n" ) );
@@ -681,12 +1441,7 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface,
                 {
                     #if ipconfigIS_ENABLED( ipconfigUSE_TCP )
                         TCPPacket_IPv6_t * const pxTCPPacket_IPv6 = ( TCPPacket_IPv6_t * const ) pxDescriptor->pucEthernetBuffer;
-
-                        /* #if defined( niEMAC_STM32HX ) && ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
-                         *  xTxConfig.PayloadLen = pxDescriptor->xDataLength;
-                         *  xTxConfig.TCPHeaderLen = sizeof( pxTCPPacket_IPv6->xTCPHeader );
-                         *  xTxConfig.Attributes |= ETH_TX_PACKETS_FEATURES_TSO;
-                         #endif */
+                        /* Super-segments are given their TSO attributes in prvSendTxQueue */
                         ( void ) pxTCPPacket_IPv6;
                     #else
                         FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Unsupported TCP\n" ) );
@@ -705,63 +1460,22 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface,
         {
         }
 
-        ETH_BufferTypeDef xTxBuffer =
-        {
-            .buffer = pxDescriptor->pucEthernetBuffer,
-            .len    = pxDescriptor->xDataLength,
-            .next   = NULL
-        };
-
-        xTxConfig.pData = pxDescriptor;
-        xTxConfig.TxBuffer = &xTxBuffer;
-        xTxConfig.Length = xTxBuffer.len;
-
-        /* TODO: Queue Tx Output? */
-
-        /* if( xQueueSendToBack( xTxQueue, pxDescriptor, 0 ) != pdPASS )
-         * {
-         *  xReleaseAfterSend = pdFALSE;
-         * } */
-
-        if( xSemaphoreTake( xTxDescSem, pdMS_TO_TICKS( niEMAC_DESCRIPTOR_WAIT_TIME_MS ) ) == pdFALSE )
-        {
-            FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: No Descriptors Available\n" ) );
-            break;
-        }
+        /* Frames are handed to the EMAC task, which owns the Tx descriptor ring and
+         * submits everything that is queued each time it wakes up. */
+        ipSET_NETWORK_BUFFER_OWNER( pxDescriptor, eNetworkBufferDriverTx );
 
-        if( xSemaphoreTake( xTxMutex, pdMS_TO_TICKS( niEMAC_TX_MAX_BLOCK_TIME_MS ) ) == pdFALSE )
+        if( xQueueSendToBack( pxEMACData->xTxQueue, &pxDescriptor, pdMS_TO_TICKS( niEMAC_TX_MAX_BLOCK_TIME_MS ) ) != pdPASS )
         {
-            FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Process Busy\n" ) );
-            ( void ) xSemaphoreGive( xTxDescSem );
+            prvCountTxDrop( &pxEMACData->xEMACStats.ulTxDropQueueFull );
+            FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Tx Queue Full\n" ) );
             break;
         }
 
-        #ifdef niEMAC_CACHEABLE
-            if( niEMAC_CACHE_MAINTENANCE != 0 )
-            {
-                const uintptr_t uxDataStart = ( uintptr_t ) xTxBuffer.buffer;
-                const uintptr_t uxLineStart = uxDataStart & ~niEMAC_DATA_ALIGNMENT_MASK;
-                const ptrdiff_t uxDataOffset = uxDataStart - uxLineStart;
-                const size_t uxLength = xTxBuffer.len + uxDataOffset;
-                SCB_CleanDCache_by_Addr( ( uint32_t * ) uxLineStart, uxLength );
-            }
-        #endif
-
-        if( HAL_ETH_Transmit_IT( pxEthHandle, &xTxConfig ) == HAL_OK )
-        {
-            /* Released later in deferred task by calling HAL_ETH_ReleaseTxPacket */
-            xReleaseAfterSend = pdFALSE;
-            xResult = pdPASS;
-        }
-        else
-        {
-            ( void ) xSemaphoreGive( xTxDescSem );
-            configASSERT( pxEthHandle->gState == HAL_ETH_STATE_STARTED );
-            /* Should be impossible if semaphores are correctly implemented */
-            configASSERT( ( pxEthHandle->ErrorCode & HAL_ETH_ERROR_BUSY ) == 0 );
-        }
+        /* Released later in deferred task by calling HAL_ETH_ReleaseTxPacket */
+        xReleaseAfterSend = pdFALSE;
+        xResult = pdPASS;
 
-        ( void ) xSemaphoreGive( xTxMutex );
+        ( void ) xTaskNotify( pxEMACData->xEMACTaskHandle, eMacEventTxPending, eSetBits );
     } while( pdFALSE );
 
     if( xReleaseAfterSend == pdTRUE )
@@ -777,20 +1491,25 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface,
 static void prvAddAllowedMACAddress( NetworkInterface_t * pxInterface,
                                      const uint8_t * pucMacAddress )
 {
-    ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
-
-    /* TODO: group address filtering with Mask Byte Control */
-    BaseType_t xResult = prvAddDestMACAddrMatch( pxEthHandle->Instance, pucMacAddress );
+    EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+    const ETH_HandleTypeDef * const pxEthHandle = &pxEMACData->xEthHandle;
 
-    if( xResult == pdFALSE )
+    /* MACA0 always matches the primary MAC-address */
+    if( memcmp( pucMacAddress, pxEthHandle->Init.MACAddr, ipMAC_ADDRESS_LENGTH_BYTES ) != 0 )
     {
-        const uint8_t ucHashIndex = prvGetMacHashIndex( pucMacAddress );
-
-        xResult = prvSetNewDestMACAddrMatch( pxEthHandle->Instance, ucHashIndex, pucMacAddress );
+        /* Each address is counted in a perfect match slot if it has one, otherwise in its hash bucket */
+        BaseType_t xResult = prvAddDestMACAddrMatch( pxEMACData, pucMacAddress );
 
         if( xResult == pdFALSE )
         {
-            prvAddDestMACAddrHash( pxEthHandle, ucHashIndex );
+            const uint8_t ucHashIndex = prvGetMacHashIndex( pucMacAddress );
+
+            xResult = prvSetNewDestMACAddrMatch( pxEMACData, ucHashIndex, pucMacAddress );
+
+            if( xResult == pdFALSE )
+            {
+                prvAddDestMACAddrHash( pxEMACData, ucHashIndex );
+            }
         }
     }
 }
@@ -800,13 +1519,17 @@ static void prvAddAllowedMACAddress( NetworkInterface_t * pxInterface,
 static void prvRemoveAllowedMACAddress( NetworkInterface_t * pxInterface,
                                         const uint8_t * pucMacAddress )
 {
-    ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
+    EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+    const ETH_HandleTypeDef * const pxEthHandle = &pxEMACData->xEthHandle;
 
-    const BaseType_t xResult = prvRemoveDestMACAddrMatch( pxEthHandle->Instance, pucMacAddress );
-
-    if( xResult == pdFALSE )
+    if( memcmp( pucMacAddress, pxEthHandle->Init.MACAddr, ipMAC_ADDRESS_LENGTH_BYTES ) != 0 )
     {
-        prvRemoveDestMACAddrHash( pxEthHandle, pucMacAddress );
+        const BaseType_t xResult = prvRemoveDestMACAddrMatch( pxEMACData, pucMacAddress );
+
+        if( xResult == pdFALSE )
+        {
+            prvRemoveDestMACAddrHash( pxEMACData, pucMacAddress );
+        }
     }
 }
 
@@ -816,10 +1539,11 @@ static void prvRemoveAllowedMACAddress( NetworkInterface_t * pxInterface,
 /*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvNetworkInterfaceInput( ETH_HandleTypeDef * pxEthHandle,
-                                            NetworkInterface_t * pxInterface )
+static UBaseType_t prvNetworkInterfaceInput( EMACData_t * pxEMACData,
+                                             NetworkInterface_t * pxInterface,
+                                             UBaseType_t uxBudget )
 {
-    BaseType_t xResult = pdFALSE;
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
     UBaseType_t uxCount = 0;
 
     #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
@@ -828,9 +1552,9 @@ static BaseType_t prvNetworkInterfaceInput( ETH_HandleTypeDef * pxEthHandle,
     #endif
     NetworkBufferDescriptor_t * pxCurDescriptor = NULL;
 
-    if( ( xMacInitStatus == eMacInitComplete ) && ( pxEthHandle->gState == HAL_ETH_STATE_STARTED ) )
+    if( ( pxEMACData->xMacInitStatus == eMacInitComplete ) && ( pxEthHandle->gState == HAL_ETH_STATE_STARTED ) )
     {
-        while( HAL_ETH_ReadData( pxEthHandle, ( void ** ) &pxCurDescriptor ) == HAL_OK )
+        while( ( uxCount < uxBudget ) && ( HAL_ETH_ReadData( pxEthHandle, ( void ** ) &pxCurDescriptor ) == HAL_OK ) )
         {
             ++uxCount;
 
@@ -840,7 +1564,14 @@ static BaseType_t prvNetworkInterfaceInput( ETH_HandleTypeDef * pxEthHandle,
                 continue;
             }
 
-            configASSERT( pxEthHandle->RxDescList.RxDataLength <= niEMAC_DATA_BUFFER_SIZE );
+            configASSERT( pxCurDescriptor->xDataLength <= niEMAC_DATA_BUFFER_SIZE );
+
+            ++pxEMACData->xEMACStats.ulRxFrames;
+            pxEMACData->xEMACStats.ulRxBytes += ( uint32_t ) pxCurDescriptor->xDataLength;
+
+            #if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK )
+                pxCurDescriptor = prvRxCopyBreak( pxEMACData, pxCurDescriptor );
+            #endif
 
             pxCurDescriptor->pxInterface = pxInterface;
             pxCurDescriptor->pxEndPoint = FreeRTOS_MatchingEndpoint( pxCurDescriptor->pxInterface, pxCurDescriptor->pucEthernetBuffer );
@@ -861,15 +1592,23 @@ static BaseType_t prvNetworkInterfaceInput( ETH_HandleTypeDef * pxEthHandle,
         }
     }
 
-    if( uxCount > 0 )
-    {
-        #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+    #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+        if( pxStartDescriptor != NULL )
+        {
             prvSendRxEvent( pxStartDescriptor );
-        #endif
-        xResult = pdTRUE;
+        }
+    #endif
+
+    if( pxEMACData->xEMACStats.ulRxDescHighWater < ( uint32_t ) uxCount )
+    {
+        pxEMACData->xEMACStats.ulRxDescHighWater = ( uint32_t ) uxCount;
     }
 
-    return xResult;
+    #if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+        prvUpdateRxModeration( pxEMACData, uxCount );
+    #endif
+
+    return uxCount;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -877,21 +1616,88 @@ static BaseType_t prvNetworkInterfaceInput( ETH_HandleTypeDef * pxEthHandle,
 static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
 {
     NetworkInterface_t * pxInterface = ( NetworkInterface_t * ) pvParameters;
-    ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
-    EthernetPhy_t * pxPhyObject = &xPhyObject;
+    EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+    EthernetPhy_t * pxPhyObject = &pxEMACData->xPhyObject;
 
     /* iptraceEMAC_TASK_STARTING(); */
 
+    #if ipconfigIS_ENABLED( niEMAC_PHY_ASYNC_START )
+        prvTakeEthContext( pxEMACData );
+
+        /* The IP task went on without waiting for the PHY reset and auto-negotiation */
+        if( prvPhyStart( pxEthHandle, pxInterface, pxPhyObject ) == pdFALSE )
+        {
+            FreeRTOS_debug_printf( ( "prvEMACHandlerTask: prvPhyStart failed\n" ) );
+        }
+        else if( ( prvGetPhyLinkStatus( pxInterface ) != pdFALSE ) && ( prvEthStart( pxEMACData ) != pdFALSE ) )
+        {
+            prvNotifyLinkUp( pxEMACData, pxInterface );
+        }
+
+        prvGiveEthContext( pxEMACData );
+    #endif
+
     for( ; ; )
     {
         BaseType_t xResult = pdFALSE;
         uint32_t ulISREvents = 0U;
+        TickType_t xBlockTime = pdMS_TO_TICKS( niEMAC_TASK_MAX_BLOCK_TIME_MS );
+        UBaseType_t uxBudget = niEMAC_RX_UNLIMITED_BUDGET;
+        UBaseType_t uxRxCount = 0U;
+
+        if( ( pxEthHandle->RxDescList.RxBuildDescCnt != 0U ) || ( uxQueueSpacesAvailable( pxEMACData->xRxReserve ) != 0U ) )
+        {
+            /* Retry soon, the network buffers are released by other tasks without telling this one */
+            xBlockTime = niEMAC_RX_REFILL_DELAY_TICKS;
+        }
+
+        #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+            uxBudget = pxEMACData->uxRxPollBudget;
+
+            if( pxEMACData->xRxPolling != pdFALSE )
+            {
+                if( pxEMACData->xRxBacklog != pdFALSE )
+                {
+                    /* Frames are left in the ring, read on once tasks of the same priority had their turn */
+                    xBlockTime = 0U;
+                    taskYIELD();
+                }
+                else
+                {
+                    /* Give lower priority tasks a chance to consume the last pass */
+                    xBlockTime = niEMAC_RX_POLL_DELAY_TICKS;
+                }
+            }
+        #endif
+
+        #if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+            if( ( pxEMACData->xTxIrqEnabled == pdFALSE ) && ( pxEthHandle->TxDescList.BuffersInUse != 0U ) &&
+                ( xBlockTime > niEMAC_TX_COALESCE_DELAY_TICKS ) )
+            {
+                /* Sent frames keep their network buffers until the next pass releases them */
+                xBlockTime = niEMAC_TX_COALESCE_DELAY_TICKS;
+            }
+        #endif
+
+        if( ( pxEMACData->xLinkMonitor.eState != eMdioIdle ) && ( xBlockTime > niEMAC_MDIO_POLL_DELAY_TICKS ) )
+        {
+            /* A PHY register read is in flight, it takes tens of microseconds */
+            xBlockTime = niEMAC_MDIO_POLL_DELAY_TICKS;
+        }
+
+        const BaseType_t xNotified = xTaskNotifyWait( 0U, eMacEventAll, &ulISREvents, xBlockTime );
 
-        if( xTaskNotifyWait( 0U, eMacEventAll, &ulISREvents, pdMS_TO_TICKS( niEMAC_TASK_MAX_BLOCK_TIME_MS ) ) == pdTRUE )
+        prvTakeEthContext( pxEMACData );
+
+        if( xNotified == pdTRUE )
         {
             if( ( ulISREvents & eMacEventRx ) != 0 )
             {
-                xResult = prvNetworkInterfaceInput( pxEthHandle, pxInterface );
+                #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+                    ++pxEMACData->xRxPollStatus.ulInterruptWakeups;
+                #endif
+                uxRxCount += prvNetworkInterfaceInput( pxEMACData, pxInterface, uxBudget );
             }
 
             if( ( ulISREvents & eMacEventTx ) != 0 )
@@ -899,14 +1705,28 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
                 prvReleaseTxPacket( pxEthHandle );
             }
 
+            if( ( ulISREvents & ( eMacEventTx | eMacEventTxPending ) ) != 0 )
+            {
+                prvSendTxQueue( pxEMACData );
+            }
+
             if( ( ulISREvents & eMacEventErrRx ) != 0 )
             {
-                xResult = prvNetworkInterfaceInput( pxEthHandle, pxInterface );
+                /* The DMA found no descriptor to receive into */
+                ++pxEMACData->xRxReserveStatus.ulRingEmpty;
+                uxRxCount += prvNetworkInterfaceInput( pxEMACData, pxInterface, uxBudget );
+                pxEMACData->xEMACStats.ulRxDropNoDescriptor += niEMAC_RX_MISSED_FRAMES( pxEthHandle->Instance );
             }
 
             if( ( ulISREvents & eMacEventErrTx ) != 0 )
             {
                 prvReleaseTxPacket( pxEthHandle );
+                prvSendTxQueue( pxEMACData );
+            }
+
+            if( ( ulISREvents & eMacEventPhy ) != 0 )
+            {
+                pxEMACData->xLinkMonitor.xIrqPending = pdTRUE;
             }
 
             if( ( ulISREvents & eMacEventErrEth ) != 0 )
@@ -915,10 +1735,25 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
 
                 if( pxEthHandle->gState == HAL_ETH_STATE_ERROR )
                 {
-                    /* Recover from critical error */
-                    ( void ) HAL_ETH_Init( pxEthHandle );
-                    ( void ) HAL_ETH_Start_IT( pxEthHandle );
-                    xResult = prvNetworkInterfaceInput( pxEthHandle, pxInterface );
+                    /* Recover from critical error, restarting the DMA alone keeps the MAC, its filters and the link */
+                    if( prvEthRestartDMA( pxEMACData ) != pdFALSE )
+                    {
+                        ++pxEMACData->xEMACStats.ulRecoveryRestarts;
+                    }
+                    else if( ( prvEthReset( pxEMACData, pxInterface ) != pdFALSE ) && ( prvGetPhyLinkStatus( pxInterface ) != pdFALSE ) )
+                    {
+                        ( void ) prvEthStart( pxEMACData );
+                    }
+
+                    const uint32_t ulRecoveryMs = ( uint32_t ) pdTICKS_TO_MS( xTaskGetTickCount() - pxEMACData->xErrorTime );
+                    pxEMACData->xEMACStats.ulRecoveryLastMs = ulRecoveryMs;
+
+                    if( ulRecoveryMs > pxEMACData->xEMACStats.ulRecoveryMaxMs )
+                    {
+                        pxEMACData->xEMACStats.ulRecoveryMaxMs = ulRecoveryMs;
+                    }
+
+                    uxRxCount += prvNetworkInterfaceInput( pxEMACData, pxInterface, uxBudget );
                 }
             }
 
@@ -926,14 +1761,35 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
             /* if( ( ulISREvents & eMacEventErrDma ) != 0 ) */
         }
 
-        if( xPhyCheckLinkStatus( pxPhyObject, xResult ) != pdFALSE )
+        #if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+            prvCoalesceTx( pxEMACData, ulISREvents );
+        #endif
+
+        prvRefillRxReserve( pxEMACData );
+
+        if( ( pxEthHandle->RxDescList.RxBuildDescCnt != 0U ) && ( uxQueueMessagesWaiting( pxEMACData->xRxReserve ) != 0U ) )
+        {
+            /* Descriptors left without a buffer are rebuilt by HAL_ETH_ReadData */
+            uxRxCount += prvNetworkInterfaceInput( pxEMACData, pxInterface, uxBudget );
+        }
+
+        #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+            uxRxCount = prvPollRx( pxEMACData, pxInterface, uxRxCount );
+        #endif
+
+        if( uxRxCount > 0U )
+        {
+            xResult = pdTRUE;
+        }
+
+        if( prvCheckLinkStatus( pxEMACData, xResult ) != pdFALSE )
         {
             if( prvGetPhyLinkStatus( pxInterface ) != pdFALSE )
             {
                 if( pxEthHandle->gState == HAL_ETH_STATE_ERROR )
                 {
                     /* Recover from critical error */
-                    ( void ) HAL_ETH_Init( pxEthHandle );
+                    ( void ) prvEthReset( pxEMACData, pxInterface );
                 }
 
                 if( pxEthHandle->gState == HAL_ETH_STATE_READY )
@@ -941,19 +1797,27 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
                     /* Link was down or critical error occurred */
                     if( prvMacUpdateConfig( pxEthHandle, pxPhyObject ) != pdFALSE )
                     {
-                        ( void ) HAL_ETH_Start_IT( pxEthHandle );
+                        ( void ) prvEthStart( pxEMACData );
                     }
                 }
+
+                prvNotifyLinkUp( pxEMACData, pxInterface );
             }
             else
             {
                 ( void ) HAL_ETH_Stop_IT( pxEthHandle );
+                #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+                    pxEMACData->xRxPolling = pdFALSE;
+                #endif
                 prvReleaseTxPacket( pxEthHandle );
+                prvFlushTxQueue( pxEMACData );
                 #if ( ipconfigIS_ENABLED( ipconfigSUPPORT_NETWORK_DOWN_EVENT ) )
                     FreeRTOS_NetworkDown( pxInterface );
                 #endif
             }
         }
+
+        prvGiveEthContext( pxEMACData );
     }
 }
 
@@ -962,55 +1826,64 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
 static BaseType_t prvEMACTaskStart( NetworkInterface_t * pxInterface )
 {
     BaseType_t xResult = pdFALSE;
+    EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
 
-    if( xTxMutex == NULL )
+    if( pxEMACData->xTxQueue == NULL )
     {
         #if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION )
-            static StaticSemaphore_t xTxMutexBuf;
-            xTxMutex = xSemaphoreCreateMutexStatic( &xTxMutexBuf );
+            pxEMACData->xTxQueue = xQueueCreateStatic(
+                ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH,
+                ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ),
+                pxEMACData->ucTxQueueStorage,
+                &pxEMACData->xTxQueueBuf
+                );
         #else
-            xTxMutex = xSemaphoreCreateMutex();
-        #endif
-        configASSERT( xTxMutex != NULL );
+            pxEMACData->xTxQueue = xQueueCreate(
+                ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH,
+                ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * )
+                );
+        #endif /* if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION ) */
+        configASSERT( pxEMACData->xTxQueue != NULL );
         #if ( configQUEUE_REGISTRY_SIZE > 0 )
-            vQueueAddToRegistry( xTxMutex, niEMAC_TX_MUTEX_NAME );
+            vQueueAddToRegistry( pxEMACData->xTxQueue, niEMAC_TX_QUEUE_NAME );
         #endif
     }
 
-    if( xTxDescSem == NULL )
+    if( pxEMACData->xRxReserve == NULL )
     {
-        #if ( ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION ) )
-            static StaticSemaphore_t xTxDescSemBuf;
-            xTxDescSem = xSemaphoreCreateCountingStatic(
-                ( UBaseType_t ) ETH_TX_DESC_CNT,
-                ( UBaseType_t ) ETH_TX_DESC_CNT,
-                &xTxDescSemBuf
+        #if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION )
+            pxEMACData->xRxReserve = xQueueCreateStatic(
+                ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH,
+                ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ),
+                pxEMACData->ucRxReserveStorage,
+                &pxEMACData->xRxReserveBuf
                 );
         #else
-            xTxDescSem = xSemaphoreCreateCounting(
-                ( UBaseType_t ) ETH_TX_DESC_CNT,
-                ( UBaseType_t ) ETH_TX_DESC_CNT
+            pxEMACData->xRxReserve = xQueueCreate(
+                ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH,
+                ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * )
                 );
-        #endif /* if ( ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION ) ) */
-        configASSERT( xTxDescSem != NULL );
+        #endif /* if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION ) */
+        configASSERT( pxEMACData->xRxReserve != NULL );
         #if ( configQUEUE_REGISTRY_SIZE > 0 )
-            vQueueAddToRegistry( xTxDescSem, niEMAC_TX_DESC_SEM_NAME );
+            vQueueAddToRegistry( pxEMACData->xRxReserve, niEMAC_RX_RESERVE_NAME );
         #endif
+
+        /* Filled before HAL_ETH_Start_IT hands the Rx descriptors their buffers */
+        prvRefillRxReserve( pxEMACData );
     }
 
-    if( ( xEMACTaskHandle == NULL ) && ( xTxMutex != NULL ) && ( xTxDescSem != NULL ) )
+    if( ( pxEMACData->xEMACTaskHandle == NULL ) && ( pxEMACData->xTxQueue != NULL ) && ( pxEMACData->xRxReserve != NULL ) )
     {
         #if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION )
-            static StackType_t uxEMACTaskStack[ niEMAC_TASK_STACK_SIZE ];
-            static StaticTask_t xEMACTaskTCB;
-            xEMACTaskHandle = xTaskCreateStatic(
+            pxEMACData->xEMACTaskHandle = xTaskCreateStatic(
                 prvEMACHandlerTask,
                 niEMAC_TASK_NAME,
                 niEMAC_TASK_STACK_SIZE,
                 ( void * ) pxInterface,
                 niEMAC_TASK_PRIORITY,
-                uxEMACTaskStack,
-                &xEMACTaskTCB
+                pxEMACData->uxEMACTaskStack,
+                &pxEMACData->xEMACTaskTCB
                 );
         #else /* if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION ) */
             ( void ) xTaskCreate(
@@ -1019,12 +1892,12 @@ static BaseType_t prvEMACTaskStart( NetworkInterface_t * pxInterface )
                 niEMAC_TASK_STACK_SIZE,
                 ( void * ) pxInterface,
                 niEMAC_TASK_PRIORITY,
-                &xEMACTaskHandle
+                &pxEMACData->xEMACTaskHandle
                 );
         #endif /* if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION ) */
     }
 
-    if( xEMACTaskHandle != NULL )
+    if( pxEMACData->xEMACTaskHandle != NULL )
     {
         xResult = pdTRUE;
     }
@@ -1032,78 +1905,233 @@ static BaseType_t prvEMACTaskStart( NetworkInterface_t * pxInterface )
     return xResult;
 }
 
-/*---------------------------------------------------------------------------*/
-/*===========================================================================*/
-/*                               EMAC Init                                   */
-/*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvEthConfigInit( ETH_HandleTypeDef * pxEthHandle,
-                                    NetworkInterface_t * pxInterface )
+static BaseType_t prvEthStart( EMACData_t * pxEMACData )
 {
     BaseType_t xResult = pdFALSE;
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
 
-    pxEthHandle->Instance = ETH;
-    pxEthHandle->Init.MediaInterface = ipconfigIS_ENABLED( niEMAC_USE_RMII ) ? HAL_ETH_RMII_MODE : HAL_ETH_MII_MODE;
-    pxEthHandle->Init.RxBuffLen = niEMAC_DATA_BUFFER_SIZE;
-    /* configASSERT( pxEthHandle->Init.RxBuffLen <= ETH_MAX_PACKET_SIZE ); */
-    configASSERT( pxEthHandle->Init.RxBuffLen % 4U == 0 );
-    #if ( defined( niEMAC_STM32FX ) && defined( ETH_RX_BUF_SIZE ) )
-        configASSERT( pxEthHandle->Init.RxBuffLen == ETH_RX_BUF_SIZE );
-    #endif
-
-    static ETH_DMADescTypeDef xDMADescTx[ ETH_TX_DESC_CNT ] __ALIGNED( portBYTE_ALIGNMENT ) __attribute__( ( section( niEMAC_TX_DESC_SECTION ) ) );
-    static ETH_DMADescTypeDef xDMADescRx[ ETH_RX_DESC_CNT ] __ALIGNED( portBYTE_ALIGNMENT ) __attribute__( ( section( niEMAC_RX_DESC_SECTION ) ) );
-    pxEthHandle->Init.TxDesc = xDMADescTx;
-    pxEthHandle->Init.RxDesc = xDMADescRx;
-    ( void ) memset( &xDMADescTx, 0, sizeof( xDMADescTx ) );
-    ( void ) memset( &xDMADescRx, 0, sizeof( xDMADescRx ) );
-
-    const NetworkEndPoint_t * const pxEndPoint = FreeRTOS_FirstEndPoint( pxInterface );
+    if( HAL_ETH_Start_IT( pxEthHandle ) == HAL_OK )
+    {
+        /* HAL_ETH_Start_IT enables every interrupt and rearms each Rx descriptor with one */
+        #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+            pxEMACData->xRxPolling = pdFALSE;
+        #endif
+        #if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+            prvSetRxModeration( pxEMACData );
+        #endif
+        #if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+            pxEMACData->uxTxUnsignalled = 0U;
+            prvSetTxInterrupt( pxEMACData, pdFALSE );
+        #endif
+        xResult = pdTRUE;
+    }
 
-    if( pxEndPoint != NULL )
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvEthRestartDMA( EMACData_t * pxEMACData )
+{
+    BaseType_t xResult = pdTRUE;
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+    ETH_TypeDef * const pxEthInstance = pxEthHandle->Instance;
+    UBaseType_t uxPolls;
+
+    /* Restart the direction at fault, and any other the fault left stopped. A MAC error
+     * stops neither, so only the state the HAL gave up on is restored. */
+    const BaseType_t xRestartTx = ( niEMAC_DMA_TX_FAULT( pxEthInstance ) || niEMAC_DMA_TX_STOPPED( pxEthInstance ) ) ? pdTRUE : pdFALSE;
+    const BaseType_t xRestartRx = ( niEMAC_DMA_RX_FAULT( pxEthInstance ) || niEMAC_DMA_RX_STOPPED( pxEthInstance ) ) ? pdTRUE : pdFALSE;
+
+    if( xRestartTx != pdFALSE )
     {
-        /* ipLOCAL_MAC_ADDRESS */
-        pxEthHandle->Init.MACAddr = ( uint8_t * ) pxEndPoint->xMACAddress.ucBytes;
+        #if defined( niEMAC_STM32FX )
+            pxEthInstance->DMAOMR &= ~ETH_DMAOMR_ST;
+        #elif defined( niEMAC_STM32HX )
+            pxEthInstance->DMACTCR &= ~ETH_DMACTCR_ST;
+        #endif
+    }
 
-        if( HAL_ETH_Init( pxEthHandle ) == HAL_OK )
+    if( xRestartRx != pdFALSE )
+    {
+        #if defined( niEMAC_STM32FX )
+            pxEthInstance->DMAOMR &= ~ETH_DMAOMR_SR;
+        #elif defined( niEMAC_STM32HX )
+            pxEthInstance->DMACRCR &= ~ETH_DMACRCR_SR;
+        #endif
+    }
+
+    for( uxPolls = 0U; uxPolls < niEMAC_DMA_STOP_POLLS; ++uxPolls )
+    {
+        if( ( ( xRestartTx == pdFALSE ) || niEMAC_DMA_TX_STOPPED( pxEthInstance ) ) &&
+            ( ( xRestartRx == pdFALSE ) || niEMAC_DMA_RX_STOPPED( pxEthInstance ) ) )
+        {
+            break;
+        }
+    }
+
+    if( uxPolls == niEMAC_DMA_STOP_POLLS )
+    {
+        /* A direction hung on the bus, only a reset gets it back */
+        xResult = pdFALSE;
+    }
+    else if( xRestartTx != pdFALSE )
+    {
+        #if defined( niEMAC_STM32FX )
+            pxEthInstance->DMAOMR |= ETH_DMAOMR_FTF;
+            xResult = prvWaitBitsClear( &pxEthInstance->DMAOMR, ETH_DMAOMR_FTF );
+        #elif defined( niEMAC_STM32HX )
+            pxEthInstance->MTLTQOMR |= ETH_MTLTQOMR_FTQ;
+            xResult = prvWaitBitsClear( &pxEthInstance->MTLTQOMR, ETH_MTLTQOMR_FTQ );
+        #endif
+
+        if( xResult == pdFALSE )
+        {
+            /* The Tx FIFO never emptied, the caller falls back to a full reinit */
+            FreeRTOS_debug_printf( ( "prvEthRestartDMA: Tx FIFO flush timed out\n" ) );
+        }
+        else
+        {
+            prvReclaimTxDescriptors( pxEMACData );
+        }
+    }
+
+    if( xResult != pdFALSE )
+    {
+        if( xRestartRx != pdFALSE )
+        {
+            prvReclaimRxDescriptors( pxEthHandle );
+        }
+
+        #if defined( niEMAC_STM32FX )
+            pxEthInstance->DMASR = ETH_DMASR_FBES | ETH_DMASR_AIS | ETH_DMASR_TPSS | ETH_DMASR_RPSS;
+        #elif defined( niEMAC_STM32HX )
+            pxEthInstance->DMACSR = ETH_DMACSR_FBE | ETH_DMACSR_AIS | ETH_DMACSR_TPS | ETH_DMACSR_RPS;
+        #endif
+        pxEthHandle->gState = HAL_ETH_STATE_STARTED;
+
+        if( xRestartRx != pdFALSE )
         {
+            /* Hands every descriptor back to the DMA, nothing can be read with none built */
+            void * pvAppBuff = NULL;
+            ( void ) HAL_ETH_ReadData( pxEthHandle, &pvAppBuff );
             #if defined( niEMAC_STM32FX )
-                /* This function doesn't get called in Fxx driver */
-                HAL_ETH_SetMDIOClockRange( pxEthHandle );
+                pxEthInstance->DMAOMR |= ETH_DMAOMR_SR;
+            #elif defined( niEMAC_STM32HX )
+                pxEthInstance->DMACRCR |= ETH_DMACRCR_SR;
             #endif
-            ETH_MACConfigTypeDef xMACConfig;
-            ( void ) HAL_ETH_GetMACConfig( pxEthHandle, &xMACConfig );
-            xMACConfig.ChecksumOffload = ( FunctionalState ) ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM );
-            xMACConfig.CRCStripTypePacket = DISABLE;
-            xMACConfig.AutomaticPadCRCStrip = ENABLE;
-            xMACConfig.RetryTransmission = ENABLE;
-            ( void ) HAL_ETH_SetMACConfig( pxEthHandle, &xMACConfig );
-
-            ETH_DMAConfigTypeDef xDMAConfig;
-            ( void ) HAL_ETH_GetDMAConfig( pxEthHandle, &xDMAConfig );
+        }
+
+        if( xRestartTx != pdFALSE )
+        {
             #if defined( niEMAC_STM32FX )
-                xDMAConfig.EnhancedDescriptorFormat = ( FunctionalState ) ( ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM ) || ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM ) );
+                pxEthInstance->DMAOMR |= ETH_DMAOMR_ST;
             #elif defined( niEMAC_STM32HX )
-                xDMAConfig.SecondPacketOperate = ENABLE;
-
-                /* #if ipconfigIS_ENABLED( ipconfigUSE_TCP ) && ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
-                 *  xDMAConfig.TCPSegmentation = ENABLE;
-                 *  xDMAConfig.MaximumSegmentSize = ipconfigTCP_MSS;
-                 #endif */
+                pxEthInstance->DMACTCR |= ETH_DMACTCR_ST;
             #endif
-            ( void ) HAL_ETH_SetDMAConfig( pxEthHandle, &xDMAConfig );
+        }
+
+        #if defined( niEMAC_STM32FX )
+            __HAL_ETH_DMA_ENABLE_IT( pxEthHandle, ETH_DMAIER_NISE | ETH_DMAIER_AISE );
+        #elif defined( niEMAC_STM32HX )
+            __HAL_ETH_DMA_ENABLE_IT( pxEthHandle, ETH_DMACIER_NIE | ETH_DMACIER_AIE );
+        #endif
+
+        if( ( ( xRestartTx != pdFALSE ) && niEMAC_DMA_TX_STOPPED( pxEthInstance ) ) ||
+            ( ( xRestartRx != pdFALSE ) && niEMAC_DMA_RX_STOPPED( pxEthInstance ) ) )
+        {
+            xResult = pdFALSE;
+        }
+    }
 
-            #if defined( niEMAC_STM32HX )
-                prvInitPacketFilter( pxEthHandle, pxInterface );
+    return xResult;
+}
 
-                /* HAL_ETHEx_DisableARPOffload( pxEthHandle );
-                 * HAL_ETHEx_SetARPAddressMatch( pxEthHandle, ulSourceIPAddress );
-                 * HAL_ETHEx_EnableARPOffload( pxEthHandle ); */
-            #endif
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvEthReset( EMACData_t * pxEMACData,
+                               NetworkInterface_t * pxInterface )
+{
+    BaseType_t xResult = pdFALSE;
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+    const EthernetPhy_t * pxPhyObject = &pxEMACData->xPhyObject;
+
+    ++pxEMACData->xEMACStats.ulRecoveryResets;
+
+    /* HAL_ETH_Init forgets the buffers held by both rings */
+    prvReclaimTxDescriptors( pxEMACData );
+    prvReleaseRxBuffers( pxEthHandle );
+
+    if( HAL_ETH_Init( pxEthHandle ) == HAL_OK )
+    {
+        prvEthApplyConfig( pxEMACData, pxInterface );
+        prvRestoreMacAddresses( pxEMACData );
+
+        /* The link is unchanged, so the speed and duplex it settled on still hold */
+        ( void ) prvMacSetLinkConfig( pxEthHandle, pxPhyObject );
+
+        xResult = pdTRUE;
+    }
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvNotifyLinkUp( const EMACData_t * pxEMACData,
+                             NetworkInterface_t * pxInterface )
+{
+    #if ( ipconfigIS_ENABLED( ipconfigSUPPORT_NETWORK_DOWN_EVENT ) )
+        if( ( pxInterface->bits.bInterfaceUp == pdFALSE_UNSIGNED ) && ( pxEMACData->xEthHandle.gState == HAL_ETH_STATE_STARTED ) )
+        {
+            /* Have the IP task run prvNetworkInterfaceInitialise now, as its own retry would */
+            FreeRTOS_NetworkDown( pxInterface );
+        }
+    #else
+        ( void ) pxEMACData;
+        ( void ) pxInterface;
+    #endif
+}
+
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                               EMAC Init                                   */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvEthConfigInit( EMACData_t * pxEMACData,
+                                    NetworkInterface_t * pxInterface )
+{
+    BaseType_t xResult = pdFALSE;
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+
+    pxEthHandle->Instance = niEMAC_ETH_INSTANCE( pxEMACData->xEMACIndex );
+    pxEthHandle->Init.MediaInterface = ipconfigIS_ENABLED( niEMAC_USE_RMII ) ? HAL_ETH_RMII_MODE : HAL_ETH_MII_MODE;
+    pxEthHandle->Init.RxBuffLen = niEMAC_RX_BUFFER_SIZE;
+    /* configASSERT( pxEthHandle->Init.RxBuffLen <= ETH_MAX_PACKET_SIZE ); */
+    configASSERT( pxEthHandle->Init.RxBuffLen % 4U == 0 );
+    #if ( defined( niEMAC_STM32FX ) && defined( ETH_RX_BUF_SIZE ) )
+        configASSERT( pxEthHandle->Init.RxBuffLen == ETH_RX_BUF_SIZE );
+    #endif
+
+    pxEthHandle->Init.TxDesc = xDMADescTx[ pxEMACData->xEMACIndex ];
+    pxEthHandle->Init.RxDesc = xDMADescRx[ pxEMACData->xEMACIndex ];
+    ( void ) memset( xDMADescTx[ pxEMACData->xEMACIndex ], 0, sizeof( xDMADescTx[ 0 ] ) );
+    ( void ) memset( xDMADescRx[ pxEMACData->xEMACIndex ], 0, sizeof( xDMADescRx[ 0 ] ) );
+
+    const NetworkEndPoint_t * const pxEndPoint = FreeRTOS_FirstEndPoint( pxInterface );
 
-            prvInitMacAddresses( pxEthHandle, pxInterface );
+    if( pxEndPoint != NULL )
+    {
+        /* ipLOCAL_MAC_ADDRESS */
+        pxEthHandle->Init.MACAddr = ( uint8_t * ) pxEndPoint->xMACAddress.ucBytes;
 
+        if( HAL_ETH_Init( pxEthHandle ) == HAL_OK )
+        {
+            prvEthApplyConfig( pxEMACData, pxInterface );
+            prvInitMacAddresses( pxInterface );
             xResult = pdTRUE;
         }
     }
@@ -1159,9 +2187,54 @@ static BaseType_t prvEthConfigInit( ETH_HandleTypeDef * pxEthHandle,
 
 /*---------------------------------------------------------------------------*/
 
-static void prvInitMacAddresses( ETH_HandleTypeDef * pxEthHandle,
-                                 NetworkInterface_t * pxInterface )
+static void prvEthApplyConfig( EMACData_t * pxEMACData,
+                               NetworkInterface_t * pxInterface )
 {
+    /* Everything HAL_ETH_Init resets to its defaults, applied again after a recovery reset */
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+
+    #if defined( niEMAC_STM32FX )
+        /* This function doesn't get called in Fxx driver */
+        HAL_ETH_SetMDIOClockRange( pxEthHandle );
+    #endif
+    ETH_MACConfigTypeDef xMACConfig;
+    ( void ) HAL_ETH_GetMACConfig( pxEthHandle, &xMACConfig );
+    xMACConfig.ChecksumOffload = ( FunctionalState ) ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM );
+    xMACConfig.CRCStripTypePacket = DISABLE;
+    xMACConfig.AutomaticPadCRCStrip = ENABLE;
+    xMACConfig.RetryTransmission = ENABLE;
+    #if ipconfigIS_ENABLED( niEMAC_JUMBO_FRAMES )
+        /* Jumbo frames do not fit in the 2 KB MTL FIFOs, so they are cut through rather than stored and forwarded */
+        xMACConfig.JumboPacket = ENABLE;
+        xMACConfig.TransmitQueueMode = ETH_TRANSMITTHRESHOLD_128;
+        xMACConfig.ReceiveQueueMode = ETH_RECEIVETHRESHOLD8_128;
+    #endif
+    ( void ) HAL_ETH_SetMACConfig( pxEthHandle, &xMACConfig );
+
+    ETH_DMAConfigTypeDef xDMAConfig;
+    ( void ) HAL_ETH_GetDMAConfig( pxEthHandle, &xDMAConfig );
+    #if defined( niEMAC_STM32FX )
+        /* Timestamps are only written back to enhanced descriptors */
+        xDMAConfig.EnhancedDescriptorFormat = ( FunctionalState ) ( ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM ) || ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM ) || ipconfigIS_ENABLED( niEMAC_TIMESTAMPING ) );
+    #elif defined( niEMAC_STM32HX )
+        xDMAConfig.SecondPacketOperate = ENABLE;
+
+        #if ipconfigIS_ENABLED( ipconfigUSE_TCP ) && ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+            /* Default MSS, each super-segment sets its own through a context descriptor */
+            xDMAConfig.TCPSegmentation = ENABLE;
+            xDMAConfig.MaximumSegmentSize = ipconfigTCP_MSS;
+        #endif
+    #endif
+    ( void ) HAL_ETH_SetDMAConfig( pxEthHandle, &xDMAConfig );
+
+    #if defined( niEMAC_STM32HX )
+        prvInitPacketFilter( pxEthHandle, pxInterface );
+
+        /* HAL_ETHEx_DisableARPOffload( pxEthHandle );
+         * HAL_ETHEx_SetARPAddressMatch( pxEthHandle, ulSourceIPAddress );
+         * HAL_ETHEx_EnableARPOffload( pxEthHandle ); */
+    #endif
+
     ETH_MACFilterConfigTypeDef xFilterConfig;
 
     ( void ) HAL_ETH_GetMACFilterConfig( pxEthHandle, &xFilterConfig );
@@ -1178,11 +2251,33 @@ static void prvInitMacAddresses( ETH_HandleTypeDef * pxEthHandle,
     xFilterConfig.PromiscuousMode = DISABLE;
     ( void ) HAL_ETH_SetMACFilterConfig( pxEthHandle, &xFilterConfig );
 
+    #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+        if( prvInitTimestamping( pxEMACData ) == pdFALSE )
+        {
+            FreeRTOS_debug_printf( ( "prvEthApplyConfig: PTP clock initialisation timed out\n" ) );
+        }
+    #endif
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvInitMacAddresses( NetworkInterface_t * pxInterface )
+{
     NetworkEndPoint_t * pxEndPoint;
 
     for( pxEndPoint = FreeRTOS_FirstEndPoint( pxInterface ); pxEndPoint != NULL; pxEndPoint = FreeRTOS_NextEndPoint( pxInterface, pxEndPoint ) )
     {
         prvAddAllowedMACAddress( pxInterface, pxEndPoint->xMACAddress.ucBytes );
+
+        #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
+            if( ENDPOINT_IS_IPv6( pxEndPoint ) )
+            {
+                /* Neighbour solicitations are sent to the solicited-node group ff02::1:ffXX:XXXX */
+                const uint8_t * const pucIPAddress = pxEndPoint->ipv6_settings.xIPAddress.ucBytes;
+                const uint8_t ucSolicitedNodeMAC[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x33, 0x33, 0xFF, pucIPAddress[ 13 ], pucIPAddress[ 14 ], pucIPAddress[ 15 ] };
+                prvAddAllowedMACAddress( pxInterface, ucSolicitedNodeMAC );
+            }
+        #endif
     }
 
     #if ipconfigIS_ENABLED( ipconfigUSE_IPv4 )
@@ -1195,14 +2290,18 @@ static void prvInitMacAddresses( ETH_HandleTypeDef * pxEthHandle,
     #endif
 
     #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
-        prvAddAllowedMACAddress( pxInterface, pcLOCAL_ALL_NODES_MULTICAST_MAC.ucBytes );
+    {
+        /* All-nodes group ff02::1 */
+        static const uint8_t ucAllNodesMulticastMAC[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 };
+        prvAddAllowedMACAddress( pxInterface, ucAllNodesMulticastMAC );
         #if ipconfigIS_ENABLED( ipconfigUSE_MDNS )
             prvAddAllowedMACAddress( pxInterface, xMDNS_MACAddressIPv6.ucBytes );
         #endif
         #if ipconfigIS_ENABLED( ipconfigUSE_LLMNR )
             prvAddAllowedMACAddress( pxInterface, xLLMNR_MacAddressIPv6.ucBytes );
         #endif
-    #endif
+    }
+    #endif /* if ipconfigIS_ENABLED( ipconfigUSE_IPv6 ) */
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1387,6 +2486,14 @@ static BaseType_t prvPhyStart( ETH_HandleTypeDef * pxEthHandle,
             pxPhyObject->xPhyPreferences.ucDuplex = xPhyProperties.ucDuplex;
         #endif
 
+        #if ipconfigIS_ENABLED( niEMAC_PHY_CACHE )
+            if( prvPhyCacheRestore( niEMAC_HANDLE_TO_DATA( pxEthHandle ) ) != pdFALSE )
+            {
+                /* Warm reset with the link still up, the PHY is neither reset nor renegotiated */
+                xResult = prvMacSetLinkConfig( pxEthHandle, pxPhyObject );
+            }
+            else
+        #endif
         if( xPhyConfigure( pxPhyObject, &xPhyProperties ) == 0 )
         {
             if( prvMacUpdateConfig( pxEthHandle, pxPhyObject ) != pdFALSE )
@@ -1400,9 +2507,99 @@ static BaseType_t prvPhyStart( ETH_HandleTypeDef * pxEthHandle,
         xResult = pdTRUE;
     }
 
+    #if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT )
+        if( xResult != pdFALSE )
+        {
+            /* xPhyConfigure resets the PHY, which clears its interrupt mask */
+            prvPhyEnableInterrupts( niEMAC_HANDLE_TO_DATA( pxEthHandle ) );
+        }
+    #endif
+
     return xResult;
 }
 
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_PHY_CACHE )
+
+    static uint32_t prvPhyCacheSum( const EMACPhyCache_t * pxCache )
+    {
+        uint32_t ulSum = pxCache->ulMagic + pxCache->ulPhyID + pxCache->ulPartnerAbility + pxCache->ulBCRValue + pxCache->ulACRValue;
+
+        ulSum += ( ( uint32_t ) pxCache->xPhyProperties.ucSpeed << 16U ) | ( ( uint32_t ) pxCache->xPhyProperties.ucDuplex << 8U ) | pxCache->xPhyProperties.ucMDI_X;
+
+        return ~ulSum;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static BaseType_t prvPhyCacheRestore( EMACData_t * pxEMACData )
+    {
+        BaseType_t xResult = pdFALSE;
+        const EMACPhyCache_t * const pxCache = &xPhyCache[ pxEMACData->xEMACIndex ];
+        EthernetPhy_t * const pxPhyObject = &pxEMACData->xPhyObject;
+        uint32_t ulStatus = 0U;
+        uint32_t ulPartnerAbility = 0U;
+
+        /* A single PHY, still linked to the partner it negotiated with before the reset */
+        if( ( pxPhyObject->xPortCount == 1 ) &&
+            ( pxCache->ulMagic == niEMAC_PHY_CACHE_MAGIC ) &&
+            ( pxCache->ulCheck == prvPhyCacheSum( pxCache ) ) &&
+            ( pxCache->ulPhyID == pxPhyObject->ulPhyIDs[ 0 ] ) )
+        {
+            const BaseType_t xAddress = pxPhyObject->ucPhyIndexes[ 0 ];
+
+            ( void ) pxPhyObject->fnPhyRead( xAddress, niEMAC_PHY_REG_BMSR, &ulStatus );
+            /* The link bit latches low, the second read gives its current state */
+            ( void ) pxPhyObject->fnPhyRead( xAddress, niEMAC_PHY_REG_BMSR, &ulStatus );
+            ( void ) pxPhyObject->fnPhyRead( xAddress, niEMAC_PHY_REG_ANLPAR, &ulPartnerAbility );
+
+            if( ( ( ulStatus & niEMAC_PHY_BMSR_LINK ) != 0U ) &&
+                ( ipconfigIS_DISABLED( niEMAC_AUTO_NEGOTIATION ) || ( ( ulStatus & niEMAC_PHY_BMSR_AN_COMPLETE ) != 0U ) ) &&
+                ( ulPartnerAbility == pxCache->ulPartnerAbility ) )
+            {
+                pxPhyObject->ulBCRValue = pxCache->ulBCRValue;
+                pxPhyObject->ulACRValue = pxCache->ulACRValue;
+                pxPhyObject->xPhyProperties = pxCache->xPhyProperties;
+                pxPhyObject->ulLinkStatusMask = xPhyGetMask( pxPhyObject );
+                vTaskSetTimeOutState( &( pxPhyObject->xLinkStatusTimer ) );
+                pxPhyObject->xLinkStatusRemaining = pdMS_TO_TICKS( ipconfigPHY_LS_HIGH_CHECK_TIME_MS );
+                ++pxEMACData->xEMACStats.ulPhyCacheHits;
+                prvLinkSettled( pxEMACData );
+                xResult = pdTRUE;
+            }
+        }
+
+        return xResult;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvPhyCacheSave( EMACData_t * pxEMACData )
+    {
+        EMACPhyCache_t * const pxCache = &xPhyCache[ pxEMACData->xEMACIndex ];
+        const EthernetPhy_t * const pxPhyObject = &pxEMACData->xPhyObject;
+        uint32_t ulPartnerAbility = 0U;
+
+        /* Invalid while it is rewritten, in case a reset cuts it short */
+        pxCache->ulMagic = 0U;
+
+        if( pxPhyObject->xPortCount == 1 )
+        {
+            ( void ) pxPhyObject->fnPhyRead( pxPhyObject->ucPhyIndexes[ 0 ], niEMAC_PHY_REG_ANLPAR, &ulPartnerAbility );
+
+            pxCache->ulPhyID = pxPhyObject->ulPhyIDs[ 0 ];
+            pxCache->ulPartnerAbility = ulPartnerAbility;
+            pxCache->ulBCRValue = pxPhyObject->ulBCRValue;
+            pxCache->ulACRValue = pxPhyObject->ulACRValue;
+            pxCache->xPhyProperties = pxPhyObject->xPhyProperties;
+            pxCache->ulMagic = niEMAC_PHY_CACHE_MAGIC;
+            pxCache->ulCheck = prvPhyCacheSum( pxCache );
+        }
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_PHY_CACHE ) */
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
 /*                           MAC Filtering Helpers                           */
@@ -1460,7 +2657,9 @@ static void prvHAL_ETH_SetDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
     const uint32_t ulMacAddrHigh = ( pucMACAddr[ 5 ] << 8 ) | ( pucMACAddr[ 4 ] );
     const uint32_t ulMacAddrLow = ( pucMACAddr[ 3 ] << 24 ) | ( pucMACAddr[ 2 ] << 16 ) | ( pucMACAddr[ 1 ] << 8 ) | ( pucMACAddr[ 0 ] );
 
-    /* MACA0HR/MACA0LR reserved for the primary MAC-address. */
+    /* MACA0HR/MACA0LR reserved for the primary MAC-address.
+     * Mask Byte Control is left clear: masking bytes would match a whole range of group
+     * addresses, which the hash filter already covers with a finer granularity. */
     const uint32_t ulMacRegHigh = ( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) );
     const uint32_t ulMacRegLow = ( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) );
     ( *( __IO uint32_t * ) ulMacRegHigh ) = ETH_MACA1HR_AE | ulMacAddrHigh;
@@ -1481,38 +2680,26 @@ static void prvHAL_ETH_ClearDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
 
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvAddDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
+static BaseType_t prvAddDestMACAddrMatch( EMACData_t * pxEMACData,
                                           const uint8_t * const pucMACAddr )
 {
     BaseType_t xResult = pdFALSE;
+    MacSrcMatchData_t * const pxSrcMatch = &pxEMACData->xMacFilteringData.xSrcMatch;
 
     uint8_t ucIndex;
 
     for( ucIndex = 0; ucIndex < niEMAC_MAC_SRC_MATCH_COUNT; ++ucIndex )
     {
-        if( ucSrcMatchCounters[ ucIndex ] > 0U )
+        if( ( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] > 0U ) &&
+            ( memcmp( pxSrcMatch->xSrcMatchAddresses[ ucIndex ].ucBytes, pucMACAddr, ipMAC_ADDRESS_LENGTH_BYTES ) == 0 ) )
         {
-            /* ETH_MACA1HR_MBC - Group Address Filtering */
-            const uint32_t ulMacRegHigh = ( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) );
-            const uint32_t ulMacRegLow = ( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) );
-
-            const uint32_t ulMacAddrHigh = ( pucMACAddr[ 5 ] << 8 ) | ( pucMACAddr[ 4 ] );
-            const uint32_t ulMacAddrLow = ( pucMACAddr[ 3 ] << 24 ) | ( pucMACAddr[ 2 ] << 16 ) | ( pucMACAddr[ 1 ] << 8 ) | ( pucMACAddr[ 0 ] );
-
-            if( ( ulMacRegHigh == ulMacAddrHigh ) && ( ulMacRegLow == ulMacAddrLow ) )
+            if( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] < UINT8_MAX )
             {
-                if( ucSrcMatchCounters[ ucIndex ] < UINT8_MAX )
-                {
-                    ++( ucSrcMatchCounters[ ucIndex ] );
-                }
-
-                xResult = pdTRUE;
-                break;
+                ++( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] );
             }
-        }
-        else if( uxMACEntryIndex > niEMAC_MAC_SRC_MATCH_COUNT )
-        {
-            uxMACEntryIndex = niEMAC_MAC_SRC_MATCH_COUNT;
+
+            xResult = pdTRUE;
+            break;
         }
     }
 
@@ -1521,37 +2708,30 @@ static BaseType_t prvAddDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
 
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvRemoveDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
+static BaseType_t prvRemoveDestMACAddrMatch( EMACData_t * pxEMACData,
                                              const uint8_t * const pucMACAddr )
 {
     BaseType_t xResult = pdFALSE;
+    MacSrcMatchData_t * const pxSrcMatch = &pxEMACData->xMacFilteringData.xSrcMatch;
 
     uint8_t ucIndex;
 
     for( ucIndex = 0; ucIndex < niEMAC_MAC_SRC_MATCH_COUNT; ++ucIndex )
     {
-        if( ucSrcMatchCounters[ ucIndex ] > 0U )
+        if( ( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] > 0U ) &&
+            ( memcmp( pxSrcMatch->xSrcMatchAddresses[ ucIndex ].ucBytes, pucMACAddr, ipMAC_ADDRESS_LENGTH_BYTES ) == 0 ) )
         {
-            /* ETH_MACA1HR_MBC - Group Address Filtering */
-            const uint32_t ulMacRegHigh = ( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) );
-            const uint32_t ulMacRegLow = ( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) );
-
-            const uint32_t ulMacAddrHigh = ( pucMACAddr[ 5 ] << 8 ) | ( pucMACAddr[ 4 ] );
-            const uint32_t ulMacAddrLow = ( pucMACAddr[ 3 ] << 24 ) | ( pucMACAddr[ 2 ] << 16 ) | ( pucMACAddr[ 1 ] << 8 ) | ( pucMACAddr[ 0 ] );
-
-            if( ( ulMacRegHigh == ulMacAddrHigh ) && ( ulMacRegLow == ulMacAddrLow ) )
+            /* A saturated counter can no longer be trusted, so the slot stays in use */
+            if( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] < UINT8_MAX )
             {
-                if( ucSrcMatchCounters[ ucIndex ] < UINT8_MAX )
+                if( --( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] ) == 0 )
                 {
-                    if( --( ucSrcMatchCounters[ ucIndex ] ) == 0 )
-                    {
-                        prvHAL_ETH_ClearDestMACAddrMatch( pxEthInstance, ucIndex );
-                    }
+                    prvHAL_ETH_ClearDestMACAddrMatch( pxEMACData->xEthHandle.Instance, ucIndex );
                 }
-
-                xResult = pdTRUE;
-                break;
             }
+
+            xResult = pdTRUE;
+            break;
         }
     }
 
@@ -1560,19 +2740,28 @@ static BaseType_t prvRemoveDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
 
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvSetNewDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
+static BaseType_t prvSetNewDestMACAddrMatch( EMACData_t * pxEMACData,
                                              uint8_t ucHashIndex,
                                              const uint8_t * const pucMACAddr )
 {
     BaseType_t xResult = pdFALSE;
+    MacSrcMatchData_t * const pxSrcMatch = &pxEMACData->xMacFilteringData.xSrcMatch;
 
-    if( uxMACEntryIndex < niEMAC_MAC_SRC_MATCH_COUNT )
+    /* An address whose hash bucket is already set passes the filter anyway, so don't spend a slot on it */
+    if( pxEMACData->xMacFilteringData.xHash.ucAddrHashCounters[ ucHashIndex ] == 0U )
     {
-        if( ucAddrHashCounters[ ucHashIndex ] == 0U )
+        uint8_t ucIndex;
+
+        for( ucIndex = 0; ucIndex < niEMAC_MAC_SRC_MATCH_COUNT; ++ucIndex )
         {
-            prvHAL_ETH_SetDestMACAddrMatch( pxEthInstance, uxMACEntryIndex, pucMACAddr );
-            ucSrcMatchCounters[ uxMACEntryIndex ] = 1U;
-            xResult = pdTRUE;
+            if( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] == 0U )
+            {
+                ( void ) memcpy( pxSrcMatch->xSrcMatchAddresses[ ucIndex ].ucBytes, pucMACAddr, ipMAC_ADDRESS_LENGTH_BYTES );
+                pxSrcMatch->ucSrcMatchCounters[ ucIndex ] = 1U;
+                prvHAL_ETH_SetDestMACAddrMatch( pxEMACData->xEthHandle.Instance, ucIndex, pucMACAddr );
+                xResult = pdTRUE;
+                break;
+            }
         }
     }
 
@@ -1581,522 +2770,2597 @@ static BaseType_t prvSetNewDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
 
 /*---------------------------------------------------------------------------*/
 
-static void prvAddDestMACAddrHash( ETH_HandleTypeDef * pxEthHandle,
+static void prvAddDestMACAddrHash( EMACData_t * pxEMACData,
                                    uint8_t ucHashIndex )
 {
-    if( ucAddrHashCounters[ ucHashIndex ] == 0 )
+    MacHashData_t * const pxHash = &pxEMACData->xMacFilteringData.xHash;
+
+    if( pxHash->ucAddrHashCounters[ ucHashIndex ] == 0 )
     {
         if( ucHashIndex & 0x20U )
         {
-            ulHashTable[ 1 ] |= ( 1U << ( ucHashIndex & 0x1FU ) );
+            pxHash->ulHashTable[ 1 ] |= ( 1U << ( ucHashIndex & 0x1FU ) );
         }
         else
         {
-            ulHashTable[ 0 ] |= ( 1U << ucHashIndex );
+            pxHash->ulHashTable[ 0 ] |= ( 1U << ucHashIndex );
         }
 
-        HAL_ETH_SetHashTable( pxEthHandle, ulHashTable );
+        HAL_ETH_SetHashTable( &pxEMACData->xEthHandle, pxHash->ulHashTable );
     }
 
-    if( ucAddrHashCounters[ ucHashIndex ] < UINT8_MAX )
+    if( pxHash->ucAddrHashCounters[ ucHashIndex ] < UINT8_MAX )
     {
-        ++( ucAddrHashCounters[ ucHashIndex ] );
+        ++( pxHash->ucAddrHashCounters[ ucHashIndex ] );
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void prvRemoveDestMACAddrHash( ETH_HandleTypeDef * pxEthHandle,
+static void prvRemoveDestMACAddrHash( EMACData_t * pxEMACData,
                                       const uint8_t * const pucMACAddr )
 {
+    MacHashData_t * const pxHash = &pxEMACData->xMacFilteringData.xHash;
     const uint8_t ucHashIndex = prvGetMacHashIndex( pucMACAddr );
 
-    if( ucAddrHashCounters[ ucHashIndex ] > 0U )
+    if( pxHash->ucAddrHashCounters[ ucHashIndex ] > 0U )
     {
-        if( ucAddrHashCounters[ ucHashIndex ] < UINT8_MAX )
+        if( pxHash->ucAddrHashCounters[ ucHashIndex ] < UINT8_MAX )
         {
-            if( --( ucAddrHashCounters[ ucHashIndex ] ) == 0 )
+            if( --( pxHash->ucAddrHashCounters[ ucHashIndex ] ) == 0 )
             {
                 if( ucHashIndex & 0x20U )
                 {
-                    ulHashTable[ 1 ] &= ~( 1U << ( ucHashIndex & 0x1FU ) );
+                    pxHash->ulHashTable[ 1 ] &= ~( 1U << ( ucHashIndex & 0x1FU ) );
                 }
                 else
                 {
-                    ulHashTable[ 0 ] &= ~( 1U << ucHashIndex );
+                    pxHash->ulHashTable[ 0 ] &= ~( 1U << ucHashIndex );
                 }
 
-                HAL_ETH_SetHashTable( pxEthHandle, ulHashTable );
+                HAL_ETH_SetHashTable( &pxEMACData->xEthHandle, pxHash->ulHashTable );
             }
         }
     }
 }
 
-/*---------------------------------------------------------------------------*/
-/*===========================================================================*/
-/*                              EMAC Helpers                                 */
-/*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-static void prvReleaseTxPacket( ETH_HandleTypeDef * pxEthHandle )
+static void prvRestoreMacAddresses( EMACData_t * pxEMACData )
 {
-    if( xSemaphoreTake( xTxMutex, pdMS_TO_TICKS( niEMAC_TX_MAX_BLOCK_TIME_MS ) ) != pdFALSE )
-    {
-        ( void ) HAL_ETH_ReleaseTxPacket( pxEthHandle );
-        ( void ) xSemaphoreGive( xTxMutex );
-    }
-    else
+    /* Writes the filters back as counted, HAL_ETH_Init having cleared them */
+    const MacSrcMatchData_t * const pxSrcMatch = &pxEMACData->xMacFilteringData.xSrcMatch;
+    uint8_t ucIndex;
+
+    for( ucIndex = 0; ucIndex < niEMAC_MAC_SRC_MATCH_COUNT; ++ucIndex )
     {
-        FreeRTOS_debug_printf( ( "prvReleaseTxPacket: Failed\n" ) );
+        if( pxSrcMatch->ucSrcMatchCounters[ ucIndex ] > 0U )
+        {
+            prvHAL_ETH_SetDestMACAddrMatch( pxEMACData->xEthHandle.Instance, ucIndex, pxSrcMatch->xSrcMatchAddresses[ ucIndex ].ucBytes );
+        }
     }
 
-    /* TODO: Is it possible for the semaphore and BuffersInUse to get out of sync? */
-
-    /* while( ETH_TX_DESC_CNT - uxQueueMessagesWaiting( ( QueueHandle_t ) xTxDescSem ) > pxEthHandle->TxDescList.BuffersInUse )
-     * {
-     *  ( void ) xSemaphoreGive( xTxDescSem );
-     * } */
+    HAL_ETH_SetHashTable( &pxEMACData->xEthHandle, pxEMACData->xMacFilteringData.xHash.ulHashTable );
 }
 
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                              EMAC Helpers                                 */
+/*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvMacUpdateConfig( ETH_HandleTypeDef * pxEthHandle,
-                                      EthernetPhy_t * pxPhyObject )
+static void prvTakeEthContext( EMACData_t * pxEMACData )
 {
-    BaseType_t xResult = pdFALSE;
-
-    if( pxEthHandle->gState == HAL_ETH_STATE_STARTED )
-    {
-        ( void ) HAL_ETH_Stop_IT( pxEthHandle );
-    }
+    /* Held across every HAL call and PHY access which may end in a callback without a handle */
+    #if ( niEMAC_INSTANCE_COUNT > 1U )
+        ( void ) xSemaphoreTake( xEthContextMutex, portMAX_DELAY );
+    #endif
+    pxActiveEMACData = pxEMACData;
+}
 
-    ETH_MACConfigTypeDef xMACConfig;
-    ( void ) HAL_ETH_GetMACConfig( pxEthHandle, &xMACConfig );
+/*---------------------------------------------------------------------------*/
 
-    #if ipconfigIS_ENABLED( niEMAC_AUTO_NEGOTIATION )
-        ( void ) xPhyStartAutoNegotiation( pxPhyObject, xPhyGetMask( pxPhyObject ) );
+static void prvGiveEthContext( EMACData_t * pxEMACData )
+{
+    #if ( niEMAC_INSTANCE_COUNT > 1U )
+        configASSERT( pxActiveEMACData == pxEMACData );
+        ( void ) xSemaphoreGive( xEthContextMutex );
     #else
-        ( void ) xPhyFixedValue( pxPhyObject, xPhyGetMask( pxPhyObject ) );
+        ( void ) pxEMACData;
     #endif
-    xMACConfig.DuplexMode = ( pxPhyObject->xPhyProperties.ucDuplex == PHY_DUPLEX_FULL ) ? ETH_FULLDUPLEX_MODE : ETH_HALFDUPLEX_MODE;
-    xMACConfig.Speed = ( pxPhyObject->xPhyProperties.ucSpeed == PHY_SPEED_10 ) ? ETH_SPEED_10M : ETH_SPEED_100M;
+}
 
-    if( HAL_ETH_SetMACConfig( pxEthHandle, &xMACConfig ) == HAL_OK )
-    {
-        xResult = pdTRUE;
-    }
+/*---------------------------------------------------------------------------*/
 
-    return xResult;
+static EMACData_t * prvGetEthContext( void )
+{
+    configASSERT( pxActiveEMACData != NULL );
+
+    return pxActiveEMACData;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void prvReleaseNetworkBufferDescriptor( NetworkBufferDescriptor_t * const pxDescriptor )
+static EMACData_t * prvInstanceToData( const ETH_TypeDef * pxEthInstance )
+{
+    EMACData_t * pxEMACData = NULL;
+    UBaseType_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < niEMAC_INSTANCE_COUNT; ++uxIndex )
+    {
+        if( xEMACData[ uxIndex ].xEthHandle.Instance == pxEthInstance )
+        {
+            pxEMACData = &xEMACData[ uxIndex ];
+            break;
+        }
+    }
+
+    configASSERT( pxEMACData != NULL );
+
+    return pxEMACData;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvReleaseTxPacket( ETH_HandleTypeDef * pxEthHandle )
+{
+    /* Only called from the EMAC task, which is the sole owner of the Tx descriptors */
+    #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+        prvGetTxTimestamps( niEMAC_HANDLE_TO_DATA( pxEthHandle ) );
+    #endif
+    ( void ) HAL_ETH_ReleaseTxPacket( pxEthHandle );
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvReclaimTxDescriptors( EMACData_t * pxEMACData )
+{
+    /* Only called with the Tx DMA stopped */
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+    ETH_TxDescListTypeDef * const pxTxDescList = &pxEthHandle->TxDescList;
+    ETH_TypeDef * const pxEthInstance = pxEthHandle->Instance;
+    UBaseType_t uxIndex;
+
+    /* Frames sent before the fault are released as usual, the rest never left */
+    prvReleaseTxPacket( pxEthHandle );
+
+    for( uxIndex = 0U; uxIndex < ( UBaseType_t ) ETH_TX_DESC_CNT; ++uxIndex )
+    {
+        ETH_DMADescTypeDef * const pxTxDesc = ( ETH_DMADescTypeDef * ) pxTxDescList->TxDesc[ uxIndex ];
+
+        if( pxTxDescList->PacketAddress[ uxIndex ] != NULL )
+        {
+            ++pxEMACData->xEMACStats.ulTxDropDmaError;
+            prvReleaseNetworkBufferDescriptor( ( NetworkBufferDescriptor_t * ) pxTxDescList->PacketAddress[ uxIndex ] );
+            pxTxDescList->PacketAddress[ uxIndex ] = NULL;
+        }
+
+        /* As left by HAL_ETH_Init, the chain address is kept */
+        #if defined( niEMAC_STM32FX )
+            pxTxDesc->DESC0 = ETH_DMATXDESC_TCH | ETH_DMATXDESC_CHECKSUMTCPUDPICMPFULL;
+            pxTxDesc->DESC1 = 0U;
+            pxTxDesc->DESC2 = 0U;
+        #elif defined( niEMAC_STM32HX )
+            pxTxDesc->DESC0 = 0U;
+            pxTxDesc->DESC1 = 0U;
+            pxTxDesc->DESC2 = 0U;
+            pxTxDesc->DESC3 = 0U;
+        #endif
+    }
+
+    pxTxDescList->CurTxDesc = 0U;
+    pxTxDescList->BuffersInUse = 0U;
+    pxTxDescList->releaseIndex = 0U;
+
+    #if defined( niEMAC_STM32FX )
+        pxEthInstance->DMATDLAR = ( uint32_t ) pxEthHandle->Init.TxDesc;
+    #elif defined( niEMAC_STM32HX )
+        pxEthInstance->DMACTDLAR = ( uint32_t ) pxEthHandle->Init.TxDesc;
+        pxEthInstance->DMACTDTPR = ( uint32_t ) pxEthHandle->Init.TxDesc;
+    #endif
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvReclaimRxDescriptors( ETH_HandleTypeDef * pxEthHandle )
+{
+    /* Only called with the Rx DMA stopped. Each descriptor keeps its buffer, frames
+     * received but not yet read are dropped, and HAL_ETH_ReadData rebuilds the ring. */
+    ETH_RxDescListTypeDef * const pxRxDescList = &pxEthHandle->RxDescList;
+    ETH_TypeDef * const pxEthInstance = pxEthHandle->Instance;
+    UBaseType_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < ( UBaseType_t ) ETH_RX_DESC_CNT; ++uxIndex )
+    {
+        ETH_DMADescTypeDef * const pxRxDesc = ( ETH_DMADescTypeDef * ) pxRxDescList->RxDesc[ uxIndex ];
+
+        #if defined( niEMAC_STM32FX )
+            pxRxDesc->DESC0 = 0U;
+            pxRxDesc->DESC2 = pxRxDesc->BackupAddr0;
+        #elif defined( niEMAC_STM32HX )
+            pxRxDesc->DESC0 = pxRxDesc->BackupAddr0;
+            pxRxDesc->DESC1 = 0U;
+            pxRxDesc->DESC2 = 0U;
+            pxRxDesc->DESC3 = 0U;
+        #endif
+    }
+
+    if( pxRxDescList->pRxStart != NULL )
+    {
+        /* Frame cut short by the fault */
+        prvReleaseNetworkBufferDescriptor( ( NetworkBufferDescriptor_t * ) pxRxDescList->pRxStart );
+        pxRxDescList->pRxStart = NULL;
+        pxRxDescList->pRxEnd = NULL;
+    }
+
+    pxRxDescList->RxDescIdx = 0U;
+    pxRxDescList->RxDescCnt = 0U;
+    pxRxDescList->RxDataLength = 0U;
+    pxRxDescList->RxBuildDescIdx = 0U;
+    pxRxDescList->RxBuildDescCnt = ETH_RX_DESC_CNT;
+
+    #if defined( niEMAC_STM32FX )
+        pxEthInstance->DMARDLAR = ( uint32_t ) pxEthHandle->Init.RxDesc;
+    #elif defined( niEMAC_STM32HX )
+        pxEthInstance->DMACRDLAR = ( uint32_t ) pxEthHandle->Init.RxDesc;
+    #endif
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvReleaseRxBuffers( ETH_HandleTypeDef * pxEthHandle )
+{
+    ETH_RxDescListTypeDef * const pxRxDescList = &pxEthHandle->RxDescList;
+    UBaseType_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < ( UBaseType_t ) ETH_RX_DESC_CNT; ++uxIndex )
+    {
+        ETH_DMADescTypeDef * const pxRxDesc = ( ETH_DMADescTypeDef * ) pxRxDescList->RxDesc[ uxIndex ];
+
+        if( pxRxDesc->BackupAddr0 != 0U )
+        {
+            prvReleaseNetworkBufferDescriptor( pxPacketBuffer_to_NetworkBuffer( ( const void * ) pxRxDesc->BackupAddr0 ) );
+            pxRxDesc->BackupAddr0 = 0U;
+        }
+    }
+
+    if( pxRxDescList->pRxStart != NULL )
+    {
+        prvReleaseNetworkBufferDescriptor( ( NetworkBufferDescriptor_t * ) pxRxDescList->pRxStart );
+        pxRxDescList->pRxStart = NULL;
+        pxRxDescList->pRxEnd = NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvSendTxQueue( EMACData_t * pxEMACData )
+{
+    ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+    ETH_TxPacketConfig xTxConfig =
+    {
+        .CRCPadCtrl = ETH_CRC_PAD_INSERT,
+        .Attributes = ETH_TX_PACKETS_FEATURES_CRCPAD,
+    };
+
+    #if ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM )
+        xTxConfig.ChecksumCtrl = ETH_CHECKSUM_IPHDR_PAYLOAD_INSERT_PHDR_CALC;
+        xTxConfig.Attributes |= ETH_TX_PACKETS_FEATURES_CSUM;
+    #else
+        xTxConfig.ChecksumCtrl = ETH_CHECKSUM_DISABLE;
+    #endif
+
+    /* Fill every free descriptor from the queue in one pass */
+    while( pxEthHandle->TxDescList.BuffersInUse < ETH_TX_DESC_CNT )
+    {
+        NetworkBufferDescriptor_t * pxDescriptor = pxEMACData->pxTxPending;
+
+        if( pxDescriptor != NULL )
+        {
+            pxEMACData->pxTxPending = NULL;
+        }
+        else if( xQueueReceive( pxEMACData->xTxQueue, &pxDescriptor, 0 ) == pdFALSE )
+        {
+            break;
+        }
+
+        /* The first buffer holds the headers, any following buffers are linked payload */
+        ETH_BufferTypeDef xTxBuffers[ niEMAC_TX_MAX_BUFFERS ];
+        UBaseType_t uxBufferCount = 0U;
+        UBaseType_t uxTxBufferCount = 0U;
+        size_t uxHeaderLength = 0U;
+        const NetworkBufferDescriptor_t * pxCurDescriptor = pxDescriptor;
+
+        xTxConfig.Length = prvGetTxFrameLength( pxDescriptor, &uxBufferCount );
+
+        UBaseType_t uxDescriptorsNeeded = ( uxBufferCount + niEMAC_BUFS_PER_DESC - 1U ) / niEMAC_BUFS_PER_DESC;
+
+        #if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+            xTxConfig.Attributes &= ~ETH_TX_PACKETS_FEATURES_TSO;
+
+            size_t uxTCPHeaderLength = 0U;
+
+            if( pxDescriptor->usTCPSegmentSize != 0U )
+            {
+                uxHeaderLength = prvGetTxHeaderLength( pxDescriptor, &uxTCPHeaderLength );
+            }
+
+            if( uxHeaderLength != 0U )
+            {
+                /* The EMAC cuts the payload into MSS sized frames and completes their headers and checksums */
+                xTxConfig.MaxSegmentSize = pxDescriptor->usTCPSegmentSize;
+                xTxConfig.PayloadLen = xTxConfig.Length - uxHeaderLength;
+                xTxConfig.TCPHeaderLen = uxTCPHeaderLength >> 2;
+                xTxConfig.Attributes |= ETH_TX_PACKETS_FEATURES_TSO;
+
+                /* One more buffer for the split off headers, one more descriptor for the MSS context */
+                uxDescriptorsNeeded = ( ( uxBufferCount + 1U + niEMAC_BUFS_PER_DESC - 1U ) / niEMAC_BUFS_PER_DESC ) + 1U;
+            }
+        #endif /* if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION ) */
+
+        if( ( pxEthHandle->TxDescList.BuffersInUse + uxDescriptorsNeeded ) > ETH_TX_DESC_CNT )
+        {
+            /* Not enough descriptors left for the whole chain, retry on the next Tx completion */
+            pxEMACData->pxTxPending = pxDescriptor;
+            break;
+        }
+
+        UBaseType_t uxIndex;
+
+        for( uxIndex = 0U; uxIndex < uxBufferCount; ++uxIndex )
+        {
+            uint8_t * pucData = pxCurDescriptor->pucEthernetBuffer;
+            size_t uxDataLength = pxCurDescriptor->xDataLength;
+
+            if( ( uxIndex == 0U ) && ( uxHeaderLength != 0U ) )
+            {
+                /* TSO requires the headers in the first buffer of the first descriptor */
+                xTxBuffers[ uxTxBufferCount ].buffer = pucData;
+                xTxBuffers[ uxTxBufferCount ].len = uxHeaderLength;
+                ++uxTxBufferCount;
+                pucData += uxHeaderLength;
+                uxDataLength -= uxHeaderLength;
+            }
+
+            xTxBuffers[ uxTxBufferCount ].buffer = pucData;
+            xTxBuffers[ uxTxBufferCount ].len = uxDataLength;
+            ++uxTxBufferCount;
+
+            #ifdef niEMAC_CACHEABLE
+                if( niEMAC_CACHE_MAINTENANCE != 0 )
+                {
+                    const uintptr_t uxDataStart = ( uintptr_t ) pxCurDescriptor->pucEthernetBuffer;
+                    const uintptr_t uxLineStart = uxDataStart & ~niEMAC_DATA_ALIGNMENT_MASK;
+                    const ptrdiff_t uxDataOffset = uxDataStart - uxLineStart;
+                    const size_t uxLength = pxCurDescriptor->xDataLength + uxDataOffset;
+                    SCB_CleanDCache_by_Addr( ( uint32_t * ) uxLineStart, uxLength );
+                }
+            #endif
+
+            #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+                pxCurDescriptor = pxCurDescriptor->pxNextBuffer;
+            #endif
+        }
+
+        for( uxIndex = 0U; uxIndex < uxTxBufferCount; ++uxIndex )
+        {
+            xTxBuffers[ uxIndex ].next = ( ( uxIndex + 1U ) < uxTxBufferCount ) ? &xTxBuffers[ uxIndex + 1U ] : NULL;
+        }
+
+        /* The whole chain is released through the head descriptor once sent */
+        xTxConfig.pData = pxDescriptor;
+        xTxConfig.TxBuffer = xTxBuffers;
+
+        #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+            /* A TSO super-segment starts with its context descriptor, and is never stamped */
+            prvSetTxTimestamping( pxEthHandle, ( uxHeaderLength == 0U ) ? pxDescriptor : NULL );
+        #endif
+
+        /* The HAL writes the tail pointer for each frame, a batch saves the wake-ups but not the doorbells */
+        if( HAL_ETH_Transmit_IT( pxEthHandle, &xTxConfig ) != HAL_OK )
+        {
+            if( ( pxEthHandle->gState == HAL_ETH_STATE_STARTED ) && ( ( pxEthHandle->ErrorCode & HAL_ETH_ERROR_BUSY ) != 0 ) )
+            {
+                /* Ring is full, retry on the next Tx completion */
+                pxEthHandle->ErrorCode &= ~HAL_ETH_ERROR_BUSY;
+                pxEMACData->pxTxPending = pxDescriptor;
+            }
+            else
+            {
+                ++pxEMACData->xEMACStats.ulTxDropDmaError;
+                FreeRTOS_debug_printf( ( "prvSendTxQueue: Transmit Failed\n" ) );
+                prvReleaseNetworkBufferDescriptor( pxDescriptor );
+            }
+
+            break;
+        }
+
+        if( pxEMACData->xEMACStats.ulTxFrames == 0U )
+        {
+            pxEMACData->xEMACStats.ulBootFirstTxMs = ( uint32_t ) pdTICKS_TO_MS( xTaskGetTickCount() );
+        }
+
+        ++pxEMACData->xEMACStats.ulTxFrames;
+        pxEMACData->xEMACStats.ulTxBytes += ( uint32_t ) xTxConfig.Length;
+        #if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+            ++pxEMACData->uxTxUnsignalled;
+        #endif
+
+        #if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+            if( uxHeaderLength != 0U )
+            {
+                /* The HAL doesn't count the context descriptor as in use, which would
+                 * stop HAL_ETH_ReleaseTxPacket one descriptor short of the frame.
+                 * Only this task touches the Tx descriptors, so no locking is needed. */
+                ++pxEthHandle->TxDescList.BuffersInUse;
+            }
+        #endif
+
+        if( pxEMACData->xEMACStats.ulTxDescHighWater < pxEthHandle->TxDescList.BuffersInUse )
+        {
+            pxEMACData->xEMACStats.ulTxDescHighWater = pxEthHandle->TxDescList.BuffersInUse;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static size_t prvGetTxFrameLength( const NetworkBufferDescriptor_t * const pxDescriptor,
+                                   UBaseType_t * const puxBufferCount )
+{
+    size_t uxLength = 0U;
+    size_t uxMaxLength = niEMAC_DATA_BUFFER_SIZE;
+    UBaseType_t uxCount = 0U;
+    UBaseType_t uxMaxCount = niEMAC_TX_MAX_BUFFERS;
+    const NetworkBufferDescriptor_t * pxCurDescriptor = pxDescriptor;
+
+    #if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+        if( pxDescriptor->usTCPSegmentSize != 0U )
+        {
+            /* The headers of a super-segment are split off into a buffer of their own */
+            uxMaxLength = niEMAC_TSO_MAX_LENGTH;
+            uxMaxCount = niEMAC_TSO_MAX_BUFFERS - 1U;
+        }
+    #endif
+
+    while( pxCurDescriptor != NULL )
+    {
+        if( ( pxCurDescriptor->pucEthernetBuffer == NULL ) || ( pxCurDescriptor->xDataLength == 0U ) || ( uxCount >= uxMaxCount ) )
+        {
+            uxLength = 0U;
+            break;
+        }
+
+        uxLength += pxCurDescriptor->xDataLength;
+        ++uxCount;
+
+        #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+            pxCurDescriptor = pxCurDescriptor->pxNextBuffer;
+        #else
+            pxCurDescriptor = NULL;
+        #endif
+    }
+
+    if( uxLength > uxMaxLength )
+    {
+        uxLength = 0U;
+    }
+
+    if( puxBufferCount != NULL )
+    {
+        *puxBufferCount = uxCount;
+    }
+
+    return uxLength;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION )
+
+    static size_t prvGetTxHeaderLength( const NetworkBufferDescriptor_t * const pxDescriptor,
+                                        size_t * const puxTCPHeaderLength )
+    {
+        const EthernetHeader_t * const pxEthHeader = ( const EthernetHeader_t * const ) pxDescriptor->pucEthernetBuffer;
+        size_t uxIPHeaderLength = 0U;
+
+        if( pxEthHeader->usFrameType == ipIPv4_FRAME_TYPE )
+        {
+            const IPHeader_t * const pxIPHeader = ( const IPHeader_t * const ) &( pxDescriptor->pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER ] );
+            uxIPHeaderLength = ( size_t ) ( ( pxIPHeader->ucVersionHeaderLength & 0x0FU ) << 2 );
+        }
+        else if( pxEthHeader->usFrameType == ipIPv6_FRAME_TYPE )
+        {
+            uxIPHeaderLength = ipSIZE_OF_IPv6_HEADER;
+        }
+
+        size_t uxHeaderLength = 0U;
+
+        if( uxIPHeaderLength != 0U )
+        {
+            const TCPHeader_t * const pxTCPHeader = ( const TCPHeader_t * const ) &( pxDescriptor->pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER + uxIPHeaderLength ] );
+            *puxTCPHeaderLength = ( size_t ) ( ( pxTCPHeader->ucTCPOffset >> 4 ) << 2 );
+            uxHeaderLength = ipSIZE_OF_ETH_HEADER + uxIPHeaderLength + *puxTCPHeaderLength;
+        }
+
+        /* The first buffer must also carry the first segment */
+        if( uxHeaderLength >= pxDescriptor->xDataLength )
+        {
+            uxHeaderLength = 0U;
+        }
+
+        return uxHeaderLength;
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_TCP_SEGMENTATION ) */
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvWaitBitsClear( const volatile uint32_t * pulRegister,
+                                    uint32_t ulMask )
+{
+    BaseType_t xResult = pdFALSE;
+    UBaseType_t uxPolls;
+
+    for( uxPolls = 0U; uxPolls < niEMAC_REG_WAIT_POLLS; ++uxPolls )
+    {
+        if( ( *pulRegister & ulMask ) == 0U )
+        {
+            xResult = pdTRUE;
+            break;
+        }
+    }
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvCountTxDrop( uint32_t * pulCounter )
+{
+    /* Tx drops are counted by the IP-task as well as by the EMAC task */
+    taskENTER_CRITICAL();
+    {
+        ++( *pulCounter );
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvFlushTxQueue( EMACData_t * pxEMACData )
+{
+    NetworkBufferDescriptor_t * pxDescriptor = pxEMACData->pxTxPending;
+
+    pxEMACData->pxTxPending = NULL;
+
+    if( pxDescriptor != NULL )
+    {
+        prvCountTxDrop( &pxEMACData->xEMACStats.ulTxDropLinkDown );
+        prvReleaseNetworkBufferDescriptor( pxDescriptor );
+    }
+
+    while( xQueueReceive( pxEMACData->xTxQueue, &pxDescriptor, 0 ) != pdFALSE )
+    {
+        prvCountTxDrop( &pxEMACData->xEMACStats.ulTxDropLinkDown );
+        prvReleaseNetworkBufferDescriptor( pxDescriptor );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvRefillRxReserve( EMACData_t * pxEMACData )
+{
+    while( uxQueueSpacesAvailable( pxEMACData->xRxReserve ) != 0U )
+    {
+        /* Never wait, whatever is missing is picked up on the next pass of the EMAC task */
+        NetworkBufferDescriptor_t * pxDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_RX_BUFFER_SIZE, 0U );
+
+        if( pxDescriptor == NULL )
+        {
+            break;
+        }
+
+        ipSET_NETWORK_BUFFER_OWNER( pxDescriptor, eNetworkBufferDriverRx );
+        ( void ) xQueueSendToBack( pxEMACData->xRxReserve, &pxDescriptor, 0U );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvMacUpdateConfig( ETH_HandleTypeDef * pxEthHandle,
+                                      EthernetPhy_t * pxPhyObject )
+{
+    if( pxEthHandle->gState == HAL_ETH_STATE_STARTED )
+    {
+        ( void ) HAL_ETH_Stop_IT( pxEthHandle );
+    }
+
+    #if ipconfigIS_ENABLED( niEMAC_AUTO_NEGOTIATION )
+        ( void ) xPhyStartAutoNegotiation( pxPhyObject, xPhyGetMask( pxPhyObject ) );
+    #else
+        ( void ) xPhyFixedValue( pxPhyObject, xPhyGetMask( pxPhyObject ) );
+    #endif
+
+    if( pxPhyObject->ulLinkStatusMask != 0U )
+    {
+        prvLinkSettled( niEMAC_HANDLE_TO_DATA( pxEthHandle ) );
+    }
+
+    return prvMacSetLinkConfig( pxEthHandle, pxPhyObject );
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvMacSetLinkConfig( ETH_HandleTypeDef * pxEthHandle,
+                                       const EthernetPhy_t * pxPhyObject )
+{
+    BaseType_t xResult = pdFALSE;
+    ETH_MACConfigTypeDef xMACConfig;
+
+    ( void ) HAL_ETH_GetMACConfig( pxEthHandle, &xMACConfig );
+    xMACConfig.DuplexMode = ( pxPhyObject->xPhyProperties.ucDuplex == PHY_DUPLEX_FULL ) ? ETH_FULLDUPLEX_MODE : ETH_HALFDUPLEX_MODE;
+    xMACConfig.Speed = ( pxPhyObject->xPhyProperties.ucSpeed == PHY_SPEED_10 ) ? ETH_SPEED_10M : ETH_SPEED_100M;
+
+    if( HAL_ETH_SetMACConfig( pxEthHandle, &xMACConfig ) == HAL_OK )
+    {
+        xResult = pdTRUE;
+    }
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvLinkSettled( EMACData_t * pxEMACData )
+{
+    if( pxEMACData->xLinkWasUp == pdFALSE )
+    {
+        pxEMACData->xLinkWasUp = pdTRUE;
+        pxEMACData->xEMACStats.ulBootLinkUpMs = ( uint32_t ) pdTICKS_TO_MS( xTaskGetTickCount() );
+    }
+
+    #if ipconfigIS_ENABLED( niEMAC_PHY_CACHE )
+        prvPhyCacheSave( pxEMACData );
+    #endif
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvReleaseNetworkBufferDescriptor( NetworkBufferDescriptor_t * const pxDescriptor )
 {
     NetworkBufferDescriptor_t * pxDescriptorToClear = pxDescriptor;
 
-    while( pxDescriptorToClear != NULL )
+    while( pxDescriptorToClear != NULL )
+    {
+        #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+            NetworkBufferDescriptor_t * const pxNext = pxDescriptorToClear->pxNextBuffer;
+        #else
+            NetworkBufferDescriptor_t * const pxNext = NULL;
+        #endif
+        #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+            EMACBufferTimestamp_t * const pxBufferTimestamp = prvGetBufferTimestamp( pxDescriptorToClear );
+
+            if( pxBufferTimestamp != NULL )
+            {
+                pxBufferTimestamp->ucFlags = 0U;
+            }
+        #endif
+        vReleaseNetworkBufferAndDescriptor( pxDescriptorToClear );
+        pxDescriptorToClear = pxNext;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void prvSendRxEvent( NetworkBufferDescriptor_t * const pxDescriptor )
+{
+    const IPStackEvent_t xRxEvent =
+    {
+        .eEventType = eNetworkRxEvent,
+        .pvData     = ( void * ) pxDescriptor
+    };
+
+    ipSET_NETWORK_BUFFER_OWNER( pxDescriptor, eNetworkBufferIPQueue );
+
+    if( xSendEventStructToIPTask( &xRxEvent, pdMS_TO_TICKS( niEMAC_RX_MAX_BLOCK_TIME_MS ) ) != pdPASS )
+    {
+        iptraceETHERNET_RX_EVENT_LOST();
+        FreeRTOS_debug_printf( ( "prvSendRxEvent: xSendEventStructToIPTask failed\n" ) );
+        prvReleaseNetworkBufferDescriptor( pxDescriptor );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvAcceptPacket( EMACData_t * pxEMACData,
+                                   const NetworkBufferDescriptor_t * const pxDescriptor,
+                                   const ETH_DMADescTypeDef * const pxRxDesc,
+                                   uint16_t usLength )
+{
+    BaseType_t xResult = pdFALSE;
+
+    ( void ) pxRxDesc;
+
+    do
+    {
+        if( pxDescriptor == NULL )
+        {
+            ++pxEMACData->xEMACStats.ulRxDropErrors;
+            iptraceETHERNET_RX_EVENT_LOST();
+            FreeRTOS_debug_printf( ( "prvAcceptPacket: Null Descriptor\n" ) );
+            break;
+        }
+
+        if( usLength > pxDescriptor->xDataLength )
+        {
+            ++pxEMACData->xEMACStats.ulRxDropOversize;
+            iptraceETHERNET_RX_EVENT_LOST();
+            FreeRTOS_debug_printf( ( "prvAcceptPacket: Packet size overflow\n" ) );
+            break;
+        }
+
+        ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+        uint32_t ulErrorCode = 0;
+        ( void ) HAL_ETH_GetRxDataErrorCode( pxEthHandle, &ulErrorCode );
+
+        #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING ) && defined( niEMAC_STM32FX )
+            /* With timestamping the HAL's header checksum error bit flags a valid timestamp instead */
+            ulErrorCode &= ~niEMAC_RX_DESC_TSV;
+        #endif
+
+        if( ulErrorCode != 0 )
+        {
+            ++pxEMACData->xEMACStats.ulRxDropErrors;
+            iptraceETHERNET_RX_EVENT_LOST();
+            FreeRTOS_debug_printf( ( "prvAcceptPacket: Rx Data Error\n" ) );
+            break;
+        }
+
+        #if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_FRAME_TYPES )
+            if( eConsiderFrameForProcessing( pxDescriptor->pucEthernetBuffer ) != eProcessBuffer )
+            {
+                ++pxEMACData->xEMACStats.ulRxDropFiltered;
+                iptraceETHERNET_RX_EVENT_LOST();
+                FreeRTOS_debug_printf( ( "prvAcceptPacket: Frame discarded\n" ) );
+                break;
+            }
+        #endif
+
+        #if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
+        {
+            const EthernetHeader_t * const pxEthHeader = ( const EthernetHeader_t * ) pxDescriptor->pucEthernetBuffer;
+            const uint16_t usFrameType = pxEthHeader->usFrameType;
+            BaseType_t xAllow = pdTRUE;
+
+            if( ( usFrameType == ipIPv4_FRAME_TYPE ) || ( usFrameType == ipIPv6_FRAME_TYPE ) )
+            {
+                /* The checksum offload engine has parsed every IP frame, anything it could not is malformed */
+                if( ( pxRxDesc == NULL ) || !niEMAC_RX_DESC_CLASSIFIED( pxRxDesc ) )
+                {
+                    xAllow = pdFALSE;
+                }
+                else
+                {
+                    const uint32_t ulRxClass = niEMAC_RX_DESC_CLASS( pxRxDesc );
+
+                    if( ( ulRxClass & niEMAC_RX_DESC_IP_ERRORS ) != 0U )
+                    {
+                        xAllow = pdFALSE;
+                    }
+
+                    #if ipconfigIS_ENABLED( ipconfigUSE_IPv4 )
+                        else if( ( ulRxClass & ETH_IP_HEADER_IPV4 ) != 0U )
+                        {
+                            xAllow = prvAcceptIPPacketIPv4( pxDescriptor->pucEthernetBuffer, usLength, ulRxClass );
+                        }
+                    #endif
+                    #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
+                        else if( ( ulRxClass & ETH_IP_HEADER_IPV6 ) != 0U )
+                        {
+                            xAllow = prvAcceptIPPacketIPv6( pxDescriptor->pucEthernetBuffer, usLength, ulRxClass );
+                        }
+                    #endif
+                    else
+                    {
+                        /* IP frame type with no usable IP header, or a disabled IP version */
+                        xAllow = pdFALSE;
+                    }
+                }
+            }
+
+            if( xAllow == pdFALSE )
+            {
+                ++pxEMACData->xEMACStats.ulRxDropFiltered;
+                iptraceETHERNET_RX_EVENT_LOST();
+                FreeRTOS_debug_printf( ( "prvAcceptPacket: Packet discarded\n" ) );
+                break;
+            }
+        }
+        #endif /* if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS ) */
+
+        xResult = pdTRUE;
+    } while( pdFALSE );
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_DESC_LOOKUP )
+
+static const ETH_DMADescTypeDef * prvGetRxDescriptor( const ETH_HandleTypeDef * pxEthHandle,
+                                                      const uint8_t * pucBuff )
+{
+    /* HAL_ETH_ReadData only advances RxDescIdx once the whole frame has been linked,
+     * so search forward from it for the descriptor that still owns this buffer */
+    const ETH_DMADescTypeDef * pxRxDesc = NULL;
+    uint32_t ulDescIdx = pxEthHandle->RxDescList.RxDescIdx;
+
+    for( UBaseType_t uxCount = 0; uxCount < ( UBaseType_t ) ETH_RX_DESC_CNT; ++uxCount )
+    {
+        const ETH_DMADescTypeDef * const pxCurDesc = ( const ETH_DMADescTypeDef * ) pxEthHandle->RxDescList.RxDesc[ ulDescIdx ];
+
+        if( pxCurDesc->BackupAddr0 == ( uint32_t ) pucBuff )
+        {
+            pxRxDesc = pxCurDesc;
+            break;
+        }
+
+        ulDescIdx = ( ulDescIdx + 1U ) % ( uint32_t ) ETH_RX_DESC_CNT;
+    }
+
+    return pxRxDesc;
+}
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_DESC_LOOKUP ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_CHAINING )
+
+static NetworkBufferDescriptor_t * prvGatherRxChain( EMACData_t * pxEMACData,
+                                                     NetworkBufferDescriptor_t * const pxFirstDescriptor,
+                                                     size_t uxFrameLength )
+{
+    /* The IP-task parses frames held in a single network buffer, so copy the chain into one */
+    NetworkBufferDescriptor_t * pxDescriptor = NULL;
+
+    if( uxFrameLength > niEMAC_DATA_BUFFER_SIZE )
+    {
+        ++pxEMACData->xEMACStats.ulRxDropOversize;
+        iptraceETHERNET_RX_EVENT_LOST();
+        FreeRTOS_debug_printf( ( "prvGatherRxChain: Packet size overflow\n" ) );
+    }
+    else
+    {
+        pxDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_DATA_BUFFER_SIZE, 0U );
+
+        if( pxDescriptor != NULL )
+        {
+            const NetworkBufferDescriptor_t * pxCurDescriptor = pxFirstDescriptor;
+            size_t uxOffset = 0U;
+
+            while( ( pxCurDescriptor != NULL ) && ( uxOffset < uxFrameLength ) )
+            {
+                const size_t uxCopyLength = FreeRTOS_min_size_t( pxCurDescriptor->xDataLength, uxFrameLength - uxOffset );
+                ( void ) memcpy( &pxDescriptor->pucEthernetBuffer[ uxOffset ], pxCurDescriptor->pucEthernetBuffer, uxCopyLength );
+                uxOffset += uxCopyLength;
+                pxCurDescriptor = pxCurDescriptor->pxNextBuffer;
+            }
+
+            ++pxEMACData->xEMACStats.ulRxChainedFrames;
+        }
+        else
+        {
+            ++pxEMACData->xEMACStats.ulRxChainDropNoBuffer;
+            iptraceETHERNET_RX_EVENT_LOST();
+            FreeRTOS_debug_printf( ( "prvGatherRxChain: No network buffer\n" ) );
+        }
+    }
+
+    prvReleaseNetworkBufferDescriptor( pxFirstDescriptor );
+
+    return pxDescriptor;
+}
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_CHAINING ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK )
+
+static BaseType_t prvIsCopyBreakFrame( const NetworkBufferDescriptor_t * const pxDescriptor )
+{
+    /* The IP-task may reuse a received buffer for a larger reply, as TCP and the name service
+     * responders do. Only UDP datagrams for a bound socket are sure to be handed to the application. */
+    const EthernetHeader_t * const pxEthHeader = ( const EthernetHeader_t * ) pxDescriptor->pucEthernetBuffer;
+    const UDPHeader_t * pxUDPHeader = NULL;
+    BaseType_t xResult = pdFALSE;
+
+    #if ipconfigIS_ENABLED( ipconfigUSE_IPv4 )
+        if( pxEthHeader->usFrameType == ipIPv4_FRAME_TYPE )
+        {
+            const IPHeader_t * const pxIPHeader = &( ( ( const IPPacket_t * ) pxDescriptor->pucEthernetBuffer )->xIPHeader );
+            const size_t uxIPHeaderLength = ( size_t ) ( ( pxIPHeader->ucVersionHeaderLength & 0x0FU ) << 2 );
+
+            if( ( pxDescriptor->xDataLength >= ( ipSIZE_OF_ETH_HEADER + uxIPHeaderLength + ipSIZE_OF_UDP_HEADER ) ) &&
+                ( pxIPHeader->ucProtocol == ipPROTOCOL_UDP ) &&
+                ( ( pxIPHeader->usFragmentOffset & ( ipFRAGMENT_OFFSET_BIT_MASK | ipFRAGMENT_FLAGS_MORE_FRAGMENTS ) ) == 0U ) )
+            {
+                pxUDPHeader = ( const UDPHeader_t * ) &( pxDescriptor->pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER + uxIPHeaderLength ] );
+            }
+        }
+    #endif /* if ipconfigIS_ENABLED( ipconfigUSE_IPv4 ) */
+
+    #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
+        if( pxEthHeader->usFrameType == ipIPv6_FRAME_TYPE )
+        {
+            const IPHeader_IPv6_t * const pxIPv6Header = &( ( ( const IPPacket_IPv6_t * ) pxDescriptor->pucEthernetBuffer )->xIPHeader );
+
+            if( ( pxDescriptor->xDataLength >= ( ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv6_HEADER + ipSIZE_OF_UDP_HEADER ) ) &&
+                ( pxIPv6Header->ucNextHeader == ipPROTOCOL_UDP ) )
+            {
+                pxUDPHeader = ( const UDPHeader_t * ) &( pxDescriptor->pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv6_HEADER ] );
+            }
+        }
+    #endif /* if ipconfigIS_ENABLED( ipconfigUSE_IPv6 ) */
+
+    if( pxUDPHeader != NULL )
+    {
+        xResult = xPortHasUDPSocket( pxUDPHeader->usDestinationPort );
+    }
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static NetworkBufferDescriptor_t * prvRxCopyBreak( EMACData_t * pxEMACData,
+                                                   NetworkBufferDescriptor_t * const pxDescriptor )
+{
+    NetworkBufferDescriptor_t * pxResult = pxDescriptor;
+    const size_t uxLength = pxDescriptor->xDataLength;
+
+    do
+    {
+        if( ( uxLength > ( size_t ) pxEMACData->uxRxCopyBreak ) || ( prvIsCopyBreakFrame( pxDescriptor ) == pdFALSE ) )
+        {
+            break;
+        }
+
+        #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+            /* The timestamp is held against the large buffer */
+            const EMACBufferTimestamp_t * const pxBufferTimestamp = prvGetBufferTimestamp( pxDescriptor );
+
+            if( ( pxBufferTimestamp != NULL ) && ( ( pxBufferTimestamp->ucFlags & niEMAC_BUF_RX_TIMESTAMP ) != 0U ) )
+            {
+                break;
+            }
+        #endif
+
+        NetworkBufferDescriptor_t * const pxSmallDescriptor = pxGetSmallNetworkBufferWithDescriptor( uxLength );
+
+        if( pxSmallDescriptor == NULL )
+        {
+            ++pxEMACData->xEMACStats.ulRxCopyBreakNoBuffer;
+            break;
+        }
+
+        ( void ) memcpy( pxSmallDescriptor->pucEthernetBuffer, pxDescriptor->pucEthernetBuffer, uxLength );
+        pxSmallDescriptor->xDataLength = uxLength;
+
+        /* The next refill of the Rx descriptors picks the large buffer up again */
+        prvReleaseNetworkBufferDescriptor( pxDescriptor );
+        pxResult = pxSmallDescriptor;
+        ++pxEMACData->xEMACStats.ulRxCopyBreakFrames;
+    } while( pdFALSE );
+
+    return pxResult;
+}
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvAcceptUDPPort( uint16_t usDestinationPort,
+                                    uint16_t usSourcePort )
+{
+    BaseType_t xResult = xPortHasUDPSocket( usDestinationPort );
+
+    /* Mirror the protocols xProcessReceivedUDPPacket handles without a socket */
+    if( xResult == pdFALSE )
+    {
+        #if ipconfigIS_ENABLED( ipconfigUSE_DNS ) && ipconfigIS_ENABLED( ipconfigDNS_USE_CALLBACKS )
+            if( usSourcePort == FreeRTOS_htons( ipDNS_PORT ) )
+            {
+                xResult = pdTRUE;
+            }
+        #endif
+
+        #if ipconfigIS_ENABLED( ipconfigUSE_DNS ) && ipconfigIS_ENABLED( ipconfigUSE_LLMNR )
+            if( ( usDestinationPort == FreeRTOS_htons( ipLLMNR_PORT ) ) || ( usSourcePort == FreeRTOS_htons( ipLLMNR_PORT ) ) )
+            {
+                xResult = pdTRUE;
+            }
+        #endif
+
+        #if ipconfigIS_ENABLED( ipconfigUSE_DNS ) && ipconfigIS_ENABLED( ipconfigUSE_MDNS )
+            if( ( usDestinationPort == FreeRTOS_htons( ipMDNS_PORT ) ) || ( usSourcePort == FreeRTOS_htons( ipMDNS_PORT ) ) )
+            {
+                xResult = pdTRUE;
+            }
+        #endif
+
+        #if ipconfigIS_ENABLED( ipconfigUSE_DNS ) && ipconfigIS_ENABLED( ipconfigUSE_NBNS )
+            if( ( usDestinationPort == FreeRTOS_htons( ipNBNS_PORT ) ) || ( usSourcePort == FreeRTOS_htons( ipNBNS_PORT ) ) )
+            {
+                xResult = pdTRUE;
+            }
+        #endif
+    }
+
+    ( void ) usSourcePort;
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( ipconfigUSE_TCP )
+
+    static BaseType_t prvAcceptTCPSegment( uint16_t usDestinationPort,
+                                           uint8_t ucTCPFlags )
+    {
+        BaseType_t xResult = xPortHasTCPSocket( usDestinationPort );
+
+        /* Without a socket the IP-task would only answer with a RST, which it never
+         * does for a RST, a lone ACK, or when ipconfigIGNORE_UNKNOWN_PACKETS is set */
+        if( ( xResult == pdFALSE ) &&
+            ipconfigIS_DISABLED( ipconfigIGNORE_UNKNOWN_PACKETS ) &&
+            ( ( ucTCPFlags & tcpTCP_FLAG_CTRL ) != tcpTCP_FLAG_ACK ) &&
+            ( ( ucTCPFlags & tcpTCP_FLAG_RST ) == 0U ) )
+        {
+            xResult = pdTRUE;
+        }
+
+        return xResult;
+    }
+
+#endif /* if ipconfigIS_ENABLED( ipconfigUSE_TCP ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( ipconfigUSE_IPv4 )
+
+    static BaseType_t prvAcceptIPPacketIPv4( const uint8_t * pucEthernetBuffer,
+                                             uint16_t usLength,
+                                             uint32_t ulRxClass )
+    {
+        /* Same checks as prvAllowIPPacketIPv4, which the IP-task skips when the driver filters packets */
+        const IPPacket_t * const pxIPPacket = ( const IPPacket_t * ) pucEthernetBuffer;
+        const IPHeader_t * const pxIPHeader = &( pxIPPacket->xIPHeader );
+        const uint32_t ulDestinationIPAddress = pxIPHeader->ulDestinationIPAddress;
+        const uint32_t ulSourceIPAddress = pxIPHeader->ulSourceIPAddress;
+        const size_t uxIPHeaderLength = ( size_t ) ( ( pxIPHeader->ucVersionHeaderLength & 0x0FU ) << 2 );
+        const uint8_t * const pucProtocol = &( pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER + uxIPHeaderLength ] );
+        BaseType_t xResult = pdFALSE;
+
+        do
+        {
+            if( usLength < ( ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv4_HEADER ) )
+            {
+                break;
+            }
+
+            if( ( pxIPHeader->ucVersionHeaderLength < ipIPV4_VERSION_HEADER_LENGTH_MIN ) ||
+                ( pxIPHeader->ucVersionHeaderLength > ipIPV4_VERSION_HEADER_LENGTH_MAX ) )
+            {
+                break;
+            }
+
+            /* Fragments are not supported by the stack */
+            if( ( pxIPHeader->usFragmentOffset & ( ipFRAGMENT_OFFSET_BIT_MASK | ipFRAGMENT_FLAGS_MORE_FRAGMENTS ) ) != 0U )
+            {
+                break;
+            }
+
+            if( ( ( xIsIPv4Loopback( ulDestinationIPAddress ) == pdTRUE ) || ( xIsIPv4Loopback( ulSourceIPAddress ) == pdTRUE ) ) &&
+                ( xBadIPv4Loopback( pxIPHeader ) == pdTRUE ) )
+            {
+                break;
+            }
+
+            /* Not for this node, unless broadcast, multicast, or still waiting on DHCP */
+            if( ( FreeRTOS_FindEndPointOnIP_IPv4( ulDestinationIPAddress, 4 ) == NULL ) &&
+                ( ( FreeRTOS_ntohl( ulDestinationIPAddress ) & 0xFFU ) != 0xFFU ) &&
+                ( xIsIPv4Multicast( ulDestinationIPAddress ) == pdFALSE ) &&
+                ( FreeRTOS_IsNetworkUp() != pdFALSE ) )
+            {
+                break;
+            }
+
+            if( ( ( FreeRTOS_ntohl( ulSourceIPAddress ) & 0xFFU ) == 0xFFU ) ||
+                ( xIsIPv4Multicast( ulSourceIPAddress ) == pdTRUE ) )
+            {
+                break;
+            }
+
+            if( memcmp( xBroadcastMACAddress.ucBytes, pxIPPacket->xEthernetHeader.xSourceAddress.ucBytes, sizeof( MACAddress_t ) ) == 0 )
+            {
+                break;
+            }
+
+            if( ( memcmp( xBroadcastMACAddress.ucBytes, pxIPPacket->xEthernetHeader.xDestinationAddress.ucBytes, sizeof( MACAddress_t ) ) == 0 ) &&
+                ( ( FreeRTOS_ntohl( ulDestinationIPAddress ) & 0xFFU ) != 0xFFU ) )
+            {
+                break;
+            }
+
+            switch( ulRxClass & ETH_IP_PAYLOAD_MASK )
+            {
+                case ETH_IP_PAYLOAD_UDP:
+
+                    if( usLength >= ( ipSIZE_OF_ETH_HEADER + uxIPHeaderLength + ipSIZE_OF_UDP_HEADER ) )
+                    {
+                        const UDPHeader_t * const pxUDPHeader = ( const UDPHeader_t * ) pucProtocol;
+                        xResult = prvAcceptUDPPort( pxUDPHeader->usDestinationPort, pxUDPHeader->usSourcePort );
+                    }
+
+                    break;
+
+                #if ipconfigIS_ENABLED( ipconfigUSE_TCP )
+                    case ETH_IP_PAYLOAD_TCP:
+
+                        if( usLength >= ( ipSIZE_OF_ETH_HEADER + uxIPHeaderLength + ipSIZE_OF_TCP_HEADER ) )
+                        {
+                            const TCPHeader_t * const pxTCPHeader = ( const TCPHeader_t * ) pucProtocol;
+                            xResult = prvAcceptTCPSegment( pxTCPHeader->usDestinationPort, pxTCPHeader->ucTCPFlags );
+                        }
+
+                        break;
+                #endif /* if ipconfigIS_ENABLED( ipconfigUSE_TCP ) */
+
+                case ETH_IP_PAYLOAD_ICMPN:
+
+                    /* ProcessICMPPacket only handles echo requests and replies */
+                    if( usLength >= ( ipSIZE_OF_ETH_HEADER + uxIPHeaderLength + ipSIZE_OF_ICMPv4_HEADER ) )
+                    {
+                        const ICMPHeader_t * const pxICMPHeader = ( const ICMPHeader_t * ) pucProtocol;
+
+                        if( pxICMPHeader->ucTypeOfMessage == ipICMP_ECHO_REQUEST )
+                        {
+                            xResult = ( BaseType_t ) ipconfigIS_ENABLED( ipconfigREPLY_TO_INCOMING_PINGS );
+                        }
+                        else if( pxICMPHeader->ucTypeOfMessage == ipICMP_ECHO_REPLY )
+                        {
+                            xResult = ( BaseType_t ) ipconfigIS_ENABLED( ipconfigSUPPORT_OUTGOING_PINGS );
+                        }
+                    }
+
+                    break;
+
+                default:
+                    /* The stack only handles UDP, TCP and ICMP over IPv4 */
+                    break;
+            }
+        } while( pdFALSE );
+
+        return xResult;
+    }
+
+#endif /* if ipconfigIS_ENABLED( ipconfigUSE_IPv4 ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
+
+    static BaseType_t prvAcceptIPPacketIPv6( const uint8_t * pucEthernetBuffer,
+                                             uint16_t usLength,
+                                             uint32_t ulRxClass )
+    {
+        /* Same checks as prvAllowIPPacketIPv6, which the IP-task skips when the driver filters packets */
+        const IPHeader_IPv6_t * const pxIPv6Header = ( const IPHeader_IPv6_t * ) &( pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER ] );
+        const IPv6_Address_t * const pxDestinationIPAddress = &( pxIPv6Header->xDestinationAddress );
+        const IPv6_Address_t * const pxSourceIPAddress = &( pxIPv6Header->xSourceAddress );
+        const uint8_t * const pucProtocol = &( pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv6_HEADER ] );
+        BaseType_t xResult = pdFALSE;
+
+        do
+        {
+            if( usLength < ( ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv6_HEADER ) )
+            {
+                break;
+            }
+
+            if( ( memcmp( pxDestinationIPAddress->ucBytes, FreeRTOS_in6addr_any.ucBytes, sizeof( IPv6_Address_t ) ) == 0 ) ||
+                ( memcmp( pxSourceIPAddress->ucBytes, FreeRTOS_in6addr_any.ucBytes, sizeof( IPv6_Address_t ) ) == 0 ) )
+            {
+                break;
+            }
+
+            if( FreeRTOS_FindEndPointOnIP_IPv6( pxDestinationIPAddress ) == NULL )
+            {
+                /* The local loopback address must never appear outside a host */
+                if( ( xIsIPv6Loopback( pxDestinationIPAddress ) != pdFALSE ) || ( xIsIPv6Loopback( pxSourceIPAddress ) != pdFALSE ) )
+                {
+                    break;
+                }
+
+                if( ( xIsIPv6AllowedMulticast( pxDestinationIPAddress ) == pdFALSE ) && ( FreeRTOS_IsNetworkUp() != pdFALSE ) )
+                {
+                    break;
+                }
+            }
+
+            /* The payload type may be behind extension headers, only ports directly after the header are checked */
+            switch( ulRxClass & ETH_IP_PAYLOAD_MASK )
+            {
+                case ETH_IP_PAYLOAD_UDP:
+
+                    if( pxIPv6Header->ucNextHeader == ipPROTOCOL_UDP )
+                    {
+                        const UDPHeader_t * const pxUDPHeader = ( const UDPHeader_t * ) pucProtocol;
+
+                        if( usLength >= ( ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv6_HEADER + ipSIZE_OF_UDP_HEADER ) )
+                        {
+                            xResult = prvAcceptUDPPort( pxUDPHeader->usDestinationPort, pxUDPHeader->usSourcePort );
+                        }
+                    }
+                    else
+                    {
+                        xResult = pdTRUE;
+                    }
+
+                    break;
+
+                #if ipconfigIS_ENABLED( ipconfigUSE_TCP )
+                    case ETH_IP_PAYLOAD_TCP:
+
+                        if( pxIPv6Header->ucNextHeader == ipPROTOCOL_TCP )
+                        {
+                            const TCPHeader_t * const pxTCPHeader = ( const TCPHeader_t * ) pucProtocol;
+
+                            if( usLength >= ( ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv6_HEADER + ipSIZE_OF_TCP_HEADER ) )
+                            {
+                                xResult = prvAcceptTCPSegment( pxTCPHeader->usDestinationPort, pxTCPHeader->ucTCPFlags );
+                            }
+                        }
+                        else
+                        {
+                            xResult = pdTRUE;
+                        }
+
+                        break;
+                #endif /* if ipconfigIS_ENABLED( ipconfigUSE_TCP ) */
+
+                default:
+                    /* ICMPv6 carries neighbour discovery, and unknown payloads may be behind extension headers */
+                    xResult = pdTRUE;
+                    break;
+            }
+        } while( pdFALSE );
+
+        return xResult;
+    }
+
+#endif /* if ipconfigIS_ENABLED( ipconfigUSE_IPv6 ) */
+
+#endif /* if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+
+    static uint32_t prvRxWatchdogCount( uint32_t ulDelayUs )
+    {
+        const uint32_t ulCyclesPerUs = HAL_RCC_GetHCLKFreq() / 1000000U;
+        uint32_t ulCount = ( ( ulDelayUs * ulCyclesPerUs ) + niEMAC_RX_WATCHDOG_UNIT - 1U ) / niEMAC_RX_WATCHDOG_UNIT;
+
+        /* Never zero, descriptors armed without an interrupt must still be signalled */
+        if( ulCount == 0U )
+        {
+            ulCount = 1U;
+        }
+        else if( ulCount > niEMAC_RX_WATCHDOG_MAX )
+        {
+            ulCount = niEMAC_RX_WATCHDOG_MAX;
+        }
+
+        return ulCount;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvSetRxModeration( EMACData_t * pxEMACData )
+    {
+        ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+        const uint32_t ulDelayUs = pxEMACData->xRxModerationStatus.ulDelayUs;
+
+        /* The watchdog is programmed before descriptors stop raising their own interrupt,
+         * and kept running afterwards for the descriptors that were armed without one.
+         * ItMode only affects descriptors as they are given back to the DMA, so the
+         * change takes effect over one revolution of the Rx ring. */
+        niEMAC_RX_WATCHDOG_REG( pxEthHandle->Instance ) = prvRxWatchdogCount( ulDelayUs );
+        pxEthHandle->RxDescList.ItMode = ( ulDelayUs == 0U ) ? 1U : 0U;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvUpdateRxModeration( EMACData_t * pxEMACData,
+                                       UBaseType_t uxFrameCount )
+    {
+        EMACRxModerationStatus_t * const pxStatus = &pxEMACData->xRxModerationStatus;
+        EMACRxModeration_t xModeration;
+
+        taskENTER_CRITICAL();
+        {
+            xModeration = pxEMACData->xRxModeration;
+        }
+        taskEXIT_CRITICAL();
+
+        pxStatus->ulRxFrames += uxFrameCount;
+
+        uint32_t ulDelayUs = pxStatus->ulDelayUs;
+
+        if( xModeration.ulFrameThreshold == 0U )
+        {
+            ulDelayUs = 0U;
+        }
+        else if( uxFrameCount >= xModeration.ulFrameThreshold )
+        {
+            /* Under load, trade latency for fewer interrupts */
+            ulDelayUs += xModeration.ulStepUs;
+
+            if( ulDelayUs > xModeration.ulMaxDelayUs )
+            {
+                ulDelayUs = xModeration.ulMaxDelayUs;
+            }
+        }
+        else if( uxFrameCount < ( xModeration.ulFrameThreshold / 2U ) )
+        {
+            /* Load has gone, return towards one interrupt per frame */
+            ulDelayUs = ( ulDelayUs > xModeration.ulStepUs ) ? ( ulDelayUs - xModeration.ulStepUs ) : 0U;
+        }
+
+        if( ulDelayUs != pxStatus->ulDelayUs )
+        {
+            pxStatus->ulDelayUs = ulDelayUs;
+
+            if( pxEMACData->xEthHandle.gState == HAL_ETH_STATE_STARTED )
+            {
+                prvSetRxModeration( pxEMACData );
+            }
+        }
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_MODERATION ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+
+    static void prvSetRxPolling( EMACData_t * pxEMACData,
+                                 BaseType_t xPolling )
+    {
+        ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+
+        /* DMA interrupt enables are shared with the ISR's error handling */
+        taskENTER_CRITICAL();
+        {
+            if( xPolling != pdFALSE )
+            {
+                __HAL_ETH_DMA_DISABLE_IT( pxEthHandle, ETH_DMA_RX_IT );
+            }
+            else
+            {
+                __HAL_ETH_DMA_ENABLE_IT( pxEthHandle, ETH_DMA_RX_IT );
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        pxEMACData->xRxPolling = xPolling;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    /* Reads the ring once more while it is polled, and switches between the two modes. uxRxCount holds
+     * the frames this pass of the EMAC task has read so far, the return value adds the polled ones. */
+    static UBaseType_t prvPollRx( EMACData_t * pxEMACData,
+                                  NetworkInterface_t * pxInterface,
+                                  UBaseType_t uxRxCount )
+    {
+        const UBaseType_t uxBudget = pxEMACData->uxRxPollBudget;
+        UBaseType_t uxPassCount = uxRxCount;
+
+        if( pxEMACData->xRxPolling != pdFALSE )
+        {
+            ++pxEMACData->xRxPollStatus.ulPollPasses;
+            const UBaseType_t uxPolled = prvNetworkInterfaceInput( pxEMACData, pxInterface, uxBudget );
+            uxPassCount += uxPolled;
+
+            /* Short of the budget, HAL_ETH_ReadData found the ring empty */
+            pxEMACData->xRxBacklog = ( uxPolled >= uxBudget ) ? pdTRUE : pdFALSE;
+
+            if( pxEMACData->xRxBacklog != pdFALSE )
+            {
+                ++pxEMACData->xRxPollStatus.ulBudgetExhausted;
+            }
+            else if( uxPassCount < uxBudget )
+            {
+                /* Ring ran dry. A frame completed since the last read left RI pending,
+                 * so it interrupts as soon as the interrupt is unmasked. */
+                prvSetRxPolling( pxEMACData, pdFALSE );
+            }
+        }
+        else if( uxPassCount >= uxBudget )
+        {
+            /* Burst detected, stop taking an interrupt per frame and poll the ring straight away */
+            prvSetRxPolling( pxEMACData, pdTRUE );
+            pxEMACData->xRxBacklog = pdTRUE;
+        }
+
+        return uxPassCount;
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_POLLING ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_TX_COALESCING )
+
+    static void prvSetTxInterrupt( EMACData_t * pxEMACData,
+                                   BaseType_t xEnable )
+    {
+        ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+
+        /* DMA interrupt enables are shared with the ISR's error handling. A completion
+         * while masked leaves TI pending, so it interrupts as soon as it is unmasked. */
+        taskENTER_CRITICAL();
+        {
+            if( xEnable != pdFALSE )
+            {
+                __HAL_ETH_DMA_ENABLE_IT( pxEthHandle, ETH_DMA_TX_IT );
+            }
+            else
+            {
+                __HAL_ETH_DMA_DISABLE_IT( pxEthHandle, ETH_DMA_TX_IT );
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        pxEMACData->xTxIrqEnabled = xEnable;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvCoalesceTx( EMACData_t * pxEMACData,
+                               uint32_t ulISREvents )
+    {
+        ETH_HandleTypeDef * pxEthHandle = &pxEMACData->xEthHandle;
+
+        if( pxEthHandle->gState == HAL_ETH_STATE_STARTED )
+        {
+            if( ( ( ulISREvents & eMacEventTx ) != 0U ) && ( pxEMACData->xTxIrqEnabled != pdFALSE ) )
+            {
+                /* The interrupt asked for has been taken */
+                prvSetTxInterrupt( pxEMACData, pdFALSE );
+            }
+
+            if( ( pxEMACData->xTxIrqEnabled == pdFALSE ) && ( pxEthHandle->TxDescList.BuffersInUse != 0U ) )
+            {
+                /* Collect every completion in one pass, whatever woke the task */
+                prvReleaseTxPacket( pxEthHandle );
+                prvSendTxQueue( pxEMACData );
+            }
+
+            if( ( pxEMACData->uxTxUnsignalled >= niEMAC_TX_COALESCE_FRAMES ) || ( pxEMACData->pxTxPending != NULL ) ||
+                ( uxQueueMessagesWaiting( pxEMACData->xTxQueue ) != 0U ) )
+            {
+                /* Enough frames went out unsignalled, or frames wait for room in the ring */
+                pxEMACData->uxTxUnsignalled = 0U;
+
+                if( pxEMACData->xTxIrqEnabled == pdFALSE )
+                {
+                    prvSetTxInterrupt( pxEMACData, pdTRUE );
+                }
+            }
+        }
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_TX_COALESCING ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+
+    static BaseType_t prvInitTimestamping( EMACData_t * pxEMACData )
+    {
+        BaseType_t xResult;
+        ETH_TypeDef * const pxEthInstance = pxEMACData->xEthHandle.Instance;
+        const uint32_t ulHclkFreq = HAL_RCC_GetHCLKFreq();
+
+        /* Leaves room above the nominal addend for the frequency trim */
+        configASSERT( ulHclkFreq >= ( 2U * niEMAC_PTP_CLOCK_HZ ) );
+
+        /* The accumulator overflows, and the sub-second counter steps, at niEMAC_PTP_CLOCK_HZ */
+        pxEMACData->ulTimestampAddend = ( uint32_t ) ( ( ( uint64_t ) niEMAC_PTP_CLOCK_HZ << 32U ) / ulHclkFreq );
+
+        /* Fine update, sub-seconds counted in nanoseconds, every received frame stamped */
+        #if defined( niEMAC_STM32FX )
+            pxEthInstance->PTPTSCR = ETH_PTPTSCR_TSE | ETH_PTPTSCR_TSFCU | ETH_PTPTSCR_TSSSR | ETH_PTPTSCR_TSSARFE;
+            pxEthInstance->PTPSSIR = niEMAC_NS_PER_SECOND / niEMAC_PTP_CLOCK_HZ;
+        #elif defined( niEMAC_STM32HX )
+            pxEthInstance->MACTSCR = ETH_MACTSCR_TSENA | ETH_MACTSCR_TSCFUPDT | ETH_MACTSCR_TSCTRLSSR | ETH_MACTSCR_TSENALL;
+            pxEthInstance->MACSSIR = ( niEMAC_NS_PER_SECOND / niEMAC_PTP_CLOCK_HZ ) << 16U;
+        #endif
+
+        /* A trim set before a recovery reset is kept */
+        xResult = prvSetClockFrequency( pxEMACData, pxEMACData->lFrequencyPpb );
+
+        /* The clock starts from zero, the next exchange steps it to the master's time */
+        if( xResult != pdFALSE )
+        {
+            #if defined( niEMAC_STM32FX )
+                pxEthInstance->PTPTSHUR = 0U;
+                pxEthInstance->PTPTSLUR = 0U;
+                pxEthInstance->PTPTSCR |= ETH_PTPTSCR_TSSTI;
+                xResult = prvWaitBitsClear( &pxEthInstance->PTPTSCR, ETH_PTPTSCR_TSSTI );
+            #elif defined( niEMAC_STM32HX )
+                pxEthInstance->MACSTSUR = 0U;
+                pxEthInstance->MACSTNUR = 0U;
+                pxEthInstance->MACTSCR |= ETH_MACTSCR_TSINIT;
+                xResult = prvWaitBitsClear( &pxEthInstance->MACTSCR, ETH_MACTSCR_TSINIT );
+            #endif
+        }
+
+        return xResult;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static BaseType_t prvSetClockFrequency( EMACData_t * pxEMACData,
+                                            int32_t lFrequencyPpb )
+    {
+        BaseType_t xResult;
+        ETH_TypeDef * const pxEthInstance = pxEMACData->xEthHandle.Instance;
+        const int64_t llAddend = ( int64_t ) pxEMACData->ulTimestampAddend;
+        const uint32_t ulAddend = ( uint32_t ) ( llAddend + ( ( llAddend * lFrequencyPpb ) / ( int64_t ) niEMAC_NS_PER_SECOND ) );
+
+        /* The addend register must not be written until the previous update has been taken */
+        #if defined( niEMAC_STM32FX )
+            xResult = prvWaitBitsClear( &pxEthInstance->PTPTSCR, ETH_PTPTSCR_TSARU );
+
+            if( xResult != pdFALSE )
+            {
+                pxEthInstance->PTPTSAR = ulAddend;
+                pxEthInstance->PTPTSCR |= ETH_PTPTSCR_TSARU;
+            }
+        #elif defined( niEMAC_STM32HX )
+            xResult = prvWaitBitsClear( &pxEthInstance->MACTSCR, ETH_MACTSCR_TSADDREG );
+
+            if( xResult != pdFALSE )
+            {
+                pxEthInstance->MACTSAR = ulAddend;
+                pxEthInstance->MACTSCR |= ETH_MACTSCR_TSADDREG;
+            }
+        #endif
+
+        if( xResult != pdFALSE )
+        {
+            pxEMACData->lFrequencyPpb = lFrequencyPpb;
+        }
+
+        return xResult;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static BaseType_t prvUpdateTime( ETH_TypeDef * const pxEthInstance,
+                                     int64_t llOffsetNs )
+    {
+        BaseType_t xResult;
+        int64_t llSeconds = llOffsetNs / ( int64_t ) niEMAC_NS_PER_SECOND;
+        int64_t llNanoseconds = llOffsetNs % ( int64_t ) niEMAC_NS_PER_SECOND;
+
+        if( llNanoseconds < 0 )
+        {
+            /* Always added, a negative offset borrows a second which the nanosecond carry gives back */
+            llNanoseconds += ( int64_t ) niEMAC_NS_PER_SECOND;
+            --llSeconds;
+        }
+
+        /* Negative seconds wrap around modulo 2^32, just like the seconds counter */
+        #if defined( niEMAC_STM32FX )
+            xResult = prvWaitBitsClear( &pxEthInstance->PTPTSCR, ETH_PTPTSCR_TSSTU );
+
+            if( xResult != pdFALSE )
+            {
+                pxEthInstance->PTPTSHUR = ( uint32_t ) llSeconds;
+                pxEthInstance->PTPTSLUR = ( uint32_t ) llNanoseconds;
+                pxEthInstance->PTPTSCR |= ETH_PTPTSCR_TSSTU;
+            }
+        #elif defined( niEMAC_STM32HX )
+            xResult = prvWaitBitsClear( &pxEthInstance->MACTSCR, ETH_MACTSCR_TSUPDT );
+
+            if( xResult != pdFALSE )
+            {
+                pxEthInstance->MACSTSUR = ( uint32_t ) llSeconds;
+                pxEthInstance->MACSTNUR = ( uint32_t ) llNanoseconds;
+                pxEthInstance->MACTSCR |= ETH_MACTSCR_TSUPDT;
+            }
+        #endif
+
+        return xResult;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static EMACBufferTimestamp_t * prvGetBufferTimestamp( const NetworkBufferDescriptor_t * const pxDescriptor )
+    {
+        EMACBufferTimestamp_t * pxBufferTimestamp = NULL;
+
+        if( ( pxNetworkBufferPool != NULL ) && ( pxDescriptor >= pxNetworkBufferPool ) && ( pxDescriptor < &pxNetworkBufferPool[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ] ) )
+        {
+            pxBufferTimestamp = &xBufferTimestamps[ pxDescriptor - pxNetworkBufferPool ];
+        }
+
+        return pxBufferTimestamp;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvSetTxTimestamping( ETH_HandleTypeDef * pxEthHandle,
+                                      const NetworkBufferDescriptor_t * const pxDescriptor )
+    {
+        /* Called just before HAL_ETH_Transmit_IT, which fills the descriptors from CurTxDesc on */
+        ETH_DMADescTypeDef * const pxTxDesc = ( ETH_DMADescTypeDef * ) pxEthHandle->TxDescList.TxDesc[ pxEthHandle->TxDescList.CurTxDesc ];
+        const EMACBufferTimestamp_t * const pxBufferTimestamp = ( pxDescriptor != NULL ) ? prvGetBufferTimestamp( pxDescriptor ) : NULL;
+
+        /* The HAL leaves the bit of an earlier frame in place, so it is written for every frame */
+        if( ( pxBufferTimestamp != NULL ) && ( ( pxBufferTimestamp->ucFlags & niEMAC_BUF_TX_TIMESTAMP ) != 0U ) )
+        {
+            #if defined( niEMAC_STM32FX )
+                SET_BIT( pxTxDesc->DESC0, ETH_DMATXDESC_TTSE );
+            #elif defined( niEMAC_STM32HX )
+                SET_BIT( pxTxDesc->DESC2, ETH_DMATXNDESCRF_TTSE );
+            #endif
+        }
+        else
+        {
+            #if defined( niEMAC_STM32FX )
+                CLEAR_BIT( pxTxDesc->DESC0, ETH_DMATXDESC_TTSE );
+            #elif defined( niEMAC_STM32HX )
+                CLEAR_BIT( pxTxDesc->DESC2, ETH_DMATXNDESCRF_TTSE );
+            #endif
+        }
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvGetTxTimestamps( EMACData_t * pxEMACData )
+    {
+        const ETH_TxDescListTypeDef * const pxTxDescList = &pxEMACData->xEthHandle.TxDescList;
+        uint32_t ulDescIdx = pxTxDescList->releaseIndex;
+        uint32_t ulCount;
+
+        /* Walks the frames HAL_ETH_ReleaseTxPacket is about to release, the stamp is
+         * written back to the descriptor holding the frame's packet address */
+        for( ulCount = pxTxDescList->BuffersInUse; ulCount != 0U; --ulCount )
+        {
+            const ETH_DMADescTypeDef * const pxTxDesc = ( const ETH_DMADescTypeDef * ) pxTxDescList->TxDesc[ ulDescIdx ];
+
+            if( pxTxDescList->PacketAddress[ ulDescIdx ] != NULL )
+            {
+                if( niEMAC_TX_DESC_OWNED( pxTxDesc ) )
+                {
+                    break;
+                }
+
+                if( niEMAC_TX_DESC_TIMESTAMPED( pxTxDesc ) )
+                {
+                    taskENTER_CRITICAL();
+                    {
+                        #if defined( niEMAC_STM32FX )
+                            pxEMACData->xTxTimestamp.ulSeconds = pxTxDesc->DESC7;
+                            pxEMACData->xTxTimestamp.ulNanoseconds = pxTxDesc->DESC6 & niEMAC_TIMESTAMP_NS_MASK;
+                        #elif defined( niEMAC_STM32HX )
+                            pxEMACData->xTxTimestamp.ulSeconds = pxTxDesc->DESC1;
+                            pxEMACData->xTxTimestamp.ulNanoseconds = pxTxDesc->DESC0 & niEMAC_TIMESTAMP_NS_MASK;
+                        #endif
+                        pxEMACData->xTxTimestampReady = pdTRUE;
+                    }
+                    taskEXIT_CRITICAL();
+                }
+            }
+
+            ulDescIdx = ( ulDescIdx + 1U ) % ( uint32_t ) ETH_TX_DESC_CNT;
+        }
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static void prvGetRxTimestamp( const ETH_HandleTypeDef * pxEthHandle,
+                                   const NetworkBufferDescriptor_t * const pxDescriptor,
+                                   const ETH_DMADescTypeDef * const pxRxDesc )
+    {
+        EMACBufferTimestamp_t * const pxBufferTimestamp = prvGetBufferTimestamp( pxDescriptor );
+
+        ( void ) pxEthHandle;
+
+        if( pxBufferTimestamp != NULL )
+        {
+            /* The buffer now holds a received frame, a Tx request left on it is void */
+            pxBufferTimestamp->ucFlags = 0U;
+
+            if( pxRxDesc != NULL )
+            {
+                #if defined( niEMAC_STM32FX )
+                    if( ( pxRxDesc->DESC0 & niEMAC_RX_DESC_TSV ) != 0U )
+                    {
+                        pxBufferTimestamp->xRxTimestamp.ulSeconds = pxRxDesc->DESC7;
+                        pxBufferTimestamp->xRxTimestamp.ulNanoseconds = pxRxDesc->DESC6 & niEMAC_TIMESTAMP_NS_MASK;
+                        pxBufferTimestamp->ucFlags = niEMAC_BUF_RX_TIMESTAMP;
+                    }
+                #elif defined( niEMAC_STM32HX )
+                    if( ( pxRxDesc->DESC1 & ETH_DMARXNDESCWBF_TSA ) != 0U )
+                    {
+                        /* The stamp is in a context descriptor written back after the last descriptor of the frame */
+                        const size_t uxCtxIdx = ( ( size_t ) ( pxRxDesc - pxEthHandle->Init.RxDesc ) + 1U ) % ( size_t ) ETH_RX_DESC_CNT;
+                        const ETH_DMADescTypeDef * const pxCtxDesc = &pxEthHandle->Init.RxDesc[ uxCtxIdx ];
+
+                        if( ( pxCtxDesc->DESC3 & ( ETH_DMARXNDESCWBF_OWN | ETH_DMARXNDESCWBF_CTXT ) ) == ETH_DMARXNDESCWBF_CTXT )
+                        {
+                            pxBufferTimestamp->xRxTimestamp.ulSeconds = pxCtxDesc->DESC1;
+                            pxBufferTimestamp->xRxTimestamp.ulNanoseconds = pxCtxDesc->DESC0 & niEMAC_TIMESTAMP_NS_MASK;
+                            pxBufferTimestamp->ucFlags = niEMAC_BUF_RX_TIMESTAMP;
+                        }
+                    }
+                #endif /* if defined( niEMAC_STM32FX ) */
+            }
+        }
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    static int64_t prvTimestampToNs( const EMACTimestamp_t * const pxTimestamp )
+    {
+        return ( ( int64_t ) pxTimestamp->ulSeconds * ( int64_t ) niEMAC_NS_PER_SECOND ) + ( int64_t ) pxTimestamp->ulNanoseconds;
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING ) */
+
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                              IRQ Handlers                                 */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+
+void ETH_IRQHandler( void )
+{
+    traceISR_ENTER();
+
+    EMACData_t * const pxEMACData = prvInstanceToData( ETH );
+
+    pxEMACData->xSwitchRequired = pdFALSE;
+    HAL_ETH_IRQHandler( &pxEMACData->xEthHandle );
+
+    portYIELD_FROM_ISR( pxEMACData->xSwitchRequired );
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT )
+
+    void vSTM32_PhyIRQHandler( NetworkInterface_t * pxInterface )
+    {
+        traceISR_ENTER();
+
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+        ++pxEMACData->xEMACStats.ulPhyInterrupts;
+
+        if( pxEMACData->xEMACTaskHandle != NULL )
+        {
+            ( void ) xTaskNotifyFromISR( pxEMACData->xEMACTaskHandle, eMacEventPhy, eSetBits, &xHigherPriorityTaskWoken );
+        }
+
+        portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_PHY_INTERRUPT ) */
+
+/*---------------------------------------------------------------------------*/
+
+void HAL_ETH_ErrorCallback( ETH_HandleTypeDef * pxEthHandle )
+{
+    EMACData_t * const pxEMACData = niEMAC_HANDLE_TO_DATA( pxEthHandle );
+    eMAC_IF_EVENT eErrorEvents = eMacEventNone;
+
+    if( pxEthHandle->gState == HAL_ETH_STATE_ERROR )
     {
-        #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
-            NetworkBufferDescriptor_t * const pxNext = pxDescriptorToClear->pxNextBuffer;
-        #else
-            NetworkBufferDescriptor_t * const pxNext = NULL;
-        #endif
-        vReleaseNetworkBufferAndDescriptor( pxDescriptorToClear );
-        pxDescriptorToClear = pxNext;
+        /* Fatal bus error occurred */
+        eErrorEvents |= eMacEventErrEth;
+        pxEMACData->xErrorTime = xTaskGetTickCountFromISR();
+    }
+
+    if( ( pxEthHandle->ErrorCode & HAL_ETH_ERROR_DMA ) != 0 )
+    {
+        eErrorEvents |= eMacEventErrDma;
+        const uint32_t ulDmaError = pxEthHandle->DMAErrorCode;
+
+        if( ( ulDmaError & ETH_DMA_FATAL_BUS_ERROR_FLAG ) != 0 )
+        {
+            ++pxEMACData->xEMACStats.ulDmaFatalErrors;
+        }
+        else if( ( ulDmaError & ( ETH_DMA_TX_BUFFER_UNAVAILABLE_FLAG | ETH_DMA_RX_BUFFER_UNAVAILABLE_FLAG ) ) == 0 )
+        {
+            ++pxEMACData->xEMACStats.ulDmaOtherErrors;
+        }
+
+        if( ( ulDmaError & ETH_DMA_TX_BUFFER_UNAVAILABLE_FLAG ) != 0 )
+        {
+            ++pxEMACData->xEMACStats.ulDmaTxUnavailable;
+            eErrorEvents |= eMacEventErrTx;
+        }
+
+        if( ( ulDmaError & ETH_DMA_RX_BUFFER_UNAVAILABLE_FLAG ) != 0 )
+        {
+            ++pxEMACData->xEMACStats.ulDmaRxUnavailable;
+            eErrorEvents |= eMacEventErrRx;
+        }
+    }
+
+    if( ( pxEthHandle->ErrorCode & HAL_ETH_ERROR_MAC ) != 0 )
+    {
+        ++pxEMACData->xEMACStats.ulMacErrors;
+        eErrorEvents |= eMacEventErrMac;
+    }
+
+    /* The HAL accumulates these, clear them so each interrupt is only counted once */
+    pxEthHandle->ErrorCode &= ~( HAL_ETH_ERROR_DMA | HAL_ETH_ERROR_MAC );
+
+    if( ( pxEMACData->xEMACTaskHandle != NULL ) && ( eErrorEvents != eMacEventNone ) )
+    {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        ( void ) xTaskNotifyFromISR( pxEMACData->xEMACTaskHandle, eErrorEvents, eSetBits, &xHigherPriorityTaskWoken );
+        pxEMACData->xSwitchRequired |= xHigherPriorityTaskWoken;
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void prvSendRxEvent( NetworkBufferDescriptor_t * const pxDescriptor )
+void HAL_ETH_RxCpltCallback( ETH_HandleTypeDef * pxEthHandle )
 {
-    const IPStackEvent_t xRxEvent =
+    EMACData_t * const pxEMACData = niEMAC_HANDLE_TO_DATA( pxEthHandle );
+
+    iptraceNETWORK_INTERFACE_RECEIVE();
+
+    #if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+        ++pxEMACData->xRxModerationStatus.ulRxInterrupts;
+    #endif
+
+    if( pxEMACData->xEMACTaskHandle != NULL )
     {
-        .eEventType = eNetworkRxEvent,
-        .pvData     = ( void * ) pxDescriptor
-    };
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        ( void ) xTaskNotifyFromISR( pxEMACData->xEMACTaskHandle, eMacEventRx, eSetBits, &xHigherPriorityTaskWoken );
+        pxEMACData->xSwitchRequired |= xHigherPriorityTaskWoken;
+    }
+}
 
-    if( xSendEventStructToIPTask( &xRxEvent, pdMS_TO_TICKS( niEMAC_RX_MAX_BLOCK_TIME_MS ) ) != pdPASS )
+/*---------------------------------------------------------------------------*/
+
+void HAL_ETH_TxCpltCallback( ETH_HandleTypeDef * pxEthHandle )
+{
+    EMACData_t * const pxEMACData = niEMAC_HANDLE_TO_DATA( pxEthHandle );
+
+    iptraceNETWORK_INTERFACE_TRANSMIT();
+    ++pxEMACData->xEMACStats.ulTxInterrupts;
+
+    if( pxEMACData->xEMACTaskHandle != NULL )
     {
-        iptraceETHERNET_RX_EVENT_LOST();
-        FreeRTOS_debug_printf( ( "prvSendRxEvent: xSendEventStructToIPTask failed\n" ) );
-        prvReleaseNetworkBufferDescriptor( pxDescriptor );
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        ( void ) xTaskNotifyFromISR( pxEMACData->xEMACTaskHandle, eMacEventTx, eSetBits, &xHigherPriorityTaskWoken );
+        pxEMACData->xSwitchRequired |= xHigherPriorityTaskWoken;
     }
 }
 
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                            HAL Tx/Rx Callbacks                            */
+/*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-static BaseType_t prvAcceptPacket( const NetworkBufferDescriptor_t * const pxDescriptor,
-                                   uint16_t usLength )
+void HAL_ETH_RxAllocateCallback( uint8_t ** ppucBuff )
 {
-    BaseType_t xResult = pdFALSE;
+    EMACData_t * const pxEMACData = prvGetEthContext();
+    NetworkBufferDescriptor_t * pxBufferDescriptor = NULL;
 
-    do
+    /* Must not block, the Rx ring is replenished from the EMAC task */
+    if( xQueueReceive( pxEMACData->xRxReserve, &pxBufferDescriptor, 0U ) == pdFALSE )
     {
-        if( pxDescriptor == NULL )
+        ++pxEMACData->xRxReserveStatus.ulReserveEmpty;
+        pxBufferDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_RX_BUFFER_SIZE, 0U );
+
+        if( pxBufferDescriptor != NULL )
         {
-            iptraceETHERNET_RX_EVENT_LOST();
-            FreeRTOS_debug_printf( ( "prvAcceptPacket: Null Descriptor\n" ) );
-            break;
+            ipSET_NETWORK_BUFFER_OWNER( pxBufferDescriptor, eNetworkBufferDriverRx );
         }
+    }
 
-        if( usLength > pxDescriptor->xDataLength )
+    if( pxBufferDescriptor != NULL )
+    {
+        #ifdef niEMAC_CACHEABLE
+            if( niEMAC_CACHE_MAINTENANCE != 0 )
+            {
+                SCB_InvalidateDCache_by_Addr( ( uint32_t * ) pxBufferDescriptor->pucEthernetBuffer, pxBufferDescriptor->xDataLength );
+            }
+        #endif
+        *ppucBuff = pxBufferDescriptor->pucEthernetBuffer;
+    }
+    else
+    {
+        /* The HAL keeps the previous buffer pointer between descriptors */
+        *ppucBuff = NULL;
+        ++pxEMACData->xRxReserveStatus.ulAllocFailures;
+        FreeRTOS_debug_printf( ( "HAL_ETH_RxAllocateCallback: failed\n" ) );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void HAL_ETH_RxLinkCallback( void ** ppvStart,
+                             void ** ppvEnd,
+                             uint8_t * pucBuff,
+                             uint16_t usLength )
+{
+    EMACData_t * const pxEMACData = prvGetEthContext();
+    NetworkBufferDescriptor_t ** const ppxStartDescriptor = ( NetworkBufferDescriptor_t ** ) ppvStart;
+    NetworkBufferDescriptor_t ** const ppxEndDescriptor = ( NetworkBufferDescriptor_t ** ) ppvEnd;
+    NetworkBufferDescriptor_t * pxCurDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) pucBuff );
+    uint16_t usBuffLength = usLength;
+    BaseType_t xFrameReady = pdTRUE;
+
+    #if ipconfigIS_ENABLED( niEMAC_RX_DESC_LOOKUP )
+        const ETH_DMADescTypeDef * const pxRxDesc = prvGetRxDescriptor( &pxEMACData->xEthHandle, pucBuff );
+    #else
+        const ETH_DMADescTypeDef * const pxRxDesc = NULL;
+    #endif
+
+    #if ipconfigIS_ENABLED( niEMAC_RX_CHAINING )
+        configASSERT( pxRxDesc != NULL );
+        const BaseType_t xLastBuffer = niEMAC_RX_DESC_IS_LAST( pxRxDesc ) ? pdTRUE : pdFALSE;
+
+        if( xLastBuffer == pdFALSE )
         {
-            iptraceETHERNET_RX_EVENT_LOST();
-            FreeRTOS_debug_printf( ( "prvAcceptPacket: Packet size overflow\n" ) );
-            break;
+            /* The HAL length is only right for the last buffer of a frame, the others are filled */
+            usBuffLength = ( uint16_t ) niEMAC_RX_BUFFER_SIZE;
         }
+    #endif
 
-        ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
-        uint32_t ulErrorCode = 0;
-        ( void ) HAL_ETH_GetRxDataErrorCode( pxEthHandle, &ulErrorCode );
-
-        if( ulErrorCode != 0 )
+    #ifdef niEMAC_CACHEABLE
+        /* Invalidate before prvAcceptPacket, which may inspect the headers */
+        if( niEMAC_CACHE_MAINTENANCE != 0 )
         {
-            iptraceETHERNET_RX_EVENT_LOST();
-            FreeRTOS_debug_printf( ( "prvAcceptPacket: Rx Data Error\n" ) );
-            break;
+            SCB_InvalidateDCache_by_Addr( ( uint32_t * ) pucBuff, usBuffLength );
         }
+    #endif
 
-        #if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_FRAME_TYPES )
-            if( eConsiderFrameForProcessing( pxDescriptor->pucEthernetBuffer ) != eProcessBuffer )
-            {
-                iptraceETHERNET_RX_EVENT_LOST();
-                FreeRTOS_debug_printf( ( "prvAcceptPacket: Frame discarded\n" ) );
-                break;
-            }
-        #endif
+    #if ipconfigIS_ENABLED( niEMAC_RX_CHAINING )
+        if( ( *ppxStartDescriptor != NULL ) && niEMAC_RX_DESC_IS_FIRST( pxRxDesc ) )
+        {
+            /* Left over from a frame cut short when the DMA was stopped */
+            prvReleaseNetworkBufferDescriptor( *ppxStartDescriptor );
+            *ppxStartDescriptor = NULL;
+        }
 
-        #if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS )
+        if( ( *ppxStartDescriptor != NULL ) || ( xLastBuffer == pdFALSE ) )
         {
-            const ETH_DMADescTypeDef * const ulRxDesc = ( const ETH_DMADescTypeDef * const ) pxEthHandle->RxDescList.RxDesc[ pxEthHandle->RxDescList.RxDescIdx ];
-            uint32_t ulRxDesc;
-            #ifdef niEMAC_STM32HX
-                ulRxDesc = ulRxDesc->DESC1;
-            #elif defined( niEMAC_STM32FX )
-                ulRxDesc = ulRxDesc->DESC4;
-            #endif
+            /* Frame spread over several buffers, linked until its last buffer arrives */
+            pxCurDescriptor->xDataLength = usBuffLength;
+            pxCurDescriptor->pxNextBuffer = NULL;
 
-            if( ( ulRxDesc & ETH_IP_HEADER_IPV4 ) != 0 )
+            if( *ppxStartDescriptor == NULL )
             {
-                /* Should be impossible if hardware filtering is implemented correctly */
-                configASSERT( ipconfigIS_ENABLED( ipconfigUSE_IPv4 ) );
-                #if ipconfigIS_ENABLED( ipconfigUSE_IPv4 )
-                    /* prvAllowIPPacketIPv4(); */
-                #endif
+                *ppxStartDescriptor = pxCurDescriptor;
             }
-            else if( ( ulRxDesc & ETH_IP_HEADER_IPV6 ) != 0 )
+            else
             {
-                /* Should be impossible if hardware filtering is implemented correctly */
-                configASSERT( ipconfigIS_ENABLED( ipconfigUSE_IPv6 ) );
-                #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
-                    /* prvAllowIPPacketIPv6(); */
-                #endif
+                ( *ppxEndDescriptor )->pxNextBuffer = pxCurDescriptor;
             }
 
-            if( ( ulRxDesc & ETH_IP_PAYLOAD_MASK ) == ETH_IP_PAYLOAD_UNKNOWN )
-            {
-                iptraceETHERNET_RX_EVENT_LOST();
-                break;
-            }
-            else if( ( ulRxDesc & ETH_IP_PAYLOAD_MASK ) == ETH_IP_PAYLOAD_UDP )
+            *ppxEndDescriptor = pxCurDescriptor;
+            xFrameReady = pdFALSE;
+
+            if( xLastBuffer != pdFALSE )
             {
-                /* prvProcessUDPPacket(); */
+                /* Dropped frames have already been counted */
+                usBuffLength = ( uint16_t ) niEMAC_RX_DESC_FRAME_LENGTH( pxRxDesc );
+                pxCurDescriptor = prvGatherRxChain( pxEMACData, *ppxStartDescriptor, usBuffLength );
+                *ppxStartDescriptor = NULL;
+                *ppxEndDescriptor = NULL;
+                xFrameReady = ( pxCurDescriptor != NULL ) ? pdTRUE : pdFALSE;
             }
-            else if( ( ulRxDesc & ETH_IP_PAYLOAD_MASK ) == ETH_IP_PAYLOAD_TCP )
+        }
+    #endif /* if ipconfigIS_ENABLED( niEMAC_RX_CHAINING ) */
+
+    if( xFrameReady != pdFALSE )
+    {
+        #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+            if( pxCurDescriptor != NULL )
             {
-                /* Should be impossible if hardware filtering is implemented correctly */
-                configASSERT( ipconfigIS_ENABLED( ipconfigUSE_TCP ) );
-                #if ipconfigIS_ENABLED( ipconfigUSE_TCP )
-                    /* xProcessReceivedTCPPacket() */
-                #endif
+                prvGetRxTimestamp( &pxEMACData->xEthHandle, pxCurDescriptor, pxRxDesc );
             }
-            else if( ( ulRxDesc & ETH_IP_PAYLOAD_MASK ) == ETH_IP_PAYLOAD_ICMPN )
+        #endif
+
+        if( prvAcceptPacket( pxEMACData, pxCurDescriptor, pxRxDesc, usBuffLength ) == pdTRUE )
+        {
+            pxCurDescriptor->xDataLength = usBuffLength;
+            #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+                pxCurDescriptor->pxNextBuffer = NULL;
+            #endif
+
+            if( *ppxStartDescriptor == NULL )
             {
-                #if ipconfigIS_DISABLED( ipconfigREPLY_TO_INCOMING_PINGS ) && ipconfigIS_DISABLED( ipconfigSUPPORT_OUTGOING_PINGS )
-                    iptraceETHERNET_RX_EVENT_LOST();
-                    break;
-                #else
-                    /* ProcessICMPPacket(); */
-                #endif
+                *ppxStartDescriptor = pxCurDescriptor;
             }
 
-            #ifdef niEMAC_STM32HX
-                else if( ( ulRxDesc & ETH_IP_PAYLOAD_MASK ) == ETH_IP_PAYLOAD_IGMP ) /* IGMP */
+            #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
+                else if( ppxEndDescriptor != NULL )
                 {
+                    ( *ppxEndDescriptor )->pxNextBuffer = pxCurDescriptor;
                 }
             #endif
+            *ppxEndDescriptor = pxCurDescriptor;
+            /* Frames are handed on in a single buffer */
+            configASSERT( *ppxStartDescriptor == *ppxEndDescriptor );
+        }
+        else
+        {
+            FreeRTOS_debug_printf( ( "HAL_ETH_RxLinkCallback: Buffer Dropped\n" ) );
+            prvReleaseNetworkBufferDescriptor( pxCurDescriptor );
+        }
+    }
+}
 
-            /* TODO: Create a eConsiderPacketForProcessing */
-            if( eConsiderPacketForProcessing( pxDescriptor->pucEthernetBuffer ) != eProcessBuffer )
-            {
-                iptraceETHERNET_RX_EVENT_LOST();
-                FreeRTOS_debug_printf( ( "prvAcceptPacket: Packet discarded\n" ) );
-                break;
-            }
+/*---------------------------------------------------------------------------*/
+
+void HAL_ETH_TxFreeCallback( uint32_t * pulBuff )
+{
+    NetworkBufferDescriptor_t * const pxNetworkBuffer = ( NetworkBufferDescriptor_t * ) pulBuff;
+
+    prvReleaseNetworkBufferDescriptor( pxNetworkBuffer );
+}
+
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                           Buffer Allocation                               */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+
+void vNetworkInterfaceAllocateRAMToBuffers( NetworkBufferDescriptor_t pxNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    static uint8_t ucNetworkPackets[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ][ niEMAC_TOTAL_BUFFER_SIZE ] __ALIGNED( niEMAC_BUF_ALIGNMENT ) __attribute__( ( section( niEMAC_BUFFERS_SECTION ) ) );
+
+    configASSERT( niEMAC_TOTAL_BUFFER_SIZE >= ipconfigETHERNET_MINIMUM_PACKET_BYTES );
+    configASSERT( xBufferAllocFixedSize == pdTRUE );
+
+    #if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
+        pxNetworkBufferPool = pxNetworkBuffers;
+    #endif
+
+    size_t uxIndex;
+
+    for( uxIndex = 0; uxIndex < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; ++uxIndex )
+    {
+        pxNetworkBuffers[ uxIndex ].pucEthernetBuffer = &( ucNetworkPackets[ uxIndex ][ ipBUFFER_PADDING ] );
+        *( ( uint32_t * ) &( ucNetworkPackets[ uxIndex ][ 0 ] ) ) = ( uint32_t ) ( &( pxNetworkBuffers[ uxIndex ] ) );
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+void vNetworkInterfaceAllocateRAMToSmallBuffers( NetworkBufferDescriptor_t pxSmallNetworkBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    /* Same section as the large buffers, small buffers are also handed to the Tx DMA */
+    static uint8_t ucSmallPackets[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ][ niEMAC_SMALL_TOTAL_BUFFER_SIZE ] __ALIGNED( niEMAC_BUF_ALIGNMENT ) __attribute__( ( section( niEMAC_BUFFERS_SECTION ) ) );
+
+    size_t uxIndex;
+
+    for( uxIndex = 0; uxIndex < ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS; ++uxIndex )
+    {
+        pxSmallNetworkBuffers[ uxIndex ].pucEthernetBuffer = &( ucSmallPackets[ uxIndex ][ ipBUFFER_PADDING ] );
+        *( ( uint32_t * ) &( ucSmallPackets[ uxIndex ][ 0 ] ) ) = ( uint32_t ) ( &( pxSmallNetworkBuffers[ uxIndex ] ) );
+    }
+}
+
+#endif /* if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+void vNetworkInterfaceAllocateRAMToMediumBuffers( NetworkBufferDescriptor_t pxMediumNetworkBuffers[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    static uint8_t ucMediumPackets[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ][ niEMAC_MEDIUM_TOTAL_BUFFER_SIZE ] __ALIGNED( niEMAC_BUF_ALIGNMENT ) __attribute__( ( section( niEMAC_BUFFERS_SECTION ) ) );
+
+    size_t uxIndex;
+
+    for( uxIndex = 0; uxIndex < ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS; ++uxIndex )
+    {
+        pxMediumNetworkBuffers[ uxIndex ].pucEthernetBuffer = &( ucMediumPackets[ uxIndex ][ ipBUFFER_PADDING ] );
+        *( ( uint32_t * ) &( ucMediumPackets[ uxIndex ][ 0 ] ) ) = ( uint32_t ) ( &( pxMediumNetworkBuffers[ uxIndex ] ) );
+    }
+}
+
+#endif /* if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 ) */
+
+/*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+/*                      Network Interface Definition                         */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+
+NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex,
+                                                      NetworkInterface_t * pxInterface )
+{
+    configASSERT( ( xEMACIndex >= 0 ) && ( ( UBaseType_t ) xEMACIndex < niEMAC_INSTANCE_COUNT ) );
+
+    EMACData_t * const pxEMACData = &xEMACData[ xEMACIndex ];
+
+    ( void ) memset( pxEMACData, '\0', sizeof( *pxEMACData ) );
+    pxEMACData->xEMACIndex = xEMACIndex;
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    #if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+        pxEMACData->xRxModeration.ulFrameThreshold = niEMAC_RX_MODERATION_FRAMES;
+        pxEMACData->xRxModeration.ulStepUs = niEMAC_RX_MODERATION_STEP_US;
+        pxEMACData->xRxModeration.ulMaxDelayUs = niEMAC_RX_MODERATION_MAX_US;
+    #endif
+    #if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+        pxEMACData->uxRxPollBudget = niEMAC_RX_POLL_BUDGET;
+    #endif
+    #if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK )
+        pxEMACData->uxRxCopyBreak = niEMAC_RX_COPY_BREAK_BYTES;
+    #endif
+
+    ( void ) snprintf( pxEMACData->pcName, sizeof( pxEMACData->pcName ), "eth%u", ( unsigned ) xEMACIndex );
+
+    #if ( niEMAC_INSTANCE_COUNT > 1U )
+        if( xEthContextMutex == NULL )
+        {
+            #if ipconfigIS_ENABLED( configSUPPORT_STATIC_ALLOCATION )
+                xEthContextMutex = xSemaphoreCreateMutexStatic( &xEthContextMutexBuf );
+            #else
+                xEthContextMutex = xSemaphoreCreateMutex();
+            #endif
+            configASSERT( xEthContextMutex != NULL );
         }
-        #endif /* if ipconfigIS_ENABLED( ipconfigETHERNET_DRIVER_FILTERS_PACKETS ) */
+    #endif
 
-        xResult = pdTRUE;
-    } while( pdFALSE );
+    ( void ) memset( pxInterface, '\0', sizeof( *pxInterface ) );
+    pxInterface->pcName = pxEMACData->pcName;
+    pxInterface->pvArgument = ( void * ) pxEMACData;
+    pxInterface->pfInitialise = prvNetworkInterfaceInitialise;
+    pxInterface->pfOutput = prvNetworkInterfaceOutput;
+    pxInterface->pfGetPhyLinkStatus = prvGetPhyLinkStatus;
 
-    return xResult;
+    pxInterface->pfAddAllowedMAC = prvAddAllowedMACAddress;
+    pxInterface->pfRemoveAllowedMAC = prvRemoveAllowedMACAddress;
+
+    return FreeRTOS_AddNetworkInterface( pxInterface );
 }
 
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( ipconfigIPv4_BACKWARD_COMPATIBLE )
+
+/* Do not call the following function directly. It is there for downward compatibility.
+ * The function FreeRTOS_IPInit() will call it to initialice the interface and end-point
+ * objects.  See the description in FreeRTOS_Routing.h. */
+    NetworkInterface_t * pxFillInterfaceDescriptor( BaseType_t xEMACIndex,
+                                                    NetworkInterface_t * pxInterface )
+    {
+        pxSTM32_FillInterfaceDescriptor( xEMACIndex, pxInterface );
+    }
+
+#endif
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
-/*                              IRQ Handlers                                 */
+/*                            Run-time Controls                              */
 /*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-void ETH_IRQHandler( void )
+void vSTM32_GetRxReserveStatus( const NetworkInterface_t * pxInterface,
+                                EMACRxReserveStatus_t * pxStatus )
 {
-    traceISR_ENTER();
-
-    ETH_HandleTypeDef * pxEthHandle = &xEthHandle;
+    configASSERT( ( pxInterface != NULL ) && ( pxStatus != NULL ) );
 
-    xSwitchRequired = pdFALSE;
-    HAL_ETH_IRQHandler( pxEthHandle );
+    const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
 
-    portYIELD_FROM_ISR( xSwitchRequired );
+    taskENTER_CRITICAL();
+    {
+        *pxStatus = pxEMACData->xRxReserveStatus;
+        pxStatus->ulReserved = ( pxEMACData->xRxReserve != NULL ) ? ( uint32_t ) uxQueueMessagesWaiting( pxEMACData->xRxReserve ) : 0U;
+    }
+    taskEXIT_CRITICAL();
 }
 
 /*---------------------------------------------------------------------------*/
 
-void HAL_ETH_ErrorCallback( ETH_HandleTypeDef * pxEthHandle )
+void vSTM32_GetStats( const NetworkInterface_t * pxInterface,
+                      EMACStats_t * pxStats )
 {
-    eMAC_IF_EVENT eErrorEvents = eMacEventNone;
+    configASSERT( ( pxInterface != NULL ) && ( pxStats != NULL ) );
 
-    if( pxEthHandle->gState == HAL_ETH_STATE_ERROR )
+    const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+    taskENTER_CRITICAL();
     {
-        /* Fatal bus error occurred */
-        eErrorEvents |= eMacEventErrEth;
+        *pxStats = pxEMACData->xEMACStats;
+        pxStats->ulRxAllocFailures = pxEMACData->xRxReserveStatus.ulAllocFailures;
     }
+    taskEXIT_CRITICAL();
+}
 
-    if( ( pxEthHandle->ErrorCode & HAL_ETH_ERROR_DMA ) != 0 )
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_MODERATION )
+
+    BaseType_t xSTM32_SetRxModeration( NetworkInterface_t * pxInterface,
+                                       const EMACRxModeration_t * pxModeration )
     {
-        eErrorEvents |= eMacEventErrDma;
-        const uint32_t ulDmaError = pxEthHandle->DMAErrorCode;
+        BaseType_t xResult = pdFAIL;
 
-        if( ( ulDmaError & ETH_DMA_TX_BUFFER_UNAVAILABLE_FLAG ) != 0 )
+        configASSERT( ( pxInterface != NULL ) && ( pxModeration != NULL ) );
+
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+        /* The longest delay the 8 bit watchdog can count */
+        const uint32_t ulMaxDelayUs = ( niEMAC_RX_WATCHDOG_MAX * niEMAC_RX_WATCHDOG_UNIT ) / ( HAL_RCC_GetHCLKFreq() / 1000000U );
+
+        if( ( pxModeration->ulStepUs != 0U ) && ( pxModeration->ulStepUs <= pxModeration->ulMaxDelayUs ) && ( pxModeration->ulMaxDelayUs <= ulMaxDelayUs ) )
         {
-            eErrorEvents |= eMacEventErrTx;
+            taskENTER_CRITICAL();
+            {
+                pxEMACData->xRxModeration = *pxModeration;
+            }
+            taskEXIT_CRITICAL();
+
+            /* The EMAC task picks up the new settings on its next reception */
+            xResult = pdPASS;
         }
 
-        if( ( ulDmaError & ETH_DMA_RX_BUFFER_UNAVAILABLE_FLAG ) != 0 )
+        return xResult;
+    }
+
+/*---------------------------------------------------------------------------*/
+
+    void vSTM32_GetRxModeration( const NetworkInterface_t * pxInterface,
+                                 EMACRxModeration_t * pxModeration )
+    {
+        configASSERT( ( pxInterface != NULL ) && ( pxModeration != NULL ) );
+
+        const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+        taskENTER_CRITICAL();
         {
-            eErrorEvents |= eMacEventErrRx;
+            *pxModeration = pxEMACData->xRxModeration;
         }
+        taskEXIT_CRITICAL();
     }
 
-    if( ( pxEthHandle->ErrorCode & HAL_ETH_ERROR_MAC ) != 0 )
+/*---------------------------------------------------------------------------*/
+
+    void vSTM32_GetRxModerationStatus( const NetworkInterface_t * pxInterface,
+                                       EMACRxModerationStatus_t * pxStatus )
     {
-        eErrorEvents |= eMacEventErrMac;
+        configASSERT( ( pxInterface != NULL ) && ( pxStatus != NULL ) );
+
+        const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+        taskENTER_CRITICAL();
+        {
+            *pxStatus = pxEMACData->xRxModerationStatus;
+        }
+        taskEXIT_CRITICAL();
     }
 
-    if( ( xEMACTaskHandle != NULL ) && ( eErrorEvents != eMacEventNone ) )
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_MODERATION ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ipconfigIS_ENABLED( niEMAC_RX_POLLING )
+
+    BaseType_t xSTM32_SetRxPollBudget( NetworkInterface_t * pxInterface,
+                                       UBaseType_t uxBudget )
     {
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        ( void ) xTaskNotifyFromISR( xEMACTaskHandle, eErrorEvents, eSetBits, &xHigherPriorityTaskWoken );
-        xSwitchRequired |= xHigherPriorityTaskWoken;
+        BaseType_t xResult = pdFAIL;
+
+        configASSERT( pxInterface != NULL );
+
+        if( uxBudget != 0U )
+        {
+            /* Read once per pass by the EMAC task, a single word write needs no lock */
+            niEMAC_GET_DATA( pxInterface )->uxRxPollBudget = uxBudget;
+            xResult = pdPASS;
+        }
+
+        return xResult;
     }
-}
 
 /*---------------------------------------------------------------------------*/
 
-void HAL_ETH_RxCpltCallback( ETH_HandleTypeDef * pxEthHandle )
-{
-    static size_t uxMostRXDescsUsed = 0U;
+    UBaseType_t uxSTM32_GetRxPollBudget( const NetworkInterface_t * pxInterface )
+    {
+        configASSERT( pxInterface != NULL );
+
+        return niEMAC_GET_DATA( pxInterface )->uxRxPollBudget;
+    }
 
-    const size_t uxRxUsed = pxEthHandle->RxDescList.RxDescCnt;
+/*---------------------------------------------------------------------------*/
 
-    if( uxMostRXDescsUsed < uxRxUsed )
+    void vSTM32_GetRxPollStatus( const NetworkInterface_t * pxInterface,
+                                 EMACRxPollStatus_t * pxStatus )
     {
-        uxMostRXDescsUsed = uxRxUsed;
+        configASSERT( ( pxInterface != NULL ) && ( pxStatus != NULL ) );
+
+        const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+        taskENTER_CRITICAL();
+        {
+            *pxStatus = pxEMACData->xRxPollStatus;
+        }
+        taskEXIT_CRITICAL();
     }
 
-    iptraceNETWORK_INTERFACE_RECEIVE();
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_POLLING ) */
+
+/*---------------------------------------------------------------------------*/
 
-    if( xEMACTaskHandle != NULL )
+#if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK )
+
+    BaseType_t xSTM32_SetRxCopyBreak( NetworkInterface_t * pxInterface,
+                                      UBaseType_t uxThreshold )
     {
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        ( void ) xTaskNotifyFromISR( xEMACTaskHandle, eMacEventRx, eSetBits, &xHigherPriorityTaskWoken );
-        xSwitchRequired |= xHigherPriorityTaskWoken;
+        BaseType_t xResult = pdFAIL;
+
+        configASSERT( pxInterface != NULL );
+
+        if( uxThreshold <= ( UBaseType_t ) ipconfigSMALL_NETWORK_BUFFER_SIZE )
+        {
+            /* Read once per frame by the EMAC task, a single word write needs no lock */
+            niEMAC_GET_DATA( pxInterface )->uxRxCopyBreak = uxThreshold;
+            xResult = pdPASS;
+        }
+
+        return xResult;
     }
-}
 
 /*---------------------------------------------------------------------------*/
 
-void HAL_ETH_TxCpltCallback( ETH_HandleTypeDef * pxEthHandle )
-{
-    static size_t uxMostTXDescsUsed = 0U;
+    UBaseType_t uxSTM32_GetRxCopyBreak( const NetworkInterface_t * pxInterface )
+    {
+        configASSERT( pxInterface != NULL );
+
+        return niEMAC_GET_DATA( pxInterface )->uxRxCopyBreak;
+    }
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_RX_COPY_BREAK ) */
+
+/*---------------------------------------------------------------------------*/
 
-    const size_t uxTxUsed = pxEthHandle->TxDescList.BuffersInUse;
+#if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING )
 
-    if( uxMostTXDescsUsed < uxTxUsed )
+    BaseType_t xSTM32_GetRxTimestamp( const void * pvUDPPayload,
+                                      EMACTimestamp_t * pxTimestamp )
     {
-        uxMostTXDescsUsed = uxTxUsed;
+        BaseType_t xResult = pdFAIL;
+
+        configASSERT( ( pvUDPPayload != NULL ) && ( pxTimestamp != NULL ) );
+
+        /* The caller owns the buffer, which the EMAC task no longer touches */
+        const NetworkBufferDescriptor_t * const pxDescriptor = pxUDPPayloadBuffer_to_NetworkBuffer( pvUDPPayload );
+        const EMACBufferTimestamp_t * const pxBufferTimestamp = ( pxDescriptor != NULL ) ? prvGetBufferTimestamp( pxDescriptor ) : NULL;
+
+        if( ( pxBufferTimestamp != NULL ) && ( ( pxBufferTimestamp->ucFlags & niEMAC_BUF_RX_TIMESTAMP ) != 0U ) )
+        {
+            *pxTimestamp = pxBufferTimestamp->xRxTimestamp;
+            xResult = pdPASS;
+        }
+
+        return xResult;
     }
 
-    iptraceNETWORK_INTERFACE_TRANSMIT();
+/*---------------------------------------------------------------------------*/
 
-    if( xEMACTaskHandle != NULL )
+    BaseType_t xSTM32_RequestTxTimestamp( const void * pvUDPPayload )
     {
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        ( void ) xTaskNotifyFromISR( xEMACTaskHandle, eMacEventTx, eSetBits, &xHigherPriorityTaskWoken );
-        xSwitchRequired |= xHigherPriorityTaskWoken;
+        BaseType_t xResult = pdFAIL;
+
+        configASSERT( pvUDPPayload != NULL );
+
+        const NetworkBufferDescriptor_t * const pxDescriptor = pxUDPPayloadBuffer_to_NetworkBuffer( pvUDPPayload );
+        EMACBufferTimestamp_t * const pxBufferTimestamp = ( pxDescriptor != NULL ) ? prvGetBufferTimestamp( pxDescriptor ) : NULL;
+
+        if( pxBufferTimestamp != NULL )
+        {
+            pxBufferTimestamp->ucFlags = niEMAC_BUF_TX_TIMESTAMP;
+            xResult = pdPASS;
+        }
+
+        return xResult;
     }
-}
 
 /*---------------------------------------------------------------------------*/
-/*===========================================================================*/
-/*                            HAL Tx/Rx Callbacks                            */
-/*===========================================================================*/
-/*---------------------------------------------------------------------------*/
-
-void HAL_ETH_RxAllocateCallback( uint8_t ** ppucBuff )
-{
-    const NetworkBufferDescriptor_t * pxBufferDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_DATA_BUFFER_SIZE, pdMS_TO_TICKS( niEMAC_DESCRIPTOR_WAIT_TIME_MS ) );
 
-    if( pxBufferDescriptor != NULL )
+    BaseType_t xSTM32_GetTxTimestamp( NetworkInterface_t * pxInterface,
+                                      EMACTimestamp_t * pxTimestamp )
     {
-        #ifdef niEMAC_CACHEABLE
-            if( niEMAC_CACHE_MAINTENANCE != 0 )
+        BaseType_t xResult = pdFAIL;
+
+        configASSERT( ( pxInterface != NULL ) && ( pxTimestamp != NULL ) );
+
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+        taskENTER_CRITICAL();
+        {
+            if( pxEMACData->xTxTimestampReady != pdFALSE )
             {
-                SCB_InvalidateDCache_by_Addr( ( uint32_t * ) pxBufferDescriptor->pucEthernetBuffer, pxBufferDescriptor->xDataLength );
+                *pxTimestamp = pxEMACData->xTxTimestamp;
+                pxEMACData->xTxTimestampReady = pdFALSE;
+                xResult = pdPASS;
             }
-        #endif
-        *ppucBuff = pxBufferDescriptor->pucEthernetBuffer;
+        }
+        taskEXIT_CRITICAL();
+
+        return xResult;
     }
-    else
+
+/*---------------------------------------------------------------------------*/
+
+    void vSTM32_GetTime( const NetworkInterface_t * pxInterface,
+                         EMACTimestamp_t * pxTime )
     {
-        FreeRTOS_debug_printf( ( "HAL_ETH_RxAllocateCallback: failed\n" ) );
+        configASSERT( ( pxInterface != NULL ) && ( pxTime != NULL ) );
+
+        const EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+        const ETH_TypeDef * const pxEthInstance = pxEMACData->xEthHandle.Instance;
+
+        configASSERT( pxEMACData->ulTimestampAddend != 0U );
+
+        /* Read the seconds again in case the nanoseconds rolled over in between */
+        uint32_t ulSeconds;
+
+        do
+        {
+            #if defined( niEMAC_STM32FX )
+                ulSeconds = pxEthInstance->PTPTSHR;
+                pxTime->ulNanoseconds = pxEthInstance->PTPTSLR & niEMAC_TIMESTAMP_NS_MASK;
+                pxTime->ulSeconds = pxEthInstance->PTPTSHR;
+            #elif defined( niEMAC_STM32HX )
+                ulSeconds = pxEthInstance->MACSTSR;
+                pxTime->ulNanoseconds = pxEthInstance->MACSTNR & niEMAC_TIMESTAMP_NS_MASK;
+                pxTime->ulSeconds = pxEthInstance->MACSTSR;
+            #endif
+        } while( pxTime->ulSeconds != ulSeconds );
     }
-}
 
 /*---------------------------------------------------------------------------*/
 
-void HAL_ETH_RxLinkCallback( void ** ppvStart,
-                             void ** ppvEnd,
-                             uint8_t * pucBuff,
-                             uint16_t usLength )
-{
-    NetworkBufferDescriptor_t ** const ppxStartDescriptor = ( NetworkBufferDescriptor_t ** ) ppvStart;
-    NetworkBufferDescriptor_t ** const ppxEndDescriptor = ( NetworkBufferDescriptor_t ** ) ppvEnd;
-    NetworkBufferDescriptor_t * const pxCurDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) pucBuff );
-
-    if( prvAcceptPacket( pxCurDescriptor, usLength ) == pdTRUE )
+    BaseType_t xSTM32_AdjustTime( NetworkInterface_t * pxInterface,
+                                  int64_t llOffsetNs )
     {
-        pxCurDescriptor->xDataLength = usLength;
-        #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
-            pxCurDescriptor->pxNextBuffer = NULL;
-        #endif
+        BaseType_t xResult;
+
+        configASSERT( pxInterface != NULL );
 
-        if( *ppxStartDescriptor == NULL )
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+
+        configASSERT( pxEMACData->ulTimestampAddend != 0U );
+
+        /* Serialised with the EMAC task, which re-initialises the clock after a reset */
+        taskENTER_CRITICAL();
         {
-            *ppxStartDescriptor = pxCurDescriptor;
+            xResult = prvUpdateTime( pxEMACData->xEthHandle.Instance, llOffsetNs );
         }
+        taskEXIT_CRITICAL();
 
-        #if ipconfigIS_ENABLED( ipconfigUSE_LINKED_RX_MESSAGES )
-            else if( ppxEndDescriptor != NULL )
-            {
-                ( *ppxEndDescriptor )->pxNextBuffer = pxCurDescriptor;
-            }
-        #endif
-        *ppxEndDescriptor = pxCurDescriptor;
-        /* Only single buffer packets are supported */
-        configASSERT( *ppxStartDescriptor == *ppxEndDescriptor );
-        #ifdef niEMAC_CACHEABLE
-            if( niEMAC_CACHE_MAINTENANCE != 0 )
-            {
-                SCB_InvalidateDCache_by_Addr( ( uint32_t * ) pucBuff, usLength );
-            }
-        #endif
+        return ( xResult != pdFALSE ) ? pdPASS : pdFAIL;
     }
-    else
-    {
-        FreeRTOS_debug_printf( ( "HAL_ETH_RxLinkCallback: Buffer Dropped\n" ) );
-        prvReleaseNetworkBufferDescriptor( pxCurDescriptor );
-    }
-}
 
 /*---------------------------------------------------------------------------*/
 
-void HAL_ETH_TxFreeCallback( uint32_t * pulBuff )
-{
-    NetworkBufferDescriptor_t * const pxNetworkBuffer = ( NetworkBufferDescriptor_t * ) pulBuff;
+    BaseType_t xSTM32_AdjustFrequency( NetworkInterface_t * pxInterface,
+                                       int32_t lFrequencyPpb )
+    {
+        BaseType_t xResult = pdFAIL;
 
-    prvReleaseNetworkBufferDescriptor( pxNetworkBuffer );
-    ( void ) xSemaphoreGive( xTxDescSem );
-}
+        configASSERT( pxInterface != NULL );
 
-/*---------------------------------------------------------------------------*/
-/*===========================================================================*/
-/*                           Buffer Allocation                               */
-/*===========================================================================*/
-/*---------------------------------------------------------------------------*/
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
 
-void vNetworkInterfaceAllocateRAMToBuffers( NetworkBufferDescriptor_t pxNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ] )
-{
-    static uint8_t ucNetworkPackets[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ][ niEMAC_TOTAL_BUFFER_SIZE ] __ALIGNED( niEMAC_BUF_ALIGNMENT ) __attribute__( ( section( niEMAC_BUFFERS_SECTION ) ) );
+        configASSERT( pxEMACData->ulTimestampAddend != 0U );
 
-    configASSERT( niEMAC_TOTAL_BUFFER_SIZE >= ipconfigETHERNET_MINIMUM_PACKET_BYTES );
-    configASSERT( xBufferAllocFixedSize == pdTRUE );
+        if( ( lFrequencyPpb >= -niEMAC_PTP_MAX_PPB ) && ( lFrequencyPpb <= niEMAC_PTP_MAX_PPB ) )
+        {
+            BaseType_t xUpdated;
 
-    size_t uxIndex;
+            taskENTER_CRITICAL();
+            {
+                xUpdated = prvSetClockFrequency( pxEMACData, lFrequencyPpb );
+            }
+            taskEXIT_CRITICAL();
 
-    for( uxIndex = 0; uxIndex < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; ++uxIndex )
-    {
-        pxNetworkBuffers[ uxIndex ].pucEthernetBuffer = &( ucNetworkPackets[ uxIndex ][ ipBUFFER_PADDING ] );
-        *( ( uint32_t * ) &( ucNetworkPackets[ uxIndex ][ 0 ] ) ) = ( uint32_t ) ( &( pxNetworkBuffers[ uxIndex ] ) );
+            xResult = ( xUpdated != pdFALSE ) ? pdPASS : pdFAIL;
+        }
+
+        return xResult;
     }
-}
 
-/*---------------------------------------------------------------------------*/
-/*===========================================================================*/
-/*                      Network Interface Definition                         */
-/*===========================================================================*/
 /*---------------------------------------------------------------------------*/
 
-NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex,
-                                                      NetworkInterface_t * pxInterface )
-{
-    static char pcName[ 17 ];
+    BaseType_t xSTM32_PtpSync( NetworkInterface_t * pxInterface,
+                               const EMACPtpExchange_t * pxExchange,
+                               EMACPtpResult_t * pxResult )
+    {
+        BaseType_t xResult = pdFAIL;
 
-    ( void ) snprintf( pcName, sizeof( pcName ), "eth%u", ( unsigned ) xEMACIndex );
+        configASSERT( ( pxInterface != NULL ) && ( pxExchange != NULL ) && ( pxResult != NULL ) );
 
-    ( void ) memset( pxInterface, '\0', sizeof( *pxInterface ) );
-    pxInterface->pcName = pcName;
-    /* TODO: use pvArgument to get xEMACData? */
-    /* xEMACData.xEMACIndex = xEMACIndex; */
-    /* pxInterface->pvArgument = ( void * ) &xEMACData; */
-    /* pxInterface->pvArgument = pvPortMalloc( sizeof( EMACData_t ) ); */
-    pxInterface->pvArgument = ( void * ) xEMACIndex;
-    pxInterface->pfInitialise = prvNetworkInterfaceInitialise;
-    pxInterface->pfOutput = prvNetworkInterfaceOutput;
-    pxInterface->pfGetPhyLinkStatus = prvGetPhyLinkStatus;
+        EMACData_t * const pxEMACData = niEMAC_GET_DATA( pxInterface );
+        const int64_t llMasterToSlave = prvTimestampToNs( &pxExchange->xT2 ) - prvTimestampToNs( &pxExchange->xT1 );
+        const int64_t llSlaveToMaster = prvTimestampToNs( &pxExchange->xT4 ) - prvTimestampToNs( &pxExchange->xT3 );
 
-    /* pxInterface->pfAddAllowedMAC = prvAddAllowedMACAddress;
-     * pxInterface->pfRemoveAllowedMAC = prvRemoveAllowedMACAddress; */
+        /* The path is taken to be symmetric, any asymmetry ends up in the offset */
+        pxResult->llOffsetNs = ( llMasterToSlave - llSlaveToMaster ) / 2;
+        pxResult->llDelayNs = ( llMasterToSlave + llSlaveToMaster ) / 2;
+        pxResult->xStepped = pdFALSE;
 
-    return FreeRTOS_AddNetworkInterface( pxInterface );
-}
+        if( pxResult->llDelayNs >= 0 )
+        {
+            const int64_t llOffsetNs = pxResult->llOffsetNs;
 
-/*---------------------------------------------------------------------------*/
+            if( ( llOffsetNs >= niEMAC_PTP_STEP_NS ) || ( llOffsetNs <= -niEMAC_PTP_STEP_NS ) )
+            {
+                /* Too far off to slew in reasonable time, the frequency trim is kept */
+                if( xSTM32_AdjustTime( pxInterface, -llOffsetNs ) == pdPASS )
+                {
+                    pxResult->xStepped = pdTRUE;
+                    xResult = pdPASS;
+                }
+            }
+            else
+            {
+                /* Over one second, an offset in nanoseconds is a rate error in parts per billion */
+                int32_t lIntegralPpb = pxEMACData->lPtpIntegralPpb - ( int32_t ) ( llOffsetNs / niEMAC_PTP_KI_DIVISOR );
+                int32_t lFrequencyPpb;
 
-#if ipconfigIS_ENABLED( ipconfigIPv4_BACKWARD_COMPATIBLE )
+                lIntegralPpb = ( lIntegralPpb > niEMAC_PTP_MAX_PPB ) ? niEMAC_PTP_MAX_PPB : lIntegralPpb;
+                lIntegralPpb = ( lIntegralPpb < -niEMAC_PTP_MAX_PPB ) ? -niEMAC_PTP_MAX_PPB : lIntegralPpb;
+                pxEMACData->lPtpIntegralPpb = lIntegralPpb;
 
-/* Do not call the following function directly. It is there for downward compatibility.
- * The function FreeRTOS_IPInit() will call it to initialice the interface and end-point
- * objects.  See the description in FreeRTOS_Routing.h. */
-    NetworkInterface_t * pxFillInterfaceDescriptor( BaseType_t xEMACIndex,
-                                                    NetworkInterface_t * pxInterface )
-    {
-        pxSTM32_FillInterfaceDescriptor( xEMACIndex, pxInterface );
+                lFrequencyPpb = lIntegralPpb - ( int32_t ) ( llOffsetNs / niEMAC_PTP_KP_DIVISOR );
+                lFrequencyPpb = ( lFrequencyPpb > niEMAC_PTP_MAX_PPB ) ? niEMAC_PTP_MAX_PPB : lFrequencyPpb;
+                lFrequencyPpb = ( lFrequencyPpb < -niEMAC_PTP_MAX_PPB ) ? -niEMAC_PTP_MAX_PPB : lFrequencyPpb;
+
+                xResult = xSTM32_AdjustFrequency( pxInterface, lFrequencyPpb );
+            }
+        }
+
+        pxResult->lFrequencyPpb = pxEMACData->lFrequencyPpb;
+
+        return xResult;
     }
 
-#endif
+#endif /* if ipconfigIS_ENABLED( niEMAC_TIMESTAMPING ) */
 
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
@@ -2372,3 +5636,5 @@ NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex,
 #endif /* if 0 */
 
 /*---------------------------------------------------------------------------*/
+
+#endif /* if ipconfigIS_DISABLED( niEMAC_REGISTER_DRIVER ) */
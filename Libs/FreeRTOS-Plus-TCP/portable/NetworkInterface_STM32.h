@@ -0,0 +1,234 @@
+/*
+ * FreeRTOS+TCP <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @brief
+ * Run-time controls of the STM32 F7/H7/H5 EMAC network interface.
+ *
+ */
+
+#ifndef NETWORKINTERFACE_STM32_H
+
+    #define NETWORKINTERFACE_STM32_H
+
+    #ifdef __cplusplus
+    extern "C" {
+    #endif
+
+/* Selects the register-level driver in Test/NetworkInterface_Regs.c in place of the HAL based
+ * NetworkInterface.c. Both files may be part of the build, only the selected one produces code.
+ * The run-time controls below are provided by NetworkInterface.c alone. */
+    #ifndef niEMAC_REGISTER_DRIVER
+        #define niEMAC_REGISTER_DRIVER    ipconfigDISABLE
+    #endif
+
+/* Every control takes the network interface filled in by pxSTM32_FillInterfaceDescriptor. */
+
+/* Rx buffer reserve. The Rx descriptors take their buffers from a small reserve which the
+ * EMAC task tops up from the network buffer pool without ever blocking. */
+    typedef struct xEMACRxReserveStatus
+    {
+        uint32_t ulReserved;      /* Buffers currently held in the reserve. */
+        uint32_t ulReserveEmpty;  /* Descriptor refills which found the reserve empty. */
+        uint32_t ulAllocFailures; /* Descriptor refills which found the pool empty as well. */
+        uint32_t ulRingEmpty;     /* Times the DMA ran out of Rx descriptors. */
+    } EMACRxReserveStatus_t;
+
+    void vSTM32_GetRxReserveStatus( const NetworkInterface_t * pxInterface,
+                                    EMACRxReserveStatus_t * pxStatus );
+
+/* Adaptive Rx interrupt moderation. Received frames are normally signalled one interrupt
+ * per frame. Once a wake-up of the EMAC task finds 'ulFrameThreshold' frames or more, the
+ * per-frame interrupt is replaced by the DMA receive watchdog, whose delay grows by
+ * 'ulStepUs' up to 'ulMaxDelayUs' while the load lasts, and shrinks back when it is gone.
+ * A 'ulFrameThreshold' of zero disables moderation. */
+    typedef struct xEMACRxModeration
+    {
+        uint32_t ulFrameThreshold; /* Frames per wake-up at which the delay is lengthened. */
+        uint32_t ulStepUs;         /* Amount by which the delay is lengthened, in microseconds. */
+        uint32_t ulMaxDelayUs;     /* Upper limit of the delay, in microseconds. */
+    } EMACRxModeration_t;
+
+    typedef struct xEMACRxModerationStatus
+    {
+        uint32_t ulDelayUs;        /* Delay in use, zero when every frame raises an interrupt. */
+        uint32_t ulRxInterrupts;   /* Rx interrupts since start-up. */
+        uint32_t ulRxFrames;       /* Frames handed to the IP-task since start-up. */
+    } EMACRxModerationStatus_t;
+
+/* Change the moderation settings, returns pdFAIL when a value is out of range. */
+    BaseType_t xSTM32_SetRxModeration( NetworkInterface_t * pxInterface,
+                                       const EMACRxModeration_t * pxModeration );
+
+    void vSTM32_GetRxModeration( const NetworkInterface_t * pxInterface,
+                                 EMACRxModeration_t * pxModeration );
+
+    void vSTM32_GetRxModerationStatus( const NetworkInterface_t * pxInterface,
+                                       EMACRxModerationStatus_t * pxStatus );
+
+/* Budgeted Rx polling. When one wake-up of the EMAC task finds at least a budget's worth of
+ * frames, the Rx interrupt is masked and the ring is polled, at most one budget per pass,
+ * until a pass finds it empty. */
+    typedef struct xEMACRxPollStatus
+    {
+        uint32_t ulInterruptWakeups; /* Wake-ups of the EMAC task by an Rx interrupt. */
+        uint32_t ulPollPasses;       /* Passes over the ring with the Rx interrupt masked. */
+        uint32_t ulBudgetExhausted;  /* Polling passes which used their whole budget. */
+    } EMACRxPollStatus_t;
+
+/* Change the number of frames read per pass, returns pdFAIL for a zero budget. */
+    BaseType_t xSTM32_SetRxPollBudget( NetworkInterface_t * pxInterface,
+                                       UBaseType_t uxBudget );
+
+    UBaseType_t uxSTM32_GetRxPollBudget( const NetworkInterface_t * pxInterface );
+
+    void vSTM32_GetRxPollStatus( const NetworkInterface_t * pxInterface,
+                                 EMACRxPollStatus_t * pxStatus );
+
+/* Copy-break: UDP frames for a bound socket of at most this many bytes are copied into a small
+ * network buffer. Returns pdFAIL above ipconfigSMALL_NETWORK_BUFFER_SIZE, zero turns it off. */
+    BaseType_t xSTM32_SetRxCopyBreak( NetworkInterface_t * pxInterface,
+                                      UBaseType_t uxThreshold );
+
+    UBaseType_t uxSTM32_GetRxCopyBreak( const NetworkInterface_t * pxInterface );
+
+/* Interface statistics. The counters run freely from start-up and wrap around, so rates are
+ * best taken as the difference between two readings. The high-water marks only ever grow. */
+    typedef struct xEMACStats
+    {
+        uint32_t ulRxFrames;            /* Frames handed to the IP-task. */
+        uint32_t ulRxBytes;             /* Bytes in the frames handed to the IP-task. */
+        uint32_t ulTxFrames;            /* Frames given to the DMA, a TSO super-segment counts once. */
+        uint32_t ulTxBytes;             /* Bytes in the frames given to the DMA. */
+        uint32_t ulRxDropErrors;        /* Frames received with an error, e.g. CRC, length or overflow. */
+        uint32_t ulRxDropOversize;      /* Frames longer than their network buffer. */
+        uint32_t ulRxDropFiltered;      /* Frames rejected by the frame type or packet filter. */
+        uint32_t ulRxDropNoDescriptor;  /* Frames the DMA dropped because the Rx ring was full, counted when the EMAC task refills it. */
+        uint32_t ulRxAllocFailures;     /* Rx descriptor refills which found no network buffer. */
+        uint32_t ulRxChainedFrames;     /* Frames spread over several Rx buffers, gathered into one. */
+        uint32_t ulRxChainDropNoBuffer; /* Frames spread over several Rx buffers, dropped for want of a network buffer. */
+        uint32_t ulRxCopyBreakFrames;   /* Small frames copied into a small network buffer. */
+        uint32_t ulRxCopyBreakNoBuffer; /* Small frames passed up in their large buffer for want of a small one. */
+        uint32_t ulTxDropInvalid;       /* Frames refused for an invalid descriptor or length. */
+        uint32_t ulTxDropLinkDown;      /* Frames refused or flushed while the link or interface was down. */
+        uint32_t ulTxDropQueueFull;     /* Frames refused because the Tx queue stayed full. */
+        uint32_t ulTxDropDmaError;      /* Frames the DMA failed to take. */
+        uint32_t ulRxDescHighWater;     /* Most frames collected from the Rx ring by one read. */
+        uint32_t ulTxDescHighWater;     /* Most Tx descriptors in use at once. */
+        uint32_t ulTxInterrupts;        /* Tx completion interrupts, fewer than ulTxFrames while they are coalesced. */
+        uint32_t ulDmaRxUnavailable;    /* Rx buffer unavailable, the DMA found no free Rx descriptor. */
+        uint32_t ulDmaTxUnavailable;    /* Tx buffer unavailable, the DMA found no more frames to send. */
+        uint32_t ulDmaOtherErrors;      /* Other abnormal DMA interrupts, e.g. receive watchdog timeout. */
+        uint32_t ulDmaFatalErrors;      /* Fatal bus errors, which stop the DMA. */
+        uint32_t ulMacErrors;           /* MAC errors, e.g. transmit jabber or receive watchdog. */
+        uint32_t ulRecoveryRestarts;    /* Fatal errors recovered by restarting the DMA alone. */
+        uint32_t ulRecoveryResets;      /* Re-initialisations of the EMAC after a fatal error the DMA restart could not clear. */
+        uint32_t ulRecoveryLastMs;      /* Time from the last fatal error to its recovery. */
+        uint32_t ulRecoveryMaxMs;       /* Longest time from a fatal error to its recovery. */
+        uint32_t ulLinkStatusReads;     /* PHY registers read by the link monitor. */
+        uint32_t ulMdioTimeouts;        /* Link monitor reads abandoned with the MDIO bus still busy. */
+        uint32_t ulPhyInterrupts;       /* Link changes signalled by the PHY interrupt. */
+        uint32_t ulPhyCacheHits;        /* PHY starts which reused the link negotiated before a warm reset. */
+        uint32_t ulBootLinkUpMs;        /* Time from the scheduler start to the first link up. */
+        uint32_t ulBootFirstTxMs;       /* Time from the scheduler start to the first frame given to the DMA. */
+    } EMACStats_t;
+
+    void vSTM32_GetStats( const NetworkInterface_t * pxInterface,
+                          EMACStats_t * pxStats );
+
+/* PHY interrupt, used when niEMAC_PHY_INTERRUPT is enabled. The link is then read over MDIO
+ * only when the PHY signals a change, or now and then while it is down. The application wires
+ * the PHY interrupt output to an EXTI line and calls this from its interrupt handler. */
+    void vSTM32_PhyIRQHandler( NetworkInterface_t * pxInterface );
+
+/* Hardware timestamping, provided when niEMAC_TIMESTAMPING is enabled. The EMAC clock starts
+ * from zero and stamps frames as they pass the MAC. Rx timestamps are kept with the network
+ * buffer of a frame, so they are read through the payload of a UDP message received with
+ * FREERTOS_ZERO_COPY. Tx timestamps are requested on a zero-copy payload before it is sent. */
+    typedef struct xEMACTimestamp
+    {
+        uint32_t ulSeconds;
+        uint32_t ulNanoseconds;
+    } EMACTimestamp_t;
+
+/* Returns pdFAIL when the frame holding the payload was not stamped. */
+    BaseType_t xSTM32_GetRxTimestamp( const void * pvUDPPayload,
+                                      EMACTimestamp_t * pxTimestamp );
+
+/* Stamp the frame that will carry a payload from FreeRTOS_GetUDPPayloadBuffer_Multi. */
+    BaseType_t xSTM32_RequestTxTimestamp( const void * pvUDPPayload );
+
+/* Take the timestamp of the latest stamped frame sent, returns pdFAIL when there is none
+ * left to take. A frame stamped before the previous one was taken overwrites it. */
+    BaseType_t xSTM32_GetTxTimestamp( NetworkInterface_t * pxInterface,
+                                      EMACTimestamp_t * pxTimestamp );
+
+    void vSTM32_GetTime( const NetworkInterface_t * pxInterface,
+                         EMACTimestamp_t * pxTime );
+
+/* Step the clock by a signed number of nanoseconds, returns pdFAIL when the EMAC never took
+ * the update. */
+    BaseType_t xSTM32_AdjustTime( NetworkInterface_t * pxInterface,
+                                  int64_t llOffsetNs );
+
+/* Trim the clock rate in parts per billion, returns pdFAIL beyond niEMAC_PTP_MAX_PPB or when
+ * the EMAC never took the update. */
+    BaseType_t xSTM32_AdjustFrequency( NetworkInterface_t * pxInterface,
+                                       int32_t lFrequencyPpb );
+
+/* Timestamps of a PTP style delay request-response exchange: the master sends a Sync at
+ * xT1 which arrives at xT2, the slave answers with a Delay_Req sent at xT3 which arrives
+ * at xT4. xT1 and xT4 are taken by the master, xT2 and xT3 by this interface. */
+    typedef struct xEMACPtpExchange
+    {
+        EMACTimestamp_t xT1;
+        EMACTimestamp_t xT2;
+        EMACTimestamp_t xT3;
+        EMACTimestamp_t xT4;
+    } EMACPtpExchange_t;
+
+    typedef struct xEMACPtpResult
+    {
+        int64_t llOffsetNs;     /* Local clock minus the master's, before correction. */
+        int64_t llDelayNs;      /* One-way path delay. */
+        int32_t lFrequencyPpb;  /* Trim in use after correction. */
+        BaseType_t xStepped;    /* The offset was too large to slew, the clock was stepped. */
+    } EMACPtpResult_t;
+
+/* Discipline the clock from one exchange, assuming exchanges about once a second. Large
+ * offsets step the clock, small ones are slewed out by a proportional-integral frequency
+ * trim. Returns pdFAIL for a negative path delay, which leaves the clock alone, or when the
+ * correction could not be applied. */
+    BaseType_t xSTM32_PtpSync( NetworkInterface_t * pxInterface,
+                               const EMACPtpExchange_t * pxExchange,
+                               EMACPtpResult_t * pxResult );
+
+    #ifdef __cplusplus
+}     /* extern "C" */
+    #endif
+
+#endif /* NETWORKINTERFACE_STM32_H */
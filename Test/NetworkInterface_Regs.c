@@ -55,6 +55,7 @@
 #include "NetworkBufferManagement.h"
 #include "NetworkInterface.h"
 #include "phyHandling.h"
+#include "NetworkInterface_STM32.h"
 
 /* ST includes. */
 #if defined( STM32F4 )
@@ -71,6 +72,8 @@
     #error "Unknown STM32 Family for NetworkInterface"
 #endif
 
+#if ipconfigIS_ENABLED( niEMAC_REGISTER_DRIVER )
+
 #if defined( STM32H5 ) || defined( STM32H7 )
     /* #ifdef LAN8742A_PHY_ADDRESS */
     #include "lan8742/lan8742.h"
@@ -229,6 +232,8 @@
 
 #define niEMAC_DATA_BUFFER_SIZE     ( ( ipTOTAL_ETHERNET_FRAME_SIZE + niEMAC_DATA_ALIGNMENT_MASK ) & ~niEMAC_DATA_ALIGNMENT_MASK )
 #define niEMAC_TOTAL_BUFFER_SIZE    ( ( ( niEMAC_DATA_BUFFER_SIZE + ipBUFFER_PADDING ) + niEMAC_BUF_ALIGNMENT_MASK ) & ~niEMAC_BUF_ALIGNMENT_MASK )
+#define niEMAC_SMALL_TOTAL_BUFFER_SIZE   ( ( ( ipconfigSMALL_NETWORK_BUFFER_SIZE + ipBUFFER_PADDING ) + niEMAC_BUF_ALIGNMENT_MASK ) & ~niEMAC_BUF_ALIGNMENT_MASK )
+#define niEMAC_MEDIUM_TOTAL_BUFFER_SIZE  ( ( ( ipconfigMEDIUM_NETWORK_BUFFER_SIZE + ipBUFFER_PADDING ) + niEMAC_BUF_ALIGNMENT_MASK ) & ~niEMAC_BUF_ALIGNMENT_MASK )
 
 #if defined( niEMAC_STM32FX )
 
@@ -565,6 +570,7 @@ static void prvRemoveDestMACAddrHash( ETH_TypeDef * const pxEthInstance, const u
 /* EMAC Helpers */
 static void prvReleaseTxPacket( ETH_HandleTypeDef * pxEthHandle );
 static BaseType_t prvMacUpdateConfig( ETH_HandleTypeDef * pxEthHandle, EthernetPhy_t * pxPhyObject );
+static BaseType_t prvEthRecover( ETH_HandleTypeDef * pxEthHandle, NetworkInterface_t * pxInterface );
 static void prvReleaseNetworkBufferDescriptor( NetworkBufferDescriptor_t * const pxDescriptor );
 static void prvSendRxEvent( NetworkBufferDescriptor_t * const pxDescriptor );
 static BaseType_t prvAcceptPacket( const NetworkBufferDescriptor_t * const pxDescriptor, uint16_t usLength );
@@ -574,6 +580,7 @@ static BaseType_t prvHAL_ETH_Init( ETH_HandleTypeDef * const pxEthHandle, Networ
 static BaseType_t prvHAL_ETH_Start_IT( ETH_HandleTypeDef * const pxEthHandle );
 static BaseType_t prvHAL_ETH_Stop_IT( ETH_HandleTypeDef * const pxEthHandle );
 static BaseType_t prvHAL_ETH_ReadData( ETH_HandleTypeDef * const pxEthHandle, void ** ppvBuff );
+static BaseType_t prvHAL_ETH_Transmit_IT( ETH_HandleTypeDef * const pxEthHandle, const ETH_TxPacketConfig * const pxTxConfig );
 static void prvHAL_ETH_ReleaseTxPacket( ETH_HandleTypeDef * const pxEthHandle );
 static void prvETH_DMATxDescListInit( ETH_HandleTypeDef * const pxEthHandle );
 static void prvETH_DMARxDescListInit( ETH_HandleTypeDef * const pxEthHandle );
@@ -619,7 +626,6 @@ static eMAC_INIT_STATUS_TYPE xMacInitStatus = eMacEthInit;
 
 /* Src Mac Matching */
 static uint8_t ucSrcMatchCounters[ niEMAC_MAC_MATCH_COUNT ] = { 0U };
-static uint8_t uxMACEntryIndex = 0;
 
 /* Src Mac Hashing */
 static uint32_t ulHashTable[ niEMAC_ADDRESS_HASH_BITS / 32 ];
@@ -645,6 +651,43 @@ void vNetworkInterfaceAllocateRAMToBuffers( NetworkBufferDescriptor_t pxNetworkB
     }
 }
 
+/*---------------------------------------------------------------------------*/
+
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+void vNetworkInterfaceAllocateRAMToSmallBuffers( NetworkBufferDescriptor_t pxSmallNetworkBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    /* Same section as the large buffers, small buffers are also handed to the Tx DMA */
+    static uint8_t ucSmallPackets[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ][ niEMAC_SMALL_TOTAL_BUFFER_SIZE ] __ALIGNED( niEMAC_BUF_ALIGNMENT ) __attribute__( ( section( niEMAC_BUFFERS_SECTION ) ) );
+
+    size_t uxIndex;
+    for( uxIndex = 0; uxIndex < ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS; ++uxIndex )
+    {
+        pxSmallNetworkBuffers[ uxIndex ].pucEthernetBuffer = &( ucSmallPackets[ uxIndex ][ ipBUFFER_PADDING ] );
+        *( ( uint32_t * ) &( ucSmallPackets[ uxIndex ][ 0 ] ) ) = ( uint32_t ) ( &( pxSmallNetworkBuffers[ uxIndex ] ) );
+    }
+}
+
+#endif /* if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 ) */
+
+/*---------------------------------------------------------------------------*/
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+void vNetworkInterfaceAllocateRAMToMediumBuffers( NetworkBufferDescriptor_t pxMediumNetworkBuffers[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    static uint8_t ucMediumPackets[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ][ niEMAC_MEDIUM_TOTAL_BUFFER_SIZE ] __ALIGNED( niEMAC_BUF_ALIGNMENT ) __attribute__( ( section( niEMAC_BUFFERS_SECTION ) ) );
+
+    size_t uxIndex;
+    for( uxIndex = 0; uxIndex < ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS; ++uxIndex )
+    {
+        pxMediumNetworkBuffers[ uxIndex ].pucEthernetBuffer = &( ucMediumPackets[ uxIndex ][ ipBUFFER_PADDING ] );
+        *( ( uint32_t * ) &( ucMediumPackets[ uxIndex ][ 0 ] ) ) = ( uint32_t ) ( &( pxMediumNetworkBuffers[ uxIndex ] ) );
+    }
+}
+
+#endif /* if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 ) */
+
 /*---------------------------------------------------------------------------*/
 /*===========================================================================*/
 /*                      Network Interface Definition                         */
@@ -667,8 +710,8 @@ NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex, Net
     pxInterface->pfInitialise = prvNetworkInterfaceInitialise;
     pxInterface->pfOutput = prvNetworkInterfaceOutput;
     pxInterface->pfGetPhyLinkStatus = prvGetPhyLinkStatus;
-    /* pxInterface->pfAddAllowedMAC = prvAddAllowedMACAddress;
-    pxInterface->pfRemoveAllowedMAC = prvRemoveAllowedMACAddress; */
+    pxInterface->pfAddAllowedMAC = prvAddAllowedMACAddress;
+    pxInterface->pfRemoveAllowedMAC = prvRemoveAllowedMACAddress;
 
     return FreeRTOS_AddNetworkInterface( pxInterface );
 }
@@ -682,7 +725,7 @@ NetworkInterface_t * pxSTM32_FillInterfaceDescriptor( BaseType_t xEMACIndex, Net
  * objects.  See the description in FreeRTOS_Routing.h. */
     NetworkInterface_t * pxFillInterfaceDescriptor( BaseType_t xEMACIndex, NetworkInterface_t * pxInterface )
     {
-        pxSTM32_FillInterfaceDescriptor( xEMACIndex, pxInterface );
+        return pxSTM32_FillInterfaceDescriptor( xEMACIndex, pxInterface );
     }
 
 #endif
@@ -837,16 +880,6 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface, N
             break;
         }
 
-        if( xCheckLoopback( pxDescriptor, xReleaseAfterSend ) != pdFALSE )
-        {
-            /* The packet has been sent back to the IP-task.
-             * The IP-task will further handle it.
-             * Do not release the descriptor. */
-            xReleaseAfterSend = pdFALSE;
-            FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Loopback\n" ) );
-            break;
-        }
-
         if( prvGetPhyLinkStatus( pxInterface ) == pdFALSE )
         {
             FreeRTOS_debug_printf( ( "xNetworkInterfaceOutput: Link Down\n" ) );
@@ -998,7 +1031,7 @@ static BaseType_t prvNetworkInterfaceOutput( NetworkInterface_t * pxInterface, N
             }
         #endif
 
-        if( HAL_ETH_Transmit_IT( pxEthHandle, &xTxConfig ) == HAL_OK )
+        if( prvHAL_ETH_Transmit_IT( pxEthHandle, &xTxConfig ) == pdPASS )
         {
             /* Released later in deferred task by calling HAL_ETH_ReleaseTxPacket */
             xReleaseAfterSend = pdFALSE;
@@ -1159,9 +1192,13 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
                 if( pxEthHandle->gState == HAL_ETH_STATE_ERROR )
                 {
                     /* Recover from critical error */
-                    /* ( void ) prvHAL_ETH_Init( pxEthHandle ); */
-                    ( void ) prvHAL_ETH_Start_IT( pxEthHandle );
-                    xResult = prvNetworkInterfaceInput( pxEthHandle, pxInterface );
+                    if( ( prvEthRecover( pxEthHandle, pxInterface ) != pdFALSE ) && ( prvGetPhyLinkStatus( pxInterface ) != pdFALSE ) )
+                    {
+                        if( prvMacUpdateConfig( pxEthHandle, pxPhyObject ) != pdFALSE )
+                        {
+                            ( void ) prvHAL_ETH_Start_IT( pxEthHandle );
+                        }
+                    }
                 }
             }
 
@@ -1169,6 +1206,12 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
             /* if( ( ulISREvents & eMacEventErrDma ) != 0 ) */
         }
 
+        if( ( pxEthHandle->gState == HAL_ETH_STATE_STARTED ) && ( pxEthHandle->RxDescList.RxBuildDescCnt != 0U ) )
+        {
+            /* Descriptors left without a buffer while the pool was empty */
+            prvETH_UpdateDescriptor( pxEthHandle );
+        }
+
         if( xPhyCheckLinkStatus( pxPhyObject, xResult ) != pdFALSE )
         {
             if( prvGetPhyLinkStatus( pxInterface ) != pdFALSE )
@@ -1176,7 +1219,7 @@ static portTASK_FUNCTION( prvEMACHandlerTask, pvParameters )
                 if( pxEthHandle->gState == HAL_ETH_STATE_ERROR )
                 {
                     /* Recover from critical error */
-                    /* ( void ) prvHAL_ETH_Init( pxEthHandle ); */
+                    ( void ) prvEthRecover( pxEthHandle, pxInterface );
                 }
                 if( pxEthHandle->gState == HAL_ETH_STATE_READY )
                 {
@@ -1313,14 +1356,18 @@ static void prvInitMacAddresses( ETH_TypeDef * const pxEthInstance, NetworkInter
     #endif
 
     #if ipconfigIS_ENABLED( ipconfigUSE_IPv6 )
-        prvAddAllowedMACAddress( pxInterface, pcLOCAL_ALL_NODES_MULTICAST_MAC.ucBytes );
+    {
+        /* All-nodes group ff02::1 */
+        static const uint8_t ucAllNodesMulticastMAC[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 };
+        prvAddAllowedMACAddress( pxInterface, ucAllNodesMulticastMAC );
         #if ipconfigIS_ENABLED( ipconfigUSE_MDNS )
             prvAddAllowedMACAddress( pxInterface, xMDNS_MACAddressIPv6.ucBytes );
         #endif
         #if ipconfigIS_ENABLED( ipconfigUSE_LLMNR )
             prvAddAllowedMACAddress( pxInterface, xLLMNR_MacAddressIPv6.ucBytes );
         #endif
-    #endif
+    }
+    #endif /* if ipconfigIS_ENABLED( ipconfigUSE_IPv6 ) */
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1610,7 +1657,7 @@ static BaseType_t prvAddDestMACAddrMatch( ETH_TypeDef * const pxEthInstance, con
         if( ucSrcMatchCounters[ ucIndex ] > 0U )
         {
             /* ETH_MACA1HR_MBC - Group Address Filtering */
-            const uint32_t ulMacRegHigh = READ_REG( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) );
+            const uint32_t ulMacRegHigh = READ_REG( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) ) & 0xFFFFU;
             const uint32_t ulMacRegLow = READ_REG( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) );
 
             const uint32_t ulMacAddrHigh = ( pucMACAddr[ 5 ] << 8 ) | ( pucMACAddr[ 4 ] );
@@ -1626,10 +1673,6 @@ static BaseType_t prvAddDestMACAddrMatch( ETH_TypeDef * const pxEthInstance, con
                 break;
             }
         }
-        else if( uxMACEntryIndex > niEMAC_MAC_MATCH_COUNT )
-        {
-            uxMACEntryIndex = niEMAC_MAC_MATCH_COUNT;
-        }
     }
 
     return xResult;
@@ -1647,7 +1690,7 @@ static BaseType_t prvRemoveDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
         if( ucSrcMatchCounters[ ucIndex ] > 0U )
         {
             /* ETH_MACA1HR_MBC - Group Address Filtering */
-            const uint32_t ulMacRegHigh = READ_REG( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) );
+            const uint32_t ulMacRegHigh = READ_REG( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) ) & 0xFFFFU;
             const uint32_t ulMacRegLow = READ_REG( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) );
 
             const uint32_t ulMacAddrHigh = ( pucMACAddr[ 5 ] << 8 ) | ( pucMACAddr[ 4 ] );
@@ -1678,13 +1721,19 @@ static BaseType_t prvSetNewDestMACAddrMatch( ETH_TypeDef * const pxEthInstance,
 {
     BaseType_t xResult = pdFALSE;
 
-    if( uxMACEntryIndex < niEMAC_MAC_MATCH_COUNT )
+    /* An address whose hash bit is already in use stays in the hash filter. */
+    if( ucAddrHashCounters[ ucHashIndex ] == 0U )
     {
-        if( ucAddrHashCounters[ ucHashIndex ] == 0U )
+        uint8_t ucIndex;
+        for( ucIndex = 0; ucIndex < niEMAC_MAC_MATCH_COUNT; ++ucIndex )
         {
-            prvHAL_ETH_SetDestMACAddrMatch( pxEthInstance, uxMACEntryIndex, pucMACAddr );
-            ucSrcMatchCounters[ uxMACEntryIndex ] = 1U;
-            xResult = pdTRUE;
+            if( ucSrcMatchCounters[ ucIndex ] == 0U )
+            {
+                prvHAL_ETH_SetDestMACAddrMatch( pxEthInstance, ucIndex, pucMACAddr );
+                ucSrcMatchCounters[ ucIndex ] = 1U;
+                xResult = pdTRUE;
+                break;
+            }
         }
     }
 
@@ -1802,6 +1851,85 @@ static BaseType_t prvMacUpdateConfig( ETH_HandleTypeDef * pxEthHandle, EthernetP
         CLEAR_BIT( pxEthHandle->Instance->MACCR, ETH_MACCR_FES );
     }
 
+    if( pxEthHandle->gState == HAL_ETH_STATE_READY )
+    {
+        xResult = pdTRUE;
+    }
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BaseType_t prvEthRecover( ETH_HandleTypeDef * pxEthHandle, NetworkInterface_t * pxInterface )
+{
+    BaseType_t xResult = pdFALSE;
+    ETH_TypeDef * const pxEthInstance = pxEthHandle->Instance;
+
+    /* The software reset in prvHAL_ETH_Init clears the destination address filters, keep
+     * the entries added since start-up so they can be restored as they were. */
+    uint32_t ulMatchHigh[ niEMAC_MAC_MATCH_COUNT ];
+    uint32_t ulMatchLow[ niEMAC_MAC_MATCH_COUNT ];
+    uint8_t ucMatchCounters[ niEMAC_MAC_MATCH_COUNT ];
+    uint32_t ulHashes[ niEMAC_ADDRESS_HASH_BITS / 32 ];
+    uint8_t ucHashCounters[ niEMAC_ADDRESS_HASH_BITS ];
+
+    uint8_t ucIndex;
+    for( ucIndex = 0; ucIndex < niEMAC_MAC_MATCH_COUNT; ++ucIndex )
+    {
+        ulMatchHigh[ ucIndex ] = READ_REG( *( __IO uint32_t * ) ( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) ) );
+        ulMatchLow[ ucIndex ] = READ_REG( *( __IO uint32_t * ) ( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) ) );
+    }
+    ( void ) memcpy( ucMatchCounters, ucSrcMatchCounters, sizeof( ucMatchCounters ) );
+    ( void ) memcpy( ulHashes, ulHashTable, sizeof( ulHashes ) );
+    ( void ) memcpy( ucHashCounters, ucAddrHashCounters, sizeof( ucHashCounters ) );
+
+    /* Give back every buffer still held by the descriptors, the lists are rebuilt from scratch. */
+    size_t uxDesc;
+    for( uxDesc = 0; uxDesc < ETH_TX_DESC_CNT; ++uxDesc )
+    {
+        if( pxEthHandle->TxDescList.PacketAddress[ uxDesc ] != NULL )
+        {
+            HAL_ETH_TxFreeCallback( pxEthHandle->TxDescList.PacketAddress[ uxDesc ] );
+            pxEthHandle->TxDescList.PacketAddress[ uxDesc ] = NULL;
+        }
+    }
+
+    for( uxDesc = 0; uxDesc < ETH_RX_DESC_CNT; ++uxDesc )
+    {
+        ETH_DMADescTypeDef * const dmarxdesc = ( ETH_DMADescTypeDef * ) pxEthHandle->RxDescList.RxDesc[ uxDesc ];
+        if( ( dmarxdesc != NULL ) && ( dmarxdesc->BackupAddr0 != 0U ) )
+        {
+            prvReleaseNetworkBufferDescriptor( pxPacketBuffer_to_NetworkBuffer( ( const void * ) dmarxdesc->BackupAddr0 ) );
+            dmarxdesc->BackupAddr0 = 0U;
+        }
+    }
+
+    if( pxEthHandle->RxDescList.pRxStart != NULL )
+    {
+        prvReleaseNetworkBufferDescriptor( ( NetworkBufferDescriptor_t * ) pxEthHandle->RxDescList.pRxStart );
+    }
+
+    if( prvHAL_ETH_Init( pxEthHandle, pxInterface ) != pdFAIL )
+    {
+        ( void ) memcpy( ucSrcMatchCounters, ucMatchCounters, sizeof( ucSrcMatchCounters ) );
+        ( void ) memcpy( ulHashTable, ulHashes, sizeof( ulHashTable ) );
+        ( void ) memcpy( ucAddrHashCounters, ucHashCounters, sizeof( ucAddrHashCounters ) );
+
+        for( ucIndex = 0; ucIndex < niEMAC_MAC_MATCH_COUNT; ++ucIndex )
+        {
+            WRITE_REG( *( __IO uint32_t * ) ( ( uint32_t ) &( pxEthInstance->MACA1HR ) + ( 8 * ucIndex ) ), ulMatchHigh[ ucIndex ] );
+            WRITE_REG( *( __IO uint32_t * ) ( ( uint32_t ) &( pxEthInstance->MACA1LR ) + ( 8 * ucIndex ) ), ulMatchLow[ ucIndex ] );
+        }
+        prvHAL_ETH_SetHashTable( pxEthInstance );
+
+        xResult = pdTRUE;
+    }
+    else
+    {
+        FreeRTOS_debug_printf( ( "prvEthRecover: Failed\n" ) );
+    }
+
     return xResult;
 }
 
@@ -1951,14 +2079,6 @@ static BaseType_t prvAcceptPacket( const NetworkBufferDescriptor_t * const pxDes
 
                 }
 			#endif
-
-			/* TODO: Create a eConsiderPacketForProcessing */
-            if( eConsiderPacketForProcessing( pxDescriptor->pucEthernetBuffer ) != eProcessBuffer )
-            {
-            	iptraceETHERNET_RX_EVENT_LOST();
-                FreeRTOS_debug_printf( ( "prvAcceptPacket: Packet discarded\n" ) );
-                break;
-            }
         #endif
 
         xResult = pdTRUE;
@@ -2029,11 +2149,16 @@ void ETH_IRQHandler( void )
 		{
 			if( __HAL_ETH_DMA_GET_IT_SOURCE( pxEthHandle, ETH_DMAIER_AISE ) )
 			{
+                const uint32_t ulDmaStatus = READ_REG( pxEthHandle->Instance->DMASR );
+
 				if( __HAL_ETH_DMA_GET_IT( pxEthHandle, ETH_DMASR_FBES ) )
 				{
 					if( __HAL_ETH_DMA_GET_IT_SOURCE( pxEthHandle, ETH_DMAIER_FBEIE ) )
                     {
                         __HAL_ETH_DMA_CLEAR_IT( pxEthHandle, ETH_DMASR_FBES );
+                        /* The DMA stops on a bus error, the EMAC task must reinitialise it. */
+                        __HAL_ETH_DMA_DISABLE_IT( pxEthHandle, ( ETH_DMAIER_NISE | ETH_DMAIER_AISE ) );
+                        pxEthHandle->gState = HAL_ETH_STATE_ERROR;
                     }
                 }
 
@@ -2101,6 +2226,10 @@ void ETH_IRQHandler( void )
                     }
                 }
 
+                pxEthHandle->ErrorCode |= HAL_ETH_ERROR_DMA;
+                pxEthHandle->DMAErrorCode = ulDmaStatus;
+                HAL_ETH_ErrorCallback( pxEthHandle );
+
 				__HAL_ETH_DMA_CLEAR_IT( pxEthHandle, ETH_DMASR_AIS );
 			}
 		}
@@ -2160,12 +2289,16 @@ void ETH_IRQHandler( void )
             {
                 if( __HAL_ETH_DMA_GET_IT_SOURCE( pxEthHandle, ETH_DMACIER_AIE ) )
                 {
+                    const uint32_t ulDmaStatus = READ_REG( pxEthHandle->Instance->DMACSR );
+
                     if( __HAL_ETH_DMA_GET_IT( pxEthHandle, ETH_DMACSR_FBE ) )
                     {
                     	if( __HAL_ETH_DMA_GET_IT_SOURCE( pxEthHandle, ETH_DMACIER_FBEE ) )
 						{
 							__HAL_ETH_DMA_CLEAR_IT( pxEthHandle, ETH_DMACSR_FBE );
-							/* prvHAL_MAC_ErrorCallback( pxEthHandle ); */
+                            /* The DMA stops on a bus error, the EMAC task must reinitialise it. */
+                            __HAL_ETH_DMA_DISABLE_IT( pxEthHandle, ( ETH_DMACIER_NIE | ETH_DMACIER_AIE ) );
+                            pxEthHandle->gState = HAL_ETH_STATE_ERROR;
 						}
                     }
 
@@ -2217,6 +2350,10 @@ void ETH_IRQHandler( void )
 						}
 					}
 
+                    pxEthHandle->ErrorCode |= HAL_ETH_ERROR_DMA;
+                    pxEthHandle->DMAErrorCode = ulDmaStatus;
+                    HAL_ETH_ErrorCallback( pxEthHandle );
+
                     __HAL_ETH_DMA_CLEAR_IT( pxEthHandle, ETH_DMACSR_AIS );
                 }
             }
@@ -2370,7 +2507,8 @@ void HAL_ETH_TxCpltCallback( ETH_HandleTypeDef * pxEthHandle )
 
 void HAL_ETH_RxAllocateCallback( uint8_t ** ppucBuff )
 {
-    const NetworkBufferDescriptor_t * pxBufferDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_DATA_BUFFER_SIZE, pdMS_TO_TICKS( niEMAC_DESCRIPTOR_WAIT_TIME_MS ) );
+    /* Never block, descriptors left without a buffer are refilled later by the EMAC task. */
+    const NetworkBufferDescriptor_t * pxBufferDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_DATA_BUFFER_SIZE, 0U );
     if( pxBufferDescriptor != NULL )
     {
         #ifdef niEMAC_CACHEABLE
@@ -2394,6 +2532,12 @@ void HAL_ETH_RxLinkCallback( void ** ppvStart, void ** ppvEnd, uint8_t * pucBuff
     NetworkBufferDescriptor_t ** const ppxStartDescriptor = ( NetworkBufferDescriptor_t ** ) ppvStart;
     NetworkBufferDescriptor_t ** const ppxEndDescriptor = ( NetworkBufferDescriptor_t ** ) ppvEnd;
     NetworkBufferDescriptor_t * const pxCurDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) pucBuff );
+    #ifdef niEMAC_CACHEABLE
+        if( niEMAC_CACHE_MAINTENANCE != 0 )
+        {
+            SCB_InvalidateDCache_by_Addr( ( uint32_t * ) pucBuff, usLength );
+        }
+    #endif
     if( prvAcceptPacket( pxCurDescriptor, usLength ) == pdTRUE )
     {
         pxCurDescriptor->xDataLength = usLength;
@@ -2413,12 +2557,6 @@ void HAL_ETH_RxLinkCallback( void ** ppvStart, void ** ppvEnd, uint8_t * pucBuff
         *ppxEndDescriptor = pxCurDescriptor;
         /* Only single buffer packets are supported */
         configASSERT( *ppxStartDescriptor == *ppxEndDescriptor );
-        #ifdef niEMAC_CACHEABLE
-            if( niEMAC_CACHE_MAINTENANCE != 0 )
-            {
-                SCB_InvalidateDCache_by_Addr( ( uint32_t * ) pucBuff, usLength );
-            }
-        #endif
     }
     else
     {
@@ -2682,7 +2820,7 @@ static BaseType_t prvHAL_ETH_Init( ETH_HandleTypeDef * const pxEthHandle, Networ
         pxEthHandle->gState = HAL_ETH_STATE_READY;
     }
 
-    return HAL_OK;
+    return xResult;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -2750,7 +2888,8 @@ static BaseType_t prvHAL_ETH_Stop_IT( ETH_HandleTypeDef * const pxEthHandle )
             SET_BIT( pxEthHandle->Instance->DMAOMR, ETH_DMAOMR_FTF );
         #elif defined( niEMAC_STM32HX )
             __HAL_ETH_DMA_DISABLE_IT( pxEthHandle, ( ETH_DMACIER_NIE | ETH_DMACIER_RIE | ETH_DMACIER_TIE | ETH_DMACIER_FBEE | ETH_DMACIER_AIE | ETH_DMACIER_RBUE ) );
-            CLEAR_BIT( pxEthHandle->Instance->DMACTCR, ETH_DMACTCR_ST | ETH_DMACRCR_SR );
+            CLEAR_BIT( pxEthHandle->Instance->DMACTCR, ETH_DMACTCR_ST );
+            CLEAR_BIT( pxEthHandle->Instance->DMACRCR, ETH_DMACRCR_SR );
             SET_BIT( pxEthHandle->Instance->MTLTQOMR, ETH_MTLTQOMR_FTQ );
         #endif
         CLEAR_BIT( pxEthHandle->Instance->MACCR, ETH_MACCR_RE | ETH_MACCR_TE );
@@ -2831,6 +2970,8 @@ static BaseType_t prvHAL_ETH_ReadData( ETH_HandleTypeDef * const pxEthHandle, vo
             #ifdef niEMAC_STM32FX
                 WRITE_REG( dmarxdesc->BackupAddr0, dmarxdesc->DESC2 );
             #endif
+            /* prvAcceptPacket checks the status of the descriptor at RxDescIdx. */
+            dmarxdesclist->RxDescIdx = descidx;
             HAL_ETH_RxLinkCallback( &dmarxdesclist->pRxStart, &dmarxdesclist->pRxEnd, ( uint8_t * ) dmarxdesc->BackupAddr0, ( uint16_t ) bufflength );
             ++( dmarxdesclist->RxDescCnt );
             dmarxdesclist->RxDataLength += bufflength;
@@ -2863,6 +3004,101 @@ static BaseType_t prvHAL_ETH_ReadData( ETH_HandleTypeDef * const pxEthHandle, vo
 
 /*---------------------------------------------------------------------------*/
 
+static BaseType_t prvHAL_ETH_Transmit_IT( ETH_HandleTypeDef * const pxEthHandle, const ETH_TxPacketConfig * const pxTxConfig )
+{
+    configASSERT( pxTxConfig->TxBuffer->next == NULL );
+    configASSERT( ( pxTxConfig->Attributes & ETH_TX_PACKETS_FEATURES_TSO ) == 0 );
+
+    BaseType_t xResult = pdFAIL;
+
+    ETH_TxDescListTypeDef * const dmatxdesclist = &( pxEthHandle->TxDescList );
+    const uint32_t descidx = dmatxdesclist->CurTxDesc;
+    ETH_DMADescTypeDef * const dmatxdesc = ( ETH_DMADescTypeDef * ) dmatxdesclist->TxDesc[ descidx ];
+    const ETH_BufferTypeDef * const txbuffer = pxTxConfig->TxBuffer;
+
+    do
+    {
+        if( pxEthHandle->gState != HAL_ETH_STATE_STARTED )
+        {
+            break;
+        }
+
+        #ifdef niEMAC_STM32FX
+            if( ( READ_BIT( dmatxdesc->DESC0, ETH_DMATXDESC_OWN ) != 0U ) || ( dmatxdesclist->PacketAddress[ descidx ] != NULL ) )
+        #elif defined( niEMAC_STM32HX )
+            if( ( READ_BIT( dmatxdesc->DESC3, ETH_DMATXNDESCRF_OWN ) != 0U ) || ( dmatxdesclist->PacketAddress[ descidx ] != NULL ) )
+        #endif
+        {
+            pxEthHandle->ErrorCode |= HAL_ETH_ERROR_BUSY;
+            break;
+        }
+
+        /* Every frame takes a single descriptor, so the control words are written in one go
+         * and ownership is handed over last. */
+        #ifdef niEMAC_STM32FX
+            uint32_t ulDesc0 = READ_REG( dmatxdesc->DESC0 ) & ETH_DMATXDESC_TCH;
+            if( READ_BIT( pxTxConfig->Attributes, ETH_TX_PACKETS_FEATURES_CSUM ) != 0U )
+            {
+                ulDesc0 |= pxTxConfig->ChecksumCtrl & ETH_DMATXDESC_CIC;
+            }
+            if( READ_BIT( pxTxConfig->Attributes, ETH_TX_PACKETS_FEATURES_CRCPAD ) != 0U )
+            {
+                ulDesc0 |= pxTxConfig->CRCPadCtrl & ETH_CRC_PAD_DISABLE;
+            }
+            ulDesc0 |= ETH_DMATXDESC_FS | ETH_DMATXDESC_LS | ETH_DMATXDESC_IC;
+
+            WRITE_REG( dmatxdesc->DESC2, ( uint32_t ) txbuffer->buffer );
+            WRITE_REG( dmatxdesc->DESC1, txbuffer->len & ETH_DMATXDESC_TBS1 );
+            WRITE_REG( dmatxdesc->DESC0, ulDesc0 );
+            __DMB();
+            SET_BIT( dmatxdesc->DESC0, ETH_DMATXDESC_OWN );
+        #elif defined( niEMAC_STM32HX )
+            uint32_t ulDesc3 = ETH_DMATXNDESCRF_FD | ETH_DMATXNDESCRF_LD | ( txbuffer->len & ETH_DMATXNDESCRF_FL );
+            if( READ_BIT( pxTxConfig->Attributes, ETH_TX_PACKETS_FEATURES_CSUM ) != 0U )
+            {
+                ulDesc3 |= pxTxConfig->ChecksumCtrl & ETH_DMATXNDESCRF_CIC;
+            }
+            if( READ_BIT( pxTxConfig->Attributes, ETH_TX_PACKETS_FEATURES_CRCPAD ) != 0U )
+            {
+                ulDesc3 |= pxTxConfig->CRCPadCtrl & ETH_DMATXNDESCRF_CPC;
+            }
+
+            WRITE_REG( dmatxdesc->DESC0, ( uint32_t ) txbuffer->buffer );
+            WRITE_REG( dmatxdesc->DESC1, 0U );
+            WRITE_REG( dmatxdesc->DESC2, ETH_DMATXNDESCRF_IOC | ( txbuffer->len & ETH_DMATXNDESCRF_B1L ) );
+            WRITE_REG( dmatxdesc->DESC3, ulDesc3 );
+            __DMB();
+            SET_BIT( dmatxdesc->DESC3, ETH_DMATXNDESCRF_OWN );
+        #endif
+
+        dmatxdesclist->PacketAddress[ descidx ] = pxTxConfig->pData;
+        dmatxdesclist->CurTxDesc = descidx;
+        INCR_TX_DESC_INDEX( dmatxdesclist->CurTxDesc, 1U );
+
+        portDISABLE_INTERRUPTS();
+        ++( dmatxdesclist->BuffersInUse );
+        portENABLE_INTERRUPTS();
+
+        __DSB();
+
+        #ifdef niEMAC_STM32FX
+            if( READ_BIT( pxEthHandle->Instance->DMASR, ETH_DMASR_TBUS ) != 0U )
+            {
+                WRITE_REG( pxEthHandle->Instance->DMASR, ETH_DMASR_TBUS );
+                WRITE_REG( pxEthHandle->Instance->DMATPDR, 0U );
+            }
+        #elif defined( niEMAC_STM32HX )
+            WRITE_REG( pxEthHandle->Instance->DMACTDTPR, ( uint32_t ) dmatxdesclist->TxDesc[ dmatxdesclist->CurTxDesc ] );
+        #endif
+
+        xResult = pdPASS;
+    } while( pdFALSE );
+
+    return xResult;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void prvHAL_ETH_ReleaseTxPacket( ETH_HandleTypeDef * const pxEthHandle )
 {
     ETH_TxDescListTypeDef * const dmatxdesclist = &( pxEthHandle->TxDescList );
@@ -2876,7 +3112,7 @@ static void prvHAL_ETH_ReleaseTxPacket( ETH_HandleTypeDef * const pxEthHandle )
         --numOfBuf;
         if( dmatxdesclist->PacketAddress[ idx ] == NULL )
         {
-            idx = ( idx + 1U ) & ( ETH_TX_DESC_CNT - 1U );
+            INCR_TX_DESC_INDEX( idx, 1U );
             pktInUse = 0U;
         }
 
@@ -2890,7 +3126,7 @@ static void prvHAL_ETH_ReleaseTxPacket( ETH_HandleTypeDef * const pxEthHandle )
             {
                 HAL_ETH_TxFreeCallback( dmatxdesclist->PacketAddress[ idx ] );
                 dmatxdesclist->PacketAddress[ idx ] = NULL;
-                idx = ( idx + 1U ) & ( ETH_TX_DESC_CNT - 1U );
+                INCR_TX_DESC_INDEX( idx, 1U );
                 dmatxdesclist->BuffersInUse = numOfBuf;
                 dmatxdesclist->releaseIndex = idx;
             }
@@ -2993,19 +3229,18 @@ static void prvETH_DMATxDescListInit( ETH_HandleTypeDef * const pxEthHandle )
 
 		#ifdef niEMAC_STM32FX
         	SET_BIT( dmatxdesc->DESC0, ETH_DMATXDESC_TCH );
-		#elif defined( niEMAC_STM32HX )
 
+            if( i < ( ETH_TX_DESC_CNT - 1U ) )
+            {
+                WRITE_REG( dmatxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.TxDesc[ i + 1U ] ) );
+            }
+            else
+            {
+                WRITE_REG( dmatxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.TxDesc[ 0 ] ) );
+            }
 		#endif
 
-        if( i < ( ETH_TX_DESC_CNT - 1U ) )
-        {
-            WRITE_REG( dmatxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.TxDesc[ i + 1U ] ) );
-        }
-        else
-        {
-            WRITE_REG( dmatxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.TxDesc[ 0 ] ) );
-        }
-
+        pxEthHandle->TxDescList.PacketAddress[ i ] = NULL;
 
         #if ipconfigIS_ENABLED( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM )
 			#ifdef niEMAC_STM32FX
@@ -3017,6 +3252,8 @@ static void prvETH_DMATxDescListInit( ETH_HandleTypeDef * const pxEthHandle )
     }
 
     pxEthHandle->TxDescList.CurTxDesc = 0;
+    pxEthHandle->TxDescList.BuffersInUse = 0;
+    pxEthHandle->TxDescList.releaseIndex = 0;
 
     #ifdef niEMAC_STM32FX
         WRITE_REG( pxEthHandle->Instance->DMATDLAR, ( uint32_t ) &( pxEthHandle->Init.TxDesc[ 0 ] ) );
@@ -3046,20 +3283,18 @@ static void prvETH_DMARxDescListInit( ETH_HandleTypeDef * const pxEthHandle )
 		#ifdef niEMAC_STM32FX
 			SET_BIT( dmarxdesc->DESC0, ETH_DMARXDESC_OWN );
 			SET_BIT( dmarxdesc->DESC1, ETH_DMARXDESC_RCH | pxEthHandle->Init.RxBuffLen );
-		#elif defined( niEMAC_STM32HX )
 
+            if( i < ( ETH_RX_DESC_CNT - 1U ) )
+            {
+                WRITE_REG( dmarxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.RxDesc[ i + 1U ] ) );
+            }
+            else
+            {
+                WRITE_REG( dmarxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.RxDesc[ 0 ] ) );
+            }
 		#endif
 
         WRITE_REG( pxEthHandle->RxDescList.RxDesc[ i ], ( uint32_t ) dmarxdesc );
-
-        if( i < ( ETH_RX_DESC_CNT - 1U ) )
-        {
-            WRITE_REG( dmarxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.RxDesc[ i + 1U ] ) );
-        }
-        else
-        {
-            WRITE_REG( dmarxdesc->DESC3, ( uint32_t ) &( pxEthHandle->Init.RxDesc[ 0 ] ) );
-        }
     }
 
     CLEAR_REG( pxEthHandle->RxDescList.RxDescIdx );
@@ -3067,6 +3302,8 @@ static void prvETH_DMARxDescListInit( ETH_HandleTypeDef * const pxEthHandle )
     CLEAR_REG( pxEthHandle->RxDescList.RxBuildDescIdx );
     CLEAR_REG( pxEthHandle->RxDescList.RxBuildDescCnt );
     CLEAR_REG( pxEthHandle->RxDescList.ItMode );
+    pxEthHandle->RxDescList.pRxStart = NULL;
+    pxEthHandle->RxDescList.pRxEnd = NULL;
 
     #ifdef niEMAC_STM32FX
         WRITE_REG( pxEthHandle->Instance->DMARDLAR, ( uint32_t ) &( pxEthHandle->Init.RxDesc[ 0 ] ) );
@@ -3737,3 +3974,5 @@ void MPU_Config(void)
 #endif /* if 0 */
 
 /*---------------------------------------------------------------------------*/
+
+#endif /* if ipconfigIS_ENABLED( niEMAC_REGISTER_DRIVER ) */
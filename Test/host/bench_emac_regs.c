@@ -0,0 +1,314 @@
+/* A/B benchmark of the Rx and Tx paths of the register-level EMAC driver of
+ * Test/NetworkInterface_Regs.c against the ST HAL functions it replaces. Both
+ * run on the driver's own handle, descriptors and buffers, and make the same
+ * HAL_ETH_xxxCallback() calls, so only the descriptor handling differs. The
+ * ETH registers are RAM, and the test plays the DMA between the timed calls:
+ * it hands sent descriptors back and writes received frames into the ring.
+ *
+ * The counts come from the host's cycle counter, they rank the two paths
+ * but are no measure of a Cortex-M7. Each frame is also checked to come out
+ * the same from both. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+    #include <x86intrin.h>
+#endif
+
+/* NetworkInterface_Regs.c is included, so the test can reach the handle and
+ * the reimplemented HAL functions. */
+#include "../NetworkInterface_Regs.c"
+
+#include "fake_registers.h"
+#include "test_support.h"
+
+#define benchFRAMES          20000U
+#define benchFRAME_LENGTH    60U
+
+typedef struct xBENCH_DRIVER
+{
+    const char * pcName;
+    BaseType_t ( * pxTransmit )( ETH_TxPacketConfig * pxTxConfig );
+    void ( * pxReleaseTx )( void );
+    BaseType_t ( * pxReadData )( void ** ppvBuff );
+} BenchDriver_t;
+
+static ETH_DMADescTypeDef xBenchDescTx[ ETH_TX_DESC_CNT ] __ALIGNED( portBYTE_ALIGNMENT );
+static ETH_DMADescTypeDef xBenchDescRx[ ETH_RX_DESC_CNT ] __ALIGNED( portBYTE_ALIGNMENT );
+
+/*-----------------------------------------------------------*/
+
+/* Left by the ST HAL sources, which are built without the rest of the HAL */
+
+uint32_t HAL_GetTick( void )
+{
+    return ( uint32_t ) xTaskGetTickCount();
+}
+
+uint32_t HAL_RCC_GetHCLKFreq( void )
+{
+    return 200000000U;
+}
+
+void HAL_SYSCFG_ETHInterfaceSelect( uint32_t SYSCFG_ETHInterface )
+{
+}
+
+void HAL_NVIC_EnableIRQ( IRQn_Type IRQn )
+{
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRegsTransmit( ETH_TxPacketConfig * pxTxConfig )
+{
+    return prvHAL_ETH_Transmit_IT( &xEthHandle, pxTxConfig );
+}
+
+static void prvRegsReleaseTx( void )
+{
+    prvHAL_ETH_ReleaseTxPacket( &xEthHandle );
+}
+
+static BaseType_t prvRegsReadData( void ** ppvBuff )
+{
+    return prvHAL_ETH_ReadData( &xEthHandle, ppvBuff );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHalTransmit( ETH_TxPacketConfig * pxTxConfig )
+{
+    return ( HAL_ETH_Transmit_IT( &xEthHandle, pxTxConfig ) == HAL_OK ) ? pdPASS : pdFAIL;
+}
+
+static void prvHalReleaseTx( void )
+{
+    ( void ) HAL_ETH_ReleaseTxPacket( &xEthHandle );
+}
+
+static BaseType_t prvHalReadData( void ** ppvBuff )
+{
+    return ( HAL_ETH_ReadData( &xEthHandle, ppvBuff ) == HAL_OK ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static const BenchDriver_t xDrivers[] =
+{
+    { "registers", prvRegsTransmit, prvRegsReleaseTx, prvRegsReadData },
+    { "ST HAL",    prvHalTransmit,  prvHalReleaseTx,  prvHalReadData  },
+};
+
+#define benchDRIVER_COUNT    ( sizeof( xDrivers ) / sizeof( xDrivers[ 0 ] ) )
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvReadCycles( void )
+{
+    #if defined( __x86_64__ ) || defined( __i386__ )
+        return ( uint64_t ) __rdtsc();
+    #else
+        struct timespec xNow;
+
+        ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+        return ( ( uint64_t ) xNow.tv_sec * 1000000000U ) + ( uint64_t ) xNow.tv_nsec;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+/* Sets the handle up as prvHAL_ETH_Init() does, without the MAC reset that
+ * RAM never completes, and starts it, which fills the Rx ring. */
+static void prvSetUp( void )
+{
+    ( void ) xNetworkBuffersInitialise();
+
+    if( xTxDescSem == NULL )
+    {
+        xTxDescSem = xSemaphoreCreateCounting( ( UBaseType_t ) ETH_TX_DESC_CNT, ( UBaseType_t ) ETH_TX_DESC_CNT );
+        configASSERT( xTxDescSem != NULL );
+    }
+
+    ( void ) memset( &xEthHandle, 0, sizeof( xEthHandle ) );
+    xEthHandle.Instance = ETH;
+    xEthHandle.Init.RxBuffLen = niEMAC_DATA_BUFFER_SIZE;
+    xEthHandle.Init.TxDesc = xBenchDescTx;
+    xEthHandle.Init.RxDesc = xBenchDescRx;
+    prvETH_DMATxDescListInit( &xEthHandle );
+    prvETH_DMARxDescListInit( &xEthHandle );
+    xEthHandle.gState = HAL_ETH_STATE_READY;
+
+    const BaseType_t xStarted = prvHAL_ETH_Start_IT( &xEthHandle );
+
+    configASSERT( xStarted == pdPASS );
+}
+/*-----------------------------------------------------------*/
+
+/* Gives back the buffers held by the Rx ring. */
+static void prvTearDown( void )
+{
+    size_t uxDesc;
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xBenchDescRx[ uxDesc ].BackupAddr0 != 0U )
+        {
+            vReleaseNetworkBufferAndDescriptor( pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xBenchDescRx[ uxDesc ].BackupAddr0 ) );
+            xBenchDescRx[ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* The DMA receives a broadcast ARP frame into the next descriptor. */
+static void prvReceiveFrame( void )
+{
+    ETH_DMADescTypeDef * const pxDesc = ( ETH_DMADescTypeDef * ) ( uintptr_t ) xEthHandle.RxDescList.RxDesc[ xEthHandle.RxDescList.RxDescIdx ];
+    EthernetHeader_t * const pxHeader = ( EthernetHeader_t * ) ( uintptr_t ) pxDesc->BackupAddr0;
+
+    ( void ) memset( pxHeader, 0, benchFRAME_LENGTH );
+    ( void ) memset( pxHeader->xDestinationAddress.ucBytes, 0xFF, sizeof( pxHeader->xDestinationAddress ) );
+    pxHeader->usFrameType = ipARP_FRAME_TYPE;
+
+    /* The write-back format, the DMA hands the descriptor back last */
+    pxDesc->DESC0 = 0U;
+    pxDesc->DESC1 = 0U;
+    pxDesc->DESC2 = 0U;
+    pxDesc->DESC3 = ETH_DMARXNDESCWBF_FD | ETH_DMARXNDESCWBF_LD | ( benchFRAME_LENGTH & ETH_DMARXNDESCWBF_PL );
+}
+/*-----------------------------------------------------------*/
+
+/* The DMA has sent every frame given to it. */
+static void prvSendFrames( void )
+{
+    size_t uxDesc;
+
+    for( uxDesc = 0U; uxDesc < ETH_TX_DESC_CNT; uxDesc++ )
+    {
+        xBenchDescTx[ uxDesc ].DESC3 &= ~ETH_DMATXNDESCRF_OWN;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void bench_tx_path( void )
+{
+    uint64_t ullCycles[ benchDRIVER_COUNT ] = { 0U };
+    ETH_DMADescTypeDef xFirstDesc[ benchDRIVER_COUNT ];
+    size_t uxDriver;
+    uint32_t ulFrame;
+
+    for( uxDriver = 0U; uxDriver < benchDRIVER_COUNT; uxDriver++ )
+    {
+        const BenchDriver_t * const pxDriver = &xDrivers[ uxDriver ];
+
+        prvSetUp();
+        const UBaseType_t uxFreeBuffers = uxGetNumberOfFreeNetworkBuffers();
+
+        for( ulFrame = 0U; ulFrame < benchFRAMES; ulFrame++ )
+        {
+            NetworkBufferDescriptor_t * const pxDescriptor = pxGetNetworkBufferWithDescriptor( benchFRAME_LENGTH, 0U );
+            ETH_BufferTypeDef xTxBuffer = { 0 };
+            ETH_TxPacketConfig xTxConfig = { 0 };
+
+            TEST_CHECK( pxDescriptor != NULL );
+            xTxBuffer.buffer = pxDescriptor->pucEthernetBuffer;
+            xTxBuffer.len = benchFRAME_LENGTH;
+            xTxConfig.Length = benchFRAME_LENGTH;
+            xTxConfig.TxBuffer = &xTxBuffer;
+            xTxConfig.pData = pxDescriptor;
+            xTxConfig.Attributes = ETH_TX_PACKETS_FEATURES_CSUM | ETH_TX_PACKETS_FEATURES_CRCPAD;
+            xTxConfig.ChecksumCtrl = ETH_CHECKSUM_IPHDR_PAYLOAD_INSERT_PHDR_CALC;
+            xTxConfig.CRCPadCtrl = ETH_CRC_PAD_INSERT;
+
+            const uint64_t ullSendStart = prvReadCycles();
+            const BaseType_t xSent = pxDriver->pxTransmit( &xTxConfig );
+            const uint64_t ullSendEnd = prvReadCycles();
+
+            TEST_CHECK_EQUAL( pdPASS, xSent );
+
+            if( ulFrame == 0U )
+            {
+                xFirstDesc[ uxDriver ] = xBenchDescTx[ 0 ];
+            }
+
+            prvSendFrames();
+
+            const uint64_t ullReleaseStart = prvReadCycles();
+            pxDriver->pxReleaseTx();
+            const uint64_t ullReleaseEnd = prvReadCycles();
+
+            TEST_CHECK_EQUAL( 0, xEthHandle.TxDescList.BuffersInUse );
+            ullCycles[ uxDriver ] += ( ullSendEnd - ullSendStart ) + ( ullReleaseEnd - ullReleaseStart );
+        }
+
+        TEST_CHECK_EQUAL( uxFreeBuffers, uxGetNumberOfFreeNetworkBuffers() );
+        prvTearDown();
+
+        ( void ) printf( "  Tx %-9s %8.1f cycles per frame\n", pxDriver->pcName, ( double ) ullCycles[ uxDriver ] / ( double ) benchFRAMES );
+    }
+
+    /* Both describe the frame to the DMA in the same words */
+    TEST_CHECK_EQUAL( xFirstDesc[ 1 ].DESC0, xFirstDesc[ 0 ].DESC0 );
+    TEST_CHECK_EQUAL( xFirstDesc[ 1 ].DESC1, xFirstDesc[ 0 ].DESC1 );
+    TEST_CHECK_EQUAL( xFirstDesc[ 1 ].DESC2, xFirstDesc[ 0 ].DESC2 );
+    TEST_CHECK_EQUAL( xFirstDesc[ 1 ].DESC3, xFirstDesc[ 0 ].DESC3 );
+}
+/*-----------------------------------------------------------*/
+
+static void bench_rx_path( void )
+{
+    uint64_t ullCycles[ benchDRIVER_COUNT ] = { 0U };
+    size_t uxDriver;
+    uint32_t ulFrame;
+
+    for( uxDriver = 0U; uxDriver < benchDRIVER_COUNT; uxDriver++ )
+    {
+        const BenchDriver_t * const pxDriver = &xDrivers[ uxDriver ];
+
+        prvSetUp();
+        const UBaseType_t uxFreeBuffers = uxGetNumberOfFreeNetworkBuffers();
+
+        for( ulFrame = 0U; ulFrame < benchFRAMES; ulFrame++ )
+        {
+            void * pvBuff = NULL;
+
+            prvReceiveFrame();
+
+            /* Includes the refill of the descriptor */
+            const uint64_t ullStart = prvReadCycles();
+            const BaseType_t xReceived = pxDriver->pxReadData( &pvBuff );
+            const uint64_t ullEnd = prvReadCycles();
+
+            TEST_CHECK_EQUAL( pdPASS, xReceived );
+            TEST_CHECK( pvBuff != NULL );
+            TEST_CHECK_EQUAL( benchFRAME_LENGTH, ( ( NetworkBufferDescriptor_t * ) pvBuff )->xDataLength );
+            TEST_CHECK_EQUAL( 0, xEthHandle.RxDescList.RxBuildDescCnt );
+
+            vReleaseNetworkBufferAndDescriptor( ( NetworkBufferDescriptor_t * ) pvBuff );
+            ullCycles[ uxDriver ] += ullEnd - ullStart;
+        }
+
+        TEST_CHECK_EQUAL( uxFreeBuffers, uxGetNumberOfFreeNetworkBuffers() );
+        prvTearDown();
+
+        ( void ) printf( "  Rx %-9s %8.1f cycles per frame\n", pxDriver->pcName, ( double ) ullCycles[ uxDriver ] / ( double ) benchFRAMES );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( bench_tx_path ),
+    TEST_CASE( bench_rx_path ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
@@ -0,0 +1,248 @@
+/* Burst absorption of the Rx ring of the EMAC driver. A burst of back to back
+ * minimum size frames is replayed while the EMAC task is late by a number of
+ * frame times, and the frames the DMA had no descriptor for are reported as
+ * the driver counts them, in ulRxDropNoDescriptor.
+ *
+ * The depth of the ring is set at build time, CMakeLists.txt builds this file
+ * once for each ETH_RX_DESC_CNT. The driver is built for the STM32H7 against
+ * stm32/hal_fake.c. Each run also checks that every frame is either delivered
+ * or counted as dropped. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the bench can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define benchFRAME_LENGTH    60U
+#define benchBURST_FRAMES    64U
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/* Frame times the EMAC task takes to run after the Rx interrupt */
+static const uint32_t ulWakeLatencies[] = { 0U, 2U, 4U, 8U, 16U, 32U };
+
+#define benchLATENCY_COUNT    ( sizeof( ulWakeLatencies ) / sizeof( ulWakeLatencies[ 0 ] ) )
+
+/* Frames the IP-task was given, their buffers go straight back to the pool */
+static uint32_t ulDelivered;
+
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout );
+
+/*-----------------------------------------------------------*/
+
+/* Linked in place of xSendEventStructToIPTask(), see CMakeLists.txt. */
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout )
+{
+    NetworkBufferDescriptor_t * pxDescriptor = ( NetworkBufferDescriptor_t * ) pxEvent->pvData;
+
+    ( void ) uxTimeout;
+    configASSERT( pxEvent->eEventType == eNetworkRxEvent );
+
+    while( pxDescriptor != NULL )
+    {
+        NetworkBufferDescriptor_t * const pxNext = pxDescriptor->pxNextBuffer;
+
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+        ++ulDelivered;
+        pxDescriptor = pxNext;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+    ulDelivered = 0U;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+    prvRefillRxReserve( pxEMACData );
+    ( void ) memset( &pxEMACData->xEMACStats, 0, sizeof( pxEMACData->xEMACStats ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReceiveFrame( void )
+{
+    static const uint8_t ucFrame[ benchFRAME_LENGTH ] =
+    {
+        0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 0x08U, 0x06U,
+        0x00U, 0x01U, 0x08U, 0x00U, 0x06U, 0x04U, 0x00U, 0x01U,
+        0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 192U,  168U,  1U,    20U,
+        0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 192U,  168U,  1U,    10U
+    };
+
+    ( void ) xFakeEthReceive( &pxEMACData->xEthHandle, ucFrame, benchFRAME_LENGTH );
+}
+/*-----------------------------------------------------------*/
+
+/* The Rx part of a pass of prvEMACHandlerTask(), woken by eMacEventRx, or by
+ * eMacEventErrRx once the DMA found no descriptor. */
+static void prvTaskPass( BaseType_t xRingEmpty )
+{
+    prvTakeEthContext( pxEMACData );
+
+    ( void ) prvNetworkInterfaceInput( pxEMACData, &xInterface, niEMAC_RX_UNLIMITED_BUDGET );
+
+    if( xRingEmpty != pdFALSE )
+    {
+        ++pxEMACData->xRxReserveStatus.ulRingEmpty;
+        pxEMACData->xEMACStats.ulRxDropNoDescriptor += niEMAC_RX_MISSED_FRAMES( pxEMACData->xEthHandle.Instance );
+
+        /* The counter clears when read, which RAM does not */
+        pxEMACData->xEthHandle.Instance->DMACMFCR = 0U;
+    }
+
+    prvRefillRxReserve( pxEMACData );
+
+    if( ( pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt != 0U ) && ( uxQueueMessagesWaiting( pxEMACData->xRxReserve ) != 0U ) )
+    {
+        ( void ) prvNetworkInterfaceInput( pxEMACData, &xInterface, niEMAC_RX_UNLIMITED_BUDGET );
+    }
+
+    prvGiveEthContext( pxEMACData );
+}
+/*-----------------------------------------------------------*/
+
+/* The burst arrives one frame per frame time. The first frame after a pass
+ * raises the Rx interrupt, and the task runs ulLatency frame times later. */
+static void prvReplayBurst( uint32_t ulLatency )
+{
+    uint32_t ulFrame;
+    uint32_t ulMissed = 0U;
+    BaseType_t xWoken = pdFALSE;
+    uint32_t ulWakeAt = 0U;
+
+    for( ulFrame = 0U; ulFrame < benchBURST_FRAMES; ulFrame++ )
+    {
+        if( ( xWoken != pdFALSE ) && ( ulFrame >= ulWakeAt ) )
+        {
+            prvTaskPass( ( xFakeEthCalls.ulRxMissed != ulMissed ) ? pdTRUE : pdFALSE );
+            ulMissed = xFakeEthCalls.ulRxMissed;
+            xWoken = pdFALSE;
+        }
+
+        prvReceiveFrame();
+
+        if( xWoken == pdFALSE )
+        {
+            xWoken = pdTRUE;
+            ulWakeAt = ulFrame + 1U + ulLatency;
+        }
+    }
+
+    prvTaskPass( ( xFakeEthCalls.ulRxMissed != ulMissed ) ? pdTRUE : pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static void test_burst_absorption( void )
+{
+    size_t uxLatency;
+
+    for( uxLatency = 0U; uxLatency < benchLATENCY_COUNT; uxLatency++ )
+    {
+        prvSetUp();
+        prvReplayBurst( ulWakeLatencies[ uxLatency ] );
+
+        ( void ) printf( "ETH_RX_DESC_CNT %2u, task late by %2u frames: %u of %u frames delivered, ulRxDropNoDescriptor %u\n",
+                         ( unsigned ) ETH_RX_DESC_CNT,
+                         ( unsigned ) ulWakeLatencies[ uxLatency ],
+                         ( unsigned ) ulDelivered,
+                         ( unsigned ) benchBURST_FRAMES,
+                         ( unsigned ) pxEMACData->xEMACStats.ulRxDropNoDescriptor );
+
+        TEST_CHECK_EQUAL( xFakeEthCalls.ulRxMissed, pxEMACData->xEMACStats.ulRxDropNoDescriptor );
+        TEST_CHECK_EQUAL( benchBURST_FRAMES, ulDelivered + pxEMACData->xEMACStats.ulRxDropNoDescriptor );
+
+        if( ulWakeLatencies[ uxLatency ] < ETH_RX_DESC_CNT )
+        {
+            /* The ring holds every frame that arrives while the task is late */
+            TEST_CHECK_EQUAL( 0, pxEMACData->xEMACStats.ulRxDropNoDescriptor );
+        }
+
+        prvTearDown();
+    }
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_burst_absorption ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
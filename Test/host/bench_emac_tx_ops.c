@@ -0,0 +1,336 @@
+/* Kernel operations per frame on the Tx path of the EMAC driver. Frames go
+ * through prvNetworkInterfaceOutput() in batches, and one pass of the EMAC
+ * task submits each batch with prvSendTxQueue(). The queue, semaphore and
+ * task notification calls of both sides are counted by wrapping the kernel
+ * functions, see CMakeLists.txt, as are the Tx tail pointer writes of the
+ * fake HAL of stm32/hal_fake.c.
+ *
+ * The frame rate comes from the host's clock, it ranks the batch sizes but is
+ * no measure of a Cortex-M7. Before the Tx queue, each frame took and gave
+ * xTxDescSem and xTxMutex, four semaphore calls. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* NetworkInterface.c is included, so the bench can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define benchFRAMES          20000U
+#define benchFRAME_LENGTH    60U
+
+typedef struct xBENCH_OPS
+{
+    uint32_t ulQueueSends;     /* To the Tx queue */
+    uint32_t ulQueueReceives;  /* From the Tx queue, the last one of a pass finds it empty */
+    uint32_t ulSemaphoreOps;   /* Takes and gives of any semaphore or mutex */
+    uint32_t ulNotifies;       /* xTaskNotify() and xTaskNotifyWait() */
+} BenchOps_t;
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/* Frames in one pass of the EMAC task */
+static const UBaseType_t uxBatchSizes[] = { 1U, 2U, ETH_TX_DESC_CNT };
+
+#define benchBATCH_COUNT    ( sizeof( uxBatchSizes ) / sizeof( uxBatchSizes[ 0 ] ) )
+
+/* Counted while set, so the network buffers the bench takes and gives are left out */
+static BaseType_t xCounting = pdFALSE;
+
+static BenchOps_t xOps;
+
+BaseType_t __real_xQueueGenericSend( QueueHandle_t xQueue,
+                                     const void * const pvItemToQueue,
+                                     TickType_t xTicksToWait,
+                                     const BaseType_t xCopyPosition );
+BaseType_t __real_xQueueReceive( QueueHandle_t xQueue,
+                                 void * const pvBuffer,
+                                 TickType_t xTicksToWait );
+BaseType_t __real_xQueueSemaphoreTake( QueueHandle_t xQueue,
+                                       TickType_t xTicksToWait );
+BaseType_t __real_xTaskGenericNotify( TaskHandle_t xTaskToNotify,
+                                      UBaseType_t uxIndexToNotify,
+                                      uint32_t ulValue,
+                                      eNotifyAction eAction,
+                                      uint32_t * pulPreviousNotificationValue );
+BaseType_t __real_xTaskGenericNotifyWait( UBaseType_t uxIndexToWaitOn,
+                                          uint32_t ulBitsToClearOnEntry,
+                                          uint32_t ulBitsToClearOnExit,
+                                          uint32_t * pulNotificationValue,
+                                          TickType_t xTicksToWait );
+
+BaseType_t __wrap_xQueueGenericSend( QueueHandle_t xQueue,
+                                     const void * const pvItemToQueue,
+                                     TickType_t xTicksToWait,
+                                     const BaseType_t xCopyPosition );
+BaseType_t __wrap_xQueueReceive( QueueHandle_t xQueue,
+                                 void * const pvBuffer,
+                                 TickType_t xTicksToWait );
+BaseType_t __wrap_xQueueSemaphoreTake( QueueHandle_t xQueue,
+                                       TickType_t xTicksToWait );
+BaseType_t __wrap_xTaskGenericNotify( TaskHandle_t xTaskToNotify,
+                                      UBaseType_t uxIndexToNotify,
+                                      uint32_t ulValue,
+                                      eNotifyAction eAction,
+                                      uint32_t * pulPreviousNotificationValue );
+BaseType_t __wrap_xTaskGenericNotifyWait( UBaseType_t uxIndexToWaitOn,
+                                          uint32_t ulBitsToClearOnEntry,
+                                          uint32_t ulBitsToClearOnExit,
+                                          uint32_t * pulNotificationValue,
+                                          TickType_t xTicksToWait );
+
+/*-----------------------------------------------------------*/
+
+/* xQueueSend() and xSemaphoreGive() */
+BaseType_t __wrap_xQueueGenericSend( QueueHandle_t xQueue,
+                                     const void * const pvItemToQueue,
+                                     TickType_t xTicksToWait,
+                                     const BaseType_t xCopyPosition )
+{
+    if( xCounting != pdFALSE )
+    {
+        if( xQueue == pxEMACData->xTxQueue )
+        {
+            ++xOps.ulQueueSends;
+        }
+        else
+        {
+            ++xOps.ulSemaphoreOps;
+        }
+    }
+
+    return __real_xQueueGenericSend( xQueue, pvItemToQueue, xTicksToWait, xCopyPosition );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t __wrap_xQueueReceive( QueueHandle_t xQueue,
+                                 void * const pvBuffer,
+                                 TickType_t xTicksToWait )
+{
+    if( ( xCounting != pdFALSE ) && ( xQueue == pxEMACData->xTxQueue ) )
+    {
+        ++xOps.ulQueueReceives;
+    }
+
+    return __real_xQueueReceive( xQueue, pvBuffer, xTicksToWait );
+}
+/*-----------------------------------------------------------*/
+
+/* xSemaphoreTake() */
+BaseType_t __wrap_xQueueSemaphoreTake( QueueHandle_t xQueue,
+                                       TickType_t xTicksToWait )
+{
+    if( xCounting != pdFALSE )
+    {
+        ++xOps.ulSemaphoreOps;
+    }
+
+    return __real_xQueueSemaphoreTake( xQueue, xTicksToWait );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t __wrap_xTaskGenericNotify( TaskHandle_t xTaskToNotify,
+                                      UBaseType_t uxIndexToNotify,
+                                      uint32_t ulValue,
+                                      eNotifyAction eAction,
+                                      uint32_t * pulPreviousNotificationValue )
+{
+    if( xCounting != pdFALSE )
+    {
+        ++xOps.ulNotifies;
+    }
+
+    return __real_xTaskGenericNotify( xTaskToNotify, uxIndexToNotify, ulValue, eAction, pulPreviousNotificationValue );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t __wrap_xTaskGenericNotifyWait( UBaseType_t uxIndexToWaitOn,
+                                          uint32_t ulBitsToClearOnEntry,
+                                          uint32_t ulBitsToClearOnExit,
+                                          uint32_t * pulNotificationValue,
+                                          TickType_t xTicksToWait )
+{
+    if( xCounting != pdFALSE )
+    {
+        ++xOps.ulNotifies;
+    }
+
+    return __real_xTaskGenericNotifyWait( uxIndexToWaitOn, ulBitsToClearOnEntry, ulBitsToClearOnExit, pulNotificationValue, xTicksToWait );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvReadNanoseconds( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000U ) + ( uint64_t ) xNow.tv_nsec;
+}
+/*-----------------------------------------------------------*/
+
+/* Creates the queues that prvEMACTaskStart() would create, then initialises
+ * and starts the EMAC with the link up. The EMAC task is not created, the
+ * bench task takes its notifications. */
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+    pxEMACData->xPhyObject.ulLinkStatusMask = 1U;
+    pxEMACData->xEMACTaskHandle = xTaskGetCurrentTaskHandle();
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    pxEMACData->xPhyObject.ulLinkStatusMask = 0U;
+    pxEMACData->xEMACTaskHandle = NULL;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void bench_tx_ops_per_frame( void )
+{
+    size_t uxBatch;
+
+    for( uxBatch = 0U; uxBatch < benchBATCH_COUNT; uxBatch++ )
+    {
+        const UBaseType_t uxBatchSize = uxBatchSizes[ uxBatch ];
+        NetworkBufferDescriptor_t * pxFrames[ ETH_TX_DESC_CNT ];
+        uint64_t ullNanoseconds = 0U;
+        uint32_t ulFrames = 0U;
+        UBaseType_t uxIndex;
+
+        prvSetUp();
+        ( void ) memset( &xOps, 0, sizeof( xOps ) );
+
+        const UBaseType_t uxFreeBuffers = uxGetNumberOfFreeNetworkBuffers();
+
+        while( ulFrames < benchFRAMES )
+        {
+            uint32_t ulEvents = 0U;
+
+            for( uxIndex = 0U; uxIndex < uxBatchSize; uxIndex++ )
+            {
+                pxFrames[ uxIndex ] = pxGetNetworkBufferWithDescriptor( benchFRAME_LENGTH, 0U );
+                TEST_CHECK( pxFrames[ uxIndex ] != NULL );
+                ( void ) memset( pxFrames[ uxIndex ]->pucEthernetBuffer, 0, benchFRAME_LENGTH );
+            }
+
+            const uint64_t ullStart = prvReadNanoseconds();
+            xCounting = pdTRUE;
+
+            for( uxIndex = 0U; uxIndex < uxBatchSize; uxIndex++ )
+            {
+                ( void ) prvNetworkInterfaceOutput( &xInterface, pxFrames[ uxIndex ], pdTRUE );
+            }
+
+            /* One wake-up of the EMAC task takes the whole batch */
+            ( void ) xTaskNotifyWait( 0U, eMacEventAll, &ulEvents, 0U );
+            configASSERT( ( ulEvents & eMacEventTxPending ) != 0U );
+            prvSendTxQueue( pxEMACData );
+
+            xCounting = pdFALSE;
+            ullNanoseconds += prvReadNanoseconds() - ullStart;
+
+            TEST_CHECK_EQUAL( uxBatchSize, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+            prvReleaseTxPacket( &pxEMACData->xEthHandle );
+            ulFrames += ( uint32_t ) uxBatchSize;
+        }
+
+        TEST_CHECK_EQUAL( uxFreeBuffers, uxGetNumberOfFreeNetworkBuffers() );
+        TEST_CHECK_EQUAL( ulFrames, pxEMACData->xEMACStats.ulTxFrames );
+        prvTearDown();
+
+        ( void ) printf( "  batch %u: %.2f queue sends, %.2f queue receives, %.2f semaphore ops, %.2f notifies, %.2f doorbells per frame, %.0f frames/s\n",
+                         ( unsigned ) uxBatchSize,
+                         ( double ) xOps.ulQueueSends / ( double ) ulFrames,
+                         ( double ) xOps.ulQueueReceives / ( double ) ulFrames,
+                         ( double ) xOps.ulSemaphoreOps / ( double ) ulFrames,
+                         ( double ) xOps.ulNotifies / ( double ) ulFrames,
+                         ( double ) xFakeEthCalls.ulTxDoorbells / ( double ) ulFrames,
+                         ( double ) ulFrames * 1e9 / ( double ) ullNanoseconds );
+
+        /* A queue send and a notify per frame, and no lock. The HAL still
+         * writes the tail pointer for each frame of a batch. */
+        TEST_CHECK_EQUAL( ulFrames, xOps.ulQueueSends );
+        TEST_CHECK_EQUAL( 0, xOps.ulSemaphoreOps );
+        TEST_CHECK_EQUAL( ulFrames + ( ulFrames / uxBatchSize ), xOps.ulNotifies );
+        TEST_CHECK_EQUAL( ulFrames, xFakeEthCalls.ulTxDoorbells );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( bench_tx_ops_per_frame ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
@@ -0,0 +1,48 @@
+#ifndef FREERTOS_IP_CONFIG_H
+#define FREERTOS_IP_CONFIG_H
+
+/* FreeRTOS+TCP configuration for the host unit tests. It follows
+ * Common/inc/FreeRTOSIPConfig.h and turns on the optional features that the
+ * tests cover. */
+
+#define ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM            1
+#define ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM            1
+#define ipconfigZERO_COPY_RX_DRIVER                       1
+#define ipconfigZERO_COPY_TX_DRIVER                       1
+#define ipconfigUSE_LINKED_RX_MESSAGES                    1
+#define ipconfigUSE_NETWORK_EVENT_HOOK                    0
+#define ipconfigUSE_DHCP                                  0
+#define ipconfigUSE_TCP                                   1
+#define ipconfigUSE_TCP_WIN                               1
+#define ipconfigUSE_DNS                                   0
+#define ipconfigBYTE_ORDER                                pdFREERTOS_LITTLE_ENDIAN
+#define ipconfigENABLE_BACKWARD_COMPATIBILITY             0
+#define ipconfigUSE_CALLBACKS                             0
+#define ipconfigNETWORK_MTU                               1500U
+
+/* Raised by the builds with a deeper Rx ring, see CMakeLists.txt */
+#ifndef ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS
+    #define ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS        24U
+#endif
+
+#define ipconfigHAS_DEBUG_PRINTF                          0
+#define ipconfigHAS_PRINTF                                0
+#define ipconfigUSE_IPv4                                  1
+#define ipconfigUSE_IPv6                                  0
+#define ipconfigUSE_RA                                    0
+#define ipconfigSUPPORT_NETWORK_DOWN_EVENT                0
+
+/* Room for a 64-bit back pointer in front of the Ethernet header. */
+#define ipconfigBUFFER_PADDING                            14U
+#define ipconfigPACKET_FILLER_SIZE                        2U
+
+#define ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS      4U
+#define ipconfigSMALL_NETWORK_BUFFER_SIZE                 128U
+#define ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS     4U
+#define ipconfigMEDIUM_NETWORK_BUFFER_SIZE                512U
+#define ipconfigTRACK_NETWORK_BUFFER_OWNERS               1
+
+#define ipconfigUSE_TCP_SEGMENTATION_OFFLOAD              1
+#define ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS     5
+
+#endif /* FREERTOS_IP_CONFIG_H */
@@ -0,0 +1,70 @@
+/*
+ * Host port used by the unit tests in Test/host.
+ *
+ * There is no scheduler: the test runs as the first task that it creates,
+ * interrupts do not exist and the tick only advances when the test calls
+ * xTaskIncrementTick(). Critical sections just count their nesting.
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+#define portCHAR                   char
+#define portFLOAT                  float
+#define portDOUBLE                 double
+#define portLONG                   long
+#define portSHORT                  short
+#define portSTACK_TYPE             uintptr_t
+#define portBASE_TYPE              long
+#define portPOINTER_SIZE_TYPE      uintptr_t
+
+typedef portSTACK_TYPE   StackType_t;
+typedef long             BaseType_t;
+typedef unsigned long    UBaseType_t;
+
+#if ( configTICK_TYPE_WIDTH_IN_BITS == TICK_TYPE_WIDTH_32_BITS )
+    typedef uint32_t     TickType_t;
+    #define portMAX_DELAY              ( TickType_t ) 0xffffffffUL
+    #define portTICK_TYPE_IS_ATOMIC    1
+#else
+    #error configTICK_TYPE_WIDTH_IN_BITS set to unsupported tick type width.
+#endif
+
+#define portSTACK_GROWTH           ( -1 )
+#define portTICK_PERIOD_MS         ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT         8
+#define portDONT_DISCARD           __attribute__( ( used ) )
+
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+
+#define portYIELD()                                 do {} while( 0 )
+#define portYIELD_FROM_ISR( x )                     ( ( void ) ( x ) )
+#define portEND_SWITCHING_ISR( x )                  ( ( void ) ( x ) )
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()           0U
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR( x )      ( ( void ) ( x ) )
+#define portDISABLE_INTERRUPTS()                    do {} while( 0 )
+#define portENABLE_INTERRUPTS()                     do {} while( 0 )
+#define portENTER_CRITICAL()                        vPortEnterCritical()
+#define portEXIT_CRITICAL()                         vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters )    void vFunction( void * pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters )          void vFunction( void * pvParameters )
+
+#define portNOP()
+#define portINLINE                 __inline
+#define portFORCE_INLINE           inline __attribute__( ( always_inline ) )
+#define portMEMORY_BARRIER()       __sync_synchronize()
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* PORTMACRO_H */
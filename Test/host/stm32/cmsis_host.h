@@ -0,0 +1,127 @@
+#ifndef CMSIS_HOST_H
+#define CMSIS_HOST_H
+
+/* Force included in place of cmsis_compiler.h and cmsis_gcc.h, whose intrinsics are ARM
+ * instructions. The core registers live in RAM mapped by the test, so the intrinsics only
+ * need to keep the compiler from reordering the accesses. */
+
+#include <stdint.h>
+
+#define __CMSIS_COMPILER_H
+#define __CMSIS_GCC_H
+
+#define __ASM                     __asm
+#define __INLINE                  inline
+#define __STATIC_INLINE           static inline
+#define __STATIC_FORCEINLINE      static inline __attribute__( ( always_inline ) )
+#define __NO_RETURN               __attribute__( ( __noreturn__ ) )
+#define __USED                    __attribute__( ( used ) )
+#define __WEAK                    __attribute__( ( weak ) )
+#define __PACKED                  __attribute__( ( packed, aligned( 1 ) ) )
+#define __PACKED_STRUCT           struct __attribute__( ( packed, aligned( 1 ) ) )
+#define __PACKED_UNION            union __attribute__( ( packed, aligned( 1 ) ) )
+#define __ALIGNED( x )            __attribute__( ( aligned( x ) ) )
+#define __RESTRICT                __restrict
+#define __COMPILER_BARRIER()      __asm volatile ( "" ::: "memory" )
+#define __UNALIGNED_UINT32( x )   ( *( ( uint32_t * ) ( x ) ) )
+
+#define __NOP()                   __COMPILER_BARRIER()
+#define __WFI()                   __COMPILER_BARRIER()
+#define __WFE()                   __COMPILER_BARRIER()
+#define __SEV()                   __COMPILER_BARRIER()
+#define __BKPT( value )           __builtin_trap()
+
+__STATIC_FORCEINLINE void __ISB( void )
+{
+    __sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __DSB( void )
+{
+    __sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __DMB( void )
+{
+    __sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __enable_irq( void )
+{
+}
+
+__STATIC_FORCEINLINE void __disable_irq( void )
+{
+}
+
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK( void )
+{
+    return 0U;
+}
+
+__STATIC_FORCEINLINE void __set_PRIMASK( uint32_t ulPriMask )
+{
+    ( void ) ulPriMask;
+}
+
+__STATIC_FORCEINLINE uint32_t __get_BASEPRI( void )
+{
+    return 0U;
+}
+
+__STATIC_FORCEINLINE void __set_BASEPRI( uint32_t ulBasePri )
+{
+    ( void ) ulBasePri;
+}
+
+__STATIC_FORCEINLINE uint32_t __get_IPSR( void )
+{
+    return 0U;
+}
+
+__STATIC_FORCEINLINE uint32_t __REV( uint32_t ulValue )
+{
+    return __builtin_bswap32( ulValue );
+}
+
+__STATIC_FORCEINLINE uint32_t __REV16( uint32_t ulValue )
+{
+    return ( ( ulValue & 0xFF00FF00U ) >> 8U ) | ( ( ulValue & 0x00FF00FFU ) << 8U );
+}
+
+__STATIC_FORCEINLINE uint8_t __CLZ( uint32_t ulValue )
+{
+    return ( ulValue == 0U ) ? 32U : ( uint8_t ) __builtin_clz( ulValue );
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT( uint32_t ulValue )
+{
+    uint32_t ulResult = 0U;
+    uint32_t ulBit;
+
+    for( ulBit = 0U; ulBit < 32U; ulBit++ )
+    {
+        ulResult = ( ulResult << 1U ) | ( ( ulValue >> ulBit ) & 1U );
+    }
+
+    return ulResult;
+}
+
+/* Exclusive access always succeeds, there is no other core */
+__STATIC_FORCEINLINE uint32_t __LDREXW( volatile uint32_t * pulAddr )
+{
+    return *pulAddr;
+}
+
+__STATIC_FORCEINLINE uint32_t __STREXW( uint32_t ulValue,
+                                        volatile uint32_t * pulAddr )
+{
+    *pulAddr = ulValue;
+    return 0U;
+}
+
+__STATIC_FORCEINLINE void __CLREX( void )
+{
+}
+
+#endif /* CMSIS_HOST_H */
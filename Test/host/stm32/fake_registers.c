@@ -0,0 +1,34 @@
+#include <sys/mman.h>
+
+#include "fake_registers.h"
+
+#define fakePAGE_SIZE    0x1000U
+
+/*-----------------------------------------------------------*/
+
+static int prvMapPages( uintptr_t uxBase,
+                        size_t uxLength )
+{
+    const uintptr_t uxPage = uxBase & ~( ( uintptr_t ) fakePAGE_SIZE - 1U );
+    const size_t uxSize = ( ( uxBase + uxLength - uxPage ) + fakePAGE_SIZE - 1U ) & ~( ( size_t ) fakePAGE_SIZE - 1U );
+    void * const pvMap = mmap( ( void * ) uxPage, uxSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+
+    return ( pvMap == ( void * ) uxPage ) ? 1 : 0;
+}
+/*-----------------------------------------------------------*/
+
+int xFakeMapRegisters( void )
+{
+    int xResult = 0;
+
+    if( ( prvMapPages( ( uintptr_t ) ETH, sizeof( ETH_TypeDef ) ) != 0 ) &&
+        ( prvMapPages( ( uintptr_t ) RCC, sizeof( RCC_TypeDef ) ) != 0 ) &&
+        ( prvMapPages( ( uintptr_t ) SCS_BASE, fakePAGE_SIZE ) != 0 ) )
+    {
+        RCC->AHB1ENR |= RCC_AHB1ENR_ETH1MACEN | RCC_AHB1ENR_ETH1TXEN | RCC_AHB1ENR_ETH1RXEN;
+        xResult = 1;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,13 @@
+#ifndef FAKE_REGISTERS_H
+#define FAKE_REGISTERS_H
+
+/* The STM32H7 peripheral registers as plain RAM. Nothing answers a write, a
+ * test plays the hardware by setting the bits it would set. */
+
+#include "stm32h7xx_hal.h"
+
+/* Maps RAM over the ETH, RCC and system control registers, and enables the
+ * ETH clocks as the application would. Returns 0 if a page is taken. */
+int xFakeMapRegisters( void );
+
+#endif /* FAKE_REGISTERS_H */
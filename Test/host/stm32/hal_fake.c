@@ -0,0 +1,458 @@
+#include <string.h>
+
+#include "hal_fake.h"
+
+FakeEthCalls_t xFakeEthCalls;
+
+/* Next Rx descriptor the DMA receives into */
+static uint32_t ulRxDmaIdx;
+
+/*-----------------------------------------------------------*/
+
+void vFakeEthReset( void )
+{
+    ( void ) memset( &xFakeEthCalls, 0, sizeof( xFakeEthCalls ) );
+    ulRxDmaIdx = 0U;
+    ETH->DMACMFCR = 0U;
+}
+/*-----------------------------------------------------------*/
+
+/* As ETH_UpdateDescriptor, a descriptor keeps the buffer it has, the others
+ * ask for one, and each is handed to the DMA. */
+static void prvUpdateDescriptors( ETH_HandleTypeDef * heth )
+{
+    ETH_RxDescListTypeDef * const pxRxDescList = &heth->RxDescList;
+
+    while( pxRxDescList->RxBuildDescCnt != 0U )
+    {
+        ETH_DMADescTypeDef * const pxDesc = ( ETH_DMADescTypeDef * ) ( uintptr_t ) pxRxDescList->RxDesc[ pxRxDescList->RxBuildDescIdx ];
+
+        if( pxDesc->BackupAddr0 == 0U )
+        {
+            uint8_t * pucBuff = NULL;
+
+            HAL_ETH_RxAllocateCallback( &pucBuff );
+
+            if( pucBuff == NULL )
+            {
+                break;
+            }
+
+            pxDesc->BackupAddr0 = ( uint32_t ) ( uintptr_t ) pucBuff;
+            pxDesc->DESC0 = pxDesc->BackupAddr0;
+        }
+
+        pxDesc->DESC3 = ETH_DMARXNDESCRF_OWN;
+        pxRxDescList->RxBuildDescIdx = ( pxRxDescList->RxBuildDescIdx + 1U ) % ( uint32_t ) ETH_RX_DESC_CNT;
+        pxRxDescList->RxBuildDescCnt--;
+    }
+}
+/*-----------------------------------------------------------*/
+
+int xFakeEthReceive( ETH_HandleTypeDef * heth,
+                     const uint8_t * pucFrame,
+                     uint32_t ulLength )
+{
+    const uint32_t ulBuffLen = heth->Init.RxBuffLen;
+    const uint32_t ulDescCount = ( ulLength + ulBuffLen - 1U ) / ulBuffLen;
+    uint32_t ulDescIdx = ulRxDmaIdx;
+    uint32_t ulOffset = 0U;
+    uint32_t ulDesc;
+    int xReceived = 1;
+
+    for( ulDesc = 0U; ulDesc < ulDescCount; ulDesc++ )
+    {
+        const ETH_DMADescTypeDef * const pxDesc = ( const ETH_DMADescTypeDef * ) ( uintptr_t ) heth->RxDescList.RxDesc[ ( ulRxDmaIdx + ulDesc ) % ( uint32_t ) ETH_RX_DESC_CNT ];
+
+        if( ( ulDesc >= ( uint32_t ) ETH_RX_DESC_CNT ) || ( ( pxDesc->DESC3 & ETH_DMARXNDESCRF_OWN ) == 0U ) )
+        {
+            /* The DMA owns too few descriptors, the frame is lost as on a Rx buffer unavailable */
+            xFakeEthCalls.ulRxMissed++;
+            xReceived = 0;
+
+            if( ( heth->Instance->DMACMFCR & ETH_DMACMFCR_MFC ) != ETH_DMACMFCR_MFC )
+            {
+                /* Counted by the missed frame counter, which saturates */
+                heth->Instance->DMACMFCR++;
+            }
+
+            break;
+        }
+    }
+
+    for( ulDesc = 0U; ( xReceived != 0 ) && ( ulDesc < ulDescCount ); ulDesc++ )
+    {
+        ETH_DMADescTypeDef * const pxDesc = ( ETH_DMADescTypeDef * ) ( uintptr_t ) heth->RxDescList.RxDesc[ ulDescIdx ];
+        const uint32_t ulCopy = ( ( ulLength - ulOffset ) < ulBuffLen ) ? ( ulLength - ulOffset ) : ulBuffLen;
+
+        /* Written back without error, the packet length counts the bytes so far */
+        ( void ) memcpy( ( void * ) ( uintptr_t ) pxDesc->DESC0, &pucFrame[ ulOffset ], ulCopy );
+        ulOffset += ulCopy;
+        pxDesc->DESC3 = ( ulOffset & ETH_DMARXNDESCWBF_PL );
+
+        if( ulDesc == 0U )
+        {
+            pxDesc->DESC3 |= ETH_DMARXNDESCWBF_FD;
+        }
+
+        if( ulOffset == ulLength )
+        {
+            pxDesc->DESC3 |= ETH_DMARXNDESCWBF_LD;
+        }
+
+        ulDescIdx = ( ulDescIdx + 1U ) % ( uint32_t ) ETH_RX_DESC_CNT;
+    }
+
+    if( xReceived != 0 )
+    {
+        ulRxDmaIdx = ulDescIdx;
+    }
+
+    return xReceived;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_Init( ETH_HandleTypeDef * heth )
+{
+    uint32_t ulIndex;
+
+    xFakeEthCalls.pxInit = heth;
+
+    /* As ETH_DMATxDescListInit and ETH_DMARxDescListInit */
+    ( void ) memset( &heth->TxDescList, 0, sizeof( heth->TxDescList ) );
+    ( void ) memset( &heth->RxDescList, 0, sizeof( heth->RxDescList ) );
+
+    for( ulIndex = 0U; ulIndex < ( uint32_t ) ETH_TX_DESC_CNT; ulIndex++ )
+    {
+        heth->TxDescList.TxDesc[ ulIndex ] = ( uint32_t ) ( uintptr_t ) &heth->Init.TxDesc[ ulIndex ];
+    }
+
+    for( ulIndex = 0U; ulIndex < ( uint32_t ) ETH_RX_DESC_CNT; ulIndex++ )
+    {
+        heth->RxDescList.RxDesc[ ulIndex ] = ( uint32_t ) ( uintptr_t ) &heth->Init.RxDesc[ ulIndex ];
+    }
+
+    heth->RxDescList.RxBuildDescCnt = ( uint32_t ) ETH_RX_DESC_CNT;
+    ulRxDmaIdx = 0U;
+
+    /* The software reset clears the address filters */
+    heth->Instance->MACA1HR = 0U;
+    heth->Instance->MACA1LR = 0U;
+    heth->Instance->MACA2HR = 0U;
+    heth->Instance->MACA2LR = 0U;
+    heth->Instance->MACA3HR = 0U;
+    heth->Instance->MACA3LR = 0U;
+    heth->Instance->MACHT0R = 0U;
+    heth->Instance->MACHT1R = 0U;
+
+    heth->ErrorCode = HAL_ETH_ERROR_NONE;
+    heth->gState = HAL_ETH_STATE_READY;
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_Start_IT( ETH_HandleTypeDef * heth )
+{
+    xFakeEthCalls.pxStart = heth;
+
+    prvUpdateDescriptors( heth );
+
+    /* As the real one, with every DMA interrupt the driver handles */
+    heth->Instance->DMACIER |= ETH_DMACIER_NIE | ETH_DMACIER_RIE | ETH_DMACIER_TIE | ETH_DMACIER_FBEE | ETH_DMACIER_AIE | ETH_DMACIER_RBUE;
+    heth->gState = HAL_ETH_STATE_STARTED;
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_Stop_IT( ETH_HandleTypeDef * heth )
+{
+    heth->gState = HAL_ETH_STATE_READY;
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_Transmit_IT( ETH_HandleTypeDef * heth,
+                                       ETH_TxPacketConfigTypeDef * pTxConfig )
+{
+    ETH_TxDescListTypeDef * const pxTxDescList = &heth->TxDescList;
+    const ETH_BufferTypeDef * pxBuffer = pTxConfig->TxBuffer;
+    uint32_t ulDescriptors = 0U;
+    uint32_t ulIndex;
+    HAL_StatusTypeDef xResult = HAL_OK;
+
+    /* As ETH_Prepare_Tx_Descriptors, each descriptor takes up to two buffers */
+    while( pxBuffer != NULL )
+    {
+        ulDescriptors++;
+        pxBuffer = ( pxBuffer->next != NULL ) ? pxBuffer->next->next : NULL;
+    }
+
+    if( ( pxTxDescList->BuffersInUse + ulDescriptors ) > ( uint32_t ) ETH_TX_DESC_CNT )
+    {
+        heth->ErrorCode |= HAL_ETH_ERROR_BUSY;
+        xResult = HAL_ERROR;
+    }
+    else
+    {
+        pxBuffer = pTxConfig->TxBuffer;
+
+        for( ulIndex = 0U; ulIndex < ulDescriptors; ulIndex++ )
+        {
+            ETH_DMADescTypeDef * const pxDesc = ( ETH_DMADescTypeDef * ) ( uintptr_t ) pxTxDescList->TxDesc[ pxTxDescList->CurTxDesc ];
+
+            pxDesc->DESC0 = ( uint32_t ) ( uintptr_t ) pxBuffer->buffer;
+            pxDesc->DESC1 = 0U;
+            pxDesc->DESC2 = pxBuffer->len & ETH_DMATXNDESCRF_B1L;
+            pxBuffer = pxBuffer->next;
+
+            if( pxBuffer != NULL )
+            {
+                pxDesc->DESC1 = ( uint32_t ) ( uintptr_t ) pxBuffer->buffer;
+                pxDesc->DESC2 |= ( pxBuffer->len << 16 ) & ETH_DMATXNDESCRF_B2L;
+                pxBuffer = pxBuffer->next;
+            }
+
+            /* The frame is released through its last descriptor */
+            if( ( ulIndex + 1U ) == ulDescriptors )
+            {
+                pxTxDescList->PacketAddress[ pxTxDescList->CurTxDesc ] = pTxConfig->pData;
+            }
+
+            pxTxDescList->CurTxDesc = ( pxTxDescList->CurTxDesc + 1U ) % ( uint32_t ) ETH_TX_DESC_CNT;
+        }
+
+        pxTxDescList->BuffersInUse += ulDescriptors;
+
+        /* The real one writes the tail pointer after each frame */
+        xFakeEthCalls.ulTxDoorbells++;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_ReadData( ETH_HandleTypeDef * heth,
+                                    void ** pAppBuff )
+{
+    ETH_RxDescListTypeDef * const pxRxDescList = &heth->RxDescList;
+    uint32_t ulDescIdx = pxRxDescList->RxDescIdx;
+    uint32_t ulDescCnt = 0U;
+    const uint32_t ulDescMax = ( uint32_t ) ETH_RX_DESC_CNT - pxRxDescList->RxBuildDescCnt;
+    int xReady = 0;
+    HAL_StatusTypeDef xResult = HAL_ERROR;
+
+    if( heth->gState == HAL_ETH_STATE_STARTED )
+    {
+        /* As the real one, the descriptors the DMA gave back are linked up to the last one of a frame */
+        while( ( xReady == 0 ) && ( ulDescCnt < ulDescMax ) )
+        {
+            ETH_DMADescTypeDef * const pxDesc = ( ETH_DMADescTypeDef * ) ( uintptr_t ) pxRxDescList->RxDesc[ ulDescIdx ];
+
+            if( ( pxDesc->DESC3 & ETH_DMARXNDESCWBF_OWN ) != 0U )
+            {
+                break;
+            }
+
+            /* A descriptor that does not start a frame is skipped, unless one is being linked */
+            if( ( ( pxDesc->DESC3 & ETH_DMARXNDESCWBF_FD ) != 0U ) || ( pxRxDescList->pRxStart != NULL ) )
+            {
+                if( ( pxDesc->DESC3 & ETH_DMARXNDESCWBF_FD ) != 0U )
+                {
+                    pxRxDescList->RxDataLength = 0U;
+                }
+
+                const uint32_t ulBuffLength = ( pxDesc->DESC3 & ETH_DMARXNDESCWBF_PL ) - pxRxDescList->RxDataLength;
+
+                if( ( pxDesc->DESC3 & ETH_DMARXNDESCWBF_LD ) != 0U )
+                {
+                    xReady = 1;
+                }
+
+                HAL_ETH_RxLinkCallback( &pxRxDescList->pRxStart, &pxRxDescList->pRxEnd,
+                                        ( uint8_t * ) ( uintptr_t ) pxDesc->BackupAddr0, ( uint16_t ) ulBuffLength );
+                pxRxDescList->RxDataLength += ulBuffLength;
+                pxDesc->BackupAddr0 = 0U;
+            }
+
+            ulDescIdx = ( ulDescIdx + 1U ) % ( uint32_t ) ETH_RX_DESC_CNT;
+            ulDescCnt++;
+        }
+
+        pxRxDescList->RxBuildDescCnt += ulDescCnt;
+        prvUpdateDescriptors( heth );
+        pxRxDescList->RxDescIdx = ulDescIdx;
+
+        if( xReady != 0 )
+        {
+            /* NULL when the link callback dropped the frame */
+            *pAppBuff = pxRxDescList->pRxStart;
+            pxRxDescList->pRxStart = NULL;
+            xResult = HAL_OK;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_ReleaseTxPacket( ETH_HandleTypeDef * heth )
+{
+    ETH_TxDescListTypeDef * const pxTxDescList = &heth->TxDescList;
+
+    xFakeEthCalls.ulTxReleases++;
+
+    /* Every frame has been sent, unless the test holds the descriptors */
+    while( ( xFakeEthCalls.xTxHold == 0 ) && ( pxTxDescList->BuffersInUse != 0U ) )
+    {
+        if( pxTxDescList->PacketAddress[ pxTxDescList->releaseIndex ] != NULL )
+        {
+            HAL_ETH_TxFreeCallback( pxTxDescList->PacketAddress[ pxTxDescList->releaseIndex ] );
+            pxTxDescList->PacketAddress[ pxTxDescList->releaseIndex ] = NULL;
+        }
+
+        pxTxDescList->releaseIndex = ( pxTxDescList->releaseIndex + 1U ) % ( uint32_t ) ETH_TX_DESC_CNT;
+        pxTxDescList->BuffersInUse--;
+    }
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_ReadPHYRegister( ETH_HandleTypeDef * heth,
+                                           uint32_t PHYAddr,
+                                           uint32_t PHYReg,
+                                           uint32_t * pRegValue )
+{
+    xFakeEthCalls.pxPhyRead = heth;
+    xFakeEthCalls.ulPhyRegister = PHYReg;
+    *pRegValue = xFakeEthCalls.ulPhyValue;
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_WritePHYRegister( const ETH_HandleTypeDef * heth,
+                                            uint32_t PHYAddr,
+                                            uint32_t PHYReg,
+                                            uint32_t RegValue )
+{
+    xFakeEthCalls.pxPhyWrite = ( ETH_HandleTypeDef * ) heth;
+    xFakeEthCalls.ulPhyRegister = PHYReg;
+    xFakeEthCalls.ulPhyValue = RegValue;
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_GetMACConfig( const ETH_HandleTypeDef * heth,
+                                        ETH_MACConfigTypeDef * macconf )
+{
+    ( void ) memset( macconf, 0, sizeof( *macconf ) );
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_SetMACConfig( ETH_HandleTypeDef * heth,
+                                        ETH_MACConfigTypeDef * macconf )
+{
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_GetDMAConfig( const ETH_HandleTypeDef * heth,
+                                        ETH_DMAConfigTypeDef * dmaconf )
+{
+    ( void ) memset( dmaconf, 0, sizeof( *dmaconf ) );
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_SetDMAConfig( ETH_HandleTypeDef * heth,
+                                        ETH_DMAConfigTypeDef * dmaconf )
+{
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_GetMACFilterConfig( const ETH_HandleTypeDef * heth,
+                                              ETH_MACFilterConfigTypeDef * pFilterConfig )
+{
+    ( void ) memset( pFilterConfig, 0, sizeof( *pFilterConfig ) );
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_SetMACFilterConfig( ETH_HandleTypeDef * heth,
+                                              const ETH_MACFilterConfigTypeDef * pFilterConfig )
+{
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_SetHashTable( ETH_HandleTypeDef * heth,
+                                        uint32_t * pHashTable )
+{
+    heth->Instance->MACHT0R = pHashTable[ 0 ];
+    heth->Instance->MACHT1R = pHashTable[ 1 ];
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETH_GetRxDataErrorCode( const ETH_HandleTypeDef * heth,
+                                              uint32_t * pErrorCode )
+{
+    *pErrorCode = 0U;
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+void HAL_ETH_IRQHandler( ETH_HandleTypeDef * heth )
+{
+    xFakeEthCalls.pxIrq = heth;
+
+    /* Reports a completed transmission, as for a TI interrupt */
+    HAL_ETH_TxCpltCallback( heth );
+}
+/*-----------------------------------------------------------*/
+
+void HAL_ETHEx_EnableL3L4Filtering( ETH_HandleTypeDef * heth )
+{
+}
+/*-----------------------------------------------------------*/
+
+void HAL_ETHEx_DisableL3L4Filtering( ETH_HandleTypeDef * heth )
+{
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETHEx_GetL3FilterConfig( const ETH_HandleTypeDef * heth,
+                                               uint32_t Filter,
+                                               ETH_L3FilterConfigTypeDef * pL3FilterConfig )
+{
+    ( void ) memset( pL3FilterConfig, 0, sizeof( *pL3FilterConfig ) );
+
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ETHEx_SetL3FilterConfig( ETH_HandleTypeDef * heth,
+                                               uint32_t Filter,
+                                               const ETH_L3FilterConfigTypeDef * pL3FilterConfig )
+{
+    return HAL_OK;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t HAL_RCC_GetHCLKFreq( void )
+{
+    return 200000000U;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,38 @@
+#ifndef HAL_FAKE_H
+#define HAL_FAKE_H
+
+/* Stand-ins for the STM32H7 ETH HAL. The real driver polls the MAC and the
+ * MDIO bus, which never answer from RAM, so each call only records the handle
+ * it was given and makes the callbacks that the real one would make. */
+
+#include "stm32h7xx_hal.h"
+
+#include "fake_registers.h"
+
+typedef struct xFAKE_ETH_CALLS
+{
+    ETH_HandleTypeDef * pxInit;       /* Last handle given to HAL_ETH_Init */
+    ETH_HandleTypeDef * pxStart;      /* Last handle given to HAL_ETH_Start_IT */
+    ETH_HandleTypeDef * pxPhyRead;    /* Last handle given to HAL_ETH_ReadPHYRegister */
+    ETH_HandleTypeDef * pxPhyWrite;   /* Last handle given to HAL_ETH_WritePHYRegister */
+    ETH_HandleTypeDef * pxIrq;        /* Last handle given to HAL_ETH_IRQHandler */
+    uint32_t ulPhyRegister;           /* Register of the last PHY access */
+    uint32_t ulPhyValue;              /* Returned by HAL_ETH_ReadPHYRegister, set by HAL_ETH_WritePHYRegister */
+    uint32_t ulTxReleases;            /* Calls to HAL_ETH_ReleaseTxPacket */
+    uint32_t ulTxDoorbells;           /* Tx tail pointer writes, one per frame HAL_ETH_Transmit_IT took */
+    int xTxHold;                      /* Non-zero while the DMA still owns every Tx descriptor */
+    uint32_t ulRxMissed;              /* Frames given to xFakeEthReceive with no Rx descriptor to take them */
+} FakeEthCalls_t;
+
+extern FakeEthCalls_t xFakeEthCalls;
+
+void vFakeEthReset( void );
+
+/* The DMA receives a frame into the next descriptors it owns, one per
+ * RxBuffLen bytes. Returns 0 when it owns too few and the frame is lost, as
+ * counted by DMACMFCR. */
+int xFakeEthReceive( ETH_HandleTypeDef * heth,
+                     const uint8_t * pucFrame,
+                     uint32_t ulLength );
+
+#endif /* HAL_FAKE_H */
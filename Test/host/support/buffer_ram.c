@@ -0,0 +1,59 @@
+/* Buffer RAM for the tests that do not link a network interface. Like the
+ * STM32 driver, each buffer starts with a pointer back to its descriptor. */
+
+#include "FreeRTOS.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "NetworkInterface.h"
+
+#define testBUFFER_SIZE( xPayload )    ( ( ( ipBUFFER_PADDING + ( xPayload ) ) + 7U ) & ~7U )
+
+static void prvAllocateRAM( NetworkBufferDescriptor_t * pxBuffers,
+                            size_t uxCount,
+                            uint8_t * pucRAM,
+                            size_t uxBufferSize )
+{
+    size_t uxIndex;
+    uint8_t * pucBuffer;
+
+    for( uxIndex = 0U; uxIndex < uxCount; uxIndex++ )
+    {
+        pucBuffer = &( pucRAM[ uxIndex * uxBufferSize ] );
+        pxBuffers[ uxIndex ].pucEthernetBuffer = &( pucBuffer[ ipBUFFER_PADDING ] );
+        *( ( NetworkBufferDescriptor_t ** ) pucBuffer ) = &( pxBuffers[ uxIndex ] );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vNetworkInterfaceAllocateRAMToBuffers( NetworkBufferDescriptor_t pxNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    static uint8_t ucRAM[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ][ testBUFFER_SIZE( ipTOTAL_ETHERNET_FRAME_SIZE ) ] __attribute__( ( aligned( 8 ) ) );
+
+    prvAllocateRAM( pxNetworkBuffers, ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, &( ucRAM[ 0 ][ 0 ] ), sizeof( ucRAM[ 0 ] ) );
+}
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+void vNetworkInterfaceAllocateRAMToSmallBuffers( NetworkBufferDescriptor_t pxSmallNetworkBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    static uint8_t ucRAM[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ][ testBUFFER_SIZE( ipconfigSMALL_NETWORK_BUFFER_SIZE ) ] __attribute__( ( aligned( 8 ) ) );
+
+    prvAllocateRAM( pxSmallNetworkBuffers, ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, &( ucRAM[ 0 ][ 0 ] ), sizeof( ucRAM[ 0 ] ) );
+}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS > 0 )
+
+void vNetworkInterfaceAllocateRAMToMediumBuffers( NetworkBufferDescriptor_t pxMediumNetworkBuffers[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+    static uint8_t ucRAM[ ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ][ testBUFFER_SIZE( ipconfigMEDIUM_NETWORK_BUFFER_SIZE ) ] __attribute__( ( aligned( 8 ) ) );
+
+    prvAllocateRAM( pxMediumNetworkBuffers, ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS, &( ucRAM[ 0 ][ 0 ] ), sizeof( ucRAM[ 0 ] ) );
+}
+
+#endif
+/*-----------------------------------------------------------*/
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "FreeRTOS_IP.h"
+
+#include "test_support.h"
+
+static BaseType_t xTestFailed;
+
+static StaticTask_t xTestTaskBuffer;
+
+static StackType_t uxTestTaskStack[ configMINIMAL_STACK_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+void vAssertCalled( const char * pcFile,
+                    unsigned long ulLine )
+{
+    ( void ) printf( "%s:%lu: configASSERT failed\n", pcFile, ulLine );
+    ( void ) fflush( stdout );
+    abort();
+}
+/*-----------------------------------------------------------*/
+
+void vTestFail( const char * pcFile,
+                int iLine,
+                const char * pcCondition )
+{
+    ( void ) printf( "%s:%d: check failed: %s\n", pcFile, iLine, pcCondition );
+    xTestFailed = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTestTask( void * pvParameters )
+{
+    /* Never runs, the test code runs in its place. */
+    ( void ) pvParameters;
+}
+/*-----------------------------------------------------------*/
+
+int xTestRun( const TestCase_t * pxCases,
+              size_t uxCount )
+{
+    size_t uxIndex;
+    size_t uxFailures = 0U;
+
+    /* Without a running scheduler the first task created becomes the
+     * current task, so the kernel sees the test as that task. */
+    ( void ) xTaskCreateStatic( prvTestTask, "Test", configMINIMAL_STACK_SIZE, NULL, 1, uxTestTaskStack, &xTestTaskBuffer );
+
+    for( uxIndex = 0U; uxIndex < uxCount; uxIndex++ )
+    {
+        xTestFailed = pdFALSE;
+        pxCases[ uxIndex ].pxFunction();
+        ( void ) printf( "%s %s\n", ( xTestFailed != pdFALSE ) ? "FAIL" : "PASS", pxCases[ uxIndex ].pcName );
+
+        if( xTestFailed != pdFALSE )
+        {
+            uxFailures++;
+        }
+    }
+
+    ( void ) printf( "%u of %u tests failed\n", ( unsigned ) uxFailures, ( unsigned ) uxCount );
+
+    return ( uxFailures == 0U ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+/*-----------------------------------------------------------*/
+
+void vTestAdvanceTicks( TickType_t xTicks )
+{
+    TickType_t xCount;
+
+    for( xCount = 0U; xCount < xTicks; xCount++ )
+    {
+        ( void ) xTaskIncrementTick();
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Application hooks needed by the IP stack. */
+
+BaseType_t xApplicationGetRandomNumber( uint32_t * pulNumber )
+{
+    *pulNumber = ( uint32_t ) rand();
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulApplicationGetNextSequenceNumber( uint32_t ulSourceAddress,
+                                             uint16_t usSourcePort,
+                                             uint32_t ulDestinationAddress,
+                                             uint16_t usDestinationPort )
+{
+    ( void ) ulSourceAddress;
+    ( void ) usSourcePort;
+    ( void ) ulDestinationAddress;
+    ( void ) usDestinationPort;
+
+    return 1000U;
+}
+/*-----------------------------------------------------------*/
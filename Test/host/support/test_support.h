@@ -0,0 +1,57 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+/* Minimal test runner for the host unit tests. A failed check reports its
+ * location and ends the current test, the runner carries on with the next
+ * one and returns a non-zero exit code if any test failed. */
+
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+
+typedef void ( * TestFunction_t )( void );
+
+typedef struct xTEST_CASE
+{
+    const char * pcName;
+    TestFunction_t pxFunction;
+} TestCase_t;
+
+#define TEST_CASE( xFunction )    { #xFunction, xFunction }
+
+#define TEST_CHECK( xCondition )                                   \
+    do {                                                           \
+        if( !( xCondition ) )                                      \
+        {                                                          \
+            vTestFail( __FILE__, __LINE__, #xCondition );          \
+            return;                                                \
+        }                                                          \
+    } while( 0 )
+
+#define TEST_CHECK_EQUAL( xExpected, xActual )                                               \
+    do {                                                                                     \
+        const unsigned long ulTestExpected = ( unsigned long ) ( xExpected );                \
+        const unsigned long ulTestActual = ( unsigned long ) ( xActual );                    \
+        if( ulTestExpected != ulTestActual )                                                 \
+        {                                                                                    \
+            ( void ) printf( "  expected %lu, got %lu\n", ulTestExpected, ulTestActual );   \
+            vTestFail( __FILE__, __LINE__, #xExpected " == " #xActual );                   \
+            return;                                                                          \
+        }                                                                                    \
+    } while( 0 )
+
+#define TEST_RUN( pxCases )    xTestRun( pxCases, sizeof( pxCases ) / sizeof( pxCases[ 0 ] ) )
+
+void vTestFail( const char * pcFile,
+                int iLine,
+                const char * pcCondition );
+
+/* Creates the task that the test runs as, then runs every case. Returns the
+ * process exit code. */
+int xTestRun( const TestCase_t * pxCases,
+              size_t uxCount );
+
+/* Advances the kernel tick by xTicks. */
+void vTestAdvanceTicks( TickType_t xTicks );
+
+#endif /* TEST_SUPPORT_H */
@@ -0,0 +1,657 @@
+/* Host tests for portable/BufferAllocation.c. The allocator is included, so
+ * the tests can look at its free lists and drive prvLifoPop() and
+ * prvCompareAndSwap() the way an interrupted context would.
+ *
+ * The last case races host threads on the full-size pool, which takes the
+ * C11 atomics path of the allocator, and reports its rate next to the same
+ * loop behind a mutex. */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/BufferAllocation.c"
+
+#include "test_support.h"
+
+#define testLARGE_SIZE    ( ( size_t ) ipconfigNETWORK_MTU )
+
+/*-----------------------------------------------------------*/
+
+/* Puts every descriptor back on its free list, in the initial order. */
+static void prvResetPools( void )
+{
+    ( void ) xNetworkBuffersInitialise();
+
+    ( void ) memset( xNetworkBufferLinks, 0, sizeof( xNetworkBufferLinks ) );
+    prvLifoInitialise( &xFreeBuffers, xNetworkBuffers, xNetworkBufferLinks, ( uint32_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS );
+    uxMinimumFreeNetworkBuffers = ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS;
+
+    ( void ) memset( xSmallNetworkBufferLinks, 0, sizeof( xSmallNetworkBufferLinks ) );
+    prvLifoInitialise( &xFreeSmallBuffers, xSmallNetworkBuffers, xSmallNetworkBufferLinks, ( uint32_t ) ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS );
+
+    ( void ) memset( xMediumNetworkBufferLinks, 0, sizeof( xMediumNetworkBufferLinks ) );
+    prvLifoInitialise( &xFreeMediumBuffers, xMediumNetworkBuffers, xMediumNetworkBufferLinks, ( uint32_t ) ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS );
+
+    ( void ) memset( ulHoldTimes, 0, sizeof( ulHoldTimes ) );
+}
+/*-----------------------------------------------------------*/
+
+static void test_lifo_hands_out_descriptors_in_order( void )
+{
+    NetworkBufferDescriptor_t * pxBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+    size_t uxIndex;
+
+    prvResetPools();
+
+    for( uxIndex = 0U; uxIndex < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; uxIndex++ )
+    {
+        pxBuffers[ uxIndex ] = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+        TEST_CHECK( pxBuffers[ uxIndex ] == &( xNetworkBuffers[ uxIndex ] ) );
+        TEST_CHECK_EQUAL( testLARGE_SIZE, pxBuffers[ uxIndex ]->xDataLength );
+        TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - uxIndex - 1U, uxGetNumberOfFreeNetworkBuffers() );
+    }
+
+    TEST_CHECK( pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U ) == NULL );
+    TEST_CHECK_EQUAL( 0U, uxGetMinimumFreeNetworkBuffers() );
+
+    /* Last in, first out. */
+    vReleaseNetworkBufferAndDescriptor( pxBuffers[ 2 ] );
+    vReleaseNetworkBufferAndDescriptor( pxBuffers[ 5 ] );
+    TEST_CHECK_EQUAL( 2U, uxGetNumberOfFreeNetworkBuffers() );
+    TEST_CHECK( pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U ) == pxBuffers[ 5 ] );
+    TEST_CHECK( pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U ) == pxBuffers[ 2 ] );
+
+    for( uxIndex = 0U; uxIndex < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; uxIndex++ )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxBuffers[ uxIndex ] );
+    }
+
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+    TEST_CHECK_EQUAL( 0U, uxGetMinimumFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_lifo_tag_changes_on_every_update( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+    uint32_t ulHead;
+
+    prvResetPools();
+
+    ulHead = xFreeBuffers.ulHead;
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( pxBuffer != NULL );
+    TEST_CHECK_EQUAL( baLIFO_NEXT_TAG( ulHead ), xFreeBuffers.ulHead & ~baLIFO_INDEX_MASK );
+
+    ulHead = xFreeBuffers.ulHead;
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+    TEST_CHECK_EQUAL( baLIFO_NEXT_TAG( ulHead ), xFreeBuffers.ulHead & ~baLIFO_INDEX_MASK );
+    TEST_CHECK_EQUAL( 1U, xFreeBuffers.ulHead & baLIFO_INDEX_MASK );
+}
+/*-----------------------------------------------------------*/
+
+/* A pop that is interrupted between reading the head and swapping it, while
+ * the interrupt takes A and B and gives A back. The head then holds A again,
+ * and without the tag the resumed pop would install B, which is in use. */
+static void test_lifo_rejects_stale_head_after_aba( void )
+{
+    NetworkBufferDescriptor_t * pxA;
+    NetworkBufferDescriptor_t * pxB;
+    NetworkBufferDescriptor_t * pxNext;
+    uint32_t ulStaleHead;
+    uint32_t ulStaleNext;
+
+    prvResetPools();
+
+    ulStaleHead = xFreeBuffers.ulHead;
+    ulStaleNext = xNetworkBufferLinks[ ( ulStaleHead & baLIFO_INDEX_MASK ) - 1U ].ulNext;
+
+    pxA = pxNetworkBufferGetFromISR( testLARGE_SIZE );
+    pxB = pxNetworkBufferGetFromISR( testLARGE_SIZE );
+    TEST_CHECK( ( pxA != NULL ) && ( pxB != NULL ) );
+    TEST_CHECK_EQUAL( ulStaleNext, ( uint32_t ) ( pxB - xNetworkBuffers ) + 1U );
+    ( void ) xReleaseNetworkBufferFromISR( pxA );
+
+    TEST_CHECK_EQUAL( ulStaleHead & baLIFO_INDEX_MASK, xFreeBuffers.ulHead & baLIFO_INDEX_MASK );
+    TEST_CHECK( xFreeBuffers.ulHead != ulStaleHead );
+
+    /* The interrupted pop resumes with what it read before. */
+    TEST_CHECK( prvCompareAndSwap( &( xFreeBuffers.ulHead ), ulStaleHead, baLIFO_NEXT_TAG( ulStaleHead ) | ulStaleNext ) == pdFALSE );
+
+    /* Its retry gets A, and B stays off the free list. */
+    pxNext = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( pxNext == pxA );
+    pxNext = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( ( pxNext != NULL ) && ( pxNext != pxB ) );
+
+    vReleaseNetworkBufferAndDescriptor( pxA );
+    vReleaseNetworkBufferAndDescriptor( pxB );
+    vReleaseNetworkBufferAndDescriptor( pxNext );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_lifo_tag_wraps_without_touching_index( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+    uint32_t ulIndex;
+
+    prvResetPools();
+
+    ulIndex = xFreeBuffers.ulHead & baLIFO_INDEX_MASK;
+    xFreeBuffers.ulHead = ~baLIFO_INDEX_MASK | ulIndex;
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( pxBuffer == &( xNetworkBuffers[ ulIndex - 1U ] ) );
+    TEST_CHECK_EQUAL( 0U, xFreeBuffers.ulHead & ~baLIFO_INDEX_MASK );
+    TEST_CHECK_EQUAL( ulIndex + 1U, xFreeBuffers.ulHead & baLIFO_INDEX_MASK );
+
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+    TEST_CHECK_EQUAL( ulIndex, xFreeBuffers.ulHead & baLIFO_INDEX_MASK );
+}
+/*-----------------------------------------------------------*/
+
+static void test_isr_leaves_buffers_for_tasks( void )
+{
+    NetworkBufferDescriptor_t * pxBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+    size_t uxTaken = 0U;
+    size_t uxIndex;
+
+    prvResetPools();
+
+    while( ( pxBuffers[ uxTaken ] = pxNetworkBufferGetFromISR( testLARGE_SIZE ) ) != NULL )
+    {
+        uxTaken++;
+    }
+
+    TEST_CHECK_EQUAL( baINTERRUPT_BUFFER_GET_THRESHOLD, uxGetNumberOfFreeNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - baINTERRUPT_BUFFER_GET_THRESHOLD, uxTaken );
+
+    /* A task may still take the reserved buffers. */
+    pxBuffers[ uxTaken ] = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( pxBuffers[ uxTaken ] != NULL );
+    uxTaken++;
+
+    for( uxIndex = 0U; uxIndex < uxTaken; uxIndex++ )
+    {
+        ( void ) xReleaseNetworkBufferFromISR( pxBuffers[ uxIndex ] );
+    }
+
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_size_class_smallest_that_fits( void )
+{
+    NetworkBufferDescriptor_t * pxSmall;
+    NetworkBufferDescriptor_t * pxMedium;
+    NetworkBufferDescriptor_t * pxLarge;
+
+    prvResetPools();
+
+    pxSmall = pxGetNetworkBufferWithDescriptor( ipconfigSMALL_NETWORK_BUFFER_SIZE, 0U );
+    pxMedium = pxGetNetworkBufferWithDescriptor( ipconfigSMALL_NETWORK_BUFFER_SIZE + 1U, 0U );
+    pxLarge = pxGetNetworkBufferWithDescriptor( ipconfigMEDIUM_NETWORK_BUFFER_SIZE + 1U, 0U );
+
+    TEST_CHECK( xIsSmallNetworkDescriptor( pxSmall ) != pdFALSE );
+    TEST_CHECK( xIsMediumNetworkDescriptor( pxMedium ) != pdFALSE );
+    TEST_CHECK( xIsValidNetworkDescriptor( pxLarge ) != pdFALSE );
+    TEST_CHECK_EQUAL( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS - 1U, uxGetNumberOfFreeSmallNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS - 1U, uxGetNumberOfFreeMediumNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - 1U, uxGetNumberOfFreeNetworkBuffers() );
+
+    /* Each buffer points back to its own descriptor. */
+    TEST_CHECK( pxPacketBuffer_to_NetworkBuffer( pxSmall->pucEthernetBuffer ) == pxSmall );
+    TEST_CHECK( pxPacketBuffer_to_NetworkBuffer( pxMedium->pucEthernetBuffer ) == pxMedium );
+    TEST_CHECK( pxPacketBuffer_to_NetworkBuffer( pxLarge->pucEthernetBuffer ) == pxLarge );
+
+    /* A release returns the descriptor to the pool it came from. */
+    vReleaseNetworkBufferAndDescriptor( pxSmall );
+    vReleaseNetworkBufferAndDescriptor( pxMedium );
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+    TEST_CHECK_EQUAL( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeSmallNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeMediumNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+
+    /* Only the full-size pool counts towards the low-water mark. */
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - 1U, uxGetMinimumFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_size_class_falls_back_to_bigger_class( void )
+{
+    NetworkBufferDescriptor_t * pxBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS + ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS + 1U ];
+    size_t uxIndex;
+
+    prvResetPools();
+
+    for( uxIndex = 0U; uxIndex < ( sizeof( pxBuffers ) / sizeof( pxBuffers[ 0 ] ) ); uxIndex++ )
+    {
+        pxBuffers[ uxIndex ] = pxGetNetworkBufferWithDescriptor( 60U, 0U );
+        TEST_CHECK( pxBuffers[ uxIndex ] != NULL );
+    }
+
+    TEST_CHECK_EQUAL( 0U, uxGetNumberOfFreeSmallNetworkBuffers() );
+    TEST_CHECK_EQUAL( 0U, uxGetNumberOfFreeMediumNetworkBuffers() );
+    TEST_CHECK( xIsSmallNetworkDescriptor( pxBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS - 1U ] ) != pdFALSE );
+    TEST_CHECK( xIsMediumNetworkDescriptor( pxBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ] ) != pdFALSE );
+    TEST_CHECK( xIsValidNetworkDescriptor( pxBuffers[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS + ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ] ) != pdFALSE );
+
+    /* The small-only getter never falls back. */
+    TEST_CHECK( pxGetSmallNetworkBufferWithDescriptor( 60U ) == NULL );
+
+    for( uxIndex = 0U; uxIndex < ( sizeof( pxBuffers ) / sizeof( pxBuffers[ 0 ] ) ); uxIndex++ )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxBuffers[ uxIndex ] );
+    }
+
+    TEST_CHECK_EQUAL( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeSmallNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeMediumNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_size_class_small_getter( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    prvResetPools();
+
+    TEST_CHECK( pxGetSmallNetworkBufferWithDescriptor( ipconfigSMALL_NETWORK_BUFFER_SIZE + 1U ) == NULL );
+
+    pxBuffer = pxGetSmallNetworkBufferWithDescriptor( ipconfigSMALL_NETWORK_BUFFER_SIZE );
+    TEST_CHECK( xIsSmallNetworkDescriptor( pxBuffer ) != pdFALSE );
+    TEST_CHECK_EQUAL( ipconfigSMALL_NETWORK_BUFFER_SIZE, pxBuffer->xDataLength );
+
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+    TEST_CHECK_EQUAL( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeSmallNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_size_class_resize_moves_data( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+    NetworkBufferDescriptor_t * pxResized;
+    size_t uxIndex;
+
+    prvResetPools();
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( 100U, 0U );
+    TEST_CHECK( xIsSmallNetworkDescriptor( pxBuffer ) != pdFALSE );
+
+    for( uxIndex = 0U; uxIndex < 100U; uxIndex++ )
+    {
+        pxBuffer->pucEthernetBuffer[ uxIndex ] = ( uint8_t ) uxIndex;
+    }
+
+    /* Growing within the capacity keeps the buffer. */
+    pxResized = pxResizeNetworkBufferWithDescriptor( pxBuffer, ipconfigSMALL_NETWORK_BUFFER_SIZE );
+    TEST_CHECK( pxResized == pxBuffer );
+    TEST_CHECK_EQUAL( ipconfigSMALL_NETWORK_BUFFER_SIZE, pxResized->xDataLength );
+    pxResized->xDataLength = 100U;
+
+    /* Beyond it, the data moves to the next class that fits. */
+    pxResized = pxResizeNetworkBufferWithDescriptor( pxBuffer, ipconfigMEDIUM_NETWORK_BUFFER_SIZE );
+    TEST_CHECK( xIsMediumNetworkDescriptor( pxResized ) != pdFALSE );
+    TEST_CHECK_EQUAL( ipconfigMEDIUM_NETWORK_BUFFER_SIZE, pxResized->xDataLength );
+    TEST_CHECK_EQUAL( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeSmallNetworkBuffers() );
+
+    for( uxIndex = 0U; uxIndex < 100U; uxIndex++ )
+    {
+        TEST_CHECK_EQUAL( uxIndex, pxResized->pucEthernetBuffer[ uxIndex ] );
+    }
+
+    vReleaseNetworkBufferAndDescriptor( pxResized );
+    TEST_CHECK_EQUAL( ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeMediumNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_refcount_last_release_frees( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    prvResetPools();
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( pxNetworkBufferAddReference( pxBuffer ) == pxBuffer );
+    TEST_CHECK( pxNetworkBufferAddReference( pxBuffer ) == pxBuffer );
+    TEST_CHECK_EQUAL( 3U, xNetworkBufferLinks[ pxBuffer - xNetworkBuffers ].ulRefCount );
+
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+    ( void ) xReleaseNetworkBufferFromISR( pxBuffer );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - 1U, uxGetNumberOfFreeNetworkBuffers() );
+    TEST_CHECK_EQUAL( testLARGE_SIZE, pxBuffer->xDataLength );
+
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+    TEST_CHECK_EQUAL( 0U, pxBuffer->xDataLength );
+}
+/*-----------------------------------------------------------*/
+
+static void test_refcount_double_release_is_ignored( void )
+{
+    NetworkBufferDescriptor_t * pxSmall;
+    NetworkBufferDescriptor_t * pxLarge;
+    NetworkBufferDescriptor_t * pxFirst;
+    NetworkBufferDescriptor_t * pxSecond;
+
+    prvResetPools();
+
+    pxSmall = pxGetSmallNetworkBufferWithDescriptor( 60U );
+    pxLarge = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+
+    vReleaseNetworkBufferAndDescriptor( pxSmall );
+    vReleaseNetworkBufferAndDescriptor( pxSmall );
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+    ( void ) xReleaseNetworkBufferFromISR( pxLarge );
+
+    TEST_CHECK_EQUAL( ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeSmallNetworkBuffers() );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+
+    /* The descriptor is on the free list only once. */
+    pxFirst = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    pxSecond = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    TEST_CHECK( pxFirst == pxLarge );
+    TEST_CHECK( pxSecond != pxLarge );
+
+    vReleaseNetworkBufferAndDescriptor( pxFirst );
+    vReleaseNetworkBufferAndDescriptor( pxSecond );
+}
+/*-----------------------------------------------------------*/
+
+static void test_refcount_free_buffer_cannot_be_revived( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    prvResetPools();
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+
+    TEST_CHECK( pxNetworkBufferAddReference( pxBuffer ) == NULL );
+    TEST_CHECK_EQUAL( 0U, xNetworkBufferLinks[ pxBuffer - xNetworkBuffers ].ulRefCount );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_refcount_foreign_descriptor_is_ignored( void )
+{
+    NetworkBufferDescriptor_t xForeign;
+
+    prvResetPools();
+
+    ( void ) memset( &xForeign, 0, sizeof( xForeign ) );
+
+    /* Not a pool buffer, so the caller has to make a copy. */
+    TEST_CHECK( pxNetworkBufferAddReference( &xForeign ) == NULL );
+
+    vReleaseNetworkBufferAndDescriptor( &xForeign );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+#define testTOTAL_DESCRIPTORS    ( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS + ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS + ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS )
+
+static void test_owner_hand_over_books_hold_time( void )
+{
+    NetworkBufferOwnerStats_t xStats[ eNetworkBufferOwnerCount ];
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    prvResetPools();
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    vGetNetworkBufferOwnerStats( xStats );
+    TEST_CHECK_EQUAL( 1U, xStats[ eNetworkBufferStack ].uxHeld );
+    TEST_CHECK_EQUAL( testTOTAL_DESCRIPTORS - 1U, xStats[ eNetworkBufferFree ].uxHeld );
+
+    /* 5 ticks fall in bucket 2, which counts holds of 4 to 15 ticks. */
+    vTestAdvanceTicks( 5U );
+    vNetworkBufferSetOwner( pxBuffer, eNetworkBufferDriverTx );
+    vTestAdvanceTicks( 3U );
+
+    vGetNetworkBufferOwnerStats( xStats );
+    TEST_CHECK_EQUAL( 0U, xStats[ eNetworkBufferStack ].uxHeld );
+    TEST_CHECK_EQUAL( 1U, xStats[ eNetworkBufferStack ].ulHoldTimes[ 2 ] );
+    TEST_CHECK_EQUAL( 1U, xStats[ eNetworkBufferDriverTx ].uxHeld );
+    TEST_CHECK_EQUAL( 3U, xStats[ eNetworkBufferDriverTx ].xLongestHeld );
+    TEST_CHECK_EQUAL( 8U, xStats[ eNetworkBufferDriverTx ].xOldestAllocation );
+
+    /* The release books the driver's hold, 3 ticks fall in bucket 1. */
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+
+    vGetNetworkBufferOwnerStats( xStats );
+    TEST_CHECK_EQUAL( 0U, xStats[ eNetworkBufferDriverTx ].uxHeld );
+    TEST_CHECK_EQUAL( 1U, xStats[ eNetworkBufferDriverTx ].ulHoldTimes[ 1 ] );
+    TEST_CHECK_EQUAL( testTOTAL_DESCRIPTORS, xStats[ eNetworkBufferFree ].uxHeld );
+}
+/*-----------------------------------------------------------*/
+
+static void test_owner_oldest_allocation_spots_a_leak( void )
+{
+    NetworkBufferOwnerStats_t xStats[ eNetworkBufferOwnerCount ];
+    NetworkBufferDescriptor_t * pxLeaked;
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    prvResetPools();
+
+    pxLeaked = pxGetSmallNetworkBufferWithDescriptor( 60U );
+    vNetworkBufferSetOwner( pxLeaked, eNetworkBufferSocket );
+    vTestAdvanceTicks( 100U );
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( 60U, 0U );
+    vNetworkBufferSetOwner( pxBuffer, eNetworkBufferSocket );
+    vTestAdvanceTicks( 10U );
+
+    vGetNetworkBufferOwnerStats( xStats );
+    TEST_CHECK_EQUAL( 2U, xStats[ eNetworkBufferSocket ].uxHeld );
+    TEST_CHECK_EQUAL( 110U, xStats[ eNetworkBufferSocket ].xOldestAllocation );
+    TEST_CHECK_EQUAL( 110U, xStats[ eNetworkBufferSocket ].xLongestHeld );
+
+    vReleaseNetworkBufferAndDescriptor( pxLeaked );
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+}
+/*-----------------------------------------------------------*/
+
+static void test_owner_cannot_be_set_to_free( void )
+{
+    NetworkBufferOwnerStats_t xStats[ eNetworkBufferOwnerCount ];
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    prvResetPools();
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+    vNetworkBufferSetOwner( pxBuffer, eNetworkBufferFree );
+
+    vGetNetworkBufferOwnerStats( xStats );
+    TEST_CHECK_EQUAL( 1U, xStats[ eNetworkBufferStack ].uxHeld );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - 1U, uxGetNumberOfFreeNetworkBuffers() );
+
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+}
+/*-----------------------------------------------------------*/
+
+/* Buffers each thread holds at once, so the threads share the pool */
+#define testCONTENTION_HELD          4U
+#define testCONTENTION_ROUNDS        50000U
+#define testCONTENTION_MAX_THREADS   4U
+
+typedef struct xCONTENTION_THREAD
+{
+    uint32_t ulId;
+    BaseType_t xLocked;      /* Each call behind xContentionLock, as with a semaphore */
+    uint32_t ulEmpty;        /* Gets that found the pool empty */
+    uint32_t ulCorrupted;    /* Buffers another thread wrote to while this one held them */
+} ContentionThread_t;
+
+static pthread_mutex_t xContentionLock = PTHREAD_MUTEX_INITIALIZER;
+
+static NetworkBufferDescriptor_t * prvContentionGet( BaseType_t xLocked )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+
+    if( xLocked != pdFALSE )
+    {
+        ( void ) pthread_mutex_lock( &xContentionLock );
+    }
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( testLARGE_SIZE, 0U );
+
+    if( xLocked != pdFALSE )
+    {
+        ( void ) pthread_mutex_unlock( &xContentionLock );
+    }
+
+    return pxBuffer;
+}
+/*-----------------------------------------------------------*/
+
+static void prvContentionRelease( NetworkBufferDescriptor_t * pxBuffer,
+                                  BaseType_t xLocked )
+{
+    if( xLocked != pdFALSE )
+    {
+        ( void ) pthread_mutex_lock( &xContentionLock );
+    }
+
+    vReleaseNetworkBufferAndDescriptor( pxBuffer );
+
+    if( xLocked != pdFALSE )
+    {
+        ( void ) pthread_mutex_unlock( &xContentionLock );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Takes testCONTENTION_HELD buffers, stamps them, and checks the stamps
+ * before giving them back. A descriptor handed out twice shows up as a
+ * stamp of another thread. */
+static void * prvContentionThread( void * pvParameters )
+{
+    ContentionThread_t * const pxThread = ( ContentionThread_t * ) pvParameters;
+    NetworkBufferDescriptor_t * pxHeld[ testCONTENTION_HELD ];
+    uint32_t ulRound;
+    uint32_t ulStamp;
+    size_t uxIndex;
+
+    for( ulRound = 0U; ulRound < testCONTENTION_ROUNDS; ulRound++ )
+    {
+        ulStamp = ( pxThread->ulId << 24 ) | ulRound;
+
+        for( uxIndex = 0U; uxIndex < testCONTENTION_HELD; uxIndex++ )
+        {
+            pxHeld[ uxIndex ] = prvContentionGet( pxThread->xLocked );
+
+            if( pxHeld[ uxIndex ] == NULL )
+            {
+                ++pxThread->ulEmpty;
+            }
+            else
+            {
+                ( void ) memcpy( pxHeld[ uxIndex ]->pucEthernetBuffer, &ulStamp, sizeof( ulStamp ) );
+            }
+        }
+
+        for( uxIndex = 0U; uxIndex < testCONTENTION_HELD; uxIndex++ )
+        {
+            if( pxHeld[ uxIndex ] != NULL )
+            {
+                if( memcmp( pxHeld[ uxIndex ]->pucEthernetBuffer, &ulStamp, sizeof( ulStamp ) ) != 0 )
+                {
+                    ++pxThread->ulCorrupted;
+                }
+
+                prvContentionRelease( pxHeld[ uxIndex ], pxThread->xLocked );
+            }
+        }
+    }
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void test_lifo_contention_rate( void )
+{
+    static const uint32_t ulThreadCounts[] = { 1U, 2U, testCONTENTION_MAX_THREADS };
+    ContentionThread_t xThreads[ testCONTENTION_MAX_THREADS ];
+    pthread_t xHandles[ testCONTENTION_MAX_THREADS ];
+    struct timespec xStart;
+    struct timespec xEnd;
+    BaseType_t xLocked;
+    size_t uxCount;
+    uint32_t ulThread;
+
+    for( uxCount = 0U; uxCount < ( sizeof( ulThreadCounts ) / sizeof( ulThreadCounts[ 0 ] ) ); uxCount++ )
+    {
+        for( xLocked = pdFALSE; xLocked <= pdTRUE; xLocked++ )
+        {
+            const uint32_t ulThreadCount = ulThreadCounts[ uxCount ];
+
+            prvResetPools();
+            ( void ) memset( xThreads, 0, sizeof( xThreads ) );
+            ( void ) clock_gettime( CLOCK_MONOTONIC, &xStart );
+
+            for( ulThread = 0U; ulThread < ulThreadCount; ulThread++ )
+            {
+                xThreads[ ulThread ].ulId = ulThread + 1U;
+                xThreads[ ulThread ].xLocked = xLocked;
+                TEST_CHECK( pthread_create( &xHandles[ ulThread ], NULL, prvContentionThread, &xThreads[ ulThread ] ) == 0 );
+            }
+
+            for( ulThread = 0U; ulThread < ulThreadCount; ulThread++ )
+            {
+                ( void ) pthread_join( xHandles[ ulThread ], NULL );
+            }
+
+            ( void ) clock_gettime( CLOCK_MONOTONIC, &xEnd );
+
+            const double dSeconds = ( double ) ( xEnd.tv_sec - xStart.tv_sec ) + ( ( double ) ( xEnd.tv_nsec - xStart.tv_nsec ) * 1e-9 );
+            const double dPairs = ( double ) ulThreadCount * testCONTENTION_ROUNDS * testCONTENTION_HELD;
+
+            ( void ) printf( "  %u threads, %s: %.0f allocations per second, each released\n",
+                             ( unsigned ) ulThreadCount,
+                             ( xLocked != pdFALSE ) ? "mutex    " : "lock-free",
+                             dPairs / dSeconds );
+
+            for( ulThread = 0U; ulThread < ulThreadCount; ulThread++ )
+            {
+                TEST_CHECK_EQUAL( 0U, xThreads[ ulThread ].ulEmpty );
+                TEST_CHECK_EQUAL( 0U, xThreads[ ulThread ].ulCorrupted );
+            }
+
+            /* Every descriptor went back exactly once */
+            TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+
+            for( ulThread = 0U; ulThread < ( uint32_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; ulThread++ )
+            {
+                TEST_CHECK_EQUAL( 0U, xNetworkBufferLinks[ ulThread ].ulRefCount );
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_lifo_hands_out_descriptors_in_order ),
+    TEST_CASE( test_lifo_tag_changes_on_every_update ),
+    TEST_CASE( test_lifo_rejects_stale_head_after_aba ),
+    TEST_CASE( test_lifo_tag_wraps_without_touching_index ),
+    TEST_CASE( test_isr_leaves_buffers_for_tasks ),
+    TEST_CASE( test_size_class_smallest_that_fits ),
+    TEST_CASE( test_size_class_falls_back_to_bigger_class ),
+    TEST_CASE( test_size_class_small_getter ),
+    TEST_CASE( test_size_class_resize_moves_data ),
+    TEST_CASE( test_refcount_last_release_frees ),
+    TEST_CASE( test_refcount_double_release_is_ignored ),
+    TEST_CASE( test_refcount_free_buffer_cannot_be_revived ),
+    TEST_CASE( test_refcount_foreign_descriptor_is_ignored ),
+    TEST_CASE( test_owner_hand_over_books_hold_time ),
+    TEST_CASE( test_owner_oldest_allocation_spots_a_leak ),
+    TEST_CASE( test_owner_cannot_be_set_to_free ),
+    TEST_CASE( test_lifo_contention_rate ),
+};
+
+int main( void )
+{
+    return TEST_RUN( xTestCases );
+}
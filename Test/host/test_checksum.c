@@ -0,0 +1,307 @@
+/* Host tests for usGenerateChecksum() in FreeRTOS_IP_Utils.c. Its result is
+ * compared with a plain RFC 1071 sum, one 16-bit word at a time, for every
+ * start alignment and every length up to a jumbo sized buffer.
+ *
+ * The Cortex-M build sums the aligned blocks with the ADCS chain of
+ * prvChecksumCarryChain(), which the host cannot run. A C model of it, one
+ * statement per instruction with the carry flag kept apart, is checked against
+ * the same reference. */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+
+#include "test_support.h"
+
+#define testMAX_LENGTH     3000U
+#define testALIGNMENTS     8U
+
+/* Room for every start alignment, and a guard byte on each side. */
+static uint8_t ucBuffer[ testMAX_LENGTH + testALIGNMENTS + 8U ] __attribute__( ( aligned( 8 ) ) );
+
+/*-----------------------------------------------------------*/
+
+/* Sums big-endian 16-bit words, an odd last byte is the high half of a word. */
+static uint16_t prvReferenceChecksum( uint16_t usSum,
+                                      const uint8_t * pucData,
+                                      size_t uxLength )
+{
+    uint32_t ulSum = usSum;
+    size_t uxIndex;
+
+    for( uxIndex = 0U; ( uxIndex + 1U ) < uxLength; uxIndex += 2U )
+    {
+        ulSum += ( ( uint32_t ) pucData[ uxIndex ] << 8 ) | pucData[ uxIndex + 1U ];
+    }
+
+    if( ( uxLength & 1U ) != 0U )
+    {
+        ulSum += ( uint32_t ) pucData[ uxLength - 1U ] << 8;
+    }
+
+    while( ( ulSum >> 16 ) != 0U )
+    {
+        ulSum = ( ulSum & 0xFFFFU ) + ( ulSum >> 16 );
+    }
+
+    return ( uint16_t ) ulSum;
+}
+/*-----------------------------------------------------------*/
+
+/* Checks every alignment and length against the reference, starting from usSum. */
+static BaseType_t prvCheckAll( uint16_t usSum )
+{
+    size_t uxAlign;
+    size_t uxLength;
+
+    for( uxAlign = 0U; uxAlign < testALIGNMENTS; uxAlign++ )
+    {
+        const uint8_t * const pucData = &( ucBuffer[ 4U + uxAlign ] );
+
+        for( uxLength = 0U; uxLength <= testMAX_LENGTH; uxLength++ )
+        {
+            const uint16_t usExpected = prvReferenceChecksum( usSum, pucData, uxLength );
+            const uint16_t usActual = usGenerateChecksum( usSum, pucData, uxLength );
+
+            if( usExpected != usActual )
+            {
+                ( void ) printf( "  sum %04X, alignment %u, length %u: expected %04X, got %04X\n",
+                                 ( unsigned ) usSum, ( unsigned ) uxAlign, ( unsigned ) uxLength,
+                                 ( unsigned ) usExpected, ( unsigned ) usActual );
+                return pdFALSE;
+            }
+        }
+    }
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+/* ADCS: Rd = Rn + Rm + C, C set on an unsigned overflow */
+static uint32_t prvAddWithCarry( uint32_t ulA,
+                                 uint32_t ulB,
+                                 uint32_t * pulCarry )
+{
+    const uint64_t ullSum = ( uint64_t ) ulA + ulB + *pulCarry;
+
+    *pulCarry = ( uint32_t ) ( ullSum >> 32 );
+
+    return ( uint32_t ) ullSum;
+}
+/*-----------------------------------------------------------*/
+
+/* The kernel of prvChecksumCarryChain(), instruction by instruction. Returns
+ * the carry flag left at the end in *pulCarryOut, which the kernel drops. */
+static uint32_t prvCarryChainModel( uint32_t ulSum,
+                                    const uint32_t * pulSource,
+                                    size_t uxBlockCount,
+                                    uint32_t * pulCarryOut )
+{
+    uint32_t ulCarry = 0U;
+    size_t uxCount = uxBlockCount;
+
+    /* adds sum, sum, #0 */
+    ulSum = prvAddWithCarry( ulSum, 0U, &ulCarry );
+
+    do
+    {
+        /* ldrd and four adcs, sub and teq leave the carry alone */
+        ulSum = prvAddWithCarry( ulSum, pulSource[ 0 ], &ulCarry );
+        ulSum = prvAddWithCarry( ulSum, pulSource[ 1 ], &ulCarry );
+        ulSum = prvAddWithCarry( ulSum, pulSource[ 2 ], &ulCarry );
+        ulSum = prvAddWithCarry( ulSum, pulSource[ 3 ], &ulCarry );
+        pulSource = &( pulSource[ 4 ] );
+        uxCount--;
+    } while( uxCount != 0U );
+
+    /* adc sum, sum, #0 */
+    ulSum = prvAddWithCarry( ulSum, 0U, &ulCarry );
+    *pulCarryOut = ulCarry;
+
+    return ulSum;
+}
+/*-----------------------------------------------------------*/
+
+/* usGenerateChecksum() as built with the carry chain, for 32-bit aligned data:
+ * the blocks go through the kernel, the rest is added in 16-bit words, then
+ * the halves are folded. */
+static uint16_t prvCarryChainChecksum( uint16_t usSum,
+                                       const uint8_t * pucData,
+                                       size_t uxLength,
+                                       uint32_t * pulCarryOut )
+{
+    const size_t uxBlocks = uxLength / 16U;
+    uint32_t ulSum = FreeRTOS_htons( usSum );
+    size_t uxIndex;
+
+    *pulCarryOut = 0U;
+
+    if( uxBlocks != 0U )
+    {
+        ulSum = prvCarryChainModel( ulSum, ( const uint32_t * ) pucData, uxBlocks, pulCarryOut );
+    }
+
+    /* The caller folds the halves, adding no carry of its own */
+    ulSum = ( ulSum & 0xFFFFU ) + ( ulSum >> 16 );
+
+    for( uxIndex = uxBlocks * 16U; ( uxIndex + 1U ) < uxLength; uxIndex += 2U )
+    {
+        uint16_t usWord;
+
+        ( void ) memcpy( &usWord, &( pucData[ uxIndex ] ), sizeof( usWord ) );
+        ulSum += usWord;
+    }
+
+    if( ( uxLength & 1U ) != 0U )
+    {
+        /* The odd byte is the high half of a big-endian word */
+        ulSum += pucData[ uxLength - 1U ];
+    }
+
+    while( ( ulSum >> 16 ) != 0U )
+    {
+        ulSum = ( ulSum & 0xFFFFU ) + ( ulSum >> 16 );
+    }
+
+    return FreeRTOS_ntohs( ( uint16_t ) ulSum );
+}
+/*-----------------------------------------------------------*/
+
+/* Checks the model against the reference for every length, from an aligned start. */
+static BaseType_t prvCheckCarryChain( uint16_t usSum )
+{
+    const uint8_t * const pucData = &( ucBuffer[ 8U ] );
+    size_t uxLength;
+
+    for( uxLength = 0U; uxLength <= testMAX_LENGTH; uxLength++ )
+    {
+        uint32_t ulCarryOut;
+        const uint16_t usExpected = prvReferenceChecksum( usSum, pucData, uxLength );
+        const uint16_t usActual = prvCarryChainChecksum( usSum, pucData, uxLength, &ulCarryOut );
+
+        if( ( usExpected != usActual ) || ( ulCarryOut != 0U ) )
+        {
+            ( void ) printf( "  sum %04X, length %u: expected %04X, got %04X, carry left %u\n",
+                             ( unsigned ) usSum, ( unsigned ) uxLength,
+                             ( unsigned ) usExpected, ( unsigned ) usActual, ( unsigned ) ulCarryOut );
+            return pdFALSE;
+        }
+    }
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void test_random_data_matches_reference( void )
+{
+    uint32_t ulState = 0x12345678U;
+    size_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < sizeof( ucBuffer ); uxIndex++ )
+    {
+        ulState = ( ulState * 1103515245U ) + 12345U;
+        ucBuffer[ uxIndex ] = ( uint8_t ) ( ulState >> 16 );
+    }
+
+    TEST_CHECK( prvCheckAll( 0U ) == pdTRUE );
+    TEST_CHECK( prvCheckAll( 0x1234U ) == pdTRUE );
+    TEST_CHECK( prvCheckCarryChain( 0U ) == pdTRUE );
+    TEST_CHECK( prvCheckCarryChain( 0x1234U ) == pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+static void test_all_ones_carries_on_every_word( void )
+{
+    /* Every 32-bit addition overflows */
+    ( void ) memset( ucBuffer, 0xFF, sizeof( ucBuffer ) );
+
+    TEST_CHECK( prvCheckAll( 0U ) == pdTRUE );
+    TEST_CHECK( prvCheckAll( 0xFFFFU ) == pdTRUE );
+    TEST_CHECK( prvCheckCarryChain( 0U ) == pdTRUE );
+    TEST_CHECK( prvCheckCarryChain( 0xFFFFU ) == pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+static void test_zero_data_keeps_initial_sum( void )
+{
+    ( void ) memset( ucBuffer, 0, sizeof( ucBuffer ) );
+
+    TEST_CHECK( prvCheckAll( 0U ) == pdTRUE );
+    TEST_CHECK( prvCheckAll( 0xABCDU ) == pdTRUE );
+    TEST_CHECK( prvCheckCarryChain( 0U ) == pdTRUE );
+    TEST_CHECK( prvCheckCarryChain( 0xABCDU ) == pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+static void test_ipv4_header_checksum( void )
+{
+    /* UDP from 192.168.0.1 to 192.168.0.199, its header checksum is B861 */
+    static const uint8_t ucHeader[] =
+    {
+        0x45U, 0x00U, 0x00U, 0x73U, 0x00U, 0x00U, 0x40U, 0x00U, 0x40U, 0x11U,
+        0x00U, 0x00U, 0xC0U, 0xA8U, 0x00U, 0x01U, 0xC0U, 0xA8U, 0x00U, 0xC7U
+    };
+
+    TEST_CHECK_EQUAL( 0xB861U, ( uint16_t ) ~usGenerateChecksum( 0U, ucHeader, sizeof( ucHeader ) ) );
+}
+/*-----------------------------------------------------------*/
+
+static void test_carry_chain_final_carry_in_ends_it( void )
+{
+    /* Words next to the wrap, where an add carries or nearly does */
+    static const uint32_t ulEdges[] = { 0U, 1U, 0x7FFFFFFFU, 0x80000000U, 0xFFFFFFFEU, 0xFFFFFFFFU };
+    const size_t uxEdgeCount = sizeof( ulEdges ) / sizeof( ulEdges[ 0 ] );
+    uint32_t ulBlock[ 4 ];
+    uint32_t ulCarryOut;
+    size_t uxCase;
+    size_t uxStart;
+    size_t uxWord;
+
+    /* An add that carries leaves at most 0xFFFFFFFE, so the one carry-in
+     * after the loop never carries again, for every start and block made of
+     * the edge words */
+    for( uxStart = 0U; uxStart < uxEdgeCount; uxStart++ )
+    {
+        for( uxCase = 0U; uxCase < ( uxEdgeCount * uxEdgeCount * uxEdgeCount * uxEdgeCount ); uxCase++ )
+        {
+            size_t uxDigits = uxCase;
+
+            for( uxWord = 0U; uxWord < 4U; uxWord++ )
+            {
+                ulBlock[ uxWord ] = ulEdges[ uxDigits % uxEdgeCount ];
+                uxDigits /= uxEdgeCount;
+            }
+
+            const uint32_t ulSum = prvCarryChainModel( ulEdges[ uxStart ], ulBlock, 1U, &ulCarryOut );
+            const uint64_t ullExpected = ( uint64_t ) ulEdges[ uxStart ] + ulBlock[ 0 ] + ulBlock[ 1 ] + ulBlock[ 2 ] + ulBlock[ 3 ];
+
+            TEST_CHECK_EQUAL( 0U, ulCarryOut );
+
+            /* With the end-around carry, a one's complement sum is the plain sum modulo 2^32 - 1 */
+            TEST_CHECK_EQUAL( ullExpected % 0xFFFFFFFFULL, ( uint64_t ) ulSum % 0xFFFFFFFFULL );
+        }
+    }
+
+    /* Every word all ones, the sum stays 0xFFFFFFFF */
+    ( void ) memset( ucBuffer, 0xFF, sizeof( ucBuffer ) );
+    TEST_CHECK_EQUAL( 0xFFFFFFFFU, prvCarryChainModel( 0xFFFFFFFFU, ( const uint32_t * ) &( ucBuffer[ 8U ] ), 8U, &ulCarryOut ) );
+    TEST_CHECK_EQUAL( 0U, ulCarryOut );
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_random_data_matches_reference ),
+    TEST_CASE( test_all_ones_carries_on_every_word ),
+    TEST_CASE( test_zero_data_keeps_initial_sum ),
+    TEST_CASE( test_ipv4_header_checksum ),
+    TEST_CASE( test_carry_chain_final_carry_in_ends_it ),
+};
+
+int main( void )
+{
+    return TEST_RUN( xTestCases );
+}
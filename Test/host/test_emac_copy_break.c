@@ -0,0 +1,225 @@
+/* Host tests for the Rx copy-break of the EMAC driver. Small UDP frames for a
+ * bound port move from the large DMA buffer into a small network buffer, and
+ * the large buffer goes back to the pool for the next Rx refill. The driver
+ * is built for the STM32H7 against stm32/hal_fake.c. */
+
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testBOUND_PORT      5000U
+#define testOTHER_PORT      5001U
+#define testHEADERS_LENGTH  ( ipSIZE_OF_ETH_HEADER + ipSIZE_OF_IPv4_HEADER + ipSIZE_OF_UDP_HEADER )
+
+static NetworkInterface_t xInterface;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+static ListItem_t xBoundPortItem;
+
+BaseType_t __wrap_xIPIsNetworkTaskReady( void );
+
+/*-----------------------------------------------------------*/
+
+/* Linked in place of xIPIsNetworkTaskReady(), see CMakeLists.txt. Without a
+ * running IP-task, xPortHasUDPSocket() would never find a bound port. */
+BaseType_t __wrap_xIPIsNetworkTaskReady( void )
+{
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    ( void ) xNetworkBuffersInitialise();
+    vNetworkSocketsInit();
+    pxNetworkInterfaces = NULL;
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+
+    /* What FreeRTOS_bind() does for a UDP socket, the port is kept in network order */
+    vListInitialiseItem( &xBoundPortItem );
+    listSET_LIST_ITEM_VALUE( &xBoundPortItem, ( TickType_t ) FreeRTOS_htons( testBOUND_PORT ) );
+    vListInsertEnd( &xBoundUDPSocketsList, &xBoundPortItem );
+}
+/*-----------------------------------------------------------*/
+
+/* Returns a large buffer holding a frame as the DMA would have received it. */
+static NetworkBufferDescriptor_t * prvReceiveFrame( uint8_t ucProtocol,
+                                                    uint16_t usPort,
+                                                    size_t uxPayloadLength )
+{
+    NetworkBufferDescriptor_t * const pxDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_RX_BUFFER_SIZE, 0U );
+    size_t uxIndex;
+
+    configASSERT( pxDescriptor != NULL );
+
+    UDPPacket_t * const pxPacket = ( UDPPacket_t * ) pxDescriptor->pucEthernetBuffer;
+
+    ( void ) memset( pxPacket, 0, testHEADERS_LENGTH );
+    pxPacket->xEthernetHeader.usFrameType = ipIPv4_FRAME_TYPE;
+    pxPacket->xIPHeader.ucVersionHeaderLength = ipIPV4_VERSION_HEADER_LENGTH_MIN;
+    pxPacket->xIPHeader.ucProtocol = ucProtocol;
+    pxPacket->xIPHeader.usLength = FreeRTOS_htons( ( uint16_t ) ( ipSIZE_OF_IPv4_HEADER + ipSIZE_OF_UDP_HEADER + uxPayloadLength ) );
+    pxPacket->xUDPHeader.usDestinationPort = FreeRTOS_htons( usPort );
+
+    for( uxIndex = 0U; uxIndex < uxPayloadLength; uxIndex++ )
+    {
+        pxDescriptor->pucEthernetBuffer[ testHEADERS_LENGTH + uxIndex ] = ( uint8_t ) uxIndex;
+    }
+
+    pxDescriptor->xDataLength = testHEADERS_LENGTH + uxPayloadLength;
+
+    return pxDescriptor;
+}
+/*-----------------------------------------------------------*/
+
+static void test_small_udp_frame_is_copied( void )
+{
+    prvSetUp();
+
+    NetworkBufferDescriptor_t * const pxLarge = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, 32U );
+    const size_t uxLength = pxLarge->xDataLength;
+    uint8_t ucFrame[ testHEADERS_LENGTH + 32U ];
+
+    ( void ) memcpy( ucFrame, pxLarge->pucEthernetBuffer, uxLength );
+    const UBaseType_t uxFreeSmall = uxGetNumberOfFreeSmallNetworkBuffers();
+
+    NetworkBufferDescriptor_t * const pxResult = prvRxCopyBreak( pxEMACData, pxLarge );
+
+    TEST_CHECK( pxResult != pxLarge );
+    TEST_CHECK_EQUAL( uxLength, pxResult->xDataLength );
+    TEST_CHECK( memcmp( ucFrame, pxResult->pucEthernetBuffer, uxLength ) == 0 );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulRxCopyBreakFrames );
+
+    /* The large buffer is free for the Rx ring again */
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+    TEST_CHECK_EQUAL( uxFreeSmall - 1U, uxGetNumberOfFreeSmallNetworkBuffers() );
+
+    vReleaseNetworkBufferAndDescriptor( pxResult );
+}
+/*-----------------------------------------------------------*/
+
+static void test_frame_above_threshold_is_kept( void )
+{
+    prvSetUp();
+
+    /* One byte over the threshold */
+    NetworkBufferDescriptor_t * const pxLarge = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, niEMAC_RX_COPY_BREAK_BYTES + 1U - testHEADERS_LENGTH );
+
+    TEST_CHECK( prvRxCopyBreak( pxEMACData, pxLarge ) == pxLarge );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEMACStats.ulRxCopyBreakFrames );
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+
+    /* Exactly the threshold */
+    NetworkBufferDescriptor_t * const pxLimit = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, niEMAC_RX_COPY_BREAK_BYTES - testHEADERS_LENGTH );
+    NetworkBufferDescriptor_t * const pxResult = prvRxCopyBreak( pxEMACData, pxLimit );
+
+    TEST_CHECK( pxResult != pxLimit );
+    vReleaseNetworkBufferAndDescriptor( pxResult );
+}
+/*-----------------------------------------------------------*/
+
+static void test_frame_for_unbound_port_is_kept( void )
+{
+    prvSetUp();
+
+    /* No socket will hold on to it, the IP-task drops it at once */
+    NetworkBufferDescriptor_t * const pxLarge = prvReceiveFrame( ipPROTOCOL_UDP, testOTHER_PORT, 32U );
+
+    TEST_CHECK( prvRxCopyBreak( pxEMACData, pxLarge ) == pxLarge );
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+}
+/*-----------------------------------------------------------*/
+
+static void test_tcp_frame_is_kept( void )
+{
+    prvSetUp();
+
+    /* TCP may reuse the buffer of a received segment for its reply */
+    NetworkBufferDescriptor_t * const pxLarge = prvReceiveFrame( ipPROTOCOL_TCP, testBOUND_PORT, 32U );
+
+    TEST_CHECK( prvRxCopyBreak( pxEMACData, pxLarge ) == pxLarge );
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+}
+/*-----------------------------------------------------------*/
+
+static void test_frame_is_kept_without_small_buffer( void )
+{
+    NetworkBufferDescriptor_t * pxHeld[ ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS ];
+    size_t uxIndex;
+
+    prvSetUp();
+
+    for( uxIndex = 0U; uxIndex < ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS; uxIndex++ )
+    {
+        pxHeld[ uxIndex ] = pxGetSmallNetworkBufferWithDescriptor( 1U );
+    }
+
+    NetworkBufferDescriptor_t * const pxLarge = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, 32U );
+
+    TEST_CHECK( prvRxCopyBreak( pxEMACData, pxLarge ) == pxLarge );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulRxCopyBreakNoBuffer );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEMACStats.ulRxCopyBreakFrames );
+
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+
+    for( uxIndex = 0U; uxIndex < ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS; uxIndex++ )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxHeld[ uxIndex ] );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void test_threshold_is_tunable( void )
+{
+    prvSetUp();
+
+    TEST_CHECK_EQUAL( niEMAC_RX_COPY_BREAK_BYTES, uxSTM32_GetRxCopyBreak( &xInterface ) );
+
+    /* Larger than a small buffer */
+    TEST_CHECK_EQUAL( pdFAIL, xSTM32_SetRxCopyBreak( &xInterface, ipconfigSMALL_NETWORK_BUFFER_SIZE + 1U ) );
+    TEST_CHECK_EQUAL( niEMAC_RX_COPY_BREAK_BYTES, uxSTM32_GetRxCopyBreak( &xInterface ) );
+
+    /* Zero turns the copy-break off */
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_SetRxCopyBreak( &xInterface, 0U ) );
+
+    NetworkBufferDescriptor_t * const pxLarge = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, 0U );
+
+    TEST_CHECK( prvRxCopyBreak( pxEMACData, pxLarge ) == pxLarge );
+    vReleaseNetworkBufferAndDescriptor( pxLarge );
+
+    /* A lower threshold applies to the next frame */
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_SetRxCopyBreak( &xInterface, 64U ) );
+
+    NetworkBufferDescriptor_t * const pxShort = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, 64U - testHEADERS_LENGTH );
+    NetworkBufferDescriptor_t * const pxResult = prvRxCopyBreak( pxEMACData, pxShort );
+
+    TEST_CHECK( pxResult != pxShort );
+    vReleaseNetworkBufferAndDescriptor( pxResult );
+
+    NetworkBufferDescriptor_t * const pxLonger = prvReceiveFrame( ipPROTOCOL_UDP, testBOUND_PORT, 65U - testHEADERS_LENGTH );
+
+    TEST_CHECK( prvRxCopyBreak( pxEMACData, pxLonger ) == pxLonger );
+    vReleaseNetworkBufferAndDescriptor( pxLonger );
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_small_udp_frame_is_copied ),
+    TEST_CASE( test_frame_above_threshold_is_kept ),
+    TEST_CASE( test_frame_for_unbound_port_is_kept ),
+    TEST_CASE( test_tcp_frame_is_kept ),
+    TEST_CASE( test_frame_is_kept_without_small_buffer ),
+    TEST_CASE( test_threshold_is_tunable ),
+};
+
+int main( void )
+{
+    return TEST_RUN( xTestCases );
+}
@@ -0,0 +1,328 @@
+/* Host tests for the recovery of the EMAC driver from a fatal DMA error. The
+ * fault is injected through the DMA status registers, which are plain RAM on
+ * the host. The DMA restart reclaims the descriptors of the direction at fault
+ * and keeps the MAC, and a DMA that never stops or a Tx FIFO that never
+ * flushes falls back to a full reset without leaking a buffer. The driver is
+ * built for the STM32H7 against stm32/hal_fake.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testFRAME_LENGTH    60U
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/*-----------------------------------------------------------*/
+
+/* Creates the queues that prvEMACTaskStart() would create, then initialises
+ * and starts the EMAC. The EMAC task is not created, it would take the place
+ * of the test task. */
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+    ( void ) memset( &pxEMACData->xMacFilteringData, 0, sizeof( pxEMACData->xMacFilteringData ) );
+    ( void ) memset( &pxEMACData->xEMACStats, 0, sizeof( pxEMACData->xEMACStats ) );
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    /* Both DMA directions running, the Tx FIFO empty */
+    ETH->DMACSR = 0U;
+    ETH->DMADSR = ETH_DMADSR_TPS | ETH_DMADSR_RPS;
+    ETH->MTLTQOMR = 0U;
+}
+/*-----------------------------------------------------------*/
+
+/* Gives back every buffer the driver holds. */
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+
+    xFakeEthCalls.xTxHold = 0;
+    ( void ) HAL_ETH_ReleaseTxPacket( &pxEMACData->xEthHandle );
+
+    while( xQueueReceive( pxEMACData->xTxQueue, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    prvReleaseRxBuffers( &pxEMACData->xEthHandle );
+
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* Puts uxCount frames in the Tx ring, which the DMA never sends. */
+static void prvFillTxRing( UBaseType_t uxCount )
+{
+    UBaseType_t uxIndex;
+
+    xFakeEthCalls.xTxHold = 1;
+
+    for( uxIndex = 0U; uxIndex < uxCount; uxIndex++ )
+    {
+        NetworkBufferDescriptor_t * pxDescriptor = pxGetNetworkBufferWithDescriptor( testFRAME_LENGTH, 0U );
+
+        configASSERT( pxDescriptor != NULL );
+        ( void ) memset( pxDescriptor->pucEthernetBuffer, 0, testFRAME_LENGTH );
+
+        const BaseType_t xQueued = xQueueSendToBack( pxEMACData->xTxQueue, &pxDescriptor, 0U );
+        configASSERT( xQueued == pdPASS );
+    }
+
+    prvSendTxQueue( pxEMACData );
+    configASSERT( pxEMACData->xEthHandle.TxDescList.BuffersInUse == uxCount );
+}
+/*-----------------------------------------------------------*/
+
+/* A fatal bus error of one direction, which the DMA stopped on. */
+static void prvInjectBusError( BaseType_t xTx )
+{
+    if( xTx != pdFALSE )
+    {
+        ETH->DMACSR = ETH_DMACSR_FBE | ETH_DMACSR_TEB;
+        ETH->DMADSR &= ~ETH_DMADSR_TPS;
+    }
+    else
+    {
+        ETH->DMACSR = ETH_DMACSR_FBE;
+        ETH->DMADSR &= ~ETH_DMADSR_RPS;
+    }
+
+    pxEMACData->xEthHandle.gState = HAL_ETH_STATE_ERROR;
+}
+/*-----------------------------------------------------------*/
+
+/* Every network buffer is free, in the Rx reserve, or in the Rx ring. */
+static UBaseType_t prvAccountedBuffers( void )
+{
+    UBaseType_t uxCount = uxGetNumberOfFreeNetworkBuffers() + uxQueueMessagesWaiting( pxEMACData->xRxReserve );
+    size_t uxDesc;
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            ++uxCount;
+        }
+    }
+
+    return uxCount;
+}
+/*-----------------------------------------------------------*/
+
+static void test_tx_reclaim_frees_unsent_frames( void )
+{
+    prvSetUp();
+    prvFillTxRing( 3U );
+
+    /* As prvEthRestartDMA, once the Tx DMA stopped and its FIFO flushed */
+    prvReclaimTxDescriptors( pxEMACData );
+
+    TEST_CHECK_EQUAL( 3, pxEMACData->xEMACStats.ulTxDropDmaError );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.TxDescList.CurTxDesc );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 0 ] == NULL );
+    TEST_CHECK_EQUAL( ( uint32_t ) ( uintptr_t ) xDMADescTx[ 0 ], ETH->DMACTDLAR );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_rx_reclaim_keeps_ring_buffers( void )
+{
+    uint32_t ulBuffers[ ETH_RX_DESC_CNT ];
+    size_t uxDesc;
+
+    prvSetUp();
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        ulBuffers[ uxDesc ] = xDMADescRx[ 0 ][ uxDesc ].BackupAddr0;
+        xDMADescRx[ 0 ][ uxDesc ].DESC3 = ETH_DMARXNDESCWBF_FD;
+    }
+
+    /* A frame cut short by the fault, its first buffer already taken off the ring */
+    pxEMACData->xEthHandle.RxDescList.pRxStart = pxGetNetworkBufferWithDescriptor( niEMAC_RX_BUFFER_SIZE, 0U );
+    pxEMACData->xEthHandle.RxDescList.pRxEnd = pxEMACData->xEthHandle.RxDescList.pRxStart;
+
+    prvReclaimRxDescriptors( &pxEMACData->xEthHandle );
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        TEST_CHECK_EQUAL( ulBuffers[ uxDesc ], xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+        TEST_CHECK_EQUAL( ulBuffers[ uxDesc ], xDMADescRx[ 0 ][ uxDesc ].DESC0 );
+        TEST_CHECK_EQUAL( 0, xDMADescRx[ 0 ][ uxDesc ].DESC3 );
+    }
+
+    TEST_CHECK( pxEMACData->xEthHandle.RxDescList.pRxStart == NULL );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_hung_tx_flush_falls_back_to_reset( void )
+{
+    prvSetUp();
+    prvFillTxRing( 3U );
+    prvInjectBusError( pdTRUE );
+
+    /* FTQ never clears in RAM, as on a Tx FIFO stuck on the bus */
+    TEST_CHECK_EQUAL( pdFALSE, prvEthRestartDMA( pxEMACData ) );
+    TEST_CHECK( ( ETH->MTLTQOMR & ETH_MTLTQOMR_FTQ ) != 0U );
+
+    /* The ring is left alone until the reset */
+    TEST_CHECK_EQUAL( 3, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEMACStats.ulTxDropDmaError );
+
+    TEST_CHECK_EQUAL( pdTRUE, prvEthReset( pxEMACData, &xInterface ) );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulRecoveryResets );
+    TEST_CHECK_EQUAL( 3, pxEMACData->xEMACStats.ulTxDropDmaError );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    /* The Rx ring is built again on the restart */
+    TEST_CHECK_EQUAL( pdTRUE, prvEthStart( pxEMACData ) );
+    TEST_CHECK( xDMADescRx[ 0 ][ 0 ].BackupAddr0 != 0U );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_dma_that_never_stops_keeps_its_ring( void )
+{
+    prvSetUp();
+    prvFillTxRing( 2U );
+    prvInjectBusError( pdTRUE );
+
+    /* Still running after the stop, the DMA may yet read the descriptors */
+    ETH->DMADSR |= ETH_DMADSR_TPS;
+
+    TEST_CHECK_EQUAL( pdFALSE, prvEthRestartDMA( pxEMACData ) );
+    TEST_CHECK_EQUAL( 0U, ETH->DMACTCR & ETH_DMACTCR_ST );
+    TEST_CHECK_EQUAL( 2, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 0 ] != NULL );
+
+    TEST_CHECK_EQUAL( pdTRUE, prvEthReset( pxEMACData, &xInterface ) );
+    TEST_CHECK_EQUAL( 2, pxEMACData->xEMACStats.ulTxDropDmaError );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_reset_restores_mac_filters( void )
+{
+    static const uint8_t ucGroups[][ ipMAC_ADDRESS_LENGTH_BYTES ] =
+    {
+        { 0x01U, 0x00U, 0x5EU, 0x00U, 0x00U, 0x01U },
+        { 0x01U, 0x00U, 0x5EU, 0x00U, 0x00U, 0x02U },
+        { 0x01U, 0x00U, 0x5EU, 0x00U, 0x00U, 0x03U },
+        { 0x01U, 0x00U, 0x5EU, 0x00U, 0x00U, 0x04U },
+    };
+    uint32_t ulFilters[ 8 ];
+    size_t uxIndex;
+
+    prvSetUp();
+
+    /* More addresses than perfect match slots, so the hash table is used too */
+    for( uxIndex = 0U; uxIndex < ( sizeof( ucGroups ) / sizeof( ucGroups[ 0 ] ) ); uxIndex++ )
+    {
+        xInterface.pfAddAllowedMAC( &xInterface, ucGroups[ uxIndex ] );
+    }
+
+    ulFilters[ 0 ] = ETH->MACA1HR;
+    ulFilters[ 1 ] = ETH->MACA1LR;
+    ulFilters[ 2 ] = ETH->MACA2HR;
+    ulFilters[ 3 ] = ETH->MACA2LR;
+    ulFilters[ 4 ] = ETH->MACA3HR;
+    ulFilters[ 5 ] = ETH->MACA3LR;
+    ulFilters[ 6 ] = ETH->MACHT0R;
+    ulFilters[ 7 ] = ETH->MACHT1R;
+    TEST_CHECK( ( ulFilters[ 0 ] & ETH_MACA1HR_AE ) != 0U );
+    TEST_CHECK( ( ulFilters[ 6 ] | ulFilters[ 7 ] ) != 0U );
+
+    /* The Rx DMA does not come back up, RPS stays stopped in RAM */
+    prvInjectBusError( pdFALSE );
+    TEST_CHECK_EQUAL( pdFALSE, prvEthRestartDMA( pxEMACData ) );
+    TEST_CHECK_EQUAL( pdTRUE, prvEthReset( pxEMACData, &xInterface ) );
+
+    /* HAL_ETH_Init cleared them, the counted filters are written back */
+    TEST_CHECK_EQUAL( ulFilters[ 0 ], ETH->MACA1HR );
+    TEST_CHECK_EQUAL( ulFilters[ 1 ], ETH->MACA1LR );
+    TEST_CHECK_EQUAL( ulFilters[ 2 ], ETH->MACA2HR );
+    TEST_CHECK_EQUAL( ulFilters[ 3 ], ETH->MACA2LR );
+    TEST_CHECK_EQUAL( ulFilters[ 4 ], ETH->MACA3HR );
+    TEST_CHECK_EQUAL( ulFilters[ 5 ], ETH->MACA3LR );
+    TEST_CHECK_EQUAL( ulFilters[ 6 ], ETH->MACHT0R );
+    TEST_CHECK_EQUAL( ulFilters[ 7 ], ETH->MACHT1R );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_tx_reclaim_frees_unsent_frames ),
+    TEST_CASE( test_rx_reclaim_keeps_ring_buffers ),
+    TEST_CASE( test_hung_tx_flush_falls_back_to_reset ),
+    TEST_CASE( test_dma_that_never_stops_keeps_its_ring ),
+    TEST_CASE( test_reset_restores_mac_filters ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
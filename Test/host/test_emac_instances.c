@@ -0,0 +1,273 @@
+/* Host tests for the EMAC driver with two ETH instances. The driver is built
+ * for the STM32H7 with niEMAC_INSTANCE_COUNT set to 2, the first context
+ * driving ETH and the second one a simulated peripheral in RAM. The HAL is
+ * replaced by stm32/hal_fake.c, and the pages of the ETH, RCC and system
+ * control registers are mapped as RAM at their addresses, so the driver's
+ * register accesses land somewhere. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32h7xx_hal.h"
+
+/* The simulated second peripheral */
+static ETH_TypeDef xSecondEth;
+
+#define niEMAC_INSTANCE_COUNT            2U
+#define niEMAC_ETH_INSTANCE( xIndex )    ( ( ( xIndex ) == 0 ) ? ETH : &xSecondEth )
+
+/* NetworkInterface.c is included, so the test can reach the contexts, the
+ * descriptor rings and the static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+static NetworkInterface_t xInterfaces[ niEMAC_INSTANCE_COUNT ];
+
+static NetworkEndPoint_t xEndPoints[ niEMAC_INSTANCE_COUNT ];
+
+static const uint8_t ucMACAddresses[ niEMAC_INSTANCE_COUNT ][ ipMAC_ADDRESS_LENGTH_BYTES ] =
+{
+    { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U },
+    { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U },
+};
+
+/*-----------------------------------------------------------*/
+
+/* Fills both interfaces and end-points, and gives each context the Rx
+ * reserve that prvEMACTaskStart() would create. The EMAC tasks are not
+ * created, they would take the place of the test task. */
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    BaseType_t xIndex;
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+
+    for( xIndex = 0; xIndex < ( BaseType_t ) niEMAC_INSTANCE_COUNT; xIndex++ )
+    {
+        ( void ) pxSTM32_FillInterfaceDescriptor( xIndex, &xInterfaces[ xIndex ] );
+        FreeRTOS_FillEndPoint( &xInterfaces[ xIndex ], &xEndPoints[ xIndex ], ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddresses[ xIndex ] );
+
+        xEMACData[ xIndex ].xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+        prvRefillRxReserve( &xEMACData[ xIndex ] );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Gives back the buffers of the Rx reserves and of the Rx descriptors. */
+static void prvTearDown( void )
+{
+    BaseType_t xIndex;
+    size_t uxDesc;
+    NetworkBufferDescriptor_t * pxDescriptor;
+
+    for( xIndex = 0; xIndex < ( BaseType_t ) niEMAC_INSTANCE_COUNT; xIndex++ )
+    {
+        while( xQueueReceive( xEMACData[ xIndex ].xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+        {
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+        }
+
+        vQueueDelete( xEMACData[ xIndex ].xRxReserve );
+        xEMACData[ xIndex ].xRxReserve = NULL;
+
+        for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+        {
+            if( xDMADescRx[ xIndex ][ uxDesc ].BackupAddr0 != 0U )
+            {
+                pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ xIndex ][ uxDesc ].BackupAddr0 );
+                vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+                xDMADescRx[ xIndex ][ uxDesc ].BackupAddr0 = 0U;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvConfigInit( BaseType_t xIndex )
+{
+    BaseType_t xResult;
+
+    prvTakeEthContext( &xEMACData[ xIndex ] );
+    xResult = prvEthConfigInit( &xEMACData[ xIndex ], &xInterfaces[ xIndex ] );
+    prvGiveEthContext( &xEMACData[ xIndex ] );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void test_each_interface_gets_its_own_context( void )
+{
+    prvSetUp();
+
+    TEST_CHECK( xInterfaces[ 0 ].pvArgument == &xEMACData[ 0 ] );
+    TEST_CHECK( xInterfaces[ 1 ].pvArgument == &xEMACData[ 1 ] );
+    TEST_CHECK_EQUAL( 0, xEMACData[ 0 ].xEMACIndex );
+    TEST_CHECK_EQUAL( 1, xEMACData[ 1 ].xEMACIndex );
+    TEST_CHECK( strcmp( xInterfaces[ 0 ].pcName, "eth0" ) == 0 );
+    TEST_CHECK( strcmp( xInterfaces[ 1 ].pcName, "eth1" ) == 0 );
+
+    /* Both interfaces were added to the stack */
+    TEST_CHECK( FreeRTOS_FirstNetworkInterface() == &xInterfaces[ 0 ] );
+    TEST_CHECK( FreeRTOS_NextNetworkInterface( &xInterfaces[ 0 ] ) == &xInterfaces[ 1 ] );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_config_init_binds_instance_and_rings( void )
+{
+    BaseType_t xIndex;
+
+    prvSetUp();
+
+    for( xIndex = 0; xIndex < ( BaseType_t ) niEMAC_INSTANCE_COUNT; xIndex++ )
+    {
+        ETH_HandleTypeDef * const pxEthHandle = &xEMACData[ xIndex ].xEthHandle;
+
+        TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( xIndex ) );
+        TEST_CHECK( xFakeEthCalls.pxInit == pxEthHandle );
+        TEST_CHECK( pxEthHandle->Init.TxDesc == xDMADescTx[ xIndex ] );
+        TEST_CHECK( pxEthHandle->Init.RxDesc == xDMADescRx[ xIndex ] );
+        TEST_CHECK( pxEthHandle->Init.MACAddr == xEndPoints[ xIndex ].xMACAddress.ucBytes );
+        TEST_CHECK( memcmp( pxEthHandle->Init.MACAddr, ucMACAddresses[ xIndex ], ipMAC_ADDRESS_LENGTH_BYTES ) == 0 );
+    }
+
+    TEST_CHECK( xEMACData[ 0 ].xEthHandle.Instance == ETH );
+    TEST_CHECK( xEMACData[ 1 ].xEthHandle.Instance == &xSecondEth );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_instance_finds_its_context( void )
+{
+    prvSetUp();
+    TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( 0 ) );
+    TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( 1 ) );
+
+    TEST_CHECK( prvInstanceToData( ETH ) == &xEMACData[ 0 ] );
+    TEST_CHECK( prvInstanceToData( &xSecondEth ) == &xEMACData[ 1 ] );
+
+    /* The ETH interrupt belongs to the first context */
+    ETH_IRQHandler();
+    TEST_CHECK( xFakeEthCalls.pxIrq == &xEMACData[ 0 ].xEthHandle );
+    TEST_CHECK_EQUAL( 1, xEMACData[ 0 ].xEMACStats.ulTxInterrupts );
+    TEST_CHECK_EQUAL( 0, xEMACData[ 1 ].xEMACStats.ulTxInterrupts );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_context_is_held_until_given( void )
+{
+    prvSetUp();
+
+    prvTakeEthContext( &xEMACData[ 1 ] );
+    TEST_CHECK( prvGetEthContext() == &xEMACData[ 1 ] );
+    TEST_CHECK( xSemaphoreGetMutexHolder( xEthContextMutex ) == xTaskGetCurrentTaskHandle() );
+
+    /* The other context has to wait */
+    TEST_CHECK_EQUAL( pdFALSE, xSemaphoreTake( xEthContextMutex, 0U ) );
+
+    prvGiveEthContext( &xEMACData[ 1 ] );
+    TEST_CHECK( xSemaphoreGetMutexHolder( xEthContextMutex ) == NULL );
+
+    prvTakeEthContext( &xEMACData[ 0 ] );
+    TEST_CHECK( prvGetEthContext() == &xEMACData[ 0 ] );
+    prvGiveEthContext( &xEMACData[ 0 ] );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_rx_buffers_come_from_active_reserve( void )
+{
+    size_t uxDesc;
+
+    prvSetUp();
+    TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( 0 ) );
+    TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( 1 ) );
+    TEST_CHECK_EQUAL( niEMAC_RX_RESERVE_LENGTH, uxQueueMessagesWaiting( xEMACData[ 0 ].xRxReserve ) );
+    TEST_CHECK_EQUAL( niEMAC_RX_RESERVE_LENGTH, uxQueueMessagesWaiting( xEMACData[ 1 ].xRxReserve ) );
+
+    /* HAL_ETH_Start_IT asks HAL_ETH_RxAllocateCallback for a buffer per descriptor */
+    prvTakeEthContext( &xEMACData[ 1 ] );
+    TEST_CHECK_EQUAL( pdTRUE, prvEthStart( &xEMACData[ 1 ] ) );
+    prvGiveEthContext( &xEMACData[ 1 ] );
+
+    TEST_CHECK( xFakeEthCalls.pxStart == &xEMACData[ 1 ].xEthHandle );
+    TEST_CHECK_EQUAL( 0, xEMACData[ 1 ].xEthHandle.RxDescList.RxBuildDescCnt );
+    TEST_CHECK_EQUAL( niEMAC_RX_RESERVE_LENGTH - ETH_RX_DESC_CNT, uxQueueMessagesWaiting( xEMACData[ 1 ].xRxReserve ) );
+    TEST_CHECK_EQUAL( niEMAC_RX_RESERVE_LENGTH, uxQueueMessagesWaiting( xEMACData[ 0 ].xRxReserve ) );
+    TEST_CHECK_EQUAL( 0, xEMACData[ 1 ].xRxReserveStatus.ulReserveEmpty );
+
+    /* Only the second ring was filled */
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        TEST_CHECK( xDMADescRx[ 1 ][ uxDesc ].BackupAddr0 != 0U );
+        TEST_CHECK_EQUAL( 0, xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+    }
+
+    prvTearDown();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_phy_access_uses_active_handle( void )
+{
+    uint32_t ulValue = 0U;
+
+    prvSetUp();
+    TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( 0 ) );
+    TEST_CHECK_EQUAL( pdTRUE, prvConfigInit( 1 ) );
+
+    /* phyHandling.c calls the hooks without saying which interface they are for */
+    xFakeEthCalls.ulPhyValue = 0x1234U;
+    prvTakeEthContext( &xEMACData[ 1 ] );
+    TEST_CHECK_EQUAL( 0, prvPhyReadReg( 0, 2, &ulValue ) );
+    prvGiveEthContext( &xEMACData[ 1 ] );
+
+    TEST_CHECK( xFakeEthCalls.pxPhyRead == &xEMACData[ 1 ].xEthHandle );
+    TEST_CHECK_EQUAL( 2, xFakeEthCalls.ulPhyRegister );
+    TEST_CHECK_EQUAL( 0x1234U, ulValue );
+
+    prvTakeEthContext( &xEMACData[ 0 ] );
+    TEST_CHECK_EQUAL( 0, prvPhyWriteReg( 0, 4, 0x01E1U ) );
+    prvGiveEthContext( &xEMACData[ 0 ] );
+
+    TEST_CHECK( xFakeEthCalls.pxPhyWrite == &xEMACData[ 0 ].xEthHandle );
+    TEST_CHECK_EQUAL( 4, xFakeEthCalls.ulPhyRegister );
+    TEST_CHECK_EQUAL( 0x01E1U, xFakeEthCalls.ulPhyValue );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_each_interface_gets_its_own_context ),
+    TEST_CASE( test_config_init_binds_instance_and_rings ),
+    TEST_CASE( test_instance_finds_its_context ),
+    TEST_CASE( test_context_is_held_until_given ),
+    TEST_CASE( test_rx_buffers_come_from_active_reserve ),
+    TEST_CASE( test_phy_access_uses_active_handle ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
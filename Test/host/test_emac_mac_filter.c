@@ -0,0 +1,321 @@
+/* Host tests for the destination MAC filtering of the EMAC driver. Group
+ * addresses take one of the MACA1 to MACA3 perfect match slots while there is
+ * one, then a bucket of the 64-bit hash table, each reference counted. The
+ * driver is built for the STM32H7 against stm32/hal_fake.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the filter state and
+ * the static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testADDRESS_COUNT    1000U
+
+static NetworkInterface_t xInterface;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+static MacFilteringData_t * const pxFilter = &xEMACData[ 0 ].xMacFilteringData;
+
+static uint8_t ucPrimaryMAC[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    pxNetworkInterfaces = NULL;
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+
+    /* As prvEthConfigInit() leaves them */
+    pxEMACData->xEthHandle.Instance = ETH;
+    pxEMACData->xEthHandle.Init.MACAddr = ucPrimaryMAC;
+    ( void ) memset( pxFilter, 0, sizeof( *pxFilter ) );
+    ETH->MACA1HR = 0U;
+    ETH->MACA2HR = 0U;
+    ETH->MACA3HR = 0U;
+}
+/*-----------------------------------------------------------*/
+
+/* The CRC-32 of IEEE 802.3, bit by bit, least significant bit first. */
+static uint32_t prvReferenceCrc32( const uint8_t * pucData,
+                                   size_t uxLength )
+{
+    uint32_t ulCRC = 0xFFFFFFFFU;
+    size_t uxIndex;
+    uint32_t ulBit;
+
+    for( uxIndex = 0U; uxIndex < uxLength; uxIndex++ )
+    {
+        ulCRC ^= pucData[ uxIndex ];
+
+        for( ulBit = 0U; ulBit < 8U; ulBit++ )
+        {
+            ulCRC = ( ( ulCRC & 1U ) != 0U ) ? ( ( ulCRC >> 1 ) ^ 0xEDB88320U ) : ( ulCRC >> 1 );
+        }
+    }
+
+    return ~ulCRC;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRandomGroupAddress( uint8_t * pucMAC )
+{
+    size_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < ipMAC_ADDRESS_LENGTH_BYTES; uxIndex++ )
+    {
+        pucMAC[ uxIndex ] = ( uint8_t ) rand();
+    }
+
+    pucMAC[ 0 ] |= 0x01U;
+}
+/*-----------------------------------------------------------*/
+
+/* Finds a group address other than pucMAC in the same hash bucket. */
+static void prvSameBucketAddress( const uint8_t * pucMAC,
+                                  uint8_t * pucOther )
+{
+    do
+    {
+        prvRandomGroupAddress( pucOther );
+    } while( ( prvGetMacHashIndex( pucOther ) != prvGetMacHashIndex( pucMAC ) ) ||
+             ( memcmp( pucOther, pucMAC, ipMAC_ADDRESS_LENGTH_BYTES ) == 0 ) );
+}
+/*-----------------------------------------------------------*/
+
+/* Finds a group address in a bucket that no address of pucUsed falls in. */
+static void prvOtherBucketAddress( const uint8_t pucUsed[][ ipMAC_ADDRESS_LENGTH_BYTES ],
+                                   size_t uxUsedCount,
+                                   uint8_t * pucOther )
+{
+    size_t uxIndex;
+    BaseType_t xClash;
+
+    do
+    {
+        prvRandomGroupAddress( pucOther );
+        xClash = pdFALSE;
+
+        for( uxIndex = 0U; uxIndex < uxUsedCount; uxIndex++ )
+        {
+            if( prvGetMacHashIndex( pucOther ) == prvGetMacHashIndex( pucUsed[ uxIndex ] ) )
+            {
+                xClash = pdTRUE;
+            }
+        }
+    } while( xClash != pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHashBitSet( uint8_t ucHashIndex )
+{
+    return ( ( pxFilter->xHash.ulHashTable[ ucHashIndex >> 5 ] & ( 1U << ( ucHashIndex & 0x1FU ) ) ) != 0U ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void test_crc32_matches_ieee_802_3( void )
+{
+    uint8_t ucMAC[ ipMAC_ADDRESS_LENGTH_BYTES ];
+    size_t uxCount;
+
+    srand( 1U );
+
+    /* The MAC indexes the hash table with the bit-reversed CRC, as bitrev32( crc32 ) >> 26 */
+    for( uxCount = 0U; uxCount < testADDRESS_COUNT; uxCount++ )
+    {
+        prvRandomGroupAddress( ucMAC );
+        TEST_CHECK_EQUAL( __RBIT( prvReferenceCrc32( ucMAC, sizeof( ucMAC ) ) ), prvCalcCrc32( ucMAC ) );
+        TEST_CHECK_EQUAL( __RBIT( prvReferenceCrc32( ucMAC, sizeof( ucMAC ) ) ) >> 26, prvGetMacHashIndex( ucMAC ) );
+    }
+
+    /* The IPv6 all-nodes group */
+    static const uint8_t ucAllNodes[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x33U, 0x33U, 0x00U, 0x00U, 0x00U, 0x01U };
+    TEST_CHECK_EQUAL( __RBIT( prvReferenceCrc32( ucAllNodes, sizeof( ucAllNodes ) ) ) >> 26, prvGetMacHashIndex( ucAllNodes ) );
+}
+/*-----------------------------------------------------------*/
+
+static void test_primary_address_is_not_filtered( void )
+{
+    prvSetUp();
+
+    xInterface.pfAddAllowedMAC( &xInterface, ucPrimaryMAC );
+
+    TEST_CHECK_EQUAL( 0, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+    TEST_CHECK_EQUAL( 0, pxFilter->xHash.ulHashTable[ 0 ] | pxFilter->xHash.ulHashTable[ 1 ] );
+}
+/*-----------------------------------------------------------*/
+
+static void test_slots_fill_before_hash( void )
+{
+    uint8_t ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 1U ][ ipMAC_ADDRESS_LENGTH_BYTES ];
+    size_t uxIndex;
+
+    prvSetUp();
+    srand( 2U );
+
+    /* Every address in a bucket of its own, so none passes through another's bucket */
+    for( uxIndex = 0U; uxIndex <= niEMAC_MAC_SRC_MATCH_COUNT; uxIndex++ )
+    {
+        prvOtherBucketAddress( ucMAC, uxIndex, ucMAC[ uxIndex ] );
+        xInterface.pfAddAllowedMAC( &xInterface, ucMAC[ uxIndex ] );
+    }
+
+    for( uxIndex = 0U; uxIndex < niEMAC_MAC_SRC_MATCH_COUNT; uxIndex++ )
+    {
+        TEST_CHECK_EQUAL( 1, pxFilter->xSrcMatch.ucSrcMatchCounters[ uxIndex ] );
+        TEST_CHECK( memcmp( pxFilter->xSrcMatch.xSrcMatchAddresses[ uxIndex ].ucBytes, ucMAC[ uxIndex ], ipMAC_ADDRESS_LENGTH_BYTES ) == 0 );
+    }
+
+    /* MACA1 holds the first one, enabled */
+    TEST_CHECK( ( ETH->MACA1HR & ETH_MACA1HR_AE ) != 0U );
+    TEST_CHECK_EQUAL( ( ( uint32_t ) ucMAC[ 0 ][ 5 ] << 8 ) | ucMAC[ 0 ][ 4 ], ETH->MACA1HR & 0xFFFFU );
+    TEST_CHECK_EQUAL( ( ( uint32_t ) ucMAC[ 0 ][ 3 ] << 24 ) | ( ( uint32_t ) ucMAC[ 0 ][ 2 ] << 16 ) | ( ( uint32_t ) ucMAC[ 0 ][ 1 ] << 8 ) | ucMAC[ 0 ][ 0 ], ETH->MACA1LR );
+    TEST_CHECK( ( ETH->MACA3HR & ETH_MACA1HR_AE ) != 0U );
+
+    /* The last one found every slot taken */
+    const uint8_t ucHashIndex = prvGetMacHashIndex( ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT ] );
+    TEST_CHECK_EQUAL( 1, pxFilter->xHash.ucAddrHashCounters[ ucHashIndex ] );
+    TEST_CHECK_EQUAL( pdTRUE, prvHashBitSet( ucHashIndex ) );
+}
+/*-----------------------------------------------------------*/
+
+static void test_slot_is_counted_per_address( void )
+{
+    uint8_t ucMAC[ ipMAC_ADDRESS_LENGTH_BYTES ];
+
+    prvSetUp();
+    srand( 3U );
+    prvRandomGroupAddress( ucMAC );
+
+    /* Two sockets join the same group */
+    xInterface.pfAddAllowedMAC( &xInterface, ucMAC );
+    xInterface.pfAddAllowedMAC( &xInterface, ucMAC );
+    TEST_CHECK_EQUAL( 2, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+    TEST_CHECK_EQUAL( 0, pxFilter->xSrcMatch.ucSrcMatchCounters[ 1 ] );
+
+    xInterface.pfRemoveAllowedMAC( &xInterface, ucMAC );
+    TEST_CHECK_EQUAL( 1, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+    TEST_CHECK( ( ETH->MACA1HR & ETH_MACA1HR_AE ) != 0U );
+
+    /* The last one leaves */
+    xInterface.pfRemoveAllowedMAC( &xInterface, ucMAC );
+    TEST_CHECK_EQUAL( 0, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+    TEST_CHECK_EQUAL( 0, ETH->MACA1HR );
+    TEST_CHECK_EQUAL( 0, ETH->MACA1LR );
+}
+/*-----------------------------------------------------------*/
+
+static void test_hash_bucket_is_counted_per_address( void )
+{
+    uint8_t ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 2U ][ ipMAC_ADDRESS_LENGTH_BYTES ];
+    size_t uxIndex;
+
+    prvSetUp();
+    srand( 4U );
+
+    for( uxIndex = 0U; uxIndex <= niEMAC_MAC_SRC_MATCH_COUNT; uxIndex++ )
+    {
+        prvOtherBucketAddress( ucMAC, uxIndex, ucMAC[ uxIndex ] );
+        xInterface.pfAddAllowedMAC( &xInterface, ucMAC[ uxIndex ] );
+    }
+
+    /* A second address in the bucket of the hashed one */
+    const uint8_t ucHashIndex = prvGetMacHashIndex( ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT ] );
+    prvSameBucketAddress( ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT ], ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 1U ] );
+    xInterface.pfAddAllowedMAC( &xInterface, ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 1U ] );
+    TEST_CHECK_EQUAL( 2, pxFilter->xHash.ucAddrHashCounters[ ucHashIndex ] );
+
+    xInterface.pfRemoveAllowedMAC( &xInterface, ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT ] );
+    TEST_CHECK_EQUAL( 1, pxFilter->xHash.ucAddrHashCounters[ ucHashIndex ] );
+    TEST_CHECK_EQUAL( pdTRUE, prvHashBitSet( ucHashIndex ) );
+
+    xInterface.pfRemoveAllowedMAC( &xInterface, ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 1U ] );
+    TEST_CHECK_EQUAL( 0, pxFilter->xHash.ucAddrHashCounters[ ucHashIndex ] );
+    TEST_CHECK_EQUAL( pdFALSE, prvHashBitSet( ucHashIndex ) );
+}
+/*-----------------------------------------------------------*/
+
+static void test_free_slot_skipped_for_set_bucket( void )
+{
+    uint8_t ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 2U ][ ipMAC_ADDRESS_LENGTH_BYTES ];
+    size_t uxIndex;
+
+    prvSetUp();
+    srand( 5U );
+
+    for( uxIndex = 0U; uxIndex <= niEMAC_MAC_SRC_MATCH_COUNT; uxIndex++ )
+    {
+        prvOtherBucketAddress( ucMAC, uxIndex, ucMAC[ uxIndex ] );
+        xInterface.pfAddAllowedMAC( &xInterface, ucMAC[ uxIndex ] );
+    }
+
+    /* A slot comes free, but the new address passes through the set bucket anyway */
+    xInterface.pfRemoveAllowedMAC( &xInterface, ucMAC[ 0 ] );
+    TEST_CHECK_EQUAL( 0, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+
+    const uint8_t ucHashIndex = prvGetMacHashIndex( ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT ] );
+    prvSameBucketAddress( ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT ], ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 1U ] );
+    xInterface.pfAddAllowedMAC( &xInterface, ucMAC[ niEMAC_MAC_SRC_MATCH_COUNT + 1U ] );
+
+    TEST_CHECK_EQUAL( 0, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+    TEST_CHECK_EQUAL( 2, pxFilter->xHash.ucAddrHashCounters[ ucHashIndex ] );
+
+    /* An address in an empty bucket takes the slot */
+    prvOtherBucketAddress( &ucMAC[ 1 ], niEMAC_MAC_SRC_MATCH_COUNT + 1U, ucMAC[ 0 ] );
+    xInterface.pfAddAllowedMAC( &xInterface, ucMAC[ 0 ] );
+    TEST_CHECK_EQUAL( 1, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+}
+/*-----------------------------------------------------------*/
+
+static void test_saturated_count_keeps_filter( void )
+{
+    uint8_t ucMAC[ ipMAC_ADDRESS_LENGTH_BYTES ];
+    size_t uxCount;
+
+    prvSetUp();
+    srand( 6U );
+    prvRandomGroupAddress( ucMAC );
+
+    for( uxCount = 0U; uxCount < UINT8_MAX + 10U; uxCount++ )
+    {
+        xInterface.pfAddAllowedMAC( &xInterface, ucMAC );
+    }
+
+    TEST_CHECK_EQUAL( UINT8_MAX, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+
+    /* The count was lost, so the address stays in the filter for good */
+    for( uxCount = 0U; uxCount < UINT8_MAX + 10U; uxCount++ )
+    {
+        xInterface.pfRemoveAllowedMAC( &xInterface, ucMAC );
+    }
+
+    TEST_CHECK_EQUAL( UINT8_MAX, pxFilter->xSrcMatch.ucSrcMatchCounters[ 0 ] );
+    TEST_CHECK( ( ETH->MACA1HR & ETH_MACA1HR_AE ) != 0U );
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_crc32_matches_ieee_802_3 ),
+    TEST_CASE( test_primary_address_is_not_filtered ),
+    TEST_CASE( test_slots_fill_before_hash ),
+    TEST_CASE( test_slot_is_counted_per_address ),
+    TEST_CASE( test_hash_bucket_is_counted_per_address ),
+    TEST_CASE( test_free_slot_skipped_for_set_bucket ),
+    TEST_CASE( test_saturated_count_keeps_filter ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
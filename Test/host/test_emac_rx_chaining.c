@@ -0,0 +1,355 @@
+/* Host tests for the Rx chaining of the EMAC driver. With niEMAC_RX_CHAINING
+ * set from CMakeLists.txt, the Rx descriptors take niEMAC_RX_CHAIN_BUFFER_SIZE
+ * buffers, and a frame spread over several of them is gathered into a single
+ * network buffer for the IP-task. The driver is built for the STM32H7 against
+ * stm32/hal_fake.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testSMALL_FRAME_LENGTH    60U
+#define testLARGE_FRAME_LENGTH    1200U
+#define testMAX_FRAME_LENGTH      2048U
+
+#if ipconfigIS_DISABLED( niEMAC_RX_CHAINING )
+    #error "Built with niEMAC_RX_CHAINING, see CMakeLists.txt"
+#endif
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/* Frames handed to the IP-task, in the order they were received */
+static NetworkBufferDescriptor_t * pxReceived[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+static size_t uxReceivedCount;
+
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout );
+
+/*-----------------------------------------------------------*/
+
+/* Linked in place of xSendEventStructToIPTask(), see CMakeLists.txt. The
+ * linked frames of an Rx event are kept one by one. */
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout )
+{
+    NetworkBufferDescriptor_t * pxDescriptor = ( NetworkBufferDescriptor_t * ) pxEvent->pvData;
+
+    ( void ) uxTimeout;
+    configASSERT( pxEvent->eEventType == eNetworkRxEvent );
+
+    while( pxDescriptor != NULL )
+    {
+        configASSERT( uxReceivedCount < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS );
+        pxReceived[ uxReceivedCount++ ] = pxDescriptor;
+        pxDescriptor = pxDescriptor->pxNextBuffer;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReleaseReceived( void )
+{
+    size_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < uxReceivedCount; uxIndex++ )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxReceived[ uxIndex ] );
+    }
+
+    uxReceivedCount = 0U;
+}
+/*-----------------------------------------------------------*/
+
+/* Every buffer of each size class is free, kept in the reserve or given to the Rx ring. */
+static BaseType_t prvAllBuffersReturned( void )
+{
+    UBaseType_t uxCount = uxGetNumberOfFreeNetworkBuffers() + uxGetNumberOfFreeSmallNetworkBuffers() + uxGetNumberOfFreeMediumNetworkBuffers();
+    size_t uxDesc;
+
+    uxCount += uxQueueMessagesWaiting( pxEMACData->xRxReserve );
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            ++uxCount;
+        }
+    }
+
+    return ( uxCount == ( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS + ipconfigNUM_SMALL_NETWORK_BUFFER_DESCRIPTORS + ipconfigNUM_MEDIUM_NETWORK_BUFFER_DESCRIPTORS ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+    uxReceivedCount = 0U;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+    prvRefillRxReserve( pxEMACData );
+    ( void ) memset( &pxEMACData->xEMACStats, 0, sizeof( pxEMACData->xEMACStats ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    prvReleaseReceived();
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* Fills a broadcast ARP frame, padded with a pattern that depends on ucSeed. */
+static void prvFillFrame( uint8_t * pucFrame,
+                          size_t uxLength,
+                          uint8_t ucSeed )
+{
+    static const uint8_t ucHeader[] =
+    {
+        0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 0x08U, 0x06U,
+        0x00U, 0x01U, 0x08U, 0x00U, 0x06U, 0x04U, 0x00U, 0x01U,
+        0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 192U,  168U,  1U,    20U,
+        0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 192U,  168U,  1U,    10U
+    };
+    size_t uxIndex;
+
+    ( void ) memcpy( pucFrame, ucHeader, sizeof( ucHeader ) );
+
+    for( uxIndex = sizeof( ucHeader ); uxIndex < uxLength; uxIndex++ )
+    {
+        pucFrame[ uxIndex ] = ( uint8_t ) ( uxIndex * 7U + ucSeed );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int prvReceiveFrame( const uint8_t * pucFrame,
+                            size_t uxLength )
+{
+    return xFakeEthReceive( &pxEMACData->xEthHandle, pucFrame, ( uint32_t ) uxLength );
+}
+/*-----------------------------------------------------------*/
+
+static void prvReadFrames( void )
+{
+    prvTakeEthContext( pxEMACData );
+    ( void ) prvNetworkInterfaceInput( pxEMACData, &xInterface, niEMAC_RX_UNLIMITED_BUDGET );
+    prvRefillRxReserve( pxEMACData );
+    prvGiveEthContext( pxEMACData );
+}
+/*-----------------------------------------------------------*/
+
+static void test_rx_buffers_are_chain_sized( void )
+{
+    prvSetUp();
+
+    TEST_CHECK_EQUAL( niEMAC_RX_BUFFER_SIZE, pxEMACData->xEthHandle.Init.RxBuffLen );
+    TEST_CHECK( niEMAC_RX_BUFFER_SIZE < niEMAC_DATA_BUFFER_SIZE );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_single_buffer_frame_is_not_copied( void )
+{
+    uint8_t ucFrame[ testSMALL_FRAME_LENGTH ];
+
+    prvSetUp();
+    prvFillFrame( ucFrame, sizeof( ucFrame ), 1U );
+
+    const uint32_t ulRingBuffer = xDMADescRx[ 0 ][ 0 ].BackupAddr0;
+
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucFrame, sizeof( ucFrame ) ) );
+    prvReadFrames();
+
+    TEST_CHECK_EQUAL( 1, uxReceivedCount );
+    TEST_CHECK_EQUAL( ulRingBuffer, ( uint32_t ) ( uintptr_t ) pxReceived[ 0 ]->pucEthernetBuffer );
+    TEST_CHECK_EQUAL( sizeof( ucFrame ), pxReceived[ 0 ]->xDataLength );
+    TEST_CHECK( memcmp( pxReceived[ 0 ]->pucEthernetBuffer, ucFrame, sizeof( ucFrame ) ) == 0 );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEMACStats.ulRxChainedFrames );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_chained_frame_is_reassembled( void )
+{
+    static uint8_t ucFrame[ testLARGE_FRAME_LENGTH ];
+
+    prvSetUp();
+    prvFillFrame( ucFrame, sizeof( ucFrame ), 2U );
+
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucFrame, sizeof( ucFrame ) ) );
+    prvReadFrames();
+
+    TEST_CHECK_EQUAL( 1, uxReceivedCount );
+    TEST_CHECK_EQUAL( sizeof( ucFrame ), pxReceived[ 0 ]->xDataLength );
+    TEST_CHECK( pxReceived[ 0 ]->pxNextBuffer == NULL );
+    TEST_CHECK( memcmp( pxReceived[ 0 ]->pucEthernetBuffer, ucFrame, sizeof( ucFrame ) ) == 0 );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulRxChainedFrames );
+
+    /* The Rx buffers of the chain went back to the pool */
+    prvReleaseReceived();
+    TEST_CHECK( prvAllBuffersReturned() != pdFALSE );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_frames_keep_their_order( void )
+{
+    static uint8_t ucLarge[ testLARGE_FRAME_LENGTH ];
+    uint8_t ucSmall[ 2 ][ testSMALL_FRAME_LENGTH ];
+
+    prvSetUp();
+    prvFillFrame( ucSmall[ 0 ], testSMALL_FRAME_LENGTH, 3U );
+    prvFillFrame( ucLarge, sizeof( ucLarge ), 4U );
+    prvFillFrame( ucSmall[ 1 ], testSMALL_FRAME_LENGTH, 5U );
+
+    /* Five of the eight descriptors, read in one pass */
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucSmall[ 0 ], testSMALL_FRAME_LENGTH ) );
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucLarge, sizeof( ucLarge ) ) );
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucSmall[ 1 ], testSMALL_FRAME_LENGTH ) );
+    prvReadFrames();
+
+    TEST_CHECK_EQUAL( 3, uxReceivedCount );
+    TEST_CHECK_EQUAL( testSMALL_FRAME_LENGTH, pxReceived[ 0 ]->xDataLength );
+    TEST_CHECK( memcmp( pxReceived[ 0 ]->pucEthernetBuffer, ucSmall[ 0 ], testSMALL_FRAME_LENGTH ) == 0 );
+    TEST_CHECK_EQUAL( sizeof( ucLarge ), pxReceived[ 1 ]->xDataLength );
+    TEST_CHECK( memcmp( pxReceived[ 1 ]->pucEthernetBuffer, ucLarge, sizeof( ucLarge ) ) == 0 );
+    TEST_CHECK_EQUAL( testSMALL_FRAME_LENGTH, pxReceived[ 2 ]->xDataLength );
+    TEST_CHECK( memcmp( pxReceived[ 2 ]->pucEthernetBuffer, ucSmall[ 1 ], testSMALL_FRAME_LENGTH ) == 0 );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_oversize_chain_is_dropped( void )
+{
+    static uint8_t ucFrame[ testMAX_FRAME_LENGTH ];
+
+    prvSetUp();
+    prvFillFrame( ucFrame, sizeof( ucFrame ), 6U );
+
+    TEST_CHECK( sizeof( ucFrame ) > niEMAC_DATA_BUFFER_SIZE );
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucFrame, sizeof( ucFrame ) ) );
+    prvReadFrames();
+
+    TEST_CHECK_EQUAL( 0, uxReceivedCount );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulRxDropOversize );
+    TEST_CHECK( prvAllBuffersReturned() != pdFALSE );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_chain_without_gather_buffer_is_dropped( void )
+{
+    static uint8_t ucFrame[ testLARGE_FRAME_LENGTH ];
+    NetworkBufferDescriptor_t * pxHeld[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS + 1U ];
+    size_t uxHeld = 0U;
+    size_t uxIndex;
+
+    prvSetUp();
+    prvFillFrame( ucFrame, sizeof( ucFrame ), 7U );
+
+    /* No full-size buffer is left to gather the frame into */
+    while( ( pxHeld[ uxHeld ] = pxGetNetworkBufferWithDescriptor( niEMAC_DATA_BUFFER_SIZE, 0U ) ) != NULL )
+    {
+        ++uxHeld;
+    }
+
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame( ucFrame, sizeof( ucFrame ) ) );
+    prvReadFrames();
+
+    for( uxIndex = 0U; uxIndex < uxHeld; uxIndex++ )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxHeld[ uxIndex ] );
+    }
+
+    TEST_CHECK_EQUAL( 0, uxReceivedCount );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulRxChainDropNoBuffer );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_rx_buffers_are_chain_sized ),
+    TEST_CASE( test_single_buffer_frame_is_not_copied ),
+    TEST_CASE( test_chained_frame_is_reassembled ),
+    TEST_CASE( test_frames_keep_their_order ),
+    TEST_CASE( test_oversize_chain_is_dropped ),
+    TEST_CASE( test_chain_without_gather_buffer_is_dropped ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
@@ -0,0 +1,278 @@
+/* Host tests for the adaptive Rx interrupt moderation of the EMAC driver.
+ * prvUpdateRxModeration() is fed the frames of each wake-up, and the delay it
+ * settles on is checked in the status and in the Rx watchdog and ItMode that
+ * prvSetRxModeration() programs. The driver is built for the STM32H7 against
+ * stm32/hal_fake.c, with HCLK at 200 MHz. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+/* Watchdog counts at 200 MHz, 200 cycles per microsecond in units of 256 */
+#define testWATCHDOG_COUNT( ulDelayUs )    ( ( ( ( ulDelayUs ) * 200U ) + 255U ) / 256U )
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void test_start_raises_interrupt_per_frame( void )
+{
+    prvSetUp();
+
+    TEST_CHECK_EQUAL( 0U, pxEMACData->xRxModerationStatus.ulDelayUs );
+    TEST_CHECK_EQUAL( 1U, pxEMACData->xEthHandle.RxDescList.ItMode );
+    TEST_CHECK_EQUAL( 1U, ETH->DMACRIWTR );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_delay_ramps_under_load( void )
+{
+    uint32_t ulStep;
+
+    prvSetUp();
+
+    for( ulStep = 1U; ulStep <= ( niEMAC_RX_MODERATION_MAX_US / niEMAC_RX_MODERATION_STEP_US ); ulStep++ )
+    {
+        const uint32_t ulDelayUs = ulStep * niEMAC_RX_MODERATION_STEP_US;
+
+        prvUpdateRxModeration( pxEMACData, niEMAC_RX_MODERATION_FRAMES );
+
+        TEST_CHECK_EQUAL( ulDelayUs, pxEMACData->xRxModerationStatus.ulDelayUs );
+        TEST_CHECK_EQUAL( 0U, pxEMACData->xEthHandle.RxDescList.ItMode );
+        TEST_CHECK_EQUAL( testWATCHDOG_COUNT( ulDelayUs ), ETH->DMACRIWTR );
+    }
+
+    TEST_CHECK_EQUAL( ( niEMAC_RX_MODERATION_MAX_US / niEMAC_RX_MODERATION_STEP_US ) * niEMAC_RX_MODERATION_FRAMES, pxEMACData->xRxModerationStatus.ulRxFrames );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_delay_clamps_to_maximum( void )
+{
+    const EMACRxModeration_t xModeration = { 4U, 30U, 100U };
+    uint32_t ulPass;
+
+    prvSetUp();
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xModeration ) == pdPASS );
+
+    prvUpdateRxModeration( pxEMACData, 4U );
+    prvUpdateRxModeration( pxEMACData, 4U );
+    prvUpdateRxModeration( pxEMACData, 4U );
+    TEST_CHECK_EQUAL( 90U, pxEMACData->xRxModerationStatus.ulDelayUs );
+
+    /* The next step would reach 120 us */
+    for( ulPass = 0U; ulPass < 3U; ulPass++ )
+    {
+        prvUpdateRxModeration( pxEMACData, ETH_RX_DESC_CNT );
+        TEST_CHECK_EQUAL( xModeration.ulMaxDelayUs, pxEMACData->xRxModerationStatus.ulDelayUs );
+        TEST_CHECK_EQUAL( testWATCHDOG_COUNT( 100U ), ETH->DMACRIWTR );
+    }
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_delay_decays_to_zero( void )
+{
+    const EMACRxModeration_t xModeration = { 4U, 30U, 100U };
+
+    prvSetUp();
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xModeration ) == pdPASS );
+
+    while( pxEMACData->xRxModerationStatus.ulDelayUs < xModeration.ulMaxDelayUs )
+    {
+        prvUpdateRxModeration( pxEMACData, 4U );
+    }
+
+    /* Between half the threshold and the threshold the delay holds */
+    prvUpdateRxModeration( pxEMACData, 2U );
+    prvUpdateRxModeration( pxEMACData, 3U );
+    TEST_CHECK_EQUAL( 100U, pxEMACData->xRxModerationStatus.ulDelayUs );
+
+    /* Below it the delay shortens a step at a time, the last one stops at zero */
+    prvUpdateRxModeration( pxEMACData, 1U );
+    TEST_CHECK_EQUAL( 70U, pxEMACData->xRxModerationStatus.ulDelayUs );
+    TEST_CHECK_EQUAL( testWATCHDOG_COUNT( 70U ), ETH->DMACRIWTR );
+    prvUpdateRxModeration( pxEMACData, 1U );
+    TEST_CHECK_EQUAL( 40U, pxEMACData->xRxModerationStatus.ulDelayUs );
+    prvUpdateRxModeration( pxEMACData, 0U );
+    TEST_CHECK_EQUAL( 10U, pxEMACData->xRxModerationStatus.ulDelayUs );
+    TEST_CHECK_EQUAL( 0U, pxEMACData->xEthHandle.RxDescList.ItMode );
+    prvUpdateRxModeration( pxEMACData, 1U );
+    TEST_CHECK_EQUAL( 0U, pxEMACData->xRxModerationStatus.ulDelayUs );
+
+    /* Back to an interrupt per frame, the watchdog still signals descriptors armed without one */
+    TEST_CHECK_EQUAL( 1U, pxEMACData->xEthHandle.RxDescList.ItMode );
+    TEST_CHECK_EQUAL( 1U, ETH->DMACRIWTR );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_zero_threshold_disables_moderation( void )
+{
+    const EMACRxModeration_t xModeration = { 0U, niEMAC_RX_MODERATION_STEP_US, niEMAC_RX_MODERATION_MAX_US };
+
+    prvSetUp();
+
+    prvUpdateRxModeration( pxEMACData, niEMAC_RX_MODERATION_FRAMES );
+    TEST_CHECK_EQUAL( niEMAC_RX_MODERATION_STEP_US, pxEMACData->xRxModerationStatus.ulDelayUs );
+
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xModeration ) == pdPASS );
+    prvUpdateRxModeration( pxEMACData, ETH_RX_DESC_CNT );
+    TEST_CHECK_EQUAL( 0U, pxEMACData->xRxModerationStatus.ulDelayUs );
+    TEST_CHECK_EQUAL( 1U, pxEMACData->xEthHandle.RxDescList.ItMode );
+    TEST_CHECK_EQUAL( 1U, ETH->DMACRIWTR );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+/* A stopped EMAC keeps the new delay for prvEthStart(), which programs it */
+static void test_registers_written_only_when_started( void )
+{
+    prvSetUp();
+
+    TEST_CHECK( HAL_ETH_Stop_IT( &pxEMACData->xEthHandle ) == HAL_OK );
+    ETH->DMACRIWTR = 0U;
+
+    prvUpdateRxModeration( pxEMACData, niEMAC_RX_MODERATION_FRAMES );
+    prvUpdateRxModeration( pxEMACData, niEMAC_RX_MODERATION_FRAMES );
+    TEST_CHECK_EQUAL( 2U * niEMAC_RX_MODERATION_STEP_US, pxEMACData->xRxModerationStatus.ulDelayUs );
+    TEST_CHECK_EQUAL( 0U, ETH->DMACRIWTR );
+    TEST_CHECK_EQUAL( 1U, pxEMACData->xEthHandle.RxDescList.ItMode );
+
+    prvTakeEthContext( pxEMACData );
+    const BaseType_t xStarted = prvEthStart( pxEMACData );
+    prvGiveEthContext( pxEMACData );
+    TEST_CHECK( xStarted != pdFALSE );
+
+    TEST_CHECK_EQUAL( testWATCHDOG_COUNT( 2U * niEMAC_RX_MODERATION_STEP_US ), ETH->DMACRIWTR );
+    TEST_CHECK_EQUAL( 0U, pxEMACData->xEthHandle.RxDescList.ItMode );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_set_rejects_out_of_range( void )
+{
+    /* 255 units of 256 cycles at 200 MHz are 326 us */
+    const EMACRxModeration_t xTooLong = { 4U, 10U, 327U };
+    const EMACRxModeration_t xNoStep = { 4U, 0U, 100U };
+    const EMACRxModeration_t xStepTooLong = { 4U, 110U, 100U };
+    const EMACRxModeration_t xLongest = { 4U, 10U, 326U };
+    EMACRxModeration_t xModeration;
+
+    prvSetUp();
+
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xTooLong ) == pdFAIL );
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xNoStep ) == pdFAIL );
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xStepTooLong ) == pdFAIL );
+
+    vSTM32_GetRxModeration( &xInterface, &xModeration );
+    TEST_CHECK_EQUAL( niEMAC_RX_MODERATION_MAX_US, xModeration.ulMaxDelayUs );
+
+    TEST_CHECK( xSTM32_SetRxModeration( &xInterface, &xLongest ) == pdPASS );
+    vSTM32_GetRxModeration( &xInterface, &xModeration );
+    TEST_CHECK_EQUAL( 326U, xModeration.ulMaxDelayUs );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_start_raises_interrupt_per_frame ),
+    TEST_CASE( test_delay_ramps_under_load ),
+    TEST_CASE( test_delay_clamps_to_maximum ),
+    TEST_CASE( test_delay_decays_to_zero ),
+    TEST_CASE( test_zero_threshold_disables_moderation ),
+    TEST_CASE( test_registers_written_only_when_started ),
+    TEST_CASE( test_set_rejects_out_of_range ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
@@ -0,0 +1,309 @@
+/* Host tests for the budgeted Rx polling of the EMAC driver. A flood faster
+ * than one budget per tick is drained by polling again straight away, and the
+ * Rx interrupt comes back once the ring runs dry. The driver is built for the
+ * STM32H7 against stm32/hal_fake.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testFRAME_LENGTH       60U
+
+/* Time advances in slots, a pass of the EMAC task takes one, and a wake-up by
+ * the Rx interrupt one more */
+#define testSLOTS_PER_TICK     16U
+
+/* 64000 frames/s with a 1 ms tick, eight times what one budget per tick reads */
+#define testFRAMES_PER_TICK    64U
+#define testFLOOD_TICKS        50U
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/* Frames the IP-task was given, their buffers go straight back to the pool */
+static uint32_t ulDelivered;
+
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout );
+
+/*-----------------------------------------------------------*/
+
+/* Linked in place of xSendEventStructToIPTask(), see CMakeLists.txt. */
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout )
+{
+    NetworkBufferDescriptor_t * pxDescriptor = ( NetworkBufferDescriptor_t * ) pxEvent->pvData;
+
+    ( void ) uxTimeout;
+    configASSERT( pxEvent->eEventType == eNetworkRxEvent );
+
+    while( pxDescriptor != NULL )
+    {
+        NetworkBufferDescriptor_t * const pxNext = pxDescriptor->pxNextBuffer;
+
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+        ++ulDelivered;
+        pxDescriptor = pxNext;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+    ulDelivered = 0U;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+    pxEMACData->uxRxPollBudget = niEMAC_RX_POLL_BUDGET;
+    prvRefillRxReserve( pxEMACData );
+    ( void ) memset( &pxEMACData->xRxPollStatus, 0, sizeof( pxEMACData->xRxPollStatus ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvReceiveFrame( void )
+{
+    static const uint8_t ucFrame[ testFRAME_LENGTH ] =
+    {
+        0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 0x08U, 0x06U,
+        0x00U, 0x01U, 0x08U, 0x00U, 0x06U, 0x04U, 0x00U, 0x01U,
+        0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 192U,  168U,  1U,    20U,
+        0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 192U,  168U,  1U,    10U
+    };
+
+    return xFakeEthReceive( &pxEMACData->xEthHandle, ucFrame, testFRAME_LENGTH );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRxInterruptEnabled( void )
+{
+    return ( ( ETH->DMACIER & ETH_DMACIER_RIE ) != 0U ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/* The Rx part of a pass of prvEMACHandlerTask(), xRxEvent when an Rx interrupt woke it. */
+static void prvTaskPass( BaseType_t xRxEvent )
+{
+    UBaseType_t uxRxCount = 0U;
+
+    prvTakeEthContext( pxEMACData );
+
+    if( xRxEvent != pdFALSE )
+    {
+        uxRxCount += prvNetworkInterfaceInput( pxEMACData, &xInterface, pxEMACData->uxRxPollBudget );
+    }
+
+    prvRefillRxReserve( pxEMACData );
+    ( void ) prvPollRx( pxEMACData, &xInterface, uxRxCount );
+
+    prvGiveEthContext( pxEMACData );
+}
+/*-----------------------------------------------------------*/
+
+/* The DMA receives the frames of the flood due by ulSlot. */
+static void prvDeliverFrames( uint32_t ulSlot,
+                              uint32_t ulFloodSlots,
+                              uint32_t * pulSent )
+{
+    const uint32_t ulDue = ( ( ulSlot < ulFloodSlots ) ? ulSlot : ulFloodSlots ) * testFRAMES_PER_TICK / testSLOTS_PER_TICK;
+
+    while( *pulSent < ulDue )
+    {
+        ( void ) prvReceiveFrame();
+        ++( *pulSent );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void test_burst_switches_to_polling( void )
+{
+    UBaseType_t uxFrame;
+
+    prvSetUp();
+
+    TEST_CHECK_EQUAL( pdTRUE, prvRxInterruptEnabled() );
+
+    for( uxFrame = 0U; uxFrame < niEMAC_RX_POLL_BUDGET; uxFrame++ )
+    {
+        TEST_CHECK_EQUAL( 1, prvReceiveFrame() );
+    }
+
+    prvTaskPass( pdTRUE );
+
+    TEST_CHECK_EQUAL( pdTRUE, pxEMACData->xRxPolling );
+    TEST_CHECK_EQUAL( pdFALSE, prvRxInterruptEnabled() );
+
+    /* The ring may hold more, the next pass does not wait for a tick */
+    TEST_CHECK_EQUAL( pdTRUE, pxEMACData->xRxBacklog );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_reads_of_one_pass_add_up( void )
+{
+    UBaseType_t uxRxCount;
+    UBaseType_t uxFrame;
+
+    prvSetUp();
+
+    /* Half a budget for the Rx interrupt, the rest for a later ring-empty event of the same pass */
+    for( uxFrame = 0U; uxFrame < niEMAC_RX_POLL_BUDGET / 2U; uxFrame++ )
+    {
+        TEST_CHECK_EQUAL( 1, prvReceiveFrame() );
+    }
+
+    prvTakeEthContext( pxEMACData );
+    uxRxCount = prvNetworkInterfaceInput( pxEMACData, &xInterface, pxEMACData->uxRxPollBudget );
+
+    for( ; uxFrame < niEMAC_RX_POLL_BUDGET; uxFrame++ )
+    {
+        ( void ) prvReceiveFrame();
+    }
+
+    uxRxCount += prvNetworkInterfaceInput( pxEMACData, &xInterface, pxEMACData->uxRxPollBudget );
+    TEST_CHECK_EQUAL( niEMAC_RX_POLL_BUDGET, prvPollRx( pxEMACData, &xInterface, uxRxCount ) );
+    prvGiveEthContext( pxEMACData );
+
+    TEST_CHECK_EQUAL( pdTRUE, pxEMACData->xRxPolling );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_flood_is_drained( void )
+{
+    const uint32_t ulFloodSlots = testFLOOD_TICKS * testSLOTS_PER_TICK;
+    uint32_t ulSlot = 0U;
+    uint32_t ulSent = 0U;
+    uint32_t ulSleeps = 0U;
+
+    prvSetUp();
+
+    /* Runs the flood, then long enough for the task to go back to interrupts */
+    while( ulSlot < ulFloodSlots + ( 4U * testSLOTS_PER_TICK ) )
+    {
+        BaseType_t xRxEvent = pdFALSE;
+
+        if( pxEMACData->xRxPolling == pdFALSE )
+        {
+            /* Asleep until the Rx interrupt */
+            while( ( ulSent == xFakeEthCalls.ulRxMissed + ulDelivered ) && ( ulSlot < ulFloodSlots + ( 4U * testSLOTS_PER_TICK ) ) )
+            {
+                ++ulSlot;
+                prvDeliverFrames( ulSlot, ulFloodSlots, &ulSent );
+            }
+
+            ++ulSlot;
+            prvDeliverFrames( ulSlot, ulFloodSlots, &ulSent );
+            xRxEvent = pdTRUE;
+        }
+        else if( pxEMACData->xRxBacklog == pdFALSE )
+        {
+            /* niEMAC_RX_POLL_DELAY_TICKS */
+            ++ulSleeps;
+            ulSlot += niEMAC_RX_POLL_DELAY_TICKS * testSLOTS_PER_TICK;
+            prvDeliverFrames( ulSlot, ulFloodSlots, &ulSent );
+        }
+
+        prvTaskPass( xRxEvent );
+
+        ++ulSlot;
+        prvDeliverFrames( ulSlot, ulFloodSlots, &ulSent );
+    }
+
+    TEST_CHECK_EQUAL( testFLOOD_TICKS * testFRAMES_PER_TICK, ulSent );
+    TEST_CHECK_EQUAL( 0, xFakeEthCalls.ulRxMissed );
+    TEST_CHECK_EQUAL( ulSent, ulDelivered );
+    TEST_CHECK( pxEMACData->xRxPollStatus.ulPollPasses != 0U );
+
+    /* Polling ended with the flood */
+    TEST_CHECK_EQUAL( pdFALSE, pxEMACData->xRxPolling );
+    TEST_CHECK_EQUAL( pdTRUE, prvRxInterruptEnabled() );
+    TEST_CHECK( ulSleeps <= 4U );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_burst_switches_to_polling ),
+    TEST_CASE( test_reads_of_one_pass_add_up ),
+    TEST_CASE( test_flood_is_drained ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
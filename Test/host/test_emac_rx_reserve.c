@@ -0,0 +1,403 @@
+/* Host stress test for the Rx buffer reserve of the EMAC driver. The DMA
+ * receives into the fake Rx ring while the IP-task hands the frames to
+ * sockets that hoard them. Whatever the pool has left, the EMAC task keeps
+ * the ring full, and once buffers come back, a ring that ran dry is rebuilt
+ * without waiting for a frame that can no longer arrive. The driver is built
+ * for the STM32H7 against stm32/hal_fake.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testFRAME_LENGTH        60U
+#define testSTRESS_PASSES       2000U
+
+/* Buffers the pool can lend out before the reserve and the ring run dry */
+#define testSPARE_BUFFERS       ( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - niEMAC_RX_RESERVE_LENGTH - ETH_RX_DESC_CNT )
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/* Rx events the IP-task passed on to sockets which did not read them yet */
+static NetworkBufferDescriptor_t * pxHoard[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+static size_t uxHoardCount;
+
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout );
+
+/*-----------------------------------------------------------*/
+
+/* Linked in place of xSendEventStructToIPTask(), see CMakeLists.txt. The
+ * frames of an Rx event stay with the test until prvReleaseHoard(). */
+BaseType_t __wrap_xSendEventStructToIPTask( const IPStackEvent_t * pxEvent,
+                                            TickType_t uxTimeout )
+{
+    ( void ) uxTimeout;
+
+    configASSERT( pxEvent->eEventType == eNetworkRxEvent );
+    configASSERT( uxHoardCount < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS );
+    pxHoard[ uxHoardCount++ ] = ( NetworkBufferDescriptor_t * ) pxEvent->pvData;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/* Counts the buffers of a linked Rx event, and releases them when asked. */
+static UBaseType_t prvWalkChain( NetworkBufferDescriptor_t * pxChain,
+                                 BaseType_t xRelease )
+{
+    NetworkBufferDescriptor_t * pxDescriptor = pxChain;
+    UBaseType_t uxCount = 0U;
+
+    while( pxDescriptor != NULL )
+    {
+        NetworkBufferDescriptor_t * const pxNext = pxDescriptor->pxNextBuffer;
+
+        if( xRelease != pdFALSE )
+        {
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+        }
+
+        pxDescriptor = pxNext;
+        ++uxCount;
+    }
+
+    return uxCount;
+}
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvHoardedBuffers( void )
+{
+    UBaseType_t uxCount = 0U;
+    size_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < uxHoardCount; uxIndex++ )
+    {
+        uxCount += prvWalkChain( pxHoard[ uxIndex ], pdFALSE );
+    }
+
+    return uxCount;
+}
+/*-----------------------------------------------------------*/
+
+/* The sockets read the uxCount oldest Rx events. */
+static void prvReleaseHoard( size_t uxCount )
+{
+    size_t uxIndex;
+
+    configASSERT( uxCount <= uxHoardCount );
+
+    for( uxIndex = 0U; uxIndex < uxCount; uxIndex++ )
+    {
+        ( void ) prvWalkChain( pxHoard[ uxIndex ], pdTRUE );
+    }
+
+    ( void ) memmove( &pxHoard[ 0 ], &pxHoard[ uxCount ], ( uxHoardCount - uxCount ) * sizeof( pxHoard[ 0 ] ) );
+    uxHoardCount -= uxCount;
+}
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvRingBuffers( void )
+{
+    UBaseType_t uxCount = 0U;
+    size_t uxDesc;
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            ++uxCount;
+        }
+    }
+
+    return uxCount;
+}
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvAccountedBuffers( void )
+{
+    return uxGetNumberOfFreeNetworkBuffers() + uxQueueMessagesWaiting( pxEMACData->xRxReserve ) + prvRingBuffers() + prvHoardedBuffers();
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+    uxHoardCount = 0U;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    /* Where prvNetworkInterfaceInitialise() ends, the EMAC task only reads frames from then on */
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+    prvRefillRxReserve( pxEMACData );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    prvReleaseHoard( uxHoardCount );
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* The DMA receives a broadcast ARP request, returns 0 when it had no descriptor for it. */
+static int prvReceiveFrame( void )
+{
+    static const uint8_t ucFrame[ testFRAME_LENGTH ] =
+    {
+        0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 0x08U, 0x06U,
+        0x00U, 0x01U, 0x08U, 0x00U, 0x06U, 0x04U, 0x00U, 0x01U,
+        0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U, 192U,  168U,  1U,    20U,
+        0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 192U,  168U,  1U,    10U
+    };
+
+    return xFakeEthReceive( &pxEMACData->xEthHandle, ucFrame, testFRAME_LENGTH );
+}
+/*-----------------------------------------------------------*/
+
+/* The Rx part of a pass of prvEMACHandlerTask(), xRxEvent when an Rx interrupt woke it. */
+static void prvTaskPass( BaseType_t xRxEvent )
+{
+    ETH_HandleTypeDef * const pxEthHandle = &pxEMACData->xEthHandle;
+
+    prvTakeEthContext( pxEMACData );
+
+    if( xRxEvent != pdFALSE )
+    {
+        ( void ) prvNetworkInterfaceInput( pxEMACData, &xInterface, niEMAC_RX_UNLIMITED_BUDGET );
+    }
+
+    prvRefillRxReserve( pxEMACData );
+
+    if( ( pxEthHandle->RxDescList.RxBuildDescCnt != 0U ) && ( uxQueueMessagesWaiting( pxEMACData->xRxReserve ) != 0U ) )
+    {
+        ( void ) prvNetworkInterfaceInput( pxEMACData, &xInterface, niEMAC_RX_UNLIMITED_BUDGET );
+    }
+
+    prvGiveEthContext( pxEMACData );
+}
+/*-----------------------------------------------------------*/
+
+static void test_ring_stays_full_while_pool_lasts( void )
+{
+    size_t uxFrame;
+
+    prvSetUp();
+
+    TEST_CHECK_EQUAL( niEMAC_RX_RESERVE_LENGTH, uxQueueMessagesWaiting( pxEMACData->xRxReserve ) );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, prvRingBuffers() );
+
+    /* Every frame taken from the ring is replaced at once, by the reserve or by the pool */
+    for( uxFrame = 0U; uxFrame < testSPARE_BUFFERS + niEMAC_RX_RESERVE_LENGTH; uxFrame++ )
+    {
+        TEST_CHECK_EQUAL( 1, prvReceiveFrame() );
+        prvTaskPass( pdTRUE );
+        TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt );
+    }
+
+    TEST_CHECK_EQUAL( testSPARE_BUFFERS + niEMAC_RX_RESERVE_LENGTH, uxHoardCount );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xRxReserveStatus.ulAllocFailures );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, prvRingBuffers() );
+
+    /* The ring is all that is left, the DMA drops what comes after it */
+    for( uxFrame = 0U; uxFrame < ETH_RX_DESC_CNT; uxFrame++ )
+    {
+        TEST_CHECK_EQUAL( 1, prvReceiveFrame() );
+        prvTaskPass( pdTRUE );
+    }
+
+    TEST_CHECK_EQUAL( 0, prvReceiveFrame() );
+    TEST_CHECK_EQUAL( 1, xFakeEthCalls.ulRxMissed );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt );
+    TEST_CHECK( pxEMACData->xRxReserveStatus.ulAllocFailures != 0U );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_empty_reserve_falls_back_to_pool( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxFrame;
+
+    prvSetUp();
+
+    /* The last pass could not refill the reserve, the buffers came back since */
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxFrame = 0U; uxFrame < ETH_RX_DESC_CNT; uxFrame++ )
+    {
+        TEST_CHECK_EQUAL( 1, prvReceiveFrame() );
+    }
+
+    /* The ring is rebuilt while the frames are read, before the reserve is refilled */
+    prvTakeEthContext( pxEMACData );
+    ( void ) prvNetworkInterfaceInput( pxEMACData, &xInterface, niEMAC_RX_UNLIMITED_BUDGET );
+    prvGiveEthContext( pxEMACData );
+
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, prvHoardedBuffers() );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, pxEMACData->xRxReserveStatus.ulReserveEmpty );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xRxReserveStatus.ulAllocFailures );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_empty_ring_is_rebuilt_without_rx_event( void )
+{
+    prvSetUp();
+
+    while( prvReceiveFrame() != 0 )
+    {
+        prvTaskPass( pdTRUE );
+    }
+
+    TEST_CHECK_EQUAL( 0, prvRingBuffers() );
+
+    /* No frame can arrive to wake the task, a pass of the task loop must be enough */
+    prvReleaseHoard( uxHoardCount );
+    prvTaskPass( pdFALSE );
+
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, prvRingBuffers() );
+
+    TEST_CHECK_EQUAL( 1, prvReceiveFrame() );
+    prvTaskPass( pdTRUE );
+    TEST_CHECK_EQUAL( 1, uxHoardCount );
+    TEST_CHECK_EQUAL( testFRAME_LENGTH, pxHoard[ 0 ]->xDataLength );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_random_hoarding_never_stalls_ring( void )
+{
+    uint32_t ulPass;
+    uint32_t ulStalls = 0U;
+
+    prvSetUp();
+    srand( 1U );
+
+    for( ulPass = 0U; ulPass < testSTRESS_PASSES; ulPass++ )
+    {
+        const int xFrames = rand() % 4;
+        int xFrame;
+
+        for( xFrame = 0; xFrame < xFrames; xFrame++ )
+        {
+            ( void ) prvReceiveFrame();
+        }
+
+        /* Sockets read some of what they hold, sometimes nothing for a while */
+        if( ( uxHoardCount != 0U ) && ( ( rand() % 3 ) == 0 ) )
+        {
+            prvReleaseHoard( ( size_t ) rand() % ( uxHoardCount + 1U ) );
+        }
+
+        prvTaskPass( ( xFrames != 0 ) ? pdTRUE : pdFALSE );
+
+        /* A descriptor waits for a buffer only while the pool and the reserve have none */
+        if( pxEMACData->xEthHandle.RxDescList.RxBuildDescCnt != 0U )
+        {
+            ++ulStalls;
+            TEST_CHECK_EQUAL( 0, uxGetNumberOfFreeNetworkBuffers() );
+            TEST_CHECK_EQUAL( 0, uxQueueMessagesWaiting( pxEMACData->xRxReserve ) );
+        }
+
+        TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, prvAccountedBuffers() );
+    }
+
+    /* The run went through exhaustion, then the sockets let go of everything */
+    TEST_CHECK( ulStalls != 0U );
+    prvReleaseHoard( uxHoardCount );
+    prvTaskPass( pdFALSE );
+    TEST_CHECK_EQUAL( ETH_RX_DESC_CNT, prvRingBuffers() );
+
+    /* The reserve that went into the ring is topped up on the next pass */
+    prvTaskPass( pdFALSE );
+    TEST_CHECK_EQUAL( niEMAC_RX_RESERVE_LENGTH, uxQueueMessagesWaiting( pxEMACData->xRxReserve ) );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_ring_stays_full_while_pool_lasts ),
+    TEST_CASE( test_empty_reserve_falls_back_to_pool ),
+    TEST_CASE( test_empty_ring_is_rebuilt_without_rx_event ),
+    TEST_CASE( test_random_hoarding_never_stalls_ring ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
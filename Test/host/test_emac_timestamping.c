@@ -0,0 +1,406 @@
+/* Host tests for the hardware timestamping of the EMAC driver, built with
+ * niEMAC_TIMESTAMPING. The Rx and Tx stamps are taken from descriptors as the
+ * STM32H7 DMA writes them back, and xSTM32_PtpSync() disciplines the clock
+ * from known exchanges. The ETH registers are RAM, so the test clears the
+ * update bits that the MAC would clear once it took an update. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+/* Addend for niEMAC_PTP_CLOCK_HZ from the 200 MHz HCLK of hal_fake.c, 2^32 / 4 */
+#define testNOMINAL_ADDEND    0x40000000U
+
+/* Exchanges start 10 s into the master's time scale */
+#define testBASE_NS           10000000000LL
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/*-----------------------------------------------------------*/
+
+/* As the MAC, which clears the update bits once it took the update */
+static void prvClockUpdated( void )
+{
+    ETH->MACTSCR &= ~( ETH_MACTSCR_TSADDREG | ETH_MACTSCR_TSUPDT | ETH_MACTSCR_TSINIT );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+    ETH->MACTSCR = 0U;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->lFrequencyPpb = 0;
+    pxEMACData->lPtpIntegralPpb = 0;
+    pxEMACData->xTxTimestampReady = pdFALSE;
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+
+    pxEMACData->xMacInitStatus = eMacInitComplete;
+    prvRefillRxReserve( pxEMACData );
+    prvClockUpdated();
+}
+/*-----------------------------------------------------------*/
+
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    pxEMACData->xMacInitStatus = eMacEthInit;
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* A network buffer holding a UDP message, and its payload as the application
+ * sees it with FREERTOS_ZERO_COPY. Only the full-size buffers, which the DMA
+ * receives into, keep a timestamp. */
+static uint8_t * prvGetUDPPayload( NetworkBufferDescriptor_t ** ppxDescriptor )
+{
+    NetworkBufferDescriptor_t * const pxDescriptor = pxGetNetworkBufferWithDescriptor( ipconfigNETWORK_MTU, 0U );
+    uint8_t * pucPayload = NULL;
+
+    if( pxDescriptor != NULL )
+    {
+        pucPayload = &pxDescriptor->pucEthernetBuffer[ sizeof( UDPPacket_t ) ];
+
+        /* Left by FreeRTOS_GetUDPPayloadBuffer_Multi for pxUDPPayloadBuffer_to_NetworkBuffer */
+        *( pucPayload - ipUDP_PAYLOAD_IP_TYPE_OFFSET ) = ipTYPE_IPv4;
+    }
+
+    *ppxDescriptor = pxDescriptor;
+
+    return pucPayload;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetTimestamp( EMACTimestamp_t * pxTimestamp,
+                             int64_t llTimeNs )
+{
+    pxTimestamp->ulSeconds = ( uint32_t ) ( llTimeNs / ( int64_t ) niEMAC_NS_PER_SECOND );
+    pxTimestamp->ulNanoseconds = ( uint32_t ) ( llTimeNs % ( int64_t ) niEMAC_NS_PER_SECOND );
+}
+/*-----------------------------------------------------------*/
+
+/* An exchange over a path of llDelayNs each way, with the local clock
+ * llOffsetNs ahead of the master's */
+static void prvSetExchange( EMACPtpExchange_t * pxExchange,
+                            int64_t llOffsetNs,
+                            int64_t llDelayNs )
+{
+    const int64_t llSyncSent = testBASE_NS;
+    const int64_t llDelayReqSent = testBASE_NS + 100000LL;
+
+    prvSetTimestamp( &pxExchange->xT1, llSyncSent );
+    prvSetTimestamp( &pxExchange->xT2, llSyncSent + llDelayNs + llOffsetNs );
+    prvSetTimestamp( &pxExchange->xT3, llDelayReqSent + llOffsetNs );
+    prvSetTimestamp( &pxExchange->xT4, llDelayReqSent + llDelayNs );
+}
+/*-----------------------------------------------------------*/
+
+static void test_rx_timestamp_from_context_descriptor( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    EMACTimestamp_t xTimestamp = { 0U, 0U };
+
+    prvSetUp();
+
+    uint8_t * const pucPayload = prvGetUDPPayload( &pxDescriptor );
+
+    TEST_CHECK( pucPayload != NULL );
+
+    /* The frame ends in the last descriptor, its stamp wraps round to the first */
+    ETH_DMADescTypeDef * const pxLastDesc = &pxEMACData->xEthHandle.Init.RxDesc[ ETH_RX_DESC_CNT - 1U ];
+    ETH_DMADescTypeDef * const pxCtxDesc = &pxEMACData->xEthHandle.Init.RxDesc[ 0 ];
+
+    pxLastDesc->DESC1 = ETH_DMARXNDESCWBF_TSA;
+    pxCtxDesc->DESC0 = 0x80000000U | 123456789U;
+    pxCtxDesc->DESC1 = 42U;
+    pxCtxDesc->DESC3 = ETH_DMARXNDESCWBF_CTXT;
+
+    prvGetRxTimestamp( &pxEMACData->xEthHandle, pxDescriptor, pxLastDesc );
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_GetRxTimestamp( pucPayload, &xTimestamp ) );
+    TEST_CHECK_EQUAL( 42U, xTimestamp.ulSeconds );
+    TEST_CHECK_EQUAL( 123456789U, xTimestamp.ulNanoseconds );
+
+    /* The DMA has not written the context descriptor back yet */
+    pxCtxDesc->DESC3 = ETH_DMARXNDESCWBF_OWN | ETH_DMARXNDESCWBF_CTXT;
+    prvGetRxTimestamp( &pxEMACData->xEthHandle, pxDescriptor, pxLastDesc );
+    TEST_CHECK_EQUAL( pdFAIL, xSTM32_GetRxTimestamp( pucPayload, &xTimestamp ) );
+
+    /* A frame that was not stamped */
+    pxCtxDesc->DESC3 = ETH_DMARXNDESCWBF_CTXT;
+    pxLastDesc->DESC1 = 0U;
+    prvGetRxTimestamp( &pxEMACData->xEthHandle, pxDescriptor, pxLastDesc );
+    TEST_CHECK_EQUAL( pdFAIL, xSTM32_GetRxTimestamp( pucPayload, &xTimestamp ) );
+
+    vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_tx_timestamp_from_written_back_descriptor( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    EMACTimestamp_t xTimestamp = { 0U, 0U };
+    ETH_TxDescListTypeDef * const pxTxDescList = &pxEMACData->xEthHandle.TxDescList;
+
+    prvSetUp();
+
+    uint8_t * const pucPayload = prvGetUDPPayload( &pxDescriptor );
+
+    TEST_CHECK( pucPayload != NULL );
+
+    /* The request sets the enable bit of the frame's first descriptor, and the next frame clears it */
+    ETH_DMADescTypeDef * const pxTxDesc = ( ETH_DMADescTypeDef * ) pxTxDescList->TxDesc[ pxTxDescList->CurTxDesc ];
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_RequestTxTimestamp( pucPayload ) );
+    prvSetTxTimestamping( &pxEMACData->xEthHandle, pxDescriptor );
+    TEST_CHECK( ( pxTxDesc->DESC2 & ETH_DMATXNDESCRF_TTSE ) != 0U );
+
+    prvSetTxTimestamping( &pxEMACData->xEthHandle, NULL );
+    TEST_CHECK( ( pxTxDesc->DESC2 & ETH_DMATXNDESCRF_TTSE ) == 0U );
+
+    /* The frame still belongs to the DMA */
+    const uint32_t ulIdx = pxTxDescList->releaseIndex;
+    ETH_DMADescTypeDef * const pxSentDesc = ( ETH_DMADescTypeDef * ) pxTxDescList->TxDesc[ ulIdx ];
+
+    pxTxDescList->PacketAddress[ ulIdx ] = ( uint32_t * ) pxDescriptor;
+    pxTxDescList->BuffersInUse = 1U;
+    pxSentDesc->DESC0 = 500U;
+    pxSentDesc->DESC1 = 7U;
+    pxSentDesc->DESC3 = ETH_DMATXNDESCWBF_OWN | ETH_DMATXNDESCWBF_TTSS;
+
+    prvGetTxTimestamps( pxEMACData );
+    TEST_CHECK_EQUAL( pdFAIL, xSTM32_GetTxTimestamp( &xInterface, &xTimestamp ) );
+
+    /* Written back with its stamp, which is taken once */
+    pxSentDesc->DESC3 = ETH_DMATXNDESCWBF_TTSS;
+
+    prvGetTxTimestamps( pxEMACData );
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_GetTxTimestamp( &xInterface, &xTimestamp ) );
+    TEST_CHECK_EQUAL( 7U, xTimestamp.ulSeconds );
+    TEST_CHECK_EQUAL( 500U, xTimestamp.ulNanoseconds );
+    TEST_CHECK_EQUAL( pdFAIL, xSTM32_GetTxTimestamp( &xInterface, &xTimestamp ) );
+
+    pxTxDescList->PacketAddress[ ulIdx ] = NULL;
+    pxTxDescList->BuffersInUse = 0U;
+    pxSentDesc->DESC3 = 0U;
+    vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_ptp_sync_slews_small_offset( void )
+{
+    EMACPtpExchange_t xExchange;
+    EMACPtpResult_t xResult;
+
+    prvSetUp();
+    TEST_CHECK_EQUAL( testNOMINAL_ADDEND, pxEMACData->ulTimestampAddend );
+
+    /* 1000 ns ahead over a 4000 ns path */
+    prvSetExchange( &xExchange, 1000, 4000 );
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+    TEST_CHECK_EQUAL( 1000, xResult.llOffsetNs );
+    TEST_CHECK_EQUAL( 4000, xResult.llDelayNs );
+    TEST_CHECK_EQUAL( pdFALSE, xResult.xStepped );
+
+    /* Integral -1000 / 8, then proportional -1000 / 2 */
+    TEST_CHECK_EQUAL( -125, pxEMACData->lPtpIntegralPpb );
+    TEST_CHECK_EQUAL( -625, xResult.lFrequencyPpb );
+    TEST_CHECK_EQUAL( -625, pxEMACData->lFrequencyPpb );
+
+    /* The addend is trimmed by -625 ppb, and the MAC asked to take it */
+    TEST_CHECK_EQUAL( testNOMINAL_ADDEND - 671U, ETH->MACTSAR );
+    TEST_CHECK( ( ETH->MACTSCR & ETH_MACTSCR_TSADDREG ) != 0U );
+    TEST_CHECK( ( ETH->MACTSCR & ETH_MACTSCR_TSUPDT ) == 0U );
+
+    /* Behind the master, with the integral carried over */
+    prvClockUpdated();
+    prvSetExchange( &xExchange, -800, 4000 );
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+    TEST_CHECK_EQUAL( -800, xResult.llOffsetNs );
+    TEST_CHECK_EQUAL( -25, pxEMACData->lPtpIntegralPpb );
+    TEST_CHECK_EQUAL( 375, xResult.lFrequencyPpb );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_ptp_sync_steps_large_offset( void )
+{
+    EMACPtpExchange_t xExchange;
+    EMACPtpResult_t xResult;
+
+    prvSetUp();
+
+    /* A trim in place before the step */
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_AdjustFrequency( &xInterface, 300 ) );
+    prvClockUpdated();
+
+    /* Exactly the step threshold ahead, stepped back by adding -2 ms */
+    prvSetExchange( &xExchange, niEMAC_PTP_STEP_NS, 100 );
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+    TEST_CHECK_EQUAL( niEMAC_PTP_STEP_NS, xResult.llOffsetNs );
+    TEST_CHECK_EQUAL( 100, xResult.llDelayNs );
+    TEST_CHECK_EQUAL( pdTRUE, xResult.xStepped );
+    TEST_CHECK( ( ETH->MACTSCR & ETH_MACTSCR_TSUPDT ) != 0U );
+
+    /* A negative offset borrows a second: -1 s + 999 ms */
+    TEST_CHECK_EQUAL( 0xFFFFFFFFU, ETH->MACSTSUR );
+    TEST_CHECK_EQUAL( niEMAC_NS_PER_SECOND - niEMAC_PTP_STEP_NS, ETH->MACSTNUR );
+
+    /* The step keeps the trim and leaves the servo alone */
+    TEST_CHECK_EQUAL( 300, xResult.lFrequencyPpb );
+    TEST_CHECK_EQUAL( 0, pxEMACData->lPtpIntegralPpb );
+
+    /* Just under the threshold behind, slewed */
+    prvClockUpdated();
+    prvSetExchange( &xExchange, -( niEMAC_PTP_STEP_NS - 8 ), 100 );
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+    TEST_CHECK_EQUAL( pdFALSE, xResult.xStepped );
+    TEST_CHECK( ( ETH->MACTSCR & ETH_MACTSCR_TSUPDT ) == 0U );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_ptp_sync_rejects_negative_delay( void )
+{
+    EMACPtpExchange_t xExchange;
+    EMACPtpResult_t xResult;
+
+    prvSetUp();
+
+    /* T4 before T3 by more than the Sync took */
+    prvSetExchange( &xExchange, 0, 1000 );
+    prvSetTimestamp( &xExchange.xT4, testBASE_NS + 100000LL - 3000LL );
+
+    TEST_CHECK_EQUAL( pdFAIL, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+    TEST_CHECK( xResult.llDelayNs < 0 );
+    TEST_CHECK_EQUAL( pdFALSE, xResult.xStepped );
+    TEST_CHECK_EQUAL( 0, xResult.lFrequencyPpb );
+    TEST_CHECK_EQUAL( 0, pxEMACData->lPtpIntegralPpb );
+    TEST_CHECK( ( ETH->MACTSCR & ( ETH_MACTSCR_TSADDREG | ETH_MACTSCR_TSUPDT ) ) == 0U );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_ptp_integral_is_clamped( void )
+{
+    EMACPtpExchange_t xExchange;
+    EMACPtpResult_t xResult;
+    int32_t lIntegralPpb = 0;
+    UBaseType_t uxSync;
+
+    prvSetUp();
+
+    /* Each sync just below the step threshold winds the integral by 124999 ppb */
+    for( uxSync = 0U; uxSync < 6U; uxSync++ )
+    {
+        prvClockUpdated();
+        prvSetExchange( &xExchange, niEMAC_PTP_STEP_NS - 8, 100 );
+
+        TEST_CHECK_EQUAL( pdPASS, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+        TEST_CHECK_EQUAL( pdFALSE, xResult.xStepped );
+
+        lIntegralPpb -= ( niEMAC_PTP_STEP_NS - 8 ) / niEMAC_PTP_KI_DIVISOR;
+        lIntegralPpb = ( lIntegralPpb < -niEMAC_PTP_MAX_PPB ) ? -niEMAC_PTP_MAX_PPB : lIntegralPpb;
+        TEST_CHECK_EQUAL( lIntegralPpb, pxEMACData->lPtpIntegralPpb );
+        TEST_CHECK( xResult.lFrequencyPpb >= -niEMAC_PTP_MAX_PPB );
+    }
+
+    TEST_CHECK_EQUAL( -niEMAC_PTP_MAX_PPB, pxEMACData->lPtpIntegralPpb );
+    TEST_CHECK_EQUAL( -niEMAC_PTP_MAX_PPB, xResult.lFrequencyPpb );
+
+    /* The clamp keeps the integral from winding up, so the first offset the
+     * other way brings it straight back in */
+    prvClockUpdated();
+    prvSetExchange( &xExchange, -8000, 100 );
+
+    TEST_CHECK_EQUAL( pdPASS, xSTM32_PtpSync( &xInterface, &xExchange, &xResult ) );
+    TEST_CHECK_EQUAL( -niEMAC_PTP_MAX_PPB + 1000, pxEMACData->lPtpIntegralPpb );
+    TEST_CHECK_EQUAL( -niEMAC_PTP_MAX_PPB + 5000, xResult.lFrequencyPpb );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_rx_timestamp_from_context_descriptor ),
+    TEST_CASE( test_tx_timestamp_from_written_back_descriptor ),
+    TEST_CASE( test_ptp_sync_slews_small_offset ),
+    TEST_CASE( test_ptp_sync_steps_large_offset ),
+    TEST_CASE( test_ptp_sync_rejects_negative_delay ),
+    TEST_CASE( test_ptp_integral_is_clamped ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
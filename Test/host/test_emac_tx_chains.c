@@ -0,0 +1,328 @@
+/* Host tests for the scatter-gather transmit of the EMAC driver. A frame may
+ * be a chain of network buffers linked through pxNextBuffer, which is given to
+ * the DMA as one linked ETH_BufferTypeDef list. The fake HAL of
+ * stm32/hal_fake.c lays the list out over the Tx ring as the STM32H7 HAL
+ * does, two buffers per descriptor. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/*-----------------------------------------------------------*/
+
+/* Creates the queues that prvEMACTaskStart() would create, then initialises
+ * and starts the EMAC. The EMAC task is not created, it would take the place
+ * of the test task. */
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+/* Sends what is left, then gives back every buffer the driver holds. */
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    xFakeEthCalls.xTxHold = 0;
+    ( void ) HAL_ETH_ReleaseTxPacket( &pxEMACData->xEthHandle );
+
+    if( pxEMACData->pxTxPending != NULL )
+    {
+        prvReleaseNetworkBufferDescriptor( pxEMACData->pxTxPending );
+        pxEMACData->pxTxPending = NULL;
+    }
+
+    while( xQueueReceive( pxEMACData->xTxQueue, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        prvReleaseNetworkBufferDescriptor( pxDescriptor );
+    }
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* Returns a frame of uxCount network buffers, the first one holding the headers. */
+static NetworkBufferDescriptor_t * prvGetChain( const size_t * puxLengths,
+                                                size_t uxCount )
+{
+    NetworkBufferDescriptor_t * pxHead = NULL;
+    NetworkBufferDescriptor_t * pxTail = NULL;
+    size_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < uxCount; uxIndex++ )
+    {
+        NetworkBufferDescriptor_t * const pxDescriptor = pxGetNetworkBufferWithDescriptor( niEMAC_DATA_BUFFER_SIZE, 0U );
+
+        configASSERT( pxDescriptor != NULL );
+        ( void ) memset( pxDescriptor->pucEthernetBuffer, ( int ) uxIndex, puxLengths[ uxIndex ] );
+        pxDescriptor->xDataLength = puxLengths[ uxIndex ];
+        pxDescriptor->pxNextBuffer = NULL;
+
+        if( pxTail == NULL )
+        {
+            pxHead = pxDescriptor;
+        }
+        else
+        {
+            pxTail->pxNextBuffer = pxDescriptor;
+        }
+
+        pxTail = pxDescriptor;
+    }
+
+    return pxHead;
+}
+/*-----------------------------------------------------------*/
+
+/* Queues a frame as xNetworkInterfaceOutput() would. */
+static void prvQueueFrame( NetworkBufferDescriptor_t * pxDescriptor )
+{
+    const BaseType_t xQueued = xQueueSendToBack( pxEMACData->xTxQueue, &pxDescriptor, 0U );
+
+    configASSERT( xQueued == pdPASS );
+}
+/*-----------------------------------------------------------*/
+
+static const ETH_DMADescTypeDef * prvTxDesc( uint32_t ulIndex )
+{
+    return &xDMADescTx[ 0 ][ ulIndex % ETH_TX_DESC_CNT ];
+}
+/*-----------------------------------------------------------*/
+
+static void test_single_buffer_takes_one_descriptor( void )
+{
+    static const size_t uxLengths[] = { 60U };
+
+    prvSetUp();
+
+    NetworkBufferDescriptor_t * const pxFrame = prvGetChain( uxLengths, 1U );
+
+    prvQueueFrame( pxFrame );
+    prvSendTxQueue( pxEMACData );
+
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( ( uint32_t ) ( uintptr_t ) pxFrame->pucEthernetBuffer, prvTxDesc( 0U )->DESC0 );
+    TEST_CHECK_EQUAL( 60, prvTxDesc( 0U )->DESC2 & ETH_DMATXNDESCRF_B1L );
+    TEST_CHECK_EQUAL( 0, prvTxDesc( 0U )->DESC1 );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 0 ] == ( uint32_t * ) pxFrame );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_chain_takes_a_descriptor_per_two_buffers( void )
+{
+    static const size_t uxLengths[] = { 42U, 100U, 200U };
+
+    prvSetUp();
+
+    NetworkBufferDescriptor_t * const pxFrame = prvGetChain( uxLengths, 3U );
+    const NetworkBufferDescriptor_t * const pxSecond = pxFrame->pxNextBuffer;
+    const NetworkBufferDescriptor_t * const pxThird = pxSecond->pxNextBuffer;
+
+    prvQueueFrame( pxFrame );
+    prvSendTxQueue( pxEMACData );
+
+    TEST_CHECK_EQUAL( 2, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( 1, pxEMACData->xEMACStats.ulTxFrames );
+    TEST_CHECK_EQUAL( 342, pxEMACData->xEMACStats.ulTxBytes );
+
+    /* The headers and the first payload share a descriptor */
+    TEST_CHECK_EQUAL( ( uint32_t ) ( uintptr_t ) pxFrame->pucEthernetBuffer, prvTxDesc( 0U )->DESC0 );
+    TEST_CHECK_EQUAL( 42, prvTxDesc( 0U )->DESC2 & ETH_DMATXNDESCRF_B1L );
+    TEST_CHECK_EQUAL( ( uint32_t ) ( uintptr_t ) pxSecond->pucEthernetBuffer, prvTxDesc( 0U )->DESC1 );
+    TEST_CHECK_EQUAL( 100, ( prvTxDesc( 0U )->DESC2 & ETH_DMATXNDESCRF_B2L ) >> 16 );
+    TEST_CHECK_EQUAL( ( uint32_t ) ( uintptr_t ) pxThird->pucEthernetBuffer, prvTxDesc( 1U )->DESC0 );
+    TEST_CHECK_EQUAL( 200, prvTxDesc( 1U )->DESC2 & ETH_DMATXNDESCRF_B1L );
+    TEST_CHECK_EQUAL( 0, prvTxDesc( 1U )->DESC1 );
+
+    /* Released once, through the last descriptor */
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 0 ] == NULL );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 1 ] == ( uint32_t * ) pxFrame );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_sent_chain_releases_every_buffer( void )
+{
+    static const size_t uxLengths[] = { 42U, 500U, 500U, 400U, 18U };
+
+    prvSetUp();
+
+    const UBaseType_t uxFreeBuffers = uxGetNumberOfFreeNetworkBuffers();
+
+    prvQueueFrame( prvGetChain( uxLengths, 5U ) );
+    prvSendTxQueue( pxEMACData );
+    TEST_CHECK_EQUAL( 3, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( uxFreeBuffers - 5U, uxGetNumberOfFreeNetworkBuffers() );
+
+    ( void ) HAL_ETH_ReleaseTxPacket( &pxEMACData->xEthHandle );
+
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( uxFreeBuffers, uxGetNumberOfFreeNetworkBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_chain_waits_for_room( void )
+{
+    static const size_t uxSingle[] = { 60U };
+    static const size_t uxLengths[] = { 42U, 100U, 200U };
+    NetworkBufferDescriptor_t * pxChain;
+    NetworkBufferDescriptor_t * pxBehind;
+    size_t uxIndex;
+
+    prvSetUp();
+
+    /* One descriptor left, the chain needs two */
+    xFakeEthCalls.xTxHold = 1;
+
+    for( uxIndex = 0U; uxIndex < ( ETH_TX_DESC_CNT - 1U ); uxIndex++ )
+    {
+        prvQueueFrame( prvGetChain( uxSingle, 1U ) );
+    }
+
+    pxChain = prvGetChain( uxLengths, 3U );
+    pxBehind = prvGetChain( uxSingle, 1U );
+    prvQueueFrame( pxChain );
+    prvQueueFrame( pxBehind );
+    prvSendTxQueue( pxEMACData );
+
+    TEST_CHECK_EQUAL( ETH_TX_DESC_CNT - 1U, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( ETH_TX_DESC_CNT - 1U, pxEMACData->xEMACStats.ulTxFrames );
+    TEST_CHECK( pxEMACData->pxTxPending == pxChain );
+    TEST_CHECK_EQUAL( 1, uxQueueMessagesWaiting( pxEMACData->xTxQueue ) );
+
+    /* The ring drains, the chain goes out first and whole */
+    xFakeEthCalls.xTxHold = 0;
+    ( void ) HAL_ETH_ReleaseTxPacket( &pxEMACData->xEthHandle );
+    prvSendTxQueue( pxEMACData );
+
+    TEST_CHECK( pxEMACData->pxTxPending == NULL );
+    TEST_CHECK_EQUAL( 3, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ ETH_TX_DESC_CNT - 1U ] == NULL );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 0 ] == ( uint32_t * ) pxChain );
+    TEST_CHECK( pxEMACData->xEthHandle.TxDescList.PacketAddress[ 1 ] == ( uint32_t * ) pxBehind );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_invalid_chains_are_refused( void )
+{
+    static const size_t uxLengths[] = { 42U, 100U, 200U };
+    static const size_t uxTooLong[] = { 42U, niEMAC_DATA_BUFFER_SIZE - 42U, 1U };
+    size_t uxMany[ niEMAC_TX_MAX_BUFFERS + 1U ];
+    UBaseType_t uxCount = 0U;
+    size_t uxIndex;
+
+    prvSetUp();
+
+    NetworkBufferDescriptor_t * const pxFrame = prvGetChain( uxLengths, 3U );
+
+    TEST_CHECK_EQUAL( 342, prvGetTxFrameLength( pxFrame, &uxCount ) );
+    TEST_CHECK_EQUAL( 3, uxCount );
+
+    /* An empty link */
+    pxFrame->pxNextBuffer->xDataLength = 0U;
+    TEST_CHECK_EQUAL( 0, prvGetTxFrameLength( pxFrame, NULL ) );
+    prvReleaseNetworkBufferDescriptor( pxFrame );
+
+    /* Longer than one Ethernet frame */
+    NetworkBufferDescriptor_t * const pxLong = prvGetChain( uxTooLong, 3U );
+    TEST_CHECK_EQUAL( 0, prvGetTxFrameLength( pxLong, NULL ) );
+    prvReleaseNetworkBufferDescriptor( pxLong );
+
+    /* More buffers than the whole Tx ring can point at */
+    for( uxIndex = 0U; uxIndex < ( niEMAC_TX_MAX_BUFFERS + 1U ); uxIndex++ )
+    {
+        uxMany[ uxIndex ] = 60U;
+    }
+
+    NetworkBufferDescriptor_t * const pxMany = prvGetChain( uxMany, niEMAC_TX_MAX_BUFFERS + 1U );
+    TEST_CHECK_EQUAL( 0, prvGetTxFrameLength( pxMany, NULL ) );
+    prvReleaseNetworkBufferDescriptor( pxMany );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_single_buffer_takes_one_descriptor ),
+    TEST_CASE( test_chain_takes_a_descriptor_per_two_buffers ),
+    TEST_CASE( test_sent_chain_releases_every_buffer ),
+    TEST_CASE( test_chain_waits_for_room ),
+    TEST_CASE( test_invalid_chains_are_refused ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
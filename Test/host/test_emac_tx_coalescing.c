@@ -0,0 +1,240 @@
+/* Host tests for the Tx interrupt coalescing of the EMAC driver. The Tx
+ * interrupt stays masked while frames go out, and the EMAC task releases the
+ * sent frames in one pass. It is unmasked once niEMAC_TX_COALESCE_FRAMES went
+ * out unsignalled, or when frames wait for room in the Tx ring. The driver is
+ * built for the STM32H7 against stm32/hal_fake.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NetworkInterface.c is included, so the test can reach the context and the
+ * static helpers. */
+#include "../../Libs/FreeRTOS-Plus-TCP/portable/NetworkInterface.c"
+
+#include "hal_fake.h"
+#include "test_support.h"
+
+#define testFRAME_LENGTH    60U
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static EMACData_t * const pxEMACData = &xEMACData[ 0 ];
+
+/*-----------------------------------------------------------*/
+
+/* Creates the queues that prvEMACTaskStart() would create, then initialises
+ * and starts the EMAC. The EMAC task is not created, it would take the place
+ * of the test task. */
+static void prvSetUp( void )
+{
+    static const uint8_t ucIPAddress[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 10U };
+    static const uint8_t ucNetMask[ ipIP_ADDRESS_LENGTH_BYTES ] = { 255U, 255U, 255U, 0U };
+    static const uint8_t ucGateway[ ipIP_ADDRESS_LENGTH_BYTES ] = { 192U, 168U, 1U, 1U };
+    static const uint8_t ucMACAddress[ ipMAC_ADDRESS_LENGTH_BYTES ] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+
+    ( void ) xNetworkBuffersInitialise();
+    vFakeEthReset();
+    pxNetworkInterfaces = NULL;
+    pxNetworkEndPoints = NULL;
+
+    ( void ) pxSTM32_FillInterfaceDescriptor( 0, &xInterface );
+    FreeRTOS_FillEndPoint( &xInterface, &xEndPoint, ucIPAddress, ucNetMask, ucGateway, ucGateway, ucMACAddress );
+
+    pxEMACData->xRxReserve = xQueueCreate( ( UBaseType_t ) niEMAC_RX_RESERVE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    pxEMACData->xTxQueue = xQueueCreate( ( UBaseType_t ) niEMAC_TX_QUEUE_LENGTH, ( UBaseType_t ) sizeof( NetworkBufferDescriptor_t * ) );
+    prvRefillRxReserve( pxEMACData );
+
+    prvTakeEthContext( pxEMACData );
+    BaseType_t xStarted = prvEthConfigInit( pxEMACData, &xInterface );
+
+    if( xStarted != pdFALSE )
+    {
+        xStarted = prvEthStart( pxEMACData );
+    }
+
+    prvGiveEthContext( pxEMACData );
+    configASSERT( xStarted != pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+/* Sends what is left, then gives back every buffer the driver holds. */
+static void prvTearDown( void )
+{
+    NetworkBufferDescriptor_t * pxDescriptor;
+    size_t uxDesc;
+
+    xFakeEthCalls.xTxHold = 0;
+    ( void ) HAL_ETH_ReleaseTxPacket( &pxEMACData->xEthHandle );
+
+    while( xQueueReceive( pxEMACData->xTxQueue, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    while( xQueueReceive( pxEMACData->xRxReserve, &pxDescriptor, 0U ) != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+    }
+
+    for( uxDesc = 0U; uxDesc < ETH_RX_DESC_CNT; uxDesc++ )
+    {
+        if( xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 != 0U )
+        {
+            pxDescriptor = pxPacketBuffer_to_NetworkBuffer( ( const void * ) ( uintptr_t ) xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 );
+            vReleaseNetworkBufferAndDescriptor( pxDescriptor );
+            xDMADescRx[ 0 ][ uxDesc ].BackupAddr0 = 0U;
+        }
+    }
+
+    vQueueDelete( pxEMACData->xTxQueue );
+    vQueueDelete( pxEMACData->xRxReserve );
+    pxEMACData->xTxQueue = NULL;
+    pxEMACData->xRxReserve = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* Queues uxCount frames as xNetworkInterfaceOutput() would. */
+static void prvQueueFrames( UBaseType_t uxCount )
+{
+    UBaseType_t uxIndex;
+
+    for( uxIndex = 0U; uxIndex < uxCount; uxIndex++ )
+    {
+        NetworkBufferDescriptor_t * pxDescriptor = pxGetNetworkBufferWithDescriptor( testFRAME_LENGTH, 0U );
+
+        configASSERT( pxDescriptor != NULL );
+        ( void ) memset( pxDescriptor->pucEthernetBuffer, 0, testFRAME_LENGTH );
+
+        const BaseType_t xQueued = xQueueSendToBack( pxEMACData->xTxQueue, &pxDescriptor, 0U );
+        configASSERT( xQueued == pdPASS );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTxInterruptEnabled( void )
+{
+    return ( ( ETH->DMACIER & ETH_DMACIER_TIE ) != 0U ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void test_tx_interrupt_is_masked_after_start( void )
+{
+    prvSetUp();
+
+    TEST_CHECK_EQUAL( pdFALSE, pxEMACData->xTxIrqEnabled );
+    TEST_CHECK_EQUAL( pdFALSE, prvTxInterruptEnabled() );
+    TEST_CHECK_EQUAL( 0, pxEMACData->uxTxUnsignalled );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_one_pass_releases_every_completion( void )
+{
+    prvSetUp();
+
+    const UBaseType_t uxFreeBuffers = uxGetNumberOfFreeNetworkBuffers();
+
+    prvQueueFrames( 3U );
+    prvSendTxQueue( pxEMACData );
+    TEST_CHECK_EQUAL( 3, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( 3, pxEMACData->uxTxUnsignalled );
+
+    /* A pass that no Tx interrupt woke up */
+    prvCoalesceTx( pxEMACData, 0U );
+
+    TEST_CHECK_EQUAL( 1, xFakeEthCalls.ulTxReleases );
+    TEST_CHECK_EQUAL( 0, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( uxFreeBuffers, uxGetNumberOfFreeNetworkBuffers() );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_interrupt_is_unmasked_after_coalesce_frames( void )
+{
+    prvSetUp();
+
+    /* Fewer frames than niEMAC_TX_COALESCE_FRAMES */
+    prvQueueFrames( niEMAC_TX_COALESCE_FRAMES - 1U );
+    prvSendTxQueue( pxEMACData );
+    prvCoalesceTx( pxEMACData, 0U );
+
+    TEST_CHECK_EQUAL( pdFALSE, prvTxInterruptEnabled() );
+    TEST_CHECK_EQUAL( niEMAC_TX_COALESCE_FRAMES - 1U, pxEMACData->uxTxUnsignalled );
+
+    /* One more reaches it */
+    prvQueueFrames( 1U );
+    prvSendTxQueue( pxEMACData );
+    prvCoalesceTx( pxEMACData, 0U );
+
+    TEST_CHECK_EQUAL( pdTRUE, prvTxInterruptEnabled() );
+    TEST_CHECK_EQUAL( pdTRUE, pxEMACData->xTxIrqEnabled );
+    TEST_CHECK_EQUAL( 0, pxEMACData->uxTxUnsignalled );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_tx_event_masks_interrupt_again( void )
+{
+    prvSetUp();
+
+    prvQueueFrames( niEMAC_TX_COALESCE_FRAMES );
+    prvSendTxQueue( pxEMACData );
+    prvCoalesceTx( pxEMACData, 0U );
+    TEST_CHECK_EQUAL( pdTRUE, prvTxInterruptEnabled() );
+
+    /* The interrupt that was asked for came in */
+    prvCoalesceTx( pxEMACData, eMacEventTx );
+
+    TEST_CHECK_EQUAL( pdFALSE, prvTxInterruptEnabled() );
+    TEST_CHECK_EQUAL( pdFALSE, pxEMACData->xTxIrqEnabled );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static void test_waiting_frames_unmask_interrupt( void )
+{
+    prvSetUp();
+
+    /* The DMA still owns the whole ring, one frame stays in the queue */
+    xFakeEthCalls.xTxHold = 1;
+    prvQueueFrames( ETH_TX_DESC_CNT + 1U );
+    prvSendTxQueue( pxEMACData );
+    TEST_CHECK_EQUAL( ETH_TX_DESC_CNT, pxEMACData->xEthHandle.TxDescList.BuffersInUse );
+    TEST_CHECK_EQUAL( 1, uxQueueMessagesWaiting( pxEMACData->xTxQueue ) );
+
+    /* Below the frame count, only the waiting frame asks for the interrupt */
+    pxEMACData->uxTxUnsignalled = 0U;
+    prvCoalesceTx( pxEMACData, 0U );
+
+    TEST_CHECK_EQUAL( pdTRUE, prvTxInterruptEnabled() );
+    TEST_CHECK_EQUAL( 1, uxQueueMessagesWaiting( pxEMACData->xTxQueue ) );
+
+    prvTearDown();
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_tx_interrupt_is_masked_after_start ),
+    TEST_CASE( test_one_pass_releases_every_completion ),
+    TEST_CASE( test_interrupt_is_unmasked_after_coalesce_frames ),
+    TEST_CASE( test_tx_event_masks_interrupt_again ),
+    TEST_CASE( test_waiting_frames_unmask_interrupt ),
+};
+
+int main( void )
+{
+    if( xFakeMapRegisters() == 0 )
+    {
+        ( void ) printf( "Cannot map the peripheral registers\n" );
+        return EXIT_FAILURE;
+    }
+
+    return TEST_RUN( xTestCases );
+}
@@ -0,0 +1,378 @@
+/* Host tests for the TCP segmentation offload in FreeRTOS_TCP_Transmission.c.
+ * A socket with a sliding window and a Tx stream is set up by hand, then
+ * prvTCPPrepareSend() builds the super-segment that the driver would cut. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "FreeRTOS_Stream_Buffer.h"
+#include "FreeRTOS_TCP_WIN.h"
+#include "FreeRTOS_TCP_Transmission.h"
+#include "NetworkBufferManagement.h"
+
+#include "test_support.h"
+
+#define testMSS                 1460U
+#define testSEQUENCE_NUMBER     1000U
+#define testSTREAM_LENGTH       ( 16U * testMSS )
+#define testHEADER_LENGTH       ( ipSIZE_OF_IPv4_HEADER + ipSIZE_OF_TCP_HEADER )
+#define testPAYLOAD_OFFSET      ( ipSIZE_OF_ETH_HEADER + testHEADER_LENGTH )
+
+static FreeRTOS_Socket_t xSocket;
+
+static NetworkInterface_t xInterface;
+
+static NetworkEndPoint_t xEndPoint;
+
+static NetworkBufferDescriptor_t * pxSentBuffer;
+
+static uint8_t ucPayload[ testSTREAM_LENGTH ];
+
+/*-----------------------------------------------------------*/
+
+static void prvCreateSocket( uint32_t ulPeerWindow )
+{
+    size_t uxIndex;
+
+    ( void ) xNetworkBuffersInitialise();
+
+    ( void ) memset( &xSocket, 0, sizeof( xSocket ) );
+    xSocket.ucProtocol = ( uint8_t ) FREERTOS_IPPROTO_TCP;
+    xSocket.u.xTCP.eTCPState = eESTABLISHED;
+    xSocket.u.xTCP.usMSS = ( uint16_t ) testMSS;
+    xSocket.u.xTCP.ulWindowSize = ulPeerWindow;
+
+    vTCPWindowCreate( &( xSocket.u.xTCP.xTCPWindow ), testSTREAM_LENGTH, testSTREAM_LENGTH, 0U, testSEQUENCE_NUMBER, testMSS );
+
+    xSocket.u.xTCP.txStream = ( StreamBuffer_t * ) calloc( 1U, sizeof( StreamBuffer_t ) + testSTREAM_LENGTH + 1U );
+    xSocket.u.xTCP.txStream->LENGTH = testSTREAM_LENGTH + 1U;
+
+    for( uxIndex = 0U; uxIndex < sizeof( ucPayload ); uxIndex++ )
+    {
+        ucPayload[ uxIndex ] = ( uint8_t ) ( ( uxIndex * 7U ) + ( uxIndex >> 8 ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvDeleteSocket( void )
+{
+    vTCPWindowDestroy( &( xSocket.u.xTCP.xTCPWindow ) );
+    free( xSocket.u.xTCP.txStream );
+    xSocket.u.xTCP.txStream = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* What FreeRTOS_send() does: add to the stream, then to the sliding window. */
+static void prvSend( size_t uxOffset,
+                     size_t uxLength )
+{
+    ( void ) uxStreamBufferAdd( xSocket.u.xTCP.txStream, 0U, &( ucPayload[ uxOffset ] ), uxLength );
+    prvTCPAddTxData( &xSocket );
+}
+/*-----------------------------------------------------------*/
+
+static void prvReleaseChain( NetworkBufferDescriptor_t * pxBuffer )
+{
+    NetworkBufferDescriptor_t * pxNext;
+
+    while( pxBuffer != NULL )
+    {
+        pxNext = pxBuffer->pxNextBuffer;
+        vReleaseNetworkBufferAndDescriptor( pxBuffer );
+        pxBuffer = pxNext;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Checks that a super-segment carries the expected segments, in order and
+ * with the bytes of the stream starting at uxOffset. */
+static BaseType_t prvCheckChain( const NetworkBufferDescriptor_t * pxBuffer,
+                                 size_t uxOffset,
+                                 const size_t * puxLengths,
+                                 size_t uxCount )
+{
+    BaseType_t xResult = pdTRUE;
+    size_t uxIndex;
+
+    if( ( pxBuffer == NULL ) || ( memcmp( &( pxBuffer->pucEthernetBuffer[ testPAYLOAD_OFFSET ] ), &( ucPayload[ uxOffset ] ), puxLengths[ 0 ] ) != 0 ) )
+    {
+        xResult = pdFALSE;
+    }
+    else
+    {
+        uxOffset += puxLengths[ 0 ];
+        pxBuffer = pxBuffer->pxNextBuffer;
+
+        for( uxIndex = 1U; ( uxIndex < uxCount ) && ( xResult != pdFALSE ); uxIndex++ )
+        {
+            if( ( pxBuffer == NULL ) ||
+                ( pxBuffer->xDataLength != puxLengths[ uxIndex ] ) ||
+                ( memcmp( pxBuffer->pucEthernetBuffer, &( ucPayload[ uxOffset ] ), puxLengths[ uxIndex ] ) != 0 ) )
+            {
+                xResult = pdFALSE;
+            }
+            else
+            {
+                uxOffset += puxLengths[ uxIndex ];
+                pxBuffer = pxBuffer->pxNextBuffer;
+            }
+        }
+
+        if( pxBuffer != NULL )
+        {
+            xResult = pdFALSE;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void test_full_segments_are_combined( void )
+{
+    const size_t uxLengths[] = { testMSS, testMSS, testMSS, testMSS, testMSS };
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, 5U * testMSS );
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 5U * testMSS ), lLength );
+    TEST_CHECK( pxBuffer != NULL );
+    TEST_CHECK_EQUAL( testMSS, pxBuffer->usTCPSegmentSize );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxLengths, 5U ) != pdFALSE );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - 5U, uxGetNumberOfFreeNetworkBuffers() );
+
+    /* The window tracks every segment on its own, so an ACK of the first
+     * segment only releases that segment. */
+    TEST_CHECK_EQUAL( testMSS, ulTCPWindowTxAck( &( xSocket.u.xTCP.xTCPWindow ), testSEQUENCE_NUMBER + testMSS ) );
+    TEST_CHECK_EQUAL( 4U * testMSS, ulTCPWindowTxAck( &( xSocket.u.xTCP.xTCPWindow ), testSEQUENCE_NUMBER + ( 5U * testMSS ) ) );
+
+    prvReleaseChain( pxBuffer );
+    prvDeleteSocket();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_super_segment_is_limited_to_max_segments( void )
+{
+    const size_t uxFirst[] = { testMSS, testMSS, testMSS, testMSS, testMSS };
+    const size_t uxSecond[] = { testMSS, testMSS };
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, ( ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS + 2U ) * testMSS );
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS * testMSS ), lLength );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxFirst, ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS ) != pdFALSE );
+    prvReleaseChain( pxBuffer );
+
+    pxBuffer = NULL;
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 2U * testMSS ), lLength );
+    TEST_CHECK_EQUAL( testMSS, pxBuffer->usTCPSegmentSize );
+    TEST_CHECK( prvCheckChain( pxBuffer, ipconfigTCP_SEGMENTATION_OFFLOAD_MAX_SEGMENTS * testMSS, uxSecond, 2U ) != pdFALSE );
+    prvReleaseChain( pxBuffer );
+
+    prvDeleteSocket();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_short_segment_ends_super_segment( void )
+{
+    const size_t uxLengths[] = { testMSS, testMSS, 100U };
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, ( 2U * testMSS ) + 100U );
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+
+    /* The driver cuts at usTCPSegmentSize, the last segment is shorter. */
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 2U * testMSS ) + 100U, lLength );
+    TEST_CHECK_EQUAL( testMSS, pxBuffer->usTCPSegmentSize );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxLengths, 3U ) != pdFALSE );
+
+    prvReleaseChain( pxBuffer );
+    prvDeleteSocket();
+}
+/*-----------------------------------------------------------*/
+
+static void test_single_segment_is_not_offloaded( void )
+{
+    const size_t uxLengths[] = { 100U };
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, 100U );
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + 100U, lLength );
+    TEST_CHECK_EQUAL( 0U, pxBuffer->usTCPSegmentSize );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxLengths, 1U ) != pdFALSE );
+
+    prvReleaseChain( pxBuffer );
+    prvDeleteSocket();
+}
+/*-----------------------------------------------------------*/
+
+static void test_peer_window_limits_super_segment( void )
+{
+    const size_t uxLengths[] = { testMSS, testMSS };
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( 2U * testMSS );
+    prvSend( 0U, 4U * testMSS );
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 2U * testMSS ), lLength );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxLengths, 2U ) != pdFALSE );
+
+    prvReleaseChain( pxBuffer );
+    prvDeleteSocket();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_buffer_shortage_sends_fewer_segments( void )
+{
+    const size_t uxFirst[] = { testMSS, testMSS };
+    const size_t uxSecond[] = { testMSS, testMSS };
+    NetworkBufferDescriptor_t * pxHeld[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    size_t uxHeld = 0U;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, 4U * testMSS );
+
+    /* Leave two full-size buffers: one for the headers, one extra segment. */
+    while( uxGetNumberOfFreeNetworkBuffers() > 2U )
+    {
+        pxHeld[ uxHeld++ ] = pxGetNetworkBufferWithDescriptor( testMSS, 0U );
+    }
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 2U * testMSS ), lLength );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxFirst, 2U ) != pdFALSE );
+    prvReleaseChain( pxBuffer );
+
+    /* The segments that did not fit stay queued and follow next time. */
+    pxBuffer = NULL;
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 2U * testMSS ), lLength );
+    TEST_CHECK( prvCheckChain( pxBuffer, 2U * testMSS, uxSecond, 2U ) != pdFALSE );
+    prvReleaseChain( pxBuffer );
+
+    while( uxHeld > 0U )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxHeld[ --uxHeld ] );
+    }
+
+    prvDeleteSocket();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+/* The network interface takes the frame, the test releases it. */
+static BaseType_t prvOutput( NetworkInterface_t * pxDescriptor,
+                             NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                             BaseType_t xReleaseAfterSend )
+{
+    ( void ) pxDescriptor;
+
+    configASSERT( xReleaseAfterSend != pdFALSE );
+    pxSentBuffer = pxNetworkBuffer;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void test_return_packet_hands_whole_chain_to_driver( void )
+{
+    const size_t uxLengths[] = { testMSS, testMSS, testMSS };
+    const IPHeader_t * pxIPHeader;
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, 3U * testMSS );
+
+    ( void ) memset( &xInterface, 0, sizeof( xInterface ) );
+    ( void ) memset( &xEndPoint, 0, sizeof( xEndPoint ) );
+    xInterface.pfOutput = prvOutput;
+    xEndPoint.pxNetworkInterface = &xInterface;
+    pxSentBuffer = NULL;
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+    TEST_CHECK( lLength > 0 );
+    pxBuffer->pxEndPoint = &xEndPoint;
+
+    prvTCPReturnPacket( &xSocket, pxBuffer, ( uint32_t ) lLength, pdTRUE );
+
+    /* The IP length covers the super-segment, the first buffer only holds
+     * the headers and the first segment. */
+    TEST_CHECK( pxSentBuffer == pxBuffer );
+    pxIPHeader = ( const IPHeader_t * ) &( pxBuffer->pucEthernetBuffer[ ipSIZE_OF_ETH_HEADER ] );
+    TEST_CHECK_EQUAL( testHEADER_LENGTH + ( 3U * testMSS ), FreeRTOS_ntohs( pxIPHeader->usLength ) );
+    TEST_CHECK_EQUAL( ipSIZE_OF_ETH_HEADER + testHEADER_LENGTH + testMSS, pxBuffer->xDataLength );
+    TEST_CHECK_EQUAL( testMSS, pxBuffer->usTCPSegmentSize );
+    TEST_CHECK( prvCheckChain( pxBuffer, 0U, uxLengths, 3U ) != pdFALSE );
+
+    prvReleaseChain( pxBuffer );
+    prvDeleteSocket();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static void test_unsent_super_segment_is_released( void )
+{
+    NetworkBufferDescriptor_t * pxBuffer = NULL;
+    int32_t lLength;
+
+    prvCreateSocket( testSTREAM_LENGTH );
+    prvSend( 0U, 3U * testMSS );
+
+    lLength = prvTCPPrepareSend( &xSocket, &pxBuffer, 0U );
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS - 3U, uxGetNumberOfFreeNetworkBuffers() );
+
+    /* No end-point is known, so nothing is sent and every segment of the
+     * chain must go back to the pool. */
+    prvTCPReturnPacket( &xSocket, pxBuffer, ( uint32_t ) lLength, pdTRUE );
+
+    prvDeleteSocket();
+    TEST_CHECK_EQUAL( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS, uxGetNumberOfFreeNetworkBuffers() );
+}
+/*-----------------------------------------------------------*/
+
+static const TestCase_t xTestCases[] =
+{
+    TEST_CASE( test_full_segments_are_combined ),
+    TEST_CASE( test_super_segment_is_limited_to_max_segments ),
+    TEST_CASE( test_short_segment_ends_super_segment ),
+    TEST_CASE( test_single_segment_is_not_offloaded ),
+    TEST_CASE( test_peer_window_limits_super_segment ),
+    TEST_CASE( test_buffer_shortage_sends_fewer_segments ),
+    TEST_CASE( test_return_packet_hands_whole_chain_to_driver ),
+    TEST_CASE( test_unsent_super_segment_is_released ),
+};
+
+int main( void )
+{
+    return TEST_RUN( xTestCases );
+}